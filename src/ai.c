@@ -91,6 +91,7 @@
 #include "nlua_rnd.h"
 #include "nlua_pilot.h"
 #include "nlua_faction.h"
+#include "nlua_prof.h"
 #include "board.h"
 #include "hook.h"
 #include "array.h"
@@ -469,7 +470,7 @@ void ai_setPilot( Pilot *p )
  */
 static void ai_run( lua_State *L, const char *funcname )
 {
-   int errf;
+   int errf, mark;
 #if DEBUGGING
    lua_pushcfunction(L, nlua_errTrace);
    errf = -2;
@@ -491,10 +492,12 @@ static void ai_run( lua_State *L, const char *funcname )
    }
 #endif /* DEBUGGING */
 
+   mark = nlua_profEnter( L, "ai", cur_pilot->ai->name );
    if (lua_pcall(L, 0, 0, errf)) { /* error has occurred */
       WARN("Pilot '%s' ai -> '%s': %s", cur_pilot->name, funcname, lua_tostring(L,-1));
       lua_pop(L,1);
    }
+   nlua_profLeave( L, mark );
 #if DEBUGGING
    lua_pop(L,1); /* Pop the cfunction. */
 #endif /* DEBUGGING */
@@ -914,7 +917,7 @@ void ai_think( Pilot* pilot, const double dt )
  */
 void ai_attacked( Pilot* attacked, const unsigned int attacker )
 {
-   int errf;
+   int errf, mark;
    lua_State *L;
    HookParam hparam;
 
@@ -943,10 +946,12 @@ void ai_attacked( Pilot* attacked, const unsigned int attacker )
 
    lua_getglobal(L, "attacked");
    lua_pushnumber(L, attacker);
+   mark = nlua_profEnter( L, "ai", cur_pilot->ai->name );
    if (lua_pcall(L, 1, 0, errf)) {
       WARN("Pilot '%s' ai -> 'attacked': %s", cur_pilot->name, lua_tostring(L,-1));
       lua_pop(L,1);
    }
+   nlua_profLeave( L, mark );
 #if DEBUGGING
    lua_pop(L,1);
 #endif /* DEBUGGING */
@@ -987,7 +992,7 @@ void ai_getDistress( Pilot* p, const Pilot* distressed )
 {
    lua_State *L;
    LuaPilot ldistressed, ltarget;
-   int errf;
+   int errf, mark;
 
    /* Ignore distress signals when under manual control. */
    if (pilot_isFlag( p, PILOT_MANUAL_CONTROL ))
@@ -1023,10 +1028,12 @@ void ai_getDistress( Pilot* p, const Pilot* distressed )
    ltarget.pilot = distressed->target;
    lua_pushpilot(L, ldistressed);
    lua_pushpilot(L, ltarget);
+   mark = nlua_profEnter( L, "ai", cur_pilot->ai->name );
    if (lua_pcall(L, 2, 0, errf)) {
       WARN("Pilot '%s' ai -> 'distress': %s", cur_pilot->name, lua_tostring(L,-1));
       lua_pop(L,1);
    }
+   nlua_profLeave( L, mark );
 #if DEBUGGING
    lua_pop(L,1);
 #endif /* DEBUGGING */
@@ -1045,7 +1052,7 @@ static void ai_create( Pilot* pilot, char *param )
 {
    LuaPilot lp;
    lua_State *L;
-   int errf, nparam;
+   int errf, nparam, mark;
    char *func;
 
    L = equip_L;
@@ -1070,10 +1077,13 @@ static void ai_create( Pilot* pilot, char *param )
       lua_getglobal(L, func);
       lp.pilot = pilot->id;
       lua_pushpilot(L,lp);
+      mark = nlua_profEnter( L, "equip",
+            (L == equip_L) ? "generic" : faction_name( pilot->faction ) );
       if (lua_pcall(L, 1, 0, errf)) { /* Error has occurred. */
          WARN("Pilot '%s' equip -> '%s': %s", pilot->name, func, lua_tostring(L,-1));
          lua_pop(L,1);
       }
+      nlua_profLeave( L, mark );
    }
 
    /* Since the pilot changes outfits and cores, we must heal him up. */
@@ -1117,10 +1127,12 @@ static void ai_create( Pilot* pilot, char *param )
    }
 
    /* Run function. */
+   mark = nlua_profEnter( L, "ai", cur_pilot->ai->name );
    if (lua_pcall(L, nparam, 0, errf)) { /* error has occurred */
       WARN("Pilot '%s' ai -> '%s': %s", cur_pilot->name, "create", lua_tostring(L,-1));
       lua_pop(L,1);
    }
+   nlua_profLeave( L, mark );
 #if DEBUGGING
    lua_pop(L,1);
 #endif /* DEBUGGING */
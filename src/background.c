@@ -71,11 +71,45 @@ static unsigned int mstars = 0; /**< Memory stars are taking. */
 static GLfloat star_x = 0.; /**< Star X movement. */
 static GLfloat star_y = 0.; /**< Star Y movement. */
 
+/*
+ * Shader stars.
+ *
+ * The star positions are uploaded once and never touched again, the vertex
+ *  shader applies the accumulated parallax offset, wraps the stars around the
+ *  star buffer and stretches the tails when going fast. Each star is made of a
+ *  head and tail vertex with the format (x, y, brightness, is_tail).
+ */
+#define STAR_REBASE  10000. /**< Offset at which the star positions are baked to keep float precision. */
+static GLuint star_program = 0; /**< Star shader program, 0 if using the CPU path. */
+static GLint star_uOffset = -1; /**< Location of the offset uniform. */
+static GLint star_uDim = -1; /**< Location of the star buffer dimension uniform. */
+static GLint star_uStreak = -1; /**< Location of the streak uniform. */
+static gl_vbo *star_shaderVBO = NULL; /**< Static VBO with the star positions for the shader. */
+static double star_offx = 0.; /**< Accumulated X offset applied by the shader. */
+static double star_offy = 0.; /**< Accumulated Y offset applied by the shader. */
+static const char star_vertShader[] =
+   "#version 110\n"
+   "uniform vec2 star_offset;\n"
+   "uniform vec2 star_dim;\n"
+   "uniform vec2 star_streak;\n"
+   "void main(void) {\n"
+   "   vec2 p = gl_Vertex.xy + star_offset / (9. - 10.*gl_Vertex.z);\n"
+   "   p = mod( p + 0.5*star_dim, star_dim ) - 0.5*star_dim;\n"
+   "   p += gl_Vertex.w * gl_Vertex.z * star_streak;\n"
+   "   gl_Position = gl_ModelViewProjectionMatrix * vec4( p, 0., 1. );\n"
+   "   gl_FrontColor = gl_Color;\n"
+   "}\n";
+
 
 /*
  * Prototypes.
  */
 static void background_renderImages( background_image_t *bkg_arr );
+static void background_starDim( GLfloat *w, GLfloat *h );
+static void background_initStarShader (void);
+static void background_uploadStarShader (void);
+static void background_bakeStars (void);
+static void background_updateStarsCPU (void);
 static lua_State* background_create( const char *path );
 static void background_clearCurrent (void);
 static void background_clearImgArr( background_image_t **arr );
@@ -100,10 +134,7 @@ void background_initStars( int n )
    size /= pow2(conf.zoom_far);
 
    /* Calculate star buffer. */
-   w  = (SCREEN_W + 2.*STAR_BUF);
-   w += conf.zoom_stars * (w / conf.zoom_far - 1.);
-   h  = (SCREEN_H + 2.*STAR_BUF);
-   h += conf.zoom_stars * (h / conf.zoom_far - 1.);
+   background_starDim( &w, &h );
    hw = w / 2.;
    hh = h / 2.;
 
@@ -144,11 +175,117 @@ void background_initStars( int n )
       star_colourVBO = NULL;
    }
 
-   /* Create now VBO. */
-   star_vertexVBO = gl_vboCreateStream(
-         nstars * sizeof(GLfloat) * 4, star_vertex );
+   /* Create now VBO, positions only get streamed when moved on the CPU. */
+   background_initStarShader();
+   if (star_program == 0)
+      star_vertexVBO = gl_vboCreateStream(
+            nstars * sizeof(GLfloat) * 4, star_vertex );
    star_colourVBO = gl_vboCreateStatic(
          nstars * sizeof(GLfloat) * 8, star_colour );
+
+   /* Positions are fresh so the shader offset starts over. */
+   star_offx = 0.;
+   star_offy = 0.;
+   if (star_program != 0)
+      background_uploadStarShader();
+}
+
+
+/**
+ * @brief Calculates the dimensions of the star buffer.
+ *
+ *    @param[out] w Width of the star buffer.
+ *    @param[out] h Height of the star buffer.
+ */
+static void background_starDim( GLfloat *w, GLfloat *h )
+{
+   *w  = (SCREEN_W + 2.*STAR_BUF);
+   *w += conf.zoom_stars * (*w / conf.zoom_far - 1.);
+   *h  = (SCREEN_H + 2.*STAR_BUF);
+   *h += conf.zoom_stars * (*h / conf.zoom_far - 1.);
+}
+
+
+/**
+ * @brief Loads the star shader if possible, otherwise stars are moved on the CPU.
+ */
+static void background_initStarShader (void)
+{
+   if (star_program != 0)
+      return;
+
+   star_program = gl_shaderCreate( "stars", star_vertShader, NULL );
+   if (star_program == 0)
+      return;
+
+   star_uOffset = gl_shaderUniform( star_program, "star_offset" );
+   star_uDim    = gl_shaderUniform( star_program, "star_dim" );
+   star_uStreak = gl_shaderUniform( star_program, "star_streak" );
+}
+
+
+/**
+ * @brief Uploads the base star positions for the shader path.
+ */
+static void background_uploadStarShader (void)
+{
+   unsigned int i;
+   GLfloat *data;
+
+   data = malloc( nstars * sizeof(GLfloat) * 8 );
+   for (i=0; i < nstars; i++) {
+      /* Head. */
+      data[8*i+0] = star_vertex[4*i+0];
+      data[8*i+1] = star_vertex[4*i+1];
+      data[8*i+2] = star_colour[8*i+3];
+      data[8*i+3] = 0.;
+      /* Tail. */
+      data[8*i+4] = star_vertex[4*i+0];
+      data[8*i+5] = star_vertex[4*i+1];
+      data[8*i+6] = star_colour[8*i+3];
+      data[8*i+7] = 1.;
+   }
+
+   if (star_shaderVBO == NULL)
+      star_shaderVBO = gl_vboCreateStatic( nstars * sizeof(GLfloat) * 8, data );
+   else
+      gl_vboData( star_shaderVBO, nstars * sizeof(GLfloat) * 8, data );
+
+   free(data);
+}
+
+
+/**
+ * @brief Bakes the accumulated shader offset into the star positions.
+ *
+ * Only done every STAR_REBASE pixels travelled so the offset doesn't lose
+ *  floating point precision on the GPU.
+ */
+static void background_bakeStars (void)
+{
+   unsigned int i;
+   GLfloat w, h, hw, hh, b;
+   double x, y;
+
+   background_starDim( &w, &h );
+   hw = w/2.;
+   hh = h/2.;
+
+   for (i=0; i < nstars; i++) {
+      b = 1./(9. - 10.*star_colour[8*i+3]);
+      x = fmod( star_vertex[4*i+0] + star_offx*b + hw, w );
+      y = fmod( star_vertex[4*i+1] + star_offy*b + hh, h );
+      if (x < 0.)
+         x += w;
+      if (y < 0.)
+         y += h;
+      star_vertex[4*i+0] = x - hw;
+      star_vertex[4*i+1] = y - hh;
+   }
+
+   star_offx = 0.;
+   star_offy = 0.;
+   background_uploadStarShader();
 }
 
 
@@ -168,9 +305,8 @@ void background_moveStars( double x, double y )
 /**
  * @brief Renders the starry background.
  *
- * This could really benefit from OpenCL directly. It would probably give a great
- *  speed up, although we'll consider it when we get a runtime linking OpenCL
- *  framework someday.
+ * With shaders the star VBO is static and only a handful of uniforms are
+ *  updated each frame, otherwise the stars are moved on the CPU.
  *
  *    @param dt Current delta tick.
  */
@@ -178,17 +314,16 @@ void background_renderStars( const double dt )
 {
    (void) dt;
    unsigned int i;
-   GLfloat hh, hw, h, w;
-   GLfloat x, y, m, b;
+   GLfloat h, w;
+   GLfloat x, y, m;
    GLfloat brightness;
    double z;
-   double sx, sy;
    int shade_mode;
-   int j, n;
 
 
    /*
-    * gprof claims it's the slowest thing in the game!
+    * gprof claimed it's the slowest thing in the game! When GLSL is available
+    *  the stars are moved by the vertex shader so the CPU cost is constant.
     */
 
    /* Do some scaling for now. */
@@ -200,49 +335,14 @@ void background_renderStars( const double dt )
 
    if (!paused && (player.p != NULL) && !player_isFlag(PLAYER_DESTROYED) &&
          !player_isFlag(PLAYER_CREATING)) { /* update position */
-
-      /* Calculate some dimensions. */
-      w  = (SCREEN_W + 2.*STAR_BUF);
-      w += conf.zoom_stars * (w / conf.zoom_far - 1.);
-      h  = (SCREEN_H + 2.*STAR_BUF);
-      h += conf.zoom_stars * (h / conf.zoom_far - 1.);
-      hw = w/2.;
-      hh = h/2.;
-
-      /* Calculate multiple updates in the case the ship is moving really ridiculously fast. */
-      if ((star_x > SCREEN_W) || (star_y > SCREEN_H)) {
-         sx = ceil( star_x / SCREEN_W );
-         sy = ceil( star_y / SCREEN_H );
-         n  = MAX( sx, sy );
-         star_x /= (double)n;
-         star_y /= (double)n;
+      if (star_program != 0) {
+         star_offx += star_x;
+         star_offy += star_y;
+         if ((FABS(star_offx) > STAR_REBASE) || (FABS(star_offy) > STAR_REBASE))
+            background_bakeStars();
       }
       else
-         n = 1;
-
-      /* Calculate new star positions. */
-      for (j=0; j < n; j++) {
-         for (i=0; i < nstars; i++) {
-
-            /* Calculate new position */
-            b = 1./(9. - 10.*star_colour[8*i+3]);
-            star_vertex[4*i+0] = star_vertex[4*i+0] + star_x*b;
-            star_vertex[4*i+1] = star_vertex[4*i+1] + star_y*b;
-
-            /* check boundaries */
-            if (star_vertex[4*i+0] > hw)
-               star_vertex[4*i+0] -= w;
-            else if (star_vertex[4*i+0] < -hw)
-               star_vertex[4*i+0] += w;
-            if (star_vertex[4*i+1] > hh)
-               star_vertex[4*i+1] -= h;
-            else if (star_vertex[4*i+1] < -hh)
-               star_vertex[4*i+1] += h;
-         }
-      }
-
-      /* Upload the data. */
-      gl_vboSubData( star_vertexVBO, 0, nstars * 4 * sizeof(GLfloat), star_vertex );
+         background_updateStarsCPU();
    }
 
    /* Decide on shade mode. */
@@ -276,7 +376,7 @@ void background_renderStars( const double dt )
          y = m*sin(VANGLE(player.p->solid->vel));
       }
 
-      if (shade_mode) {
+      if (shade_mode && (star_program == 0)) {
          /* Generate lines. */
          for (i=0; i < nstars; i++) {
             brightness = star_colour[8*i+3];
@@ -290,15 +390,37 @@ void background_renderStars( const double dt )
    }
 
    /* Render. */
-   gl_vboActivate( star_vertexVBO, GL_VERTEX_ARRAY, 2, GL_FLOAT, 2 * sizeof(GLfloat) );
-   gl_vboActivate( star_colourVBO, GL_COLOR_ARRAY,  4, GL_FLOAT, 4 * sizeof(GLfloat) );
-   if (shade_mode) {
-      glDrawArrays( GL_LINES, 0, nstars );
-      glDrawArrays( GL_POINTS, 0, nstars ); /* This second pass is when the lines are very short that they "lose" intensity. */
-      glShadeModel(GL_FLAT);
+   if (star_program != 0) {
+      background_starDim( &w, &h );
+      gl_shaderUse( star_program );
+      nglUniform2f( star_uOffset, star_offx, star_offy );
+      nglUniform2f( star_uDim, w, h );
+      if (shade_mode)
+         nglUniform2f( star_uStreak, x, y );
+      else
+         nglUniform2f( star_uStreak, 0., 0. );
+      gl_vboActivate( star_shaderVBO, GL_VERTEX_ARRAY, 4, GL_FLOAT, 4 * sizeof(GLfloat) );
+      gl_vboActivate( star_colourVBO, GL_COLOR_ARRAY,  4, GL_FLOAT, 4 * sizeof(GLfloat) );
+      if (shade_mode) {
+         glDrawArrays( GL_LINES, 0, nstars );
+         glDrawArrays( GL_POINTS, 0, nstars ); /* Tails have no alpha so only heads show up. */
+         glShadeModel(GL_FLAT);
+      }
+      else
+         glDrawArrays( GL_POINTS, 0, nstars );
+      gl_shaderUse( 0 );
+   }
+   else {
+      gl_vboActivate( star_vertexVBO, GL_VERTEX_ARRAY, 2, GL_FLOAT, 2 * sizeof(GLfloat) );
+      gl_vboActivate( star_colourVBO, GL_COLOR_ARRAY,  4, GL_FLOAT, 4 * sizeof(GLfloat) );
+      if (shade_mode) {
+         glDrawArrays( GL_LINES, 0, nstars );
+         glDrawArrays( GL_POINTS, 0, nstars ); /* This second pass is when the lines are very short that they "lose" intensity. */
+         glShadeModel(GL_FLAT);
+      }
+      else
+         glDrawArrays( GL_POINTS, 0, nstars );
    }
-   else
-      glDrawArrays( GL_POINTS, 0, nstars );
 
    /* Clear star movement. */
    star_x = 0.;
@@ -315,6 +437,59 @@ void background_renderStars( const double dt )
 }
 
 
+/**
+ * @brief Moves the stars on the CPU when shaders aren't available.
+ */
+static void background_updateStarsCPU (void)
+{
+   unsigned int i;
+   GLfloat hh, hw, h, w, b;
+   double sx, sy;
+   int j, n;
+
+
+   /* Calculate some dimensions. */
+   background_starDim( &w, &h );
+   hw = w/2.;
+   hh = h/2.;
+
+   /* Calculate multiple updates in the case the ship is moving really ridiculously fast. */
+   if ((star_x > SCREEN_W) || (star_y > SCREEN_H)) {
+      sx = ceil( star_x / SCREEN_W );
+      sy = ceil( star_y / SCREEN_H );
+      n  = MAX( sx, sy );
+      star_x /= (double)n;
+      star_y /= (double)n;
+   }
+   else
+      n = 1;
+
+   /* Calculate new star positions. */
+   for (j=0; j < n; j++) {
+      for (i=0; i < nstars; i++) {
+
+         /* Calculate new position */
+         b = 1./(9. - 10.*star_colour[8*i+3]);
+         star_vertex[4*i+0] = star_vertex[4*i+0] + star_x*b;
+         star_vertex[4*i+1] = star_vertex[4*i+1] + star_y*b;
+
+         /* check boundaries */
+         if (star_vertex[4*i+0] > hw)
+            star_vertex[4*i+0] -= w;
+         else if (star_vertex[4*i+0] < -hw)
+            star_vertex[4*i+0] += w;
+         if (star_vertex[4*i+1] > hh)
+            star_vertex[4*i+1] -= h;
+         else if (star_vertex[4*i+1] < -hh)
+            star_vertex[4*i+1] += h;
+      }
+   }
+
+   /* Upload the data. */
+   gl_vboSubData( star_vertexVBO, 0, nstars * 4 * sizeof(GLfloat), star_vertex );
+}
+
+
 /**
  * @brief Render the background.
  */
@@ -604,6 +779,14 @@ void background_free (void)
       gl_vboDestroy( star_colourVBO );
       star_colourVBO = NULL;
    }
+   if (star_shaderVBO != NULL) {
+      gl_vboDestroy( star_shaderVBO );
+      star_shaderVBO = NULL;
+   }
+
+   /* Destroy the shader. */
+   gl_shaderDestroy( star_program );
+   star_program = 0;
 
    /* Free the stars. */
    if (star_vertex != NULL) {
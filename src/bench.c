@@ -0,0 +1,710 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file bench.c
+ *
+ * @brief Micro-benchmarks of the engine hot paths.
+ *
+ * Runs with the real data loaded through the headless startup, so there is
+ *  no window nor sound. Every benchmark sets up its inputs from a fixed seed
+ *  and then runs an operation in a loop. The iteration count gets calibrated
+ *  to the requested time and the runs are repeated, reporting the fastest and
+ *  the median ns/op so that results can be compared between builds.
+ */
+
+
+#include "bench.h"
+
+#include "naev.h"
+
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "log.h"
+#include "conf.h"
+#include "rng.h"
+#include "nfile.h"
+#include "pack.h"
+#include "collision.h"
+#include "opengl.h"
+#include "ship.h"
+#include "outfit.h"
+#include "pilot.h"
+#include "weapon.h"
+#include "faction.h"
+#include "space.h"
+#include "map.h"
+#include "economy.h"
+#include "perlin.h"
+#include "cond.h"
+#include "tech.h"
+#include "perf.h"
+
+
+#define BENCH_SEED         0x6e617665 /**< Seed used for all the benchmarks. */
+#define BENCH_RUNS         5 /**< Measured runs per benchmark. */
+#define BENCH_SAMPLES      256 /**< Precomputed inputs, must be a power of two. */
+#define BENCH_SHIPS        16 /**< Ships to take sprites from. */
+#define BENCH_PACK_FILES   32 /**< Files in the benchmark pack. */
+#define BENCH_PACK_SIZE    16384 /**< Size of the files in the benchmark pack. */
+#define BENCH_PACK_PATH    "bench/" /**< Cache subdirectory for the benchmark pack. */
+#define BENCH_COND         "var.peek(\"bench\") == nil" /**< Conditional to check. */
+
+
+/**
+ * @brief A benchmark.
+ */
+typedef struct Bench_ {
+   const char *name; /**< Name of the benchmark. */
+   int (*init)( void ); /**< Sets up the inputs, nonzero skips the benchmark. */
+   void (*run)( int n ); /**< Runs the operation n times. */
+   void (*cleanup)( void ); /**< Cleans up, can be NULL. */
+} Bench;
+
+
+/**
+ * @brief Input of the sprite collision benchmarks.
+ */
+typedef struct BenchCollide_ {
+   const glTexture *at; /**< First sprite. */
+   int asx; /**< First sprite x. */
+   int asy; /**< First sprite y. */
+   Vector2d ap; /**< First position. */
+   const glTexture *bt; /**< Second sprite. */
+   int bsx; /**< Second sprite x. */
+   int bsy; /**< Second sprite y. */
+   Vector2d bp; /**< Second position. */
+   Vector2d lp; /**< Start of the line. */
+   double dir; /**< Direction of the line. */
+   double len; /**< Length of the line. */
+} BenchCollide;
+
+
+static volatile int bench_sink = 0; /**< Keeps results from being optimized out. */
+static BenchCollide bench_collide[BENCH_SAMPLES]; /**< Sprite collision inputs. */
+static const char *bench_names[BENCH_SAMPLES]; /**< Names to look up. */
+static const char *bench_ends[BENCH_SAMPLES]; /**< End systems of the paths. */
+static tech_group_t *bench_techs[BENCH_SAMPLES]; /**< Tech groups to get outfits from. */
+static int bench_ntechs = 0; /**< Number of tech groups. */
+static Packcache_t *bench_cache = NULL; /**< Benchmark pack. */
+static char *bench_files[BENCH_PACK_FILES]; /**< Files in the benchmark pack. */
+
+
+/*
+ * Prototypes.
+ */
+static double bench_measure( const Bench *b, int n );
+static int bench_cmpDouble( const void *p1, const void *p2 );
+static Ship* bench_getShip( int i );
+/* Benchmarks. */
+static int bench_collideInit (void);
+static void bench_collideSprite( int n );
+static void bench_collideLineSprite( int n );
+static int bench_weaponsSetup( int nweapons, int npilots );
+static int bench_weaponsSmallInit (void);
+static int bench_weaponsLargeInit (void);
+static void bench_weaponsRun( int n );
+static void bench_weaponsCleanup (void);
+static int bench_jumpPathInit (void);
+static void bench_jumpPathRun( int n );
+static int bench_economyInit (void);
+static void bench_economyRun( int n );
+static int bench_nebulaInit (void);
+static void bench_nebulaRun( int n );
+static int bench_packInit (void);
+static void bench_packRun( int n );
+static void bench_packCleanup (void);
+static int bench_outfitInit (void);
+static void bench_outfitRun( int n );
+static int bench_systemInit (void);
+static void bench_systemRun( int n );
+static int bench_condInit (void);
+static void bench_condRun( int n );
+static int bench_techInit (void);
+static void bench_techRun( int n );
+
+
+/**
+ * @brief All the benchmarks.
+ */
+static const Bench bench_list[] = {
+   { "CollideSprite", bench_collideInit, bench_collideSprite, NULL },
+   { "CollideLineSprite", bench_collideInit, bench_collideLineSprite, NULL },
+   { "weapons_update 100x20", bench_weaponsSmallInit, bench_weaponsRun, bench_weaponsCleanup },
+   { "weapons_update 500x100", bench_weaponsLargeInit, bench_weaponsRun, bench_weaponsCleanup },
+   { "map_getJumpPath", bench_jumpPathInit, bench_jumpPathRun, NULL },
+   { "economy_update", bench_economyInit, bench_economyRun, NULL },
+   { "noise_genNebulaMap 256x256x4", bench_nebulaInit, bench_nebulaRun, NULL },
+   { "pack_readfileCached", bench_packInit, bench_packRun, bench_packCleanup },
+   { "outfit_get", bench_outfitInit, bench_outfitRun, NULL },
+   { "system_get", bench_systemInit, bench_systemRun, NULL },
+   { "cond_check", bench_condInit, bench_condRun, NULL },
+   { "tech_getOutfit", bench_techInit, bench_techRun, NULL }
+};
+
+
+/**
+ * @brief Times a run of a benchmark.
+ *
+ *    @param b Benchmark to run.
+ *    @param n Number of iterations.
+ *    @return Seconds taken.
+ */
+static double bench_measure( const Bench *b, int n )
+{
+   uint64_t t;
+   rng_seed( BENCH_SEED );
+   t = perf_ticks();
+   b->run( n );
+   return perf_ms( perf_ticks() - t ) / 1000.;
+}
+
+
+/**
+ * @brief Compares doubles for qsort.
+ */
+static int bench_cmpDouble( const void *p1, const void *p2 )
+{
+   double d1, d2;
+   d1 = *(const double*)p1;
+   d2 = *(const double*)p2;
+   if (d1 < d2)
+      return -1;
+   else if (d1 > d2)
+      return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Runs the benchmarks.
+ *
+ * Only benchmarks with conf.bench_filter in their name get run if set.
+ *
+ *    @return 0 on success.
+ */
+int bench_run (void)
+{
+   const Bench *b;
+   double target, t, ns[BENCH_RUNS];
+   int i, j, n, ret;
+
+   target = (conf.bench_time > 0.) ? conf.bench_time : BENCH_TIME_DEFAULT;
+
+   LOG("%-30s %12s %14s %14s", "benchmark", "iterations", "min ns/op", "median ns/op");
+   ret = 0;
+   for (i=0; i<(int)(sizeof(bench_list)/sizeof(bench_list[0])); i++) {
+      b = &bench_list[i];
+      if ((conf.bench_filter != NULL) && (strstr( b->name, conf.bench_filter ) == NULL))
+         continue;
+
+      rng_seed( BENCH_SEED );
+      if (b->init()) {
+         LOG("%-30s %12s", b->name, "skipped");
+         ret = -1;
+         continue;
+      }
+
+      /* Calibrate so a run takes about the target time. */
+      n = 1;
+      while (((t = bench_measure( b, n )) < target / 10.) && (n < (1<<28)))
+         n *= 2;
+      n = MAX( 1, (int)MIN( (double)n * target / MAX( t, 1e-9 ), (double)(1<<28) ) );
+
+      for (j=0; j<BENCH_RUNS; j++)
+         ns[j] = 1e9 * bench_measure( b, n ) / (double)n;
+      qsort( ns, BENCH_RUNS, sizeof(double), bench_cmpDouble );
+      LOG("%-30s %12d %14.1f %14.1f", b->name, n, ns[0], ns[BENCH_RUNS/2]);
+
+      if (b->cleanup != NULL)
+         b->cleanup();
+   }
+
+   return ret;
+}
+
+
+/**
+ * @brief Gets the i-th ship that has a sprite with a transparency map.
+ *
+ *    @param i Index of the ship to get.
+ *    @return The ship or NULL if there aren't enough.
+ */
+static Ship* bench_getShip( int i )
+{
+   Ship *ships;
+   int j, n;
+
+   ships = ship_getAll( &n );
+   for (j=0; j<n; j++) {
+      if (ship_gfxLoad( &ships[j] ) || (ships[j].gfx_space == NULL) ||
+            (ships[j].gfx_space->trans == NULL))
+         continue;
+      if (i-- == 0)
+         return &ships[j];
+   }
+   return NULL;
+}
+
+
+/**
+ * @brief Sets up pairs of overlapping ship sprites.
+ */
+static int bench_collideInit (void)
+{
+   const glTexture *gfx[BENCH_SHIPS];
+   BenchCollide *c;
+   Ship *s;
+   int i, n;
+   double r, a;
+
+   for (n=0; n<BENCH_SHIPS; n++) {
+      s = bench_getShip( n );
+      if (s == NULL)
+         break;
+      gfx[n] = s->gfx_space;
+   }
+   if (n == 0)
+      return -1;
+
+   for (i=0; i<BENCH_SAMPLES; i++) {
+      c     = &bench_collide[i];
+      c->at = gfx[ RNG_SANE( 0, n-1 ) ];
+      c->bt = gfx[ RNG_SANE( 0, n-1 ) ];
+      gl_getSpriteFromDir( &c->asx, &c->asy, c->at, RNGF() * 2. * M_PI );
+      gl_getSpriteFromDir( &c->bsx, &c->bsy, c->bt, RNGF() * 2. * M_PI );
+
+      /* Mostly overlapping bounding boxes so the pixels get checked. */
+      r = RNGF() * (c->at->sw + c->bt->sw) / 2.;
+      a = RNGF() * 2. * M_PI;
+      vect_pset( &c->ap, r, a );
+      vectnull( &c->bp );
+
+      /* Lines start outside and cross near the middle. */
+      vect_pset( &c->lp, c->bt->sw, a );
+      c->dir = a + M_PI + (RNGF() - 0.5) * 0.5;
+      c->len = 2. * c->bt->sw;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Benchmarks CollideSprite().
+ */
+static void bench_collideSprite( int n )
+{
+   BenchCollide *c;
+   Vector2d crash;
+   int i, hits;
+
+   hits = 0;
+   for (i=0; i<n; i++) {
+      c = &bench_collide[ i & (BENCH_SAMPLES-1) ];
+      hits += CollideSprite( c->at, c->asx, c->asy, &c->ap,
+            c->bt, c->bsx, c->bsy, &c->bp, &crash );
+   }
+   bench_sink = hits;
+}
+
+
+/**
+ * @brief Benchmarks CollideLineSprite().
+ */
+static void bench_collideLineSprite( int n )
+{
+   BenchCollide *c;
+   Vector2d crash[2];
+   int i, hits;
+
+   hits = 0;
+   for (i=0; i<n; i++) {
+      c = &bench_collide[ i & (BENCH_SAMPLES-1) ];
+      hits += CollideLineSprite( &c->lp, c->dir, c->len,
+            c->bt, c->bsx, c->bsy, &c->bp, crash );
+   }
+   bench_sink = hits;
+}
+
+
+/**
+ * @brief Sets up two hostile groups of pilots and weapons flying between them.
+ *
+ *    @param nweapons Number of weapons.
+ *    @param npilots Number of pilots.
+ *    @return 0 on success.
+ */
+static int bench_weaponsSetup( int nweapons, int npilots )
+{
+   StarSystem *systems;
+   Outfit *outfits, *o;
+   Ship *ship;
+   Pilot *parent;
+   PilotFlags flags;
+   Vector2d pos, vel;
+   unsigned int *ids;
+   int i, n, fa, fb, *fact, nfact;
+
+   /* Need a ship, a bolt weapon and two enemy factions. */
+   ship = bench_getShip( 0 );
+   outfits = outfit_getAll( &n );
+   o = NULL;
+   for (i=0; i<n; i++) {
+      if (outfit_isBolt( &outfits[i] ) && (outfit_gfx( &outfits[i] ) != NULL)) {
+         o = &outfits[i];
+         break;
+      }
+   }
+   fa = fb = -1;
+   fact = faction_getAll( &nfact );
+   for (i=0; (i<nfact*nfact) && (fb < 0); i++) {
+      if (areEnemies( fact[i/nfact], fact[i%nfact] )) {
+         fa = fact[i/nfact];
+         fb = fact[i%nfact];
+      }
+   }
+   free( fact );
+   systems = system_getAll( &n );
+   if ((ship == NULL) || (o == NULL) || (fb < 0) || (n == 0))
+      return -1;
+
+   /* Empty system. */
+   space_init( systems[0].name );
+   pilots_clean();
+
+   /* Pilots scattered about, alternating factions. */
+   pilot_clearFlagsRaw( flags );
+   ids = malloc( npilots * sizeof(unsigned int) );
+   for (i=0; i<npilots; i++) {
+      vect_cset( &pos, RNGF() * 10000. - 5000., RNGF() * 10000. - 5000. );
+      vectnull( &vel );
+      ids[i] = pilot_create( ship, "Bench", (i%2==0) ? fa : fb, NULL,
+            RNGF() * 2. * M_PI, &pos, &vel, flags, -1 );
+   }
+
+   /* Weapons shot from the first group at the second. */
+   for (i=0; i<nweapons; i++) {
+      parent = pilot_get( ids[ 2*RNG_SANE( 0, (npilots-1)/2 ) ] );
+      vect_cset( &pos, RNGF() * 10000. - 5000., RNGF() * 10000. - 5000. );
+      vect_pset( &vel, 100., RNGF() * 2. * M_PI );
+      weapon_add( o, 0., VANGLE(vel), &pos, &vel, parent,
+            ids[ MIN( npilots-1, 2*RNG_SANE( 0, npilots/2 )+1 ) ] );
+   }
+   free( ids );
+
+   return 0;
+}
+
+
+/**
+ * @brief Sets up 100 weapons and 20 pilots.
+ */
+static int bench_weaponsSmallInit (void)
+{
+   return bench_weaponsSetup( 100, 20 );
+}
+
+
+/**
+ * @brief Sets up 500 weapons and 100 pilots.
+ */
+static int bench_weaponsLargeInit (void)
+{
+   return bench_weaponsSetup( 500, 100 );
+}
+
+
+/**
+ * @brief Benchmarks weapons_update().
+ *
+ * Time doesn't advance so the same weapons get checked against the same
+ *  pilots every iteration.
+ */
+static void bench_weaponsRun( int n )
+{
+   int i;
+   for (i=0; i<n; i++)
+      weapons_update( 0. );
+}
+
+
+/**
+ * @brief Removes the benchmark weapons and pilots.
+ */
+static void bench_weaponsCleanup (void)
+{
+   weapon_clear();
+   pilots_clean();
+}
+
+
+/**
+ * @brief Picks random pairs of systems.
+ */
+static int bench_jumpPathInit (void)
+{
+   StarSystem *systems;
+   int i, n;
+
+   systems = system_getAll( &n );
+   if (n < 2)
+      return -1;
+   for (i=0; i<BENCH_SAMPLES; i++) {
+      bench_names[i] = systems[ RNG_SANE( 0, n-1 ) ].name;
+      bench_ends[i]  = systems[ RNG_SANE( 0, n-1 ) ].name;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Benchmarks map_getJumpPath().
+ */
+static void bench_jumpPathRun( int n )
+{
+   StarSystem **path;
+   int i, k, njumps;
+
+   k = 0;
+   for (i=0; i<n; i++) {
+      path = map_getJumpPath( &njumps, bench_names[ i & (BENCH_SAMPLES-1) ],
+            bench_ends[ i & (BENCH_SAMPLES-1) ], 1, 0, NULL );
+      k += njumps;
+      free( path );
+   }
+   bench_sink = k;
+}
+
+
+/**
+ * @brief Makes sure the economy is set up.
+ */
+static int bench_economyInit (void)
+{
+   return economy_init();
+}
+
+
+/**
+ * @brief Benchmarks economy_update().
+ */
+static void bench_economyRun( int n )
+{
+   int i;
+   for (i=0; i<n; i++)
+      economy_update( 0 );
+}
+
+
+/**
+ * @brief Nothing to set up.
+ */
+static int bench_nebulaInit (void)
+{
+   return 0;
+}
+
+
+/**
+ * @brief Benchmarks noise_genNebulaMap().
+ */
+static void bench_nebulaRun( int n )
+{
+   int i;
+   for (i=0; i<n; i++)
+      free( noise_genNebulaMap( 256, 256, 4, 5. ) );
+}
+
+
+/**
+ * @brief Writes some random files and packs them.
+ */
+static int bench_packInit (void)
+{
+   char path[PATH_MAX], pack[PATH_MAX];
+   char *buf;
+   int i, j, ret;
+
+   nfile_dirMakeExist( "%s"BENCH_PACK_PATH, nfile_cachePath() );
+   buf = malloc( BENCH_PACK_SIZE );
+   ret = 0;
+   for (i=0; i<BENCH_PACK_FILES; i++) {
+      for (j=0; j<BENCH_PACK_SIZE; j++)
+         buf[j] = RNG( 0, 255 );
+      nsnprintf( path, sizeof(path), "%s"BENCH_PACK_PATH"file%02d.dat", nfile_cachePath(), i );
+      if (nfile_writeFile( buf, BENCH_PACK_SIZE, "%s", path ))
+         ret = -1;
+      bench_files[i] = strdup( path );
+   }
+   free( buf );
+
+   /* Pack and open it, files are looked up by the path they were packed as. */
+   nsnprintf( pack, sizeof(pack), "%s"BENCH_PACK_PATH"bench.pack", nfile_cachePath() );
+   if ((ret == 0) && (pack_files( pack, (const char**)bench_files, BENCH_PACK_FILES ) == 0))
+      bench_cache = pack_openCache( pack );
+   for (i=0; i<BENCH_PACK_FILES; i++)
+      nfile_delete( bench_files[i] );
+
+   if (bench_cache == NULL) {
+      bench_packCleanup();
+      return -1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Benchmarks pack_readfileCached().
+ */
+static void bench_packRun( int n )
+{
+   uint32_t size;
+   int i, k;
+
+   k = 0;
+   for (i=0; i<n; i++) {
+      free( pack_readfileCached( bench_cache, bench_files[ i % BENCH_PACK_FILES ], &size ) );
+      k += size;
+   }
+   bench_sink = k;
+}
+
+
+/**
+ * @brief Closes and removes the benchmark pack.
+ */
+static void bench_packCleanup (void)
+{
+   char pack[PATH_MAX];
+
+   int i;
+
+   if (bench_cache != NULL)
+      pack_closeCache( bench_cache );
+   bench_cache = NULL;
+   for (i=0; i<BENCH_PACK_FILES; i++) {
+      free( bench_files[i] );
+      bench_files[i] = NULL;
+   }
+   nsnprintf( pack, sizeof(pack), "%s"BENCH_PACK_PATH"bench.pack", nfile_cachePath() );
+   nfile_delete( pack );
+}
+
+
+/**
+ * @brief Picks random outfit names.
+ */
+static int bench_outfitInit (void)
+{
+   Outfit *outfits;
+   int i, n;
+
+   outfits = outfit_getAll( &n );
+   if (n == 0)
+      return -1;
+   for (i=0; i<BENCH_SAMPLES; i++)
+      bench_names[i] = outfits[ RNG_SANE( 0, n-1 ) ].name;
+   return 0;
+}
+
+
+/**
+ * @brief Benchmarks outfit_get().
+ */
+static void bench_outfitRun( int n )
+{
+   int i, k;
+   k = 0;
+   for (i=0; i<n; i++)
+      k += (outfit_get( bench_names[ i & (BENCH_SAMPLES-1) ] ) != NULL);
+   bench_sink = k;
+}
+
+
+/**
+ * @brief Picks random system names.
+ */
+static int bench_systemInit (void)
+{
+   StarSystem *systems;
+   int i, n;
+
+   systems = system_getAll( &n );
+   if (n == 0)
+      return -1;
+   for (i=0; i<BENCH_SAMPLES; i++)
+      bench_names[i] = systems[ RNG_SANE( 0, n-1 ) ].name;
+   return 0;
+}
+
+
+/**
+ * @brief Benchmarks system_get().
+ */
+static void bench_systemRun( int n )
+{
+   int i, k;
+   k = 0;
+   for (i=0; i<n; i++)
+      k += (system_get( bench_names[ i & (BENCH_SAMPLES-1) ] ) != NULL);
+   bench_sink = k;
+}
+
+
+/**
+ * @brief Makes sure the conditional works.
+ */
+static int bench_condInit (void)
+{
+   return (cond_check( BENCH_COND ) < 0) ? -1 : 0;
+}
+
+
+/**
+ * @brief Benchmarks cond_check().
+ */
+static void bench_condRun( int n )
+{
+   int i, k;
+   k = 0;
+   for (i=0; i<n; i++)
+      k += cond_check( BENCH_COND );
+   bench_sink = k;
+}
+
+
+/**
+ * @brief Picks the tech groups of random planets.
+ */
+static int bench_techInit (void)
+{
+   Planet *planets;
+   int i, n;
+
+   planets = planet_getAll( &n );
+   bench_ntechs = 0;
+   for (i=0; (i<n) && (bench_ntechs<BENCH_SAMPLES); i++)
+      if (planets[i].tech != NULL)
+         bench_techs[ bench_ntechs++ ] = planets[i].tech;
+   return (bench_ntechs == 0) ? -1 : 0;
+}
+
+
+/**
+ * @brief Benchmarks tech_getOutfit().
+ */
+static void bench_techRun( int n )
+{
+   Outfit **o;
+   int i, k, no;
+
+   k = 0;
+   for (i=0; i<n; i++) {
+      o = tech_getOutfit( bench_techs[ i % bench_ntechs ], &no );
+      k += no;
+      free( o );
+   }
+   bench_sink = k;
+}
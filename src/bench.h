@@ -0,0 +1,16 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef BENCH_H
+#  define BENCH_H
+
+
+#define BENCH_TIME_DEFAULT    0.2 /**< Default seconds to run each benchmark for. */
+
+
+int bench_run (void);
+
+
+#endif /* BENCH_H */
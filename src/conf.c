@@ -104,6 +104,18 @@ static void print_usage( char **argv )
    LOG("   --devmode             enables dev mode perks like the editors");
    LOG("   --devcsv              generates csv output from the ndata for development purposes");
 #endif /* DEBUGGING */
+   LOG("   --headless            runs the simulation without window nor sound and exits");
+   LOG("   --simtime f           simulated seconds to run for when headless (default 60)");
+   LOG("   --simdt f             fixed simulation step when headless (default 1/60)");
+   LOG("   --load s              loads savegame s and takes off when headless");
+   LOG("   --system s            starts in system s when headless and not loading a save");
+   LOG("   --fleet s             spawns fleet s when headless, may be given multiple times");
+   LOG("   --until s             stops the headless run once Lua conditional s is true");
+   LOG("   --scenario s          runs stress test scenario s, headless if also given --headless");
+   LOG("   --bench               runs the benchmarks without window nor sound and exits");
+   LOG("   --benchonly s         only runs the benchmarks with s in their name");
+   LOG("   --benchtime f         seconds to run each benchmark for (default 0.2)");
+   LOG("   --convert-save f      converts savegame f between XML and binary and exits");
    LOG("   -h, --help            display this message and exit");
    LOG("   -v, --version         print the version and exit");
 }
@@ -181,6 +193,7 @@ void conf_setGameplayDefaults (void)
    conf.compression_velocity  = TIME_COMPRESSION_DEFAULT_MAX;
    conf.compression_mult      = TIME_COMPRESSION_DEFAULT_MULT;
    conf.save_compress         = SAVE_COMPRESSION_DEFAULT;
+   conf.save_binary           = SAVE_BINARY_DEFAULT;
    conf.mouse_thrust          = MOUSE_THRUST_DEFAULT;
    conf.autonav_abort         = AUTONAV_ABORT_DEFAULT;
    conf.autonav_pause         = AUTONAV_PAUSE_DEFAULT;
@@ -240,6 +253,7 @@ void conf_setVideoDefaults (void)
    conf.fsaa         = FSAA_DEFAULT;
    conf.vsync        = VSYNC_DEFAULT;
    conf.vbo          = VBO_DEFAULT; /* Seems to cause a lot of issues. */
+   conf.shaders      = SHADERS_DEFAULT;
    conf.mipmaps      = MIPMAP_DEFAULT; /* Also cause for issues. */
    conf.compress     = TEXTURE_COMPRESSION_DEFAULT;
    conf.interpolate  = INTERPOLATION_DEFAULT;
@@ -254,6 +268,7 @@ void conf_setVideoDefaults (void)
 
    /* FPS. */
    conf.fps_show     = SHOW_FPS_DEFAULT;
+   conf.perf_show    = SHOW_PERF_DEFAULT;
    conf.fps_max      = FPS_MAX_DEFAULT;
 
    /* Memory. */
@@ -272,6 +287,20 @@ void conf_cleanup (void)
       free(conf.sound_backend);
    if (conf.joystick_nam != NULL)
       free(conf.joystick_nam);
+   if (conf.headless_save != NULL)
+      free(conf.headless_save);
+   if (conf.headless_system != NULL)
+      free(conf.headless_system);
+   if (conf.headless_fleets != NULL)
+      free(conf.headless_fleets);
+   if (conf.headless_until != NULL)
+      free(conf.headless_until);
+   if (conf.scenario != NULL)
+      free(conf.scenario);
+   if (conf.bench_filter != NULL)
+      free(conf.bench_filter);
+   if (conf.convert_save != NULL)
+      free(conf.convert_save);
 
    /* Clear memory. */
    memset( &conf, 0, sizeof(conf) );
@@ -323,6 +352,7 @@ int conf_loadConfig ( const char* file )
       conf_loadInt("fsaa",conf.fsaa);
       conf_loadBool("vsync",conf.vsync);
       conf_loadBool("vbo",conf.vbo);
+      conf_loadBool("shaders",conf.shaders);
       conf_loadBool("mipmaps",conf.mipmaps);
       conf_loadBool("compress",conf.compress);
       conf_loadBool("interpolate",conf.interpolate);
@@ -348,6 +378,7 @@ int conf_loadConfig ( const char* file )
 
       /* FPS */
       conf_loadBool("showfps",conf.fps_show);
+      conf_loadBool("showperf",conf.perf_show);
       conf_loadInt("maxfps",conf.fps_max);
 
       /* Sound. */
@@ -398,6 +429,7 @@ int conf_loadConfig ( const char* file )
       conf_loadFloat("compression_velocity",conf.compression_velocity);
       conf_loadFloat("compression_mult",conf.compression_mult);
       conf_loadBool("save_compress",conf.save_compress);
+      conf_loadBool("save_binary",conf.save_binary);
       conf_loadInt("afterburn_sensitivity",conf.afterburn_sens);
       conf_loadInt("mouse_thrust",conf.mouse_thrust);
       conf_loadFloat("autonav_abort",conf.autonav_abort);
@@ -573,11 +605,24 @@ void conf_parseCLI( int argc, char** argv )
       { "devmode", no_argument, 0, 'D' },
       { "devcsv", no_argument, 0, 'C' },
 #endif /* DEBUGGING */
+      { "headless", no_argument, 0, 'X' },
+      { "simtime", required_argument, 0, 'T' },
+      { "simdt", required_argument, 0, 't' },
+      { "load", required_argument, 0, 'L' },
+      { "system", required_argument, 0, 'Y' },
+      { "fleet", required_argument, 0, 'E' },
+      { "until", required_argument, 0, 'U' },
+      { "scenario", required_argument, 0, 'A' },
+      { "bench", no_argument, 0, 'b' },
+      { "benchonly", required_argument, 0, 'k' },
+      { "benchtime", required_argument, 0, 'K' },
+      { "convert-save", required_argument, 0, 'c' },
       { "help", no_argument, 0, 'h' },
       { "version", no_argument, 0, 'v' },
       { NULL, 0, 0, 0 } };
    int option_index = 1;
    int c = 0;
+   size_t len;
 
    /* man 3 getopt says optind should be initialized to 1, but that seems to
     * cause all options to get parsed, i.e. we cannot detect a trailing ndata
@@ -643,6 +688,71 @@ void conf_parseCLI( int argc, char** argv )
             break;
 #endif /* DEBUGGING */
 
+         case 'X':
+            conf.headless = 1;
+            conf.nosound  = 1;
+            conf.nosave   = 1;
+            break;
+         case 'T':
+            conf.headless_time = atof(optarg);
+            break;
+         case 't':
+            conf.headless_dt = atof(optarg);
+            break;
+         case 'L':
+            if (conf.headless_save != NULL)
+               free(conf.headless_save);
+            conf.headless_save = strdup(optarg);
+            break;
+         case 'Y':
+            if (conf.headless_system != NULL)
+               free(conf.headless_system);
+            conf.headless_system = strdup(optarg);
+            break;
+         case 'E':
+            /* Fleets get accumulated as a comma separated list. */
+            if (conf.headless_fleets == NULL)
+               conf.headless_fleets = strdup(optarg);
+            else {
+               len = strlen(conf.headless_fleets) + strlen(optarg) + 2;
+               conf.headless_fleets = realloc( conf.headless_fleets, len );
+               strcat( conf.headless_fleets, "," );
+               strcat( conf.headless_fleets, optarg );
+            }
+            break;
+         case 'U':
+            if (conf.headless_until != NULL)
+               free(conf.headless_until);
+            conf.headless_until = strdup(optarg);
+            break;
+         case 'A':
+            if (conf.scenario != NULL)
+               free(conf.scenario);
+            conf.scenario = strdup(optarg);
+            conf.nosave   = 1;
+            break;
+
+         case 'b':
+            conf.bench    = 1;
+            conf.headless = 1;
+            conf.nosound  = 1;
+            conf.nosave   = 1;
+            break;
+         case 'k':
+            if (conf.bench_filter != NULL)
+               free(conf.bench_filter);
+            conf.bench_filter = strdup(optarg);
+            break;
+         case 'K':
+            conf.bench_time = atof(optarg);
+            break;
+
+         case 'c':
+            if (conf.convert_save != NULL)
+               free(conf.convert_save);
+            conf.convert_save = strdup(optarg);
+            break;
+
          case 'v':
             /* by now it has already displayed the version */
             exit(EXIT_SUCCESS);
@@ -867,6 +977,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("vbo",conf.vbo);
    conf_saveEmptyLine();
 
+   conf_saveComment("Use OpenGL shaders (GLSL) for effects like the starfield");
+   conf_saveBool("shaders",conf.shaders);
+   conf_saveEmptyLine();
+
    conf_saveComment("Use OpenGL MipMaps");
    conf_saveBool("mipmaps",conf.mipmaps);
    conf_saveEmptyLine();
@@ -915,6 +1029,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("showfps",conf.fps_show);
    conf_saveEmptyLine();
 
+   conf_saveComment("Display how long every stage of a frame takes");
+   conf_saveBool("showperf",conf.perf_show);
+   conf_saveEmptyLine();
+
    conf_saveComment("Limit the rendering framerate");
    conf_saveInt("maxfps",conf.fps_max);
    conf_saveEmptyLine();
@@ -1023,6 +1141,10 @@ int conf_saveConfig ( const char* file )
    conf_saveBool("save_compress",conf.save_compress);
    conf_saveEmptyLine();
 
+   conf_saveComment("Uses the compact binary format for savegames, faster but not human readable");
+   conf_saveBool("save_binary",conf.save_binary);
+   conf_saveEmptyLine();
+
    conf_saveComment("Afterburner sensitivity");
    conf_saveInt("afterburn_sensitivity",conf.afterburn_sens);
    conf_saveEmptyLine();
@@ -15,6 +15,7 @@
 #define TIME_COMPRESSION_DEFAULT_MAX         5000. /**< Maximum default level of time compression (target speed to match). */
 #define TIME_COMPRESSION_DEFAULT_MULT        200   /**< Default level of time compression multiplier. */
 #define SAVE_COMPRESSION_DEFAULT             1     /**< Whether or not saved games should be compressed. */
+#define SAVE_BINARY_DEFAULT                  0     /**< Whether or not saved games should use the binary format. */
 #define MOUSE_THRUST_DEFAULT                 1     /**< Whether or not to use mouse thrust controls. */
 #define AUTONAV_ABORT_DEFAULT                1.    /**< Shield level (0-1) to abort autonav at. 1 means at missile lock, 0 means at armour damage. */
 #define AUTONAV_PAUSE_DEFAULT                0     /**< Whether or not the game should pause when autonav is aborted. */
@@ -27,12 +28,14 @@
 #define FSAA_DEFAULT                         1     /**< Whether to use Full Screen Anti-Aliasing. */
 #define VSYNC_DEFAULT                        0     /**< Whether to wait for vertical sync. */
 #define VBO_DEFAULT                          0     /**< Whether to use Vertex Buffer Objects. */
+#define SHADERS_DEFAULT                      1     /**< Whether to use GLSL shaders. */
 #define MIPMAP_DEFAULT                       0     /**< Whether to use Mip Mapping. */
 #define TEXTURE_COMPRESSION_DEFAULT          0     /**< Whether to use texture compression. */
 #define INTERPOLATION_DEFAULT                1     /**< Whether to use interpolation. */
 #define NPOT_TEXTURES_DEFAULT                0     /**< Whether to allow non-power-of-two textures. */
 #define SCALE_FACTOR_DEFAULT                 1.    /**< Default scale factor. */
 #define SHOW_FPS_DEFAULT                     0     /**< Whether to display FPS on screen. */
+#define SHOW_PERF_DEFAULT                    0     /**< Whether to display frame timing on screen. */
 #define FPS_MAX_DEFAULT                      60    /**< Maximum FPS. */
 #define ENGINE_GLOWS_DEFAULT                 1     /**< Whether to display engine glows. */
 /* Audio options */
@@ -65,6 +68,7 @@ typedef struct PlayerConf_s {
    int fsaa; /**< Full Scene Anti-Aliasing to use. */
    int vsync; /**< Whether or not to use vsync. */
    int vbo; /**< Use vbo. */
+   int shaders; /**< Use GLSL shaders. */
    int mipmaps; /**< Use mipmaps. */
    int compress; /**< Use texture compression. */
    int interpolate; /**< Use texture interpolation. */
@@ -92,6 +96,7 @@ typedef struct PlayerConf_s {
 
    /* FPS. */
    int fps_show; /**< Whether or not should show FPS. */
+   int perf_show; /**< Whether or not should show frame timing. */
    int fps_max; /**< Maximum FPS to limit to. */
 
    /* Joystick. */
@@ -125,6 +130,7 @@ typedef struct PlayerConf_s {
    double compression_velocity; /**< Velocity to compress to. */
    double compression_mult; /**< Maximum time multiplier. */
    int save_compress; /**< Compress savegame. */
+   int save_binary; /**< Use the binary savegame format. */
    unsigned int afterburn_sens; /**< Afterburn sensibility. */
    int mouse_thrust; /**< Whether mouse flying controls thrust. */
    double autonav_abort; /**< Condition for aborting autonav. */
@@ -133,6 +139,24 @@ typedef struct PlayerConf_s {
    int devmode; /**< Developer mode. */
    int devcsv; /**< Output CSV data. */
 
+   /* Headless simulation. */
+   int headless; /**< Run the simulation without video nor sound. */
+   double headless_time; /**< Simulated seconds to run for. */
+   double headless_dt; /**< Fixed simulation step. */
+   char *headless_save; /**< Savegame to load before running. */
+   char *headless_system; /**< System to start in when not loading a save. */
+   char *headless_fleets; /**< Comma separated list of fleets to spawn. */
+   char *headless_until; /**< Lua conditional that ends the run early. */
+   char *scenario; /**< Stress test scenario to run. */
+
+   /* Benchmarks. */
+   int bench; /**< Run the benchmarks and exit. */
+   char *bench_filter; /**< Only run benchmarks with this in their name. */
+   double bench_time; /**< Seconds to run each benchmark for. */
+
+   /* Savegame conversion. */
+   char *convert_save; /**< Savegame to convert to the other format and exit. */
+
    /* Debugging. */
    int fpu_except; /**< Enable FPU exceptions? */
 
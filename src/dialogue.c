@@ -759,6 +759,13 @@ static int toolkit_loop( int *loop_done )
 {
    SDL_Event event;
 
+   /* Nobody to answer when headless, leave the dialogue be. */
+   if (gl_has(OPENGL_HEADLESS)) {
+      DEBUG("Skipping modal dialogue in headless mode.");
+      *loop_done = 1;
+      return -1;
+   }
+
    /* Delay a toolkit iteration. */
    toolkit_delay();
 
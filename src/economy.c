@@ -35,6 +35,8 @@
 #include "rng.h"
 #include "space.h"
 #include "ntime.h"
+#include "array.h"
+#include "perf.h"
 
 
 #define XML_COMMODITY_ID      "Commodities" /**< XML document identifier */
@@ -49,6 +51,7 @@
 #define ECON_FACTION_MOD   0.1 /**< Modifier on Base for faction standings. */
 #define ECON_PROD_MODIFIER 500000. /**< Production modifier, divide production by this amount. */
 #define ECON_PROD_VAR      0.01 /**< Defines the variability of production. */
+#define ECON_UPDATE_MAX    32 /**< Dirty systems after which a full rebuild is cheaper than updating. */
 
 
 /* commodity stack */
@@ -68,6 +71,22 @@ static int econ_initialized   = 0; /**< Is economy system initialized? */
 static int *econ_comm         = NULL; /**< Commodities to calculate. */
 static int econ_nprices       = 0; /**< Number of prices to calculate. */
 static cs *econ_G             = NULL; /**< Admittance matrix. */
+static css *econ_S            = NULL; /**< Symbolic factorization of the admittance matrix. */
+static csn *econ_N            = NULL; /**< Numeric factorization of the admittance matrix. */
+static int econ_useLU         = 0; /**< Whether the factorization is LU instead of Cholesky. */
+
+
+/**
+ * @brief Admittance of a single directed jump as entered into the G matrix.
+ */
+typedef struct EconJump_ {
+   int target; /**< ID of the target system. */
+   double Y; /**< Admittance (inverted resistance) of the jump. */
+} EconJump;
+static EconJump **econ_jumps  = NULL; /**< Per system jumps currently in the factorization (array.h). */
+static int econ_njumps        = 0; /**< Number of systems in econ_jumps. */
+static int *econ_dirty        = NULL; /**< Systems queued for an incremental update (array.h). */
+static int econ_rebuild       = 0; /**< Whether a full rebuild is queued. */
 
 
 /*
@@ -79,6 +98,13 @@ static int commodity_parse( Commodity *temp, xmlNodePtr parent );
 /* Economy. */
 static double econ_calcJumpR( StarSystem *A, StarSystem *B );
 static int econ_createGMatrix (void);
+static int econ_factorGMatrix (void);
+static void econ_freeFactor (void);
+static int econ_solve( double *B, int nrhs );
+static void econ_freeJumps (void);
+static int econ_hasEntry( int i, int t );
+static int econ_updown( int sigma, int i, int t, double Y );
+static int econ_updateGMatrix (void);
 credits_t economy_getPrice( const Commodity *com,
       const StarSystem *sys, const Planet *p ); /* externed in land.c */
 
@@ -144,6 +170,19 @@ Commodity* commodity_getW( const char* name )
 }
 
 
+/**
+ * @brief Gets all the commodities.
+ *
+ *    @param[out] n Number of commodities.
+ *    @return The commodity stack.
+ */
+Commodity* commodity_getAll( int *n )
+{
+   *n = commodity_nstack;
+   return commodity_stack;
+}
+
+
 /**
  * @brief Frees a commodity.
  *
@@ -481,16 +520,28 @@ static int econ_createGMatrix (void)
    double R, Rsum;
    cs *M;
    StarSystem *sys;
+   EconJump *jmp;
+
+   /* Everything queued is covered by the rebuild. */
+   econ_rebuild = 0;
+   if (econ_dirty != NULL)
+      array_resize( &econ_dirty, 0 );
 
    /* Create the matrix. */
    M = cs_spalloc( systems_nstack, systems_nstack, 1, 1, 1 );
    if (M == NULL)
       ERR("Unable to create CSparse Matrix.");
 
+   /* Start the jump cache over. */
+   econ_freeJumps();
+   econ_jumps  = calloc( systems_nstack, sizeof(EconJump*) );
+   econ_njumps = systems_nstack;
+
    /* Fill the matrix. */
    for (i=0; i < systems_nstack; i++) {
       sys   = &systems_stack[i];
       Rsum = 0.;
+      econ_jumps[i] = array_create( EconJump );
 
       /* Set some values. */
       for (j=0; j < sys->njumps; j++) {
@@ -500,6 +551,11 @@ static int econ_createGMatrix (void)
          R     = 1./R; /* Must be inverted. */
          Rsum += R;
 
+         /* Remember it for incremental updates. */
+         jmp         = &array_grow( &econ_jumps[i] );
+         jmp->target = sys->jumps[j].target->id;
+         jmp->Y      = R;
+
          /* Matrix is symmetrical and non-diagonal is negative. */
          ret = cs_entry( M, i, sys->jumps[j].target->id, -R );
          if (ret != 1)
@@ -520,10 +576,317 @@ static int econ_createGMatrix (void)
    econ_G = cs_compress( M );
    if (econ_G == NULL)
       ERR("Unable to create economy G Matrix.");
+   /* Two way jumps enter each off-diagonal twice, the factorizations expect them summed. */
+   if (!cs_dupl( econ_G ))
+      ERR("Unable to sum economy G Matrix entries.");
 
    /* Clean up. */
    cs_spfree(M);
 
+   /* The matrix only changes here so factorize it once for all solves. */
+   return econ_factorGMatrix();
+}
+
+
+/**
+ * @brief Frees the factorization of the admittance matrix.
+ */
+static void econ_freeFactor (void)
+{
+   if (econ_S != NULL) {
+      cs_sfree( econ_S );
+      econ_S = NULL;
+   }
+   if (econ_N != NULL) {
+      cs_nfree( econ_N );
+      econ_N = NULL;
+   }
+}
+
+
+/**
+ * @brief Factorizes the admittance matrix.
+ *
+ * The matrix is symmetric so Cholesky is tried first, falling back to LU with
+ *  partial pivoting if it turns out not to be positive definite.
+ *
+ *    @return 0 on success.
+ */
+static int econ_factorGMatrix (void)
+{
+   econ_freeFactor();
+
+   /* Cholesky with AMD ordering. */
+   econ_useLU = 0;
+   econ_S = cs_schol( 1, econ_G );
+   if (econ_S != NULL)
+      econ_N = cs_chol( econ_G, econ_S );
+   if (econ_N != NULL)
+      return 0;
+
+   /* Not positive definite, use LU instead. */
+   econ_freeFactor();
+   econ_useLU = 1;
+   econ_S = cs_sqr( 1, econ_G, 0 );
+   if (econ_S != NULL)
+      econ_N = cs_lu( econ_G, econ_S, 1. );
+   if (econ_N == NULL) {
+      econ_freeFactor();
+      WARN("Unable to factorize the economy G Matrix.");
+      return -1;
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Solves G*X = B for multiple right hand sides with the stored factorization.
+ *
+ *    @param B Column-major matrix of systems_nstack rows and nrhs columns,
+ *             overwritten with the solution.
+ *    @param nrhs Number of right hand sides.
+ *    @return 0 on success.
+ */
+static int econ_solve( double *B, int nrhs )
+{
+   int j, n;
+   double *x, *b;
+
+   if (econ_N == NULL)
+      return -1;
+
+   n = econ_G->n;
+   x = malloc( sizeof(double) * n );
+   if (x == NULL) {
+      WARN("Out of Memory!");
+      return -1;
+   }
+
+   for (j=0; j<nrhs; j++) {
+      b = &B[ j*n ];
+      if (econ_useLU) {
+         cs_ipvec( econ_N->pinv, b, x, n ); /* x = P*b */
+         cs_lsolve( econ_N->L, x ); /* x = L\x */
+         cs_usolve( econ_N->U, x ); /* x = U\x */
+         cs_ipvec( econ_S->q, x, b, n ); /* b = Q*x */
+      }
+      else {
+         cs_ipvec( econ_S->pinv, b, x, n ); /* x = P*b */
+         cs_lsolve( econ_N->L, x ); /* x = L\x */
+         cs_ltsolve( econ_N->L, x ); /* x = L'\x */
+         cs_pvec( econ_S->pinv, x, b, n ); /* b = P'*x */
+      }
+   }
+
+   free(x);
+   return 0;
+}
+
+
+/**
+ * @brief Frees the per system jump admittance cache.
+ */
+static void econ_freeJumps (void)
+{
+   int i;
+
+   for (i=0; i<econ_njumps; i++)
+      if (econ_jumps[i] != NULL)
+         array_free( econ_jumps[i] );
+   free( econ_jumps );
+   econ_jumps  = NULL;
+   econ_njumps = 0;
+}
+
+
+/**
+ * @brief Checks to see if the G matrix has an off-diagonal entry between two systems.
+ *
+ *    @param i ID of one of the systems.
+ *    @param t ID of the other system.
+ *    @return 1 if either system has a jump to the other in the factorization.
+ */
+static int econ_hasEntry( int i, int t )
+{
+   int k;
+
+   for (k=0; k<array_size(econ_jumps[i]); k++)
+      if (econ_jumps[i][k].target == t)
+         return 1;
+   for (k=0; k<array_size(econ_jumps[t]); k++)
+      if (econ_jumps[t][k].target == i)
+         return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Applies the change of admittance of a directed jump to the Cholesky factor.
+ *
+ * A jump from i to t with admittance Y adds Y to G(i,i) and -Y to G(i,t) and
+ *  G(t,i), which is Y*(e_i-e_t)*(e_i-e_t)' - Y*e_t*e_t', so it can be applied
+ *  as a rank-1 update and a rank-1 downdate of the factorization.
+ *
+ *    @param sigma +1 to apply the positive part, -1 to apply the negative part.
+ *    @param i ID of the system the jump starts at.
+ *    @param t ID of the system the jump ends at.
+ *    @param Y Change in admittance.
+ *    @return 0 on success, -1 if the factorization is no longer positive definite.
+ */
+static int econ_updown( int sigma, int i, int t, double Y )
+{
+   int Ci[2], Cp[2];
+   double Cx[2], w;
+   cs C;
+
+   /* Positive changes update the first term, negative ones the second. */
+   w = sqrt( FABS(Y) );
+   if (((Y > 0.) ? 1 : -1) == sigma) {
+      Ci[0] = econ_S->pinv[i];
+      Ci[1] = econ_S->pinv[t];
+      Cx[0] = w;
+      Cx[1] = -w;
+      Cp[1] = 2;
+   }
+   else {
+      Ci[0] = econ_S->pinv[t];
+      Cx[0] = w;
+      Cp[1] = 1;
+   }
+   Cp[0] = 0;
+
+   /* Single column matrix. */
+   C.nzmax = 2;
+   C.m     = econ_G->n;
+   C.n     = 1;
+   C.p     = Cp;
+   C.i     = Ci;
+   C.x     = Cx;
+   C.nz    = -1;
+
+   if (!cs_updown( econ_N->L, sigma, &C, econ_S->parent ))
+      return -1;
+   return 0;
+}
+
+
+/**
+ * @brief Brings the factorization up to date with the queued system changes.
+ *
+ * Jumps whose admittance changed are applied as low-rank updates to the
+ *  Cholesky factor. If the topology changed, the factorization is LU or there
+ *  are too many changes, the matrix is rebuilt from scratch instead.
+ *
+ *    @return 0 on success.
+ */
+static int econ_updateGMatrix (void)
+{
+   int i, j, k, n, t, sigma, found;
+   int *affected;
+   double Y;
+   StarSystem *sys;
+   EconJump *jmp, *newjumps;
+
+   if ((econ_dirty == NULL) || (array_size(econ_dirty) == 0)) {
+      if (!econ_rebuild)
+         return 0;
+   }
+
+   /* See if a full rebuild is needed. */
+   if (econ_rebuild || econ_useLU || (econ_N == NULL) ||
+         (econ_G->n != systems_nstack) || (econ_njumps != systems_nstack))
+      return econ_createGMatrix();
+
+   /* Jumps from and into dirty systems depend on them. */
+   affected = calloc( systems_nstack, sizeof(int) );
+   for (k=0; k<array_size(econ_dirty); k++)
+      affected[ econ_dirty[k] ] = 1;
+   for (i=0; i<systems_nstack; i++) {
+      sys = &systems_stack[i];
+      if (affected[i])
+         continue;
+      for (j=0; j<sys->njumps; j++)
+         if (affected[ sys->jumps[j].target->id ] == 1)
+            affected[i] = 2;
+      for (j=0; j<array_size(econ_jumps[i]); j++)
+         if (affected[ econ_jumps[i][j].target ] == 1)
+            affected[i] = 2;
+   }
+   array_resize( &econ_dirty, 0 );
+
+   /* Apply all the updates before the downdates to stay positive definite. */
+   for (sigma=1; sigma>=-1; sigma-=2) {
+      for (i=0; i<systems_nstack; i++) {
+         if (!affected[i])
+            continue;
+         sys = &systems_stack[i];
+
+         /* New and changed jumps. */
+         for (j=0; j<sys->njumps; j++) {
+            t = sys->jumps[j].target->id;
+            Y = 1. / econ_calcJumpR( sys, sys->jumps[j].target );
+            found = 0;
+            for (k=0; k<array_size(econ_jumps[i]); k++) {
+               if (econ_jumps[i][k].target == t) {
+                  Y -= econ_jumps[i][k].Y;
+                  found = 1;
+                  break;
+               }
+            }
+            /* New connection changes the sparsity pattern. */
+            if (!found && !econ_hasEntry( i, t )) {
+               free( affected );
+               return econ_createGMatrix();
+            }
+            if ((Y != 0.) && econ_updown( sigma, i, t, Y )) {
+               free( affected );
+               return econ_createGMatrix();
+            }
+         }
+
+         /* Removed jumps. */
+         for (k=0; k<array_size(econ_jumps[i]); k++) {
+            t = econ_jumps[i][k].target;
+            found = 0;
+            for (j=0; j<sys->njumps; j++) {
+               if (sys->jumps[j].target->id == t) {
+                  found = 1;
+                  break;
+               }
+            }
+            if (!found && econ_updown( sigma, i, t, -econ_jumps[i][k].Y )) {
+               free( affected );
+               return econ_createGMatrix();
+            }
+         }
+      }
+   }
+
+   /* Update the jump cache. */
+   n = 0;
+   for (i=0; i<systems_nstack; i++) {
+      if (!affected[i])
+         continue;
+      sys      = &systems_stack[i];
+      newjumps = array_create( EconJump );
+      for (j=0; j<sys->njumps; j++) {
+         jmp         = &array_grow( &newjumps );
+         jmp->target = sys->jumps[j].target->id;
+         jmp->Y      = 1. / econ_calcJumpR( sys, sys->jumps[j].target );
+      }
+      array_free( econ_jumps[i] );
+      econ_jumps[i] = newjumps;
+      n++;
+   }
+   free( affected );
+
+   /* econ_G is left stale, only the factorization is used to solve and
+    * rebuilds always start from scratch. */
+#if DEBUGGING
+   DEBUG("Economy: updated factorization for %d system%s", n, (n==1) ? "" : "s" );
+#endif /* DEBUGGING */
+
    return 0;
 }
 
@@ -564,21 +927,107 @@ int economy_init (void)
  */
 int economy_refresh (void)
 {
+#if DEBUGGING
+   uint64_t t0, t1, t2;
+#endif /* DEBUGGING */
+
    /* Economy must be initialized. */
    if (econ_initialized == 0)
       return 0;
 
+#if DEBUGGING
+   t0 = perf_ticks();
+#endif /* DEBUGGING */
+
    /* Create the resistance matrix. */
    if (econ_createGMatrix())
       return -1;
 
+#if DEBUGGING
+   t1 = perf_ticks();
+#endif /* DEBUGGING */
+
    /* Initialize the prices. */
    economy_update( 0 );
 
+#if DEBUGGING
+   t2 = perf_ticks();
+   DEBUG("Economy: %s factorization of %d systems took %.1f ms, solving %d price%s took %.1f ms",
+         econ_useLU ? "LU" : "Cholesky", systems_nstack, perf_ms( t1-t0 ),
+         econ_nprices, (econ_nprices==1) ? "" : "s", perf_ms( t2-t1 ) );
+#endif /* DEBUGGING */
+
    return 0;
 }
 
 
+/**
+ * @brief Queues a system whose economy parameters changed.
+ *
+ * Call when the jumps or dominant faction of a system change, the change is
+ *  applied on the next economy_refreshQueued() or economy_update().
+ *
+ *    @param sysid ID of the system that changed.
+ */
+void economy_queueSystem( int sysid )
+{
+   int i;
+
+   /* Economy must be initialized. */
+   if (econ_initialized == 0)
+      return;
+
+   if (econ_rebuild)
+      return;
+
+   /* New systems can't be updated incrementally. */
+   if ((sysid < 0) || (sysid >= econ_njumps)) {
+      econ_rebuild = 1;
+      return;
+   }
+
+   if (econ_dirty == NULL)
+      econ_dirty = array_create( int );
+
+   /* Already queued. */
+   for (i=0; i<array_size(econ_dirty); i++)
+      if (econ_dirty[i] == sysid)
+         return;
+
+   /* Too much changed to bother updating. */
+   if (array_size(econ_dirty) >= ECON_UPDATE_MAX) {
+      econ_rebuild = 1;
+      return;
+   }
+
+   array_push_back( &econ_dirty, sysid );
+}
+
+
+/**
+ * @brief Applies the queued system changes and recalculates the prices.
+ *
+ * Much cheaper than economy_refresh() when only a few systems changed.
+ *
+ *    @return 0 on success.
+ */
+int economy_refreshQueued (void)
+{
+   /* Economy must be initialized. */
+   if (econ_initialized == 0)
+      return 0;
+
+   /* Nothing to do. */
+   if (!econ_rebuild && ((econ_dirty == NULL) || (array_size(econ_dirty) == 0)))
+      return 0;
+
+   if (econ_updateGMatrix())
+      return -1;
+
+   return economy_update( 0 );
+}
+
+
 /**
  * @brief Updates the economy.
  *
@@ -586,9 +1035,8 @@ int economy_refresh (void)
  */
 int economy_update( unsigned int dt )
 {
-   int ret;
    int i, j;
-   double *X;
+   double *X, *Xj;
    double scale, offset;
    /*double min, max;*/
 
@@ -596,31 +1044,32 @@ int economy_update( unsigned int dt )
    if (econ_initialized == 0)
       return 0;
 
-   /* Create the vector to solve the system. */
-   X = malloc(sizeof(double)*systems_nstack);
+   /* Make sure queued changes are taken into account. */
+   econ_updateGMatrix();
+
+   /* Nothing to solve. */
+   if ((econ_nprices == 0) || (systems_nstack == 0))
+      return 0;
+
+   /* Create the matrix with one column per price set. */
+   X = malloc(sizeof(double)*systems_nstack*econ_nprices);
    if (X == NULL) {
       WARN("Out of Memory!");
       return -1;
    }
 
+   /* First we must load the columns with intensities. */
+   for (j=0; j<econ_nprices; j++)
+      for (i=0; i<systems_nstack; i++)
+         X[ j*systems_nstack + i ] = econ_calcSysI( dt, &systems_stack[i], j );
+
+   /* Solve all the price sets with the stored factorization. */
+   if (econ_solve( X, econ_nprices ))
+      WARN("Failed to solve the Economy System.");
+
    /* Calculate the results for each price set. */
    for (j=0; j<econ_nprices; j++) {
-
-      /* First we must load the vector with intensities. */
-      for (i=0; i<systems_nstack; i++)
-         X[i] = econ_calcSysI( dt, &systems_stack[i], j );
-
-      /* Solve the system. */
-      /** @TODO This should be improved to try to use better factorizations (LU/Cholesky)
-       * if possible or just outright try to use some other library that does fancy stuff
-       * like UMFPACK. Would be also interesting to see if it could be optimized so we
-       * store the factorization or update that instead of handling it individually. Another
-       * point of interest would be to split loops out to make the solving faster, however,
-       * this may be trickier to do (although it would surely let us use cholesky always if we
-       * enforce that condition). */
-      ret = cs_qrsol( 3, econ_G, X );
-      if (ret != 1)
-         WARN("Failed to solve the Economy System.");
+      Xj = &X[ j*systems_nstack ];
 
       /*
        * Get the minimum and maximum to scale.
@@ -629,10 +1078,10 @@ int economy_update( unsigned int dt )
       min = +HUGE_VALF;
       max = -HUGE_VALF;
       for (i=0; i<systems_nstack; i++) {
-         if (X[i] < min)
-            min = X[i];
-         if (X[i] > max)
-            max = X[i];
+         if (Xj[i] < min)
+            min = Xj[i];
+         if (Xj[i] > max)
+            max = Xj[i];
       }
       scale = 1. / (max - min);
       offset = 0.5 - min * scale;
@@ -646,7 +1095,7 @@ int economy_update( unsigned int dt )
       scale    = 1.;
       offset   = 1.;
       for (i=0; i<systems_nstack; i++)
-         systems_stack[i].prices[j] = X[i] * scale + offset;
+         systems_stack[i].prices[j] = Xj[i] * scale + offset;
    }
 
    /* Clean up. */
@@ -676,6 +1125,13 @@ void economy_destroy (void)
    }
 
    /* Destroy the economy matrix. */
+   econ_freeFactor();
+   econ_freeJumps();
+   if (econ_dirty != NULL) {
+      array_free( econ_dirty );
+      econ_dirty = NULL;
+   }
+   econ_rebuild = 0;
    if (econ_G != NULL) {
       cs_spfree( econ_G );
       econ_G = NULL;
@@ -39,6 +39,7 @@ typedef struct Commodity_ {
  */
 Commodity* commodity_get( const char* name );
 Commodity* commodity_getW( const char* name );
+Commodity* commodity_getAll( int *n );
 int commodity_load (void);
 void commodity_free (void);
 
@@ -49,6 +50,8 @@ void commodity_free (void);
 int economy_init (void);
 int economy_update( unsigned int dt );
 int economy_refresh (void);
+void economy_queueSystem( int sysid );
+int economy_refreshQueued (void);
 void economy_destroy (void);
 
 
@@ -404,7 +404,7 @@ static void equipment_renderColumn( double x, double y, double w, double h,
 
       if (lst[i].outfit != NULL) {
          /* Draw bugger. */
-         gl_blitScale( lst[i].outfit->gfx_store,
+         gl_blitScale( outfit_gfxStore( lst[i].outfit ),
                x, y, w, h, NULL );
          c = &cBlack; /* Ensures nice uniform outlines. */
       }
@@ -1490,6 +1490,7 @@ static void equipment_addOutfitListSingle( unsigned int wid,
          toutfits, soutfits, noutfits,
          equipment_updateOutfitSingle,
          equipment_rightClickOutfits );
+   toolkit_setImageArrayLoader( wid, EQUIPMENT_OUTFITS, outfits_loadImage, NULL );
 
    /* Case there are none we don't need to do more. */
    if (strcmp( soutfits[0], "None" )==0)
@@ -27,6 +27,7 @@
 #include "colour.h"
 #include "hook.h"
 #include "space.h"
+#include "economy.h"
 
 
 #define XML_FACTION_ID     "Factions"   /**< XML section identifier */
@@ -100,6 +101,9 @@ static void faction_sanitizePlayer( Faction* faction );
 static void faction_modPlayerLua( int f, double mod, const char *source, int secondary );
 static int faction_parse( Faction* temp, xmlNodePtr parent );
 static void faction_parseSocial( xmlNodePtr parent );
+static int faction_addRelation( int **list, int *n, int o );
+static int faction_rmRelation( int *list, int *n, int o );
+static void faction_relationChanged( int a, int b );
 /* externed */
 int pfaction_save( xmlTextWriterPtr writer );
 int pfaction_load( xmlNodePtr parent );
@@ -128,6 +132,17 @@ int faction_get( const char* name )
 }
 
 
+/**
+ * @brief Gets the number of factions, including invisible ones.
+ *
+ *    @return Number of factions, faction IDs are below this.
+ */
+int faction_count (void)
+{
+   return faction_nstack;
+}
+
+
 /**
  * @brief Gets all the factions.
  */
@@ -356,6 +371,162 @@ int* faction_getAllies( int f, int *n )
 }
 
 
+/**
+ * @brief Adds a faction to a relation list if it isn't there yet.
+ *
+ *    @param list List to add to.
+ *    @param n Number of elements in the list.
+ *    @param o Faction to add.
+ *    @return 1 if the list changed.
+ */
+static int faction_addRelation( int **list, int *n, int o )
+{
+   int i;
+   for (i=0; i<*n; i++)
+      if ((*list)[i] == o)
+         return 0;
+   *list = realloc( *list, sizeof(int) * (*n+1) );
+   (*list)[ (*n)++ ] = o;
+   return 1;
+}
+
+
+/**
+ * @brief Removes a faction from a relation list.
+ *
+ *    @param list List to remove from.
+ *    @param n Number of elements in the list.
+ *    @param o Faction to remove.
+ *    @return 1 if the list changed.
+ */
+static int faction_rmRelation( int *list, int *n, int o )
+{
+   int i;
+   for (i=0; i<*n; i++) {
+      if (list[i] != o)
+         continue;
+      list[i] = list[ --(*n) ];
+      return 1;
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Updates what depends on the relation between two factions.
+ *
+ * Jumps between systems of the two factions change resistance in the economy.
+ *
+ *    @param a One of the factions.
+ *    @param b The other faction.
+ */
+static void faction_relationChanged( int a, int b )
+{
+   StarSystem *sys;
+   int i, n;
+
+   sys = system_getAll( &n );
+   for (i=0; i<n; i++)
+      if ((sys[i].faction == a) || (sys[i].faction == b))
+         economy_queueSystem( sys[i].id );
+   economy_refreshQueued();
+}
+
+
+/**
+ * @brief Makes two factions enemies.
+ *
+ *    @param f Faction to add an enemy to.
+ *    @param o Faction to become an enemy.
+ */
+void faction_addEnemy( int f, int o )
+{
+   Faction *ff;
+
+   if (!faction_isFaction(f) || !faction_isFaction(o) || (f == o)) {
+      WARN("Invalid factions '%d' and '%d' to make enemies.", f, o);
+      return;
+   }
+
+   ff = &faction_stack[f];
+   if (faction_addRelation( &ff->enemies, &ff->nenemies, o ))
+      faction_relationChanged( f, o );
+}
+
+
+/**
+ * @brief Makes two factions no longer enemies.
+ *
+ *    @param f Faction to remove an enemy from.
+ *    @param o Faction to stop being an enemy.
+ */
+void faction_rmEnemy( int f, int o )
+{
+   Faction *ff, *fo;
+   int changed;
+
+   if (!faction_isFaction(f) || !faction_isFaction(o)) {
+      WARN("Invalid factions '%d' and '%d' to stop being enemies.", f, o);
+      return;
+   }
+
+   /* Enmity goes both ways. */
+   ff = &faction_stack[f];
+   fo = &faction_stack[o];
+   changed  = faction_rmRelation( ff->enemies, &ff->nenemies, o );
+   changed |= faction_rmRelation( fo->enemies, &fo->nenemies, f );
+   if (changed)
+      faction_relationChanged( f, o );
+}
+
+
+/**
+ * @brief Makes two factions allies.
+ *
+ *    @param f Faction to add an ally to.
+ *    @param o Faction to become an ally.
+ */
+void faction_addAlly( int f, int o )
+{
+   Faction *ff;
+
+   if (!faction_isFaction(f) || !faction_isFaction(o) || (f == o)) {
+      WARN("Invalid factions '%d' and '%d' to make allies.", f, o);
+      return;
+   }
+
+   ff = &faction_stack[f];
+   if (faction_addRelation( &ff->allies, &ff->nallies, o ))
+      faction_relationChanged( f, o );
+}
+
+
+/**
+ * @brief Makes two factions no longer allies.
+ *
+ *    @param f Faction to remove an ally from.
+ *    @param o Faction to stop being an ally.
+ */
+void faction_rmAlly( int f, int o )
+{
+   Faction *ff, *fo;
+   int changed;
+
+   if (!faction_isFaction(f) || !faction_isFaction(o)) {
+      WARN("Invalid factions '%d' and '%d' to stop being allies.", f, o);
+      return;
+   }
+
+   /* Alliance goes both ways. */
+   ff = &faction_stack[f];
+   fo = &faction_stack[o];
+   changed  = faction_rmRelation( ff->allies, &ff->nallies, o );
+   changed |= faction_rmRelation( fo->allies, &fo->nallies, f );
+   if (changed)
+      faction_relationChanged( f, o );
+}
+
+
 /**
  * @brief Gets the state associated to the faction scheduler.
  */
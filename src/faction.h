@@ -18,6 +18,7 @@
 /* get stuff */
 int faction_isFaction( int f );
 int faction_get( const char* name );
+int faction_count (void);
 int* faction_getAll( int *n );
 int* faction_getKnown( int *n );
 int faction_isKnown( int id );
@@ -35,6 +36,10 @@ int* faction_getGroup( int *n, int which );
 
 /* set stuff */
 int faction_setKnown( int id, int state );
+void faction_addEnemy( int f, int o );
+void faction_rmEnemy( int f, int o );
+void faction_addAlly( int f, int o );
+void faction_rmAlly( int f, int o );
 
 /* player stuff */
 void faction_modPlayer( int f, double mod, const char *source );
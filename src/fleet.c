@@ -60,6 +60,19 @@ Fleet* fleet_get( const char* name )
 }
 
 
+/**
+ * @brief Gets all the fleets.
+ *
+ *    @param[out] n Number of fleets.
+ *    @return The fleet stack.
+ */
+Fleet* fleet_getAll( int *n )
+{
+   *n = nfleets;
+   return fleet_stack;
+}
+
+
 /**
  * @brief Creates a pilot belonging to a fleet.
  *
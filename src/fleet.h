@@ -52,6 +52,7 @@ typedef struct Fleet_ {
  * getting fleet stuff
  */
 Fleet* fleet_get( const char* name );
+Fleet* fleet_getAll( int *n );
 
 
 /*
@@ -804,24 +804,26 @@ static int font_genTextureAtlas( glFont* font, FT_Face face )
       free(chars[i].data);
    }
 
-   /* Create the font texture. */
-   glGenTextures( 1, &font->texture );
-   glBindTexture( GL_TEXTURE_2D, font->texture );
+   /* Create the font texture, only the metrics are needed when headless. */
+   if (!gl_has(OPENGL_HEADLESS)) {
+      glGenTextures( 1, &font->texture );
+      glBindTexture( GL_TEXTURE_2D, font->texture );
 
-   /* Shouldn't ever scale - we'll generate appropriate size font. */
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      /* Shouldn't ever scale - we'll generate appropriate size font. */
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
-   /* Clamp texture .*/
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      /* Clamp texture .*/
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-   /* Upload data. */
-   glTexImage2D( GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, w, h, 0,
-         GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, data );
+      /* Upload data. */
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, w, h, 0,
+            GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, data );
 
-   /* Check for errors. */
-   gl_checkErr();
+      /* Check for errors. */
+      gl_checkErr();
+   }
 
    /* Create the VBOs. */
    n           = 8 * 128;
@@ -1116,7 +1118,8 @@ void gl_freeFont( glFont* font )
 {
    if (font == NULL)
       font = &gl_defFont;
-   glDeleteTextures(1,&font->texture);
+   if (font->texture != 0)
+      glDeleteTextures(1,&font->texture);
    if (font->chars != NULL)
       free(font->chars);
    font->chars = NULL;
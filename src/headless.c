@@ -0,0 +1,228 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file headless.c
+ *
+ * @brief Runs the simulation without window, context nor sound.
+ *
+ * The game is advanced with a fixed time step as fast as the CPU allows,
+ *  which makes runs reproducible and lets them go far faster than real
+ *  time. Useful for profiling, balancing and soak testing.
+ */
+
+
+#include "headless.h"
+
+#include "naev.h"
+
+#include <stdlib.h>
+#include "nstring.h"
+#include "SDL.h"
+
+#include "log.h"
+#include "conf.h"
+#include "rng.h"
+#include "nfile.h"
+#include "pilot.h"
+#include "player.h"
+#include "fleet.h"
+#include "space.h"
+#include "land.h"
+#include "load.h"
+#include "cond.h"
+#include "perf.h"
+#include "scenario.h"
+
+
+/*
+ * Prototypes.
+ */
+static int headless_setup (void);
+static int headless_addFleet( const char *name );
+static int headless_done (void);
+
+
+/**
+ * @brief Sets up the scenario to simulate.
+ *
+ *    @return 0 on success.
+ */
+static int headless_setup (void)
+{
+   char file[PATH_MAX];
+   char *fleets, *name, *sep;
+   int ret;
+
+   /* Load a savegame, a bare name is looked up in the save directory. */
+   if (conf.headless_save != NULL) {
+      if (nfile_fileExists( conf.headless_save ))
+         strncpy( file, conf.headless_save, sizeof(file)-1 );
+      else
+         nsnprintf( file, sizeof(file), "%ssaves/%s.ns",
+               nfile_dataPath(), conf.headless_save );
+      file[sizeof(file)-1] = '\0';
+      if (load_game( file, 0 ))
+         return -1;
+
+      /* The save leaves the player landed. */
+      takeoff( 0 );
+   }
+   /* Start in an empty system with no player. */
+   else if (conf.headless_system != NULL) {
+      if (!system_exists( conf.headless_system )) {
+         WARN("System '%s' not found!", conf.headless_system);
+         return -1;
+      }
+      space_init( conf.headless_system );
+   }
+   else {
+      WARN("Headless mode needs either a savegame or a system to start in!");
+      return -1;
+   }
+
+   /* Spawn requested fleets. */
+   if (conf.headless_fleets == NULL)
+      return 0;
+   ret    = 0;
+   fleets = strdup( conf.headless_fleets );
+   for (name = fleets; name != NULL; name = sep) {
+      sep = strchr( name, ',' );
+      if (sep != NULL)
+         *sep++ = '\0';
+      if (headless_addFleet( name ))
+         ret = -1;
+   }
+   free( fleets );
+
+   return ret;
+}
+
+
+/**
+ * @brief Spawns a fleet jumping into the current system.
+ *
+ *    @param name Name of the fleet to spawn.
+ *    @return 0 on success.
+ */
+static int headless_addFleet( const char *name )
+{
+   Fleet *flt;
+   Vector2d vp, vv;
+   PilotFlags flags;
+   double a;
+   int i;
+
+   flt = fleet_get( name );
+   if (flt == NULL) {
+      WARN("Fleet '%s' not found!", name);
+      return -1;
+   }
+
+   /* Jump in through a random jump point if possible. */
+   pilot_clearFlagsRaw( flags );
+   if (cur_system->njumps > 0) {
+      i = RNG_SANE( 0, cur_system->njumps-1 );
+      space_calcJumpInPos( cur_system, cur_system->jumps[i].target, &vp, &vv, &a );
+      pilot_setFlagRaw( flags, PILOT_HYP_END );
+   }
+   else {
+      a = RNGF() * 2. * M_PI;
+      vect_pset( &vp, RNGF() * cur_system->radius, a );
+      vectnull( &vv );
+   }
+
+   /* Same displacement as when spawned from Lua, first ship is exact. */
+   for (i=0; i<flt->npilots; i++) {
+      if (i > 0)
+         vect_cadd( &vp, RNG(75,150) * (RNG(0,1) ? 1 : -1),
+               RNG(75,150) * (RNG(0,1) ? 1 : -1) );
+      fleet_createPilot( flt, &flt->pilots[i], a, &vp, &vv, NULL, flags, -1 );
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Checks to see if the run should end before the time is up.
+ *
+ *    @return 1 if the run is over.
+ */
+static int headless_done (void)
+{
+   int ret;
+
+   /* Player got blown up. */
+   if ((conf.headless_save != NULL) &&
+         ((player.p == NULL) || player_isFlag(PLAYER_DESTROYED)))
+      return 1;
+
+   if (conf.headless_until == NULL)
+      return 0;
+
+   /* Errors also stop the run, they would just repeat every step. */
+   ret = cond_check( conf.headless_until );
+   return (ret != 0);
+}
+
+
+/**
+ * @brief Runs the headless simulation.
+ *
+ * Uses conf.headless_time and conf.headless_dt, falling back to defaults if
+ *  not set.
+ *
+ *    @return 0 on success.
+ */
+int headless_run (void)
+{
+   double dt, t, tmax;
+   unsigned int steps, start, elapsed;
+   int n;
+
+   dt   = (conf.headless_dt > 0.)   ? conf.headless_dt   : HEADLESS_DT_DEFAULT;
+   tmax = (conf.headless_time > 0.) ? conf.headless_time : HEADLESS_TIME_DEFAULT;
+
+   /* Scenarios set up everything and say when they are done. */
+   if (conf.scenario != NULL) {
+      if (scenario_start( conf.scenario ))
+         return -1;
+      tmax = HUGE_VAL;
+   }
+   else if (headless_setup()) {
+      WARN("Unable to set up the headless simulation!");
+      return -1;
+   }
+   pilot_getAll( &n );
+   if (!scenario_active())
+      LOG("Headless: simulating %.1f seconds in %s with %d pilots (dt = %.4f)",
+            tmax, cur_system->name, n, dt );
+
+   /* Fixed step, no frame limiting nor time compression. */
+   start = SDL_GetTicks();
+   t     = 0.;
+   steps = 0;
+   while (t < tmax) {
+      perf_frameBegin();
+      perf_begin( PERF_UPDATE );
+      update_routine( dt, 0 );
+      perf_end( PERF_UPDATE );
+      perf_frameEnd();
+      t += dt;
+      steps++;
+      if (scenario_frame( dt ) || headless_done())
+         break;
+   }
+   elapsed = SDL_GetTicks() - start;
+
+   /* Summary. */
+   pilot_getAll( &n );
+   LOG("Headless: %.1f simulated seconds in %.3f real seconds (%.1fx, %.0f steps/s)",
+         t, elapsed / 1000., t * 1000. / MAX(elapsed,1),
+         steps * 1000. / MAX(elapsed,1) );
+   LOG("Headless: ended in %s with %d pilots", cur_system->name, n );
+
+   return scenario_end();
+}
@@ -0,0 +1,17 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef HEADLESS_H
+#  define HEADLESS_H
+
+
+#define HEADLESS_TIME_DEFAULT    60.      /**< Default simulated seconds to run for. */
+#define HEADLESS_DT_DEFAULT      (1./60.) /**< Default fixed simulation step. */
+
+
+int headless_run (void);
+
+
+#endif /* HEADLESS_H */
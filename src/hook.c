@@ -36,6 +36,7 @@
 #include "claim.h"
 #include "nlua_pilot.h"
 #include "nlua_hook.h"
+#include "nlua_prof.h"
 #include "mission.h"
 #include "space.h"
 #include "menu.h"
@@ -429,7 +430,7 @@ static int hook_runFunc( Hook *hook )
  */
 static int hook_run( Hook *hook, HookParam *param, int claims )
 {
-   int ret;
+   int ret, mark;
 
    /* Do not run if pending deletion. */
    if (hook->delete)
@@ -439,6 +440,7 @@ static int hook_run( Hook *hook, HookParam *param, int claims )
    if (menu_isOpen(MENU_MAIN))
       return 0;
 
+   mark = nlua_profEnter( NULL, "hook", hook->stack );
    switch (hook->type) {
       case HOOK_TYPE_MISN:
          ret = hook_runMisn(hook, param, claims);
@@ -455,8 +457,10 @@ static int hook_run( Hook *hook, HookParam *param, int claims )
       default:
          WARN("Invalid hook type '%d', deleting.", hook->type);
          hook->delete = 1;
-         return -1;
+         ret = -1;
+         break;
    }
+   nlua_profLeave( NULL, mark );
 
    return ret;
 }
@@ -163,7 +163,7 @@ void outfits_open( unsigned int wid )
       slottype = malloc(sizeof(char*)*noutfits );
       for (i=0; i<noutfits; i++) {
          soutfits[i] = strdup(outfits[i]->name);
-         toutfits[i] = outfits[i]->gfx_store;
+         toutfits[i] = NULL; /* Loaded when visible. */
 
          /* Background colour. */
          c = outfit_slotSizeColour( &outfits[i]->slot );
@@ -187,6 +187,7 @@ void outfits_open( unsigned int wid )
    window_addImageArray( wid, 20, 20,
          iw, ih, "iarOutfits", 64, 64,
          toutfits, soutfits, noutfits, outfits_update, outfits_rmouse );
+   toolkit_setImageArrayLoader( wid, "iarOutfits", outfits_loadImage, NULL );
 
    /* write the outfits stuff */
    outfits_update( wid, NULL );
@@ -230,6 +231,28 @@ void outfits_updateQuantities( unsigned int wid )
    free(outfits);
    toolkit_setImageArrayQuantity( wid, "iarOutfits", quantity );
 }
+
+
+/**
+ * @brief Loads the store image of an outfit for image arrays.
+ *
+ * The image array holds the only reference, so scrolled away images get
+ *  freed.
+ *
+ *    @param name Name of the outfit.
+ *    @return New reference to the store image or NULL if not an outfit.
+ */
+glTexture* outfits_loadImage( const char *name )
+{
+   Outfit *o;
+
+   o = outfit_getW( name );
+   if (o == NULL)
+      return NULL;
+   return outfit_gfxStoreRef( o );
+}
+
+
 /**
  * @brief Updates the outfits in the outfit window.
  *    @param wid Window to update the outfits in.
@@ -277,7 +300,7 @@ void outfits_update( unsigned int wid, char* str )
    outfit = outfit_get( outfitname );
 
    /* new image */
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 0, 0 );
+   window_modifyImage( wid, "imgOutfit", outfit_gfxStore( outfit ), 0, 0 );
 
    if (outfit_canBuy(outfitname) > 0)
       window_enableButton( wid, "btnBuyOutfit" );
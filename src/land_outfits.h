@@ -14,6 +14,7 @@
 void outfits_open( unsigned int wid );
 void outfits_updateQuantities( unsigned int wid );
 void outfits_update( unsigned int wid, char* str );
+glTexture* outfits_loadImage( const char *name );
 void outfits_updateEquipmentOutfits( void );
 int outfit_canBuy( char *outfit );
 int outfit_canSell( char *outfit );
@@ -42,6 +42,8 @@ static void shipyard_rmouse( unsigned int wid, char* widget_name );
 static void shipyard_renderSlots( double bx, double by, double bw, double bh, void *data );
 static void shipyard_renderSlotsRow( double bx, double by, double bw, char *str, ShipOutfitSlot *s, int n );
 static void shipyard_find( unsigned int wid, char* str );
+static glTexture* shipyard_loadImage( const char *name );
+static void shipyard_unloadImage( const char *name, glTexture *tex );
 
 
 /**
@@ -152,19 +154,64 @@ void shipyard_open( unsigned int wid )
       tships = malloc(sizeof(glTexture*)*nships);
       for (i=0; i<nships; i++) {
          sships[i] = strdup(ships[i]->name);
-         tships[i] = ships[i]->gfx_store;
+         tships[i] = NULL; /* Loaded when visible. */
       }
       free(ships);
    }
    window_addImageArray( wid, 20, 20,
          iw, ih, "iarShipyard", 64./96.*128., 64.,
          tships, sships, nships, shipyard_update, shipyard_rmouse );
+   toolkit_setImageArrayLoader( wid, "iarShipyard",
+         shipyard_loadImage, shipyard_unloadImage );
 
    /* write the shipyard stuff */
    shipyard_update(wid, NULL);
    /* Set default keyboard focuse to the list */
    window_setFocus( wid , "iarShipyard" );
 }
+
+
+/**
+ * @brief Loads the store image of a ship for the image array.
+ *
+ * The ship graphics stay in use until shipyard_unloadImage() is called.
+ *
+ *    @param name Name of the ship.
+ *    @return New reference to the store image or NULL if not a ship.
+ */
+static glTexture* shipyard_loadImage( const char *name )
+{
+   Ship *s;
+
+   s = ship_getW( name );
+   if (s == NULL)
+      return NULL;
+   ship_gfxUse( s );
+   if (s->gfx_store == NULL) {
+      ship_gfxRelease( s );
+      return NULL;
+   }
+   return gl_dupTexture( s->gfx_store );
+}
+
+
+/**
+ * @brief Releases a store image loaded with shipyard_loadImage().
+ *
+ *    @param name Name of the ship.
+ *    @param tex Store image to release.
+ */
+static void shipyard_unloadImage( const char *name, glTexture *tex )
+{
+   Ship *s;
+
+   gl_freeTexture( tex );
+   s = ship_getW( name );
+   if (s != NULL)
+      ship_gfxRelease( s );
+}
+
+
 /**
  * @brief Updates the ships in the shipyard window.
  *    @param wid Window to update the ships in.
@@ -216,6 +263,7 @@ void shipyard_update( unsigned int wid, char* str )
    shipyard_selected = ship;
 
    /* update image */
+   ship_gfxLoad( ship );
    window_modifyImage( wid, "imgTarget", ship->gfx_store, 0, 0 );
 
    /* update text */
@@ -14,6 +14,7 @@
 #include "naev.h"
 
 #include "nxml.h"
+#include "libxml/xmlreader.h"
 #include "log.h"
 #include "player.h"
 #include "nfile.h"
@@ -33,6 +34,8 @@
 #include "hook.h"
 #include "nstring.h"
 #include "outfit.h"
+#include "save.h"
+#include "nbxml.h"
 
 
 #define LOAD_WIDTH      600 /**< Load window width. */
@@ -41,6 +44,8 @@
 #define BUTTON_WIDTH    80 /**< Button width. */
 #define BUTTON_HEIGHT   30 /**< Button height. */
 
+#define LOAD_INDEX      ".index.xml" /**< Save summary index, hidden so it's not listed. */
+
 
 static nsave_t *load_saves = NULL; /**< Array of save.s */
 
@@ -76,12 +81,154 @@ static void load_menu_close( unsigned int wdw, char *str );
 static void load_menu_load( unsigned int wdw, char *str );
 static void load_menu_delete( unsigned int wdw, char *str );
 static int load_load( nsave_t *save, const char *path );
+static int load_loadFull( nsave_t *save, const char *path );
+static int load_loadHeader( nsave_t *save, const char *path );
+static char* load_readerStr( xmlTextReaderPtr reader );
+static void load_freeSave( nsave_t *ns );
+static nsave_t* load_indexRead (void);
+static int load_indexWrite (void);
 
 
 /**
- * @brief Loads an individual save.
+ * @brief Loads the summary of an individual save.
+ *
+ * Only reads the header if available, older saves get parsed fully.
+ *
+ *    @param save Save to load into.
+ *    @param path Path of the save.
+ *    @return 0 on success.
  */
 static int load_load( nsave_t *save, const char *path )
+{
+   int ret;
+
+   ret = load_loadHeader( save, path );
+   if (ret > 0) {
+      load_freeSave( save );
+      ret = load_loadFull( save, path );
+   }
+   if (ret == 0)
+      nfile_fileInfo( &save->mtime, &save->size, "%s", path );
+   return ret;
+}
+
+
+/**
+ * @brief Gets the text contents of the current node of a reader.
+ *
+ *    @param reader Reader to get text from.
+ *    @return Newly allocated text or NULL if empty.
+ */
+static char* load_readerStr( xmlTextReaderPtr reader )
+{
+   xmlChar *str;
+   char *ret;
+
+   str = xmlTextReaderReadString( reader );
+   if (str == NULL)
+      return NULL;
+   ret = strdup( (char*)str );
+   xmlFree( str );
+   return ret;
+}
+
+
+/**
+ * @brief Loads the summary of a save from its header.
+ *
+ * Streams the file and stops right after the header, so the size of the save
+ *  doesn't matter.
+ *
+ *    @param save Save to load into.
+ *    @param path Path of the save.
+ *    @return 0 on success, 1 if the save has no header or -1 on error.
+ */
+static int load_loadHeader( nsave_t *save, const char *path )
+{
+   xmlTextReaderPtr reader;
+   const char *name;
+   char *str;
+   int depth, ret, in_header;
+
+   memset( save, 0, sizeof(nsave_t) );
+
+   /* Binary saves have to be decoded fully. */
+   if (nbxml_isBinary( path ))
+      return 1;
+
+   reader = xmlReaderForFile( path, NULL, 0 );
+   if (reader == NULL) {
+      WARN("Unable to parse save path '%s'.", path);
+      return -1;
+   }
+
+   ret       = 1;
+   in_header = 0;
+   while (xmlTextReaderRead( reader ) == 1) {
+      if (xmlTextReaderNodeType( reader ) != XML_READER_TYPE_ELEMENT)
+         continue;
+      name  = (const char*) xmlTextReaderConstName( reader );
+      depth = xmlTextReaderDepth( reader );
+
+      /* Top level, header comes right after the version. */
+      if (depth == 1) {
+         if (strcmp( name, "header" ) == 0) {
+            in_header = 1;
+            ret       = 0;
+         }
+         else if (strcmp( name, "version" ) == 0)
+            in_header = 1;
+         else /* Past the header. */
+            break;
+         continue;
+      }
+      if (!in_header || (depth != 2))
+         continue;
+
+      /* Save data. */
+      str = load_readerStr( reader );
+      if (strcmp( name, "naev" ) == 0)
+         save->version = str;
+      else if (strcmp( name, "data" ) == 0)
+         save->data = str;
+      else if (strcmp( name, "name" ) == 0)
+         save->name = str;
+      else if (strcmp( name, "location" ) == 0)
+         save->planet = str;
+      else if (strcmp( name, "shipname" ) == 0)
+         save->shipname = str;
+      else if (strcmp( name, "shipmodel" ) == 0)
+         save->shipmodel = str;
+      else {
+         if (strcmp( name, "credits" ) == 0)
+            save->credits = (str == NULL) ? 0 : strtoull( str, NULL, 10 );
+         else if (strcmp( name, "date" ) == 0)
+            save->date = (str == NULL) ? 0 : strtoll( str, NULL, 10 );
+         free( str );
+      }
+   }
+   xmlFreeTextReader( reader );
+
+   if ((ret == 0) && (save->name == NULL)) {
+      WARN("Save '%s' has an invalid header.", path);
+      ret = 1;
+   }
+   if (ret == 0)
+      save->path = strdup(path);
+   return ret;
+}
+
+
+/**
+ * @brief Loads the summary of a save by parsing all of it.
+ *
+ * Needed for saves made before the header was added.
+ *
+ *    @param save Save to load into.
+ *    @param path Path of the save.
+ *    @return 0 on success.
+ */
+static int load_loadFull( nsave_t *save, const char *path )
 {
    xmlDocPtr doc;
    xmlNodePtr root, parent, node, cur;
@@ -90,7 +237,7 @@ static int load_load( nsave_t *save, const char *path )
    memset( save, 0, sizeof(nsave_t) );
 
    /* Load the XML. */
-   doc   = xmlParseFile(path);
+   doc   = nbxml_readFile(path);
    if (doc == NULL) {
       WARN("Unable to parse save path '%s'.", path);
       return -1;
@@ -163,20 +310,152 @@ static int load_load( nsave_t *save, const char *path )
 }
 
 
+/**
+ * @brief Reads the save summary index.
+ *
+ *    @return Array of the indexed saves, must be freed.
+ */
+static nsave_t* load_indexRead (void)
+{
+   xmlDocPtr doc;
+   xmlNodePtr root, parent, node;
+   nsave_t *index, *ns;
+   char *buf;
+   int size;
+
+   index = array_create( nsave_t );
+   if (!nfile_fileExists( "%ssaves/"LOAD_INDEX, nfile_dataPath() ))
+      return index;
+
+   buf = nfile_readFile( &size, "%ssaves/"LOAD_INDEX, nfile_dataPath() );
+   if (buf == NULL)
+      return index;
+   doc = xmlParseMemory( buf, size );
+   free( buf );
+   if (doc == NULL) {
+      WARN("Save index is corrupt, rebuilding.");
+      return index;
+   }
+
+   root = doc->xmlChildrenNode;
+   if ((root == NULL) || !xml_isNode(root,"saves")) {
+      xmlFreeDoc(doc);
+      return index;
+   }
+
+   parent = root->xmlChildrenNode;
+   do {
+      if (!xml_isNode(parent,"save"))
+         continue;
+
+      ns = &array_grow( &index );
+      memset( ns, 0, sizeof(nsave_t) );
+      xmlr_attr(parent,"path",ns->path);
+      node = parent->xmlChildrenNode;
+      do {
+         xml_onlyNodes(node);
+         xmlr_long(node,"mtime",ns->mtime);
+         xmlr_ulong(node,"size",ns->size);
+         xmlr_strd(node,"name",ns->name);
+         xmlr_strd(node,"version",ns->version);
+         xmlr_strd(node,"data",ns->data);
+         xmlr_strd(node,"location",ns->planet);
+         xmlr_long(node,"date",ns->date);
+         xmlr_ulong(node,"credits",ns->credits);
+         xmlr_strd(node,"shipname",ns->shipname);
+         xmlr_strd(node,"shipmodel",ns->shipmodel);
+      } while (xml_nextNode(node));
+
+      /* Entries missing required data are useless. */
+      if ((ns->path == NULL) || (ns->name == NULL)) {
+         load_freeSave( ns );
+         array_erase( &index, ns, ns+1 );
+      }
+   } while (xml_nextNode(parent));
+
+   xmlFreeDoc(doc);
+   return index;
+}
+
+
+/**
+ * @brief Writes the save summary index.
+ *
+ *    @return 0 on success.
+ */
+static int load_indexWrite (void)
+{
+   xmlDocPtr doc;
+   xmlTextWriterPtr writer;
+   nsave_t *ns;
+   char file[PATH_MAX];
+   int i;
+
+   writer = xmlNewTextWriterDoc(&doc, 0);
+   if (writer == NULL) {
+      WARN("Unable to create the save index writer.");
+      return -1;
+   }
+   xmlw_setParams( writer );
+
+   xmlw_start(writer);
+   xmlw_startElem(writer,"saves");
+   for (i=0; i<array_size(load_saves); i++) {
+      ns = &load_saves[i];
+      xmlw_startElem(writer,"save");
+      xmlw_attr(writer,"path","%s",ns->path);
+      xmlw_elem(writer,"mtime","%"PRIi64,(int64_t)ns->mtime);
+      xmlw_elem(writer,"size","%"PRIu64,(uint64_t)ns->size);
+      xmlw_elem(writer,"name","%s",ns->name);
+      if (ns->version != NULL)
+         xmlw_elem(writer,"version","%s",ns->version);
+      if (ns->data != NULL)
+         xmlw_elem(writer,"data","%s",ns->data);
+      if (ns->planet != NULL)
+         xmlw_elem(writer,"location","%s",ns->planet);
+      xmlw_elem(writer,"date","%"PRIi64,ns->date);
+      xmlw_elem(writer,"credits","%"PRIu64,ns->credits);
+      if (ns->shipname != NULL)
+         xmlw_elem(writer,"shipname","%s",ns->shipname);
+      if (ns->shipmodel != NULL)
+         xmlw_elem(writer,"shipmodel","%s",ns->shipmodel);
+      xmlw_endElem(writer); /* "save" */
+   }
+   xmlw_endElem(writer); /* "saves" */
+   xmlw_done(writer);
+   xmlFreeTextWriter(writer);
+
+   nsnprintf( file, sizeof(file), "%ssaves/"LOAD_INDEX, nfile_dataPath() );
+   if (xmlSaveFileEnc( file, doc, "UTF-8" ) < 0)
+      WARN("Failed to write save index '%s'.", file);
+   xmlFreeDoc(doc);
+
+   return 0;
+}
+
+
 /**
  * @brief Loads or refreshes saved games.
+ *
+ * Saves that haven't changed since last time are taken from the index, only
+ *  new or modified ones get read.
  */
 int load_refresh (void)
 {
    char **files, buf[PATH_MAX], *tmp;
-   int nfiles, i, len;
-   int ok;
-   nsave_t *ns;
+   int nfiles, i, j, len;
+   int ok, changed;
+   nsave_t *ns, *index;
+   time_t mtime;
+   size_t size;
 
    if (load_saves != NULL)
       load_free();
    load_saves = array_create( nsave_t );
 
+   /* Make sure saves being written are done. */
+   save_flush();
+
    /* load the saves */
    files = nfile_readDir( &nfiles, "%ssaves", nfile_dataPath() );
    for (i=0; i<nfiles; i++) {
@@ -215,14 +494,47 @@ int load_refresh (void)
    }
 
    /* Allocate and parse. */
-   ok = 0;
-   ns = NULL;
+   index   = load_indexRead();
+   changed = 0;
+   ok      = 0;
+   ns      = NULL;
    for (i=0; i<nfiles; i++) {
       if (!ok)
          ns = &array_grow( &load_saves );
       nsnprintf( buf, sizeof(buf), "%ssaves/%s", nfile_dataPath(), files[i] );
+
+      /* Use the index if the save hasn't changed. */
+      if (nfile_fileInfo( &mtime, &size, "%s", buf ) == 0) {
+         for (j=0; j<array_size(index); j++) {
+            if ((index[j].path != NULL) && (strcmp( index[j].path, buf ) == 0) &&
+                  (index[j].mtime == mtime) && (index[j].size == size))
+               break;
+         }
+         if (j < array_size(index)) {
+            *ns = index[j];
+            memset( &index[j], 0, sizeof(nsave_t) );
+            ok = 0;
+            continue;
+         }
+      }
+
+      changed = 1;
       ok = load_load( ns, buf );
    }
+   /* Last one failed. */
+   if (ok)
+      array_erase( &load_saves, ns, ns+1 );
+
+   /* Saves that are gone also change the index. */
+   for (i=0; i<array_size(index); i++) {
+      if (index[i].path != NULL) {
+         changed = 1;
+         load_freeSave( &index[i] );
+      }
+   }
+   array_free( index );
+   if (changed)
+      load_indexWrite();
 
    /* Clean up memory. */
    for (i=0; i<nfiles; i++)
@@ -233,34 +545,44 @@ int load_refresh (void)
 }
 
 
+/**
+ * @brief Frees the contents of a save.
+ *
+ *    @param ns Save to free.
+ */
+static void load_freeSave( nsave_t *ns )
+{
+   if (ns->path != NULL)
+      free(ns->path);
+   if (ns->name != NULL)
+      free(ns->name);
+
+   if (ns->version != NULL)
+      free(ns->version);
+   if (ns->data != NULL)
+      free(ns->data);
+
+   if (ns->planet != NULL)
+      free(ns->planet);
+
+   if (ns->shipname != NULL)
+      free(ns->shipname);
+   if (ns->shipmodel != NULL)
+      free(ns->shipmodel);
+   memset( ns, 0, sizeof(nsave_t) );
+}
+
+
 /**
  * @brief Frees loaded save stuff.
  */
 void load_free (void)
 {
    int i;
-   nsave_t *ns;
 
    if (load_saves != NULL) {
-      for (i=0; i<array_size(load_saves); i++) {
-         ns = &load_saves[i];
-         free(ns->path);
-         if (ns->name != NULL)
-            free(ns->name);
-
-         if (ns->version != NULL)
-            free(ns->version);
-         if (ns->data != NULL)
-            free(ns->data);
-
-         if (ns->planet != NULL)
-            free(ns->planet);
-
-         if (ns->shipname != NULL)
-            free(ns->shipname);
-         if (ns->shipmodel != NULL)
-            free(ns->shipmodel);
-      }
+      for (i=0; i<array_size(load_saves); i++)
+         load_freeSave( &load_saves[i] );
       array_free( load_saves );
    }
    load_saves = NULL;
@@ -532,6 +854,12 @@ int load_game( const char* file, int version_diff )
    xmlNodePtr node;
    xmlDocPtr doc;
    Planet *pnt;
+#ifdef DEBUGGING
+   unsigned int time;
+#endif /* DEBUGGING */
+
+   /* Savegame could still be being written. */
+   save_flush();
 
    /* Make sure it exists. */
    if (!nfile_fileExists(file)) {
@@ -540,9 +868,16 @@ int load_game( const char* file, int version_diff )
    }
 
    /* Load the XML. */
-   doc   = xmlParseFile(file);
+#ifdef DEBUGGING
+   time  = SDL_GetTicks();
+#endif /* DEBUGGING */
+   doc   = nbxml_readFile(file);
    if (doc == NULL)
       goto err;
+#ifdef DEBUGGING
+   DEBUG("Read %s savegame in %u ms", nbxml_isBinary(file) ? "binary" : "XML",
+         SDL_GetTicks() - time );
+#endif /* DEBUGGING */
    node  = doc->xmlChildrenNode; /* base node */
    if (node == NULL)
       goto err_doc;
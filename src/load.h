@@ -8,6 +8,8 @@
 
 
 #include <stdint.h>
+#include <stddef.h>
+#include <time.h>
 
 #include "ntime.h"
 
@@ -18,6 +20,8 @@
 typedef struct nsave_s {
    char *name; /**< Player name. */
    char *path; /**< File path. */
+   time_t mtime; /**< Modification time of the file when read. */
+   size_t size; /**< Size of the file when read. */
 
    /* Naev info. */
    char *version; /**< Naev version. */
@@ -698,7 +698,7 @@ static void map_showOutfitDetail(unsigned int wid, char* wgtname, int x, int y,
 
    outfit = outfit_get( toolkit_getList(wid, wgtname) );
    window_modifyText( wid, "txtOutfitName", outfit->name );
-   window_modifyImage( wid, "imgOutfit", outfit->gfx_store, 0, 0 );
+   window_modifyImage( wid, "imgOutfit", outfit_gfxStore( outfit ), 0, 0 );
 
    window_modifyText( wid, "txtDescription", outfit->description );
    credits2str( buf2, outfit->price, 2 );
@@ -738,7 +738,7 @@ static void map_showOutfitDetail(unsigned int wid, char* wgtname, int x, int y,
  */
 static int map_findSearchOutfits( unsigned int parent, const char *name )
 {
-   int i, j;
+   int i;
    char **names;
    int len, n, ret;
    map_find_t *found;
@@ -746,8 +746,7 @@ static int map_findSearchOutfits( unsigned int parent, const char *name )
    StarSystem *sys;
    const char *oname, *sysname;
    char **list;
-   Outfit *o, **olist;
-   int nolist;
+   Outfit *o;
 
    /* Match planet first. */
    o     = NULL;
@@ -783,13 +782,7 @@ static int map_findSearchOutfits( unsigned int parent, const char *name )
    for (i=0; i<map_nknown; i++) {
 
       /* Try to find the outfit in the planet. */
-      olist = tech_getOutfit( map_known_techs[i], &nolist );
-      for (j=0; j<nolist; j++)
-         if (olist[j] == o)
-            break;
-      if (olist != NULL)
-         free(olist);
-      if (j >= nolist)
+      if (!tech_hasOutfit( map_known_techs[i], o ))
          continue;
       pnt = map_known_planets[i];
 
@@ -890,7 +883,7 @@ static char **map_shipsMatch( const char *name, int *len )
  */
 static int map_findSearchShips( unsigned int parent, const char *name )
 {
-   int i, j;
+   int i;
    char **names;
    int len, n, ret;
    map_find_t *found;
@@ -898,8 +891,7 @@ static int map_findSearchShips( unsigned int parent, const char *name )
    StarSystem *sys;
    const char *sname, *sysname;
    char **list;
-   Ship *s, **slist;
-   int nslist;
+   Ship *s;
 
    /* Match planet first. */
    s     = NULL;
@@ -934,13 +926,7 @@ static int map_findSearchShips( unsigned int parent, const char *name )
    for (i=0; i<map_nknown; i++) {
 
       /* Try to find the ship in the planet. */
-      slist = tech_getShip( map_known_techs[i], &nslist );
-      for (j=0; j<nslist; j++)
-         if (slist[j] == s)
-            break;
-      if (slist != NULL)
-         free(slist);
-      if (j >= nslist)
+      if (!tech_hasShip( map_known_techs[i], s ))
          continue;
       pnt = map_known_planets[i];
 
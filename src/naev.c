@@ -78,6 +78,11 @@
 #include "gui.h"
 #include "news.h"
 #include "nlua_var.h"
+#include "nlua_prof.h"
+#include "perf.h"
+#include "headless.h"
+#include "bench.h"
+#include "scenario.h"
 #include "map.h"
 #include "event.h"
 #include "cond.h"
@@ -87,6 +92,7 @@
 #include "npc.h"
 #include "console.h"
 #include "npng.h"
+#include "texcache.h"
 #include "dev.h"
 #include "background.h"
 #include "camera.h"
@@ -94,6 +100,7 @@
 #include "start.h"
 #include "threadpool.h"
 #include "load.h"
+#include "save.h"
 #include "dialogue.h"
 #include "slots.h"
 
@@ -172,6 +179,7 @@ void naev_quit (void)
 int main( int argc, char** argv )
 {
    char buf[PATH_MAX];
+   int i, status;
 
    /* Save the binary path. */
    binary_path = strdup(argv[0]);
@@ -191,6 +199,18 @@ int main( int argc, char** argv )
    /* Set up debug signal handlers. */
    debug_sigInit();
 
+   /* Headless runs can't rely on there being a display. */
+   for (i=1; i<argc; i++) {
+      if ((strcmp(argv[i], "--headless")==0) || (strcmp(argv[i], "--bench")==0)) {
+#if SDL_VERSION_ATLEAST(2,0,0)
+         SDL_setenv( "SDL_VIDEODRIVER", "dummy", 1 );
+#else /* SDL_VERSION_ATLEAST(2,0,0) */
+         SDL_putenv( "SDL_VIDEODRIVER=dummy" );
+#endif /* SDL_VERSION_ATLEAST(2,0,0) */
+         break;
+      }
+   }
+
    /* Must be initialized before input_init is called. */
    if (SDL_InitSubSystem(SDL_INIT_VIDEO) < 0) {
       WARN("Unable to initialize SDL Video: %s", SDL_GetError());
@@ -255,6 +275,14 @@ int main( int argc, char** argv )
    conf_loadConfig(buf); /* Lua to parse the configuration file */
    conf_parseCLI( argc, argv ); /* parse CLI arguments */
 
+   /* Only converting a savegame. */
+   if (conf.convert_save != NULL) {
+      status = save_convert( conf.convert_save );
+      conf_cleanup();
+      SDL_Quit();
+      return (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+
    /* Enable FPU exceptions. */
 #if defined(HAVE_FEENABLEEXCEPT) && defined(DEBUGGING)
    if (conf.fpu_except)
@@ -273,6 +301,9 @@ int main( int argc, char** argv )
    LOG(" %s", ndata_name());
    DEBUG();
 
+   /* Drop cached graphics whose source is gone. */
+   texcache_prune();
+
    /* Display the SDL Version. */
    print_SDLversion();
    DEBUG();
@@ -283,18 +314,22 @@ int main( int argc, char** argv )
    /*
     * OpenGL
     */
-   if (gl_init()) { /* initializes video output */
+   if (conf.headless)
+      gl_initHeadless(); /* no video output at all */
+   else if (gl_init()) { /* initializes video output */
       ERR("Initializing video output failed, exiting...");
       SDL_Quit();
       exit(EXIT_FAILURE);
    }
-   window_caption();
+   else
+      window_caption();
    gl_fontInit( NULL, NULL, conf.font_size_def ); /* initializes default font to size */
    gl_fontInit( &gl_smallFont, NULL, conf.font_size_small ); /* small font */
    gl_fontInit( &gl_defFontMono, "dat/mono.ttf", conf.font_size_def );
 
    /* Display the load screen. */
-   loadscreen_load();
+   if (!conf.headless)
+      loadscreen_load();
    loadscreen_render( 0., "Initializing subsystems..." );
    time_ms = SDL_GetTicks();
 
@@ -302,7 +337,8 @@ int main( int argc, char** argv )
    /*
     * Input
     */
-   if ((conf.joystick_ind >= 0) || (conf.joystick_nam != NULL)) {
+   if (!conf.headless &&
+         ((conf.joystick_ind >= 0) || (conf.joystick_nam != NULL))) {
       if (joystick_init()) WARN("Error initializing joystick input");
       if (conf.joystick_nam != NULL) { /* use the joystick name to find a joystick */
          if (joystick_use(joystick_get(conf.joystick_nam))) {
@@ -355,18 +391,35 @@ int main( int argc, char** argv )
    /* Unload load screen. */
    loadscreen_unload();
 
-   /* Start menu. */
-   menu_main();
+   /* Headless runs skip the menus and interactive loop altogether. */
+   status = 0;
+   if (conf.bench) {
+      status = bench_run();
+      quit   = 1;
+   }
+   else if (conf.headless) {
+      status = headless_run();
+      quit   = 1;
+   }
+   /* Windowed scenarios skip the menus and end on their own. */
+   else if (conf.scenario != NULL) {
+      if (scenario_start( conf.scenario )) {
+         status = -1;
+         quit   = 1;
+      }
+   }
+   else
+      menu_main(); /* Start menu. */
 
    /* Force a minimum delay with loading screen */
-   if ((SDL_GetTicks() - time_ms) < NAEV_INIT_DELAY)
+   if (!conf.headless && (SDL_GetTicks() - time_ms) < NAEV_INIT_DELAY)
       SDL_Delay( NAEV_INIT_DELAY - (SDL_GetTicks() - time_ms) );
    fps_init(); /* initializes the time_ms */
 
 #if HAS_UNIX
    /* Tell the player to migrate their configuration files out of ~/.naev */
    /* TODO get rid of this cruft ASAP. */
-   if ((oldconfig) && (!conf.datapath)) {
+   if ((oldconfig) && (!conf.datapath) && (!conf.headless)) {
       char path[PATH_MAX], *script, *home;
       uint32_t scriptsize;
       int ret;
@@ -447,11 +500,20 @@ int main( int argc, char** argv )
       }
 
       main_loop( 1 );
+
+      if (scenario_active() && !paused && scenario_frame( game_dt ))
+         quit = 1;
    }
+   if (scenario_active() && scenario_end())
+      status = -1;
+
 
+   /* Finish writing savegames. */
+   save_exit();
 
    /* Save configuration. */
-   conf_saveConfig(buf);
+   if (!conf.headless)
+      conf_saveConfig(buf);
 
    /* data unloading */
    unload_all();
@@ -474,6 +536,8 @@ int main( int argc, char** argv )
    ovr_mrkFree(); /* Clear markers. */
    toolkit_exit(); /* Kills the toolkit */
    ai_exit(); /* Stops the Lua AI magic */
+   nlua_profFree(); /* Drops the Lua profiling results. */
+   perf_exit(); /* Drops any frame trace. */
    joystick_exit(); /* Releases joystick */
    input_exit(); /* Cleans up keybindings */
    nebu_exit(); /* Destroys the nebula */
@@ -497,7 +561,7 @@ int main( int argc, char** argv )
    free(binary_path);
 
    /* all is well */
-   exit(EXIT_SUCCESS);
+   exit( (status == 0) ? EXIT_SUCCESS : EXIT_FAILURE );
 }
 
 
@@ -551,6 +615,10 @@ void loadscreen_render( double done, const char *msg )
    double x,y, w,h, rh;
    SDL_Event event;
 
+   /* Nothing to show. */
+   if (gl_has(OPENGL_HEADLESS))
+      return;
+
    /* Clear background. */
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -706,18 +774,22 @@ void main_loop( int update )
     * Control FPS.
     */
    fps_control(); /* everyone loves fps control */
+   perf_frameBegin();
 
    /*
     * Handle update.
     */
    input_update( real_dt ); /* handle key repeats. */
    sound_update( real_dt ); /* Update sounds. */
+   save_update(); /* Report finished savegames. */
    if (toolkit_isOpen())
       toolkit_update(); /* to simulate key repetition */
    if (!paused && update) {
+      perf_begin( PERF_UPDATE );
       /* Important that we pass real_dt here otherwise we get a dt feedback loop which isn't pretty. */
       player_updateAutonav( real_dt );
       update_all(); /* update game */
+      perf_end( PERF_UPDATE );
    }
 
    /*
@@ -725,17 +797,25 @@ void main_loop( int update )
     */
    /* Clear buffer. */
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+   perf_begin( PERF_RENDER );
    render_all();
+   perf_end( PERF_RENDER );
    /* Toolkit is rendered on top. */
-   if (toolkit_isOpen())
+   if (toolkit_isOpen()) {
+      perf_begin( PERF_TOOLKIT );
       toolkit_render();
+      perf_end( PERF_TOOLKIT );
+   }
    gl_checkErr(); /* check error every loop */
    /* Draw buffer. */
+   perf_begin( PERF_SWAP );
 #if SDL_VERSION_ATLEAST(2,0,0)
    SDL_GL_SwapWindow( gl_screen.window );
 #else /* SDL_VERSION_ATLEAST(2,0,0) */
    SDL_GL_SwapBuffers();
 #endif /* SDL_VERSION_ATLEAST(2,0,0) */
+   perf_end( PERF_SWAP );
+   perf_frameEnd();
 }
 
 
@@ -886,16 +966,29 @@ void update_routine( double dt, int enter_sys )
    }
 
    /* Update engine stuff. */
+   perf_begin( PERF_SPACE_UPDATE );
    space_update(dt);
+   perf_end( PERF_SPACE_UPDATE );
+   perf_begin( PERF_WEAPONS_UPDATE );
    weapons_update(dt);
+   perf_end( PERF_WEAPONS_UPDATE );
+   perf_begin( PERF_SPFX_UPDATE );
    spfx_update(dt);
+   perf_end( PERF_SPFX_UPDATE );
+   perf_begin( PERF_PILOTS_UPDATE );
    pilots_update(dt);
+   perf_end( PERF_PILOTS_UPDATE );
 
    /* Update camera. */
+   perf_begin( PERF_CAM_UPDATE );
    cam_update( dt );
+   perf_end( PERF_CAM_UPDATE );
 
-   if (!enter_sys)
+   if (!enter_sys) {
+      perf_begin( PERF_HOOKS );
       hook_exclusionEnd( dt );
+      perf_end( PERF_HOOKS );
+   }
 }
 
 
@@ -924,24 +1017,46 @@ static void render_all (void)
    dt = (paused) ? 0. : game_dt;
 
    /* setup */
+   perf_begin( PERF_SPFX_RENDER );
    spfx_begin(dt, real_dt);
+   perf_end( PERF_SPFX_RENDER );
    /* BG */
+   perf_begin( PERF_SPACE_RENDER );
    space_render(dt);
    planets_render();
+   perf_end( PERF_SPACE_RENDER );
+   perf_begin( PERF_WEAPONS_RENDER );
    weapons_render(WEAPON_LAYER_BG, dt);
+   perf_end( PERF_WEAPONS_RENDER );
    /* N */
+   perf_begin( PERF_PILOTS_RENDER );
    pilots_render(dt);
+   perf_end( PERF_PILOTS_RENDER );
+   perf_begin( PERF_WEAPONS_RENDER );
    weapons_render(WEAPON_LAYER_FG, dt);
+   perf_end( PERF_WEAPONS_RENDER );
+   perf_begin( PERF_SPFX_RENDER );
    spfx_render(SPFX_LAYER_BACK);
+   perf_end( PERF_SPFX_RENDER );
    /* FG */
+   perf_begin( PERF_PILOTS_RENDER );
    player_render(dt);
+   perf_end( PERF_PILOTS_RENDER );
+   perf_begin( PERF_SPFX_RENDER );
    spfx_render(SPFX_LAYER_FRONT);
+   perf_end( PERF_SPFX_RENDER );
+   perf_begin( PERF_OVERLAY_RENDER );
    space_renderOverlay(dt);
    gui_renderReticles(dt);
    pilots_renderOverlay(dt);
+   perf_end( PERF_OVERLAY_RENDER );
+   perf_begin( PERF_SPFX_RENDER );
    spfx_end();
+   perf_end( PERF_SPFX_RENDER );
+   perf_begin( PERF_GUI_RENDER );
    gui_render(dt);
    ovr_render(dt);
+   perf_end( PERF_GUI_RENDER );
    display_fps( real_dt ); /* Exception. */
 }
 
@@ -956,6 +1071,8 @@ static double fps_cur = 0.; /**< FPS accumulator to trigger change. */
 static void display_fps( const double dt )
 {
    double x,y;
+   int spfx_active, spfx_rendered;
+   double spfx_ms;
 
    fps_dt  += dt;
    fps_cur += 1.;
@@ -969,7 +1086,15 @@ static void display_fps( const double dt )
    if (conf.fps_show) {
       gl_print( NULL, x, y, NULL, "%3.2f", fps );
       y -= gl_defFont.h + 5.;
+      spfx_getStats( &spfx_active, &spfx_rendered, &spfx_ms );
+      if (spfx_active > 0) {
+         gl_print( NULL, x, y, NULL, "spfx: %d (%d drawn, %.2f ms)",
+               spfx_active, spfx_rendered, spfx_ms );
+         y -= gl_defFont.h + 5.;
+      }
    }
+   if (conf.perf_show)
+      y = perf_render( x, y );
    if (dt_mod != 1.)
       gl_print( NULL, x, y, NULL, "%3.1fx", dt_mod);
 }
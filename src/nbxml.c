@@ -0,0 +1,524 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file nbxml.c
+ *
+ * @brief Compact binary encoding of XML documents.
+ *
+ * Stores the same tree as the XML, so anything that reads the resulting
+ *  document works the same regardless of how it was stored. All the names
+ *  and values go into a string table that is written once, the tree itself
+ *  is then just a stream of indices into it. Savegames repeat the same
+ *  element, system, outfit and ship names a lot so this ends up smaller and
+ *  much faster to read than the text.
+ *
+ * The layout is:
+ *  - NBXML_MAGIC followed by the version as a varint.
+ *  - Number of strings followed by each string as length and bytes.
+ *  - The tree in document order, where elements are NBXML_ELEM, the name, the
+ *    number of attributes, the attribute name and value pairs, their
+ *    children and finally NBXML_END. Text is NBXML_TEXT and the value.
+ *
+ * All numbers are unsigned LEB128 varints. Whitespace used only to indent
+ *  elements is dropped.
+ */
+
+
+#include "nbxml.h"
+
+#include "naev.h"
+
+#include <stdlib.h>
+#include <ctype.h>
+#include "nstring.h"
+
+#include "log.h"
+#include "nfile.h"
+
+
+#define NBXML_END          0 /**< Ends the current element. */
+#define NBXML_ELEM         1 /**< Starts an element. */
+#define NBXML_TEXT         2 /**< Text node. */
+
+#define NBXML_HASH_MIN     1024 /**< Minimum string hash table size, power of two. */
+
+
+/**
+ * @brief Growable output buffer.
+ */
+typedef struct NBuf_ {
+   char *data; /**< Data. */
+   size_t len; /**< Used length. */
+   size_t size; /**< Allocated size. */
+} NBuf;
+
+
+/**
+ * @brief String table being built while encoding.
+ */
+typedef struct NStrTable_ {
+   char **str; /**< Strings in order of appearance. */
+   int nstr; /**< Number of strings. */
+   int mstr; /**< Allocated strings. */
+   int *hash; /**< Open addressing table of string indices, -1 is empty. */
+   int nhash; /**< Size of the hash table, power of two. */
+} NStrTable;
+
+
+/*
+ * Prototypes.
+ */
+/* Encoding. */
+static void nbuf_grow( NBuf *b, size_t len );
+static void nbuf_putVarint( NBuf *b, uint64_t v );
+static void nbuf_putBytes( NBuf *b, const void *data, size_t len );
+static uint32_t nstr_hashStr( const char *s );
+static int nstr_intern( NStrTable *t, const char *s );
+static void nstr_free( NStrTable *t );
+static int nbxml_isIndent( xmlNodePtr node );
+static void nbxml_collect( NStrTable *t, xmlNodePtr node );
+static void nbxml_encodeNode( NStrTable *t, NBuf *b, xmlNodePtr node );
+/* Decoding. */
+static int nbxml_getVarint( const uint8_t **p, const uint8_t *end, uint64_t *v );
+
+
+/**
+ * @brief Makes sure a buffer has room for more data.
+ */
+static void nbuf_grow( NBuf *b, size_t len )
+{
+   if (b->len + len <= b->size)
+      return;
+   b->size = MAX( 2*b->size, b->len + len );
+   b->size = MAX( b->size, 4096 );
+   b->data = realloc( b->data, b->size );
+}
+
+
+/**
+ * @brief Writes a varint to a buffer.
+ */
+static void nbuf_putVarint( NBuf *b, uint64_t v )
+{
+   nbuf_grow( b, 10 );
+   do {
+      b->data[ b->len++ ] = (char)((v & 0x7f) | ((v > 0x7f) ? 0x80 : 0));
+      v >>= 7;
+   } while (v > 0);
+}
+
+
+/**
+ * @brief Writes raw bytes to a buffer.
+ */
+static void nbuf_putBytes( NBuf *b, const void *data, size_t len )
+{
+   nbuf_grow( b, len );
+   memcpy( &b->data[ b->len ], data, len );
+   b->len += len;
+}
+
+
+/**
+ * @brief FNV-1a hash of a string.
+ */
+static uint32_t nstr_hashStr( const char *s )
+{
+   uint32_t h = 2166136261u;
+   for ( ; *s != '\0'; s++) {
+      h ^= (uint8_t)*s;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+/**
+ * @brief Gets the index of a string in the table, adding it if needed.
+ *
+ *    @param t Table to use.
+ *    @param s String to look up, gets copied.
+ *    @return Index of the string.
+ */
+static int nstr_intern( NStrTable *t, const char *s )
+{
+   uint32_t h;
+   int i, j, *old, nold;
+
+   /* Keep the load factor under a half. */
+   if (2*(t->nstr+1) > t->nhash) {
+      old     = t->hash;
+      nold    = t->nhash;
+      t->nhash = MAX( 2*t->nhash, NBXML_HASH_MIN );
+      t->hash = malloc( sizeof(int) * t->nhash );
+      for (i=0; i<t->nhash; i++)
+         t->hash[i] = -1;
+      for (i=0; i<nold; i++) {
+         if (old[i] < 0)
+            continue;
+         h = nstr_hashStr( t->str[ old[i] ] ) & (t->nhash-1);
+         while (t->hash[h] >= 0)
+            h = (h+1) & (t->nhash-1);
+         t->hash[h] = old[i];
+      }
+      free( old );
+   }
+
+   /* Look it up. */
+   h = nstr_hashStr( s ) & (t->nhash-1);
+   while ((j = t->hash[h]) >= 0) {
+      if (strcmp( t->str[j], s ) == 0)
+         return j;
+      h = (h+1) & (t->nhash-1);
+   }
+
+   /* Add it. */
+   if (t->nstr >= t->mstr) {
+      t->mstr = MAX( 2*t->mstr, 256 );
+      t->str  = realloc( t->str, sizeof(char*) * t->mstr );
+   }
+   t->str[ t->nstr ] = strdup( s );
+   t->hash[h]        = t->nstr;
+   return t->nstr++;
+}
+
+
+/**
+ * @brief Frees a string table.
+ */
+static void nstr_free( NStrTable *t )
+{
+   int i;
+   for (i=0; i<t->nstr; i++)
+      free( t->str[i] );
+   free( t->str );
+   free( t->hash );
+   memset( t, 0, sizeof(NStrTable) );
+}
+
+
+/**
+ * @brief Checks to see if a text node is only indentation between elements.
+ */
+static int nbxml_isIndent( xmlNodePtr node )
+{
+   const xmlChar *c;
+
+   if (((node->prev == NULL) || (node->prev->type != XML_ELEMENT_NODE)) &&
+         ((node->next == NULL) || (node->next->type != XML_ELEMENT_NODE)))
+      return 0;
+   if (node->content == NULL)
+      return 1;
+   for (c=node->content; *c != '\0'; c++)
+      if (!isspace(*c))
+         return 0;
+   return 1;
+}
+
+
+/**
+ * @brief Adds all the strings of a node and its children to the table.
+ *
+ * Done before encoding so the table can be written first.
+ */
+static void nbxml_collect( NStrTable *t, xmlNodePtr node )
+{
+   xmlAttrPtr attr;
+   xmlNodePtr child;
+   xmlChar *val;
+
+   if (node->type == XML_ELEMENT_NODE) {
+      nstr_intern( t, (const char*)node->name );
+      for (attr=node->properties; attr!=NULL; attr=attr->next) {
+         nstr_intern( t, (const char*)attr->name );
+         val = xmlNodeListGetString( node->doc, attr->children, 1 );
+         nstr_intern( t, (val != NULL) ? (const char*)val : "" );
+         xmlFree( val );
+      }
+      for (child=node->children; child!=NULL; child=child->next)
+         nbxml_collect( t, child );
+   }
+   else if (((node->type == XML_TEXT_NODE) || (node->type == XML_CDATA_SECTION_NODE)) &&
+         !nbxml_isIndent( node ))
+      nstr_intern( t, (node->content != NULL) ? (const char*)node->content : "" );
+}
+
+
+/**
+ * @brief Encodes a node and its children.
+ */
+static void nbxml_encodeNode( NStrTable *t, NBuf *b, xmlNodePtr node )
+{
+   xmlAttrPtr attr;
+   xmlNodePtr child;
+   xmlChar *val;
+   int n;
+
+   if (node->type == XML_ELEMENT_NODE) {
+      nbuf_putVarint( b, NBXML_ELEM );
+      nbuf_putVarint( b, nstr_intern( t, (const char*)node->name ) );
+      n = 0;
+      for (attr=node->properties; attr!=NULL; attr=attr->next)
+         n++;
+      nbuf_putVarint( b, n );
+      for (attr=node->properties; attr!=NULL; attr=attr->next) {
+         nbuf_putVarint( b, nstr_intern( t, (const char*)attr->name ) );
+         val = xmlNodeListGetString( node->doc, attr->children, 1 );
+         nbuf_putVarint( b, nstr_intern( t, (val != NULL) ? (const char*)val : "" ) );
+         xmlFree( val );
+      }
+      for (child=node->children; child!=NULL; child=child->next)
+         nbxml_encodeNode( t, b, child );
+      nbuf_putVarint( b, NBXML_END );
+   }
+   else if (((node->type == XML_TEXT_NODE) || (node->type == XML_CDATA_SECTION_NODE)) &&
+         !nbxml_isIndent( node )) {
+      nbuf_putVarint( b, NBXML_TEXT );
+      nbuf_putVarint( b, nstr_intern( t,
+               (node->content != NULL) ? (const char*)node->content : "" ) );
+   }
+}
+
+
+/**
+ * @brief Encodes a document.
+ *
+ *    @param doc Document to encode.
+ *    @param[out] len Length of the encoded data.
+ *    @return Newly allocated encoded data or NULL on error.
+ */
+char* nbxml_encode( xmlDocPtr doc, size_t *len )
+{
+   NStrTable t;
+   NBuf b;
+   xmlNodePtr root;
+   size_t slen;
+   int i;
+
+   root = xmlDocGetRootElement( doc );
+   if (root == NULL) {
+      WARN("Unable to encode document with no root element.");
+      return NULL;
+   }
+
+   /* Build the string table. */
+   memset( &t, 0, sizeof(t) );
+   nbxml_collect( &t, root );
+
+   /* Header and strings. */
+   memset( &b, 0, sizeof(b) );
+   nbuf_putBytes( &b, NBXML_MAGIC, NBXML_MAGIC_LEN );
+   nbuf_putVarint( &b, NBXML_VERSION );
+   nbuf_putVarint( &b, t.nstr );
+   for (i=0; i<t.nstr; i++) {
+      slen = strlen( t.str[i] );
+      nbuf_putVarint( &b, slen );
+      nbuf_putBytes( &b, t.str[i], slen );
+   }
+
+   /* Tree, only the root and what hangs off it. */
+   nbxml_encodeNode( &t, &b, root );
+
+   nstr_free( &t );
+   *len = b.len;
+   return b.data;
+}
+
+
+/**
+ * @brief Reads a varint.
+ *
+ *    @return 0 on success, -1 if out of data or too long.
+ */
+static int nbxml_getVarint( const uint8_t **p, const uint8_t *end, uint64_t *v )
+{
+   int shift;
+   uint8_t c;
+
+   *v    = 0;
+   shift = 0;
+   do {
+      if ((*p >= end) || (shift > 63))
+         return -1;
+      c   = *(*p)++;
+      *v |= (uint64_t)(c & 0x7f) << shift;
+      shift += 7;
+   } while (c & 0x80);
+   return 0;
+}
+
+
+/**
+ * @brief Decodes a document.
+ *
+ *    @param buf Encoded data.
+ *    @param len Length of the encoded data.
+ *    @return Newly allocated document or NULL on error.
+ */
+xmlDocPtr nbxml_decode( const char *buf, size_t len )
+{
+   const uint8_t *p, *end;
+   uint64_t v, nstr, slen, tag, name, nattr, key, val;
+   char **str, *strbuf;
+   size_t i, off;
+   xmlDocPtr doc;
+   xmlNodePtr parent, node;
+
+   p   = (const uint8_t*) buf;
+   end = p + len;
+
+   /* Header. */
+   if ((len < NBXML_MAGIC_LEN) || (memcmp( p, NBXML_MAGIC, NBXML_MAGIC_LEN ) != 0)) {
+      WARN("Binary XML has invalid magic.");
+      return NULL;
+   }
+   p += NBXML_MAGIC_LEN;
+   if (nbxml_getVarint( &p, end, &v ) || (v != NBXML_VERSION)) {
+      WARN("Binary XML has unsupported version.");
+      return NULL;
+   }
+
+   /* String table, all strings go in one block after each other. */
+   if (nbxml_getVarint( &p, end, &nstr ) || (nstr > len))
+      goto err_header;
+   str    = malloc( sizeof(char*) * (nstr+1) );
+   strbuf = malloc( len + nstr + 1 );
+   off    = 0;
+   for (i=0; i<nstr; i++) {
+      if (nbxml_getVarint( &p, end, &slen ) || (slen > (uint64_t)(end-p)))
+         goto err_strings;
+      str[i] = &strbuf[off];
+      memcpy( str[i], p, slen );
+      str[i][slen] = '\0';
+      off += slen+1;
+      p   += slen;
+   }
+
+   /* Tree. */
+   doc    = xmlNewDoc( (const xmlChar*)"1.0" );
+   parent = NULL;
+   do {
+      if (nbxml_getVarint( &p, end, &tag ))
+         goto err_tree;
+
+      switch (tag) {
+         case NBXML_ELEM:
+            if (nbxml_getVarint( &p, end, &name ) || (name >= nstr) ||
+                  nbxml_getVarint( &p, end, &nattr ))
+               goto err_tree;
+            node = xmlNewDocNode( doc, NULL, (const xmlChar*)str[name], NULL );
+            if (parent == NULL)
+               xmlDocSetRootElement( doc, node );
+            else
+               xmlAddChild( parent, node );
+            for (i=0; i<nattr; i++) {
+               if (nbxml_getVarint( &p, end, &key ) || (key >= nstr) ||
+                     nbxml_getVarint( &p, end, &val ) || (val >= nstr))
+                  goto err_tree;
+               xmlNewProp( node, (const xmlChar*)str[key], (const xmlChar*)str[val] );
+            }
+            parent = node;
+            break;
+
+         case NBXML_TEXT:
+            if ((parent == NULL) || nbxml_getVarint( &p, end, &val ) || (val >= nstr))
+               goto err_tree;
+            xmlAddChild( parent, xmlNewDocText( doc, (const xmlChar*)str[val] ) );
+            break;
+
+         case NBXML_END:
+            if (parent == NULL)
+               goto err_tree;
+            parent = parent->parent;
+            if ((parent != NULL) && (parent->type != XML_ELEMENT_NODE))
+               parent = NULL;
+            break;
+
+         default:
+            goto err_tree;
+      }
+   } while (parent != NULL);
+
+   free( strbuf );
+   free( str );
+   return doc;
+
+err_tree:
+   xmlFreeDoc( doc );
+err_strings:
+   free( strbuf );
+   free( str );
+err_header:
+   WARN("Binary XML is corrupt.");
+   return NULL;
+}
+
+
+/**
+ * @brief Checks to see if a file is binary XML.
+ *
+ *    @param path File to check.
+ *    @return 1 if it's binary XML.
+ */
+int nbxml_isBinary( const char *path )
+{
+   FILE *f;
+   char magic[NBXML_MAGIC_LEN];
+   size_t n;
+
+   f = fopen( path, "rb" );
+   if (f == NULL)
+      return 0;
+   n = fread( magic, 1, NBXML_MAGIC_LEN, f );
+   fclose( f );
+
+   return ((n == NBXML_MAGIC_LEN) && (memcmp( magic, NBXML_MAGIC, NBXML_MAGIC_LEN ) == 0));
+}
+
+
+/**
+ * @brief Reads a document from a file that is either binary or text XML.
+ *
+ *    @param path File to read.
+ *    @return Newly allocated document or NULL on error.
+ */
+xmlDocPtr nbxml_readFile( const char *path )
+{
+   char *buf;
+   int len;
+   xmlDocPtr doc;
+
+   if (!nbxml_isBinary( path ))
+      return xmlParseFile( path );
+
+   buf = nfile_readFile( &len, "%s", path );
+   if (buf == NULL)
+      return NULL;
+   doc = nbxml_decode( buf, len );
+   free( buf );
+   return doc;
+}
+
+
+/**
+ * @brief Saves a document as binary XML.
+ *
+ *    @param path File to write to.
+ *    @param doc Document to write.
+ *    @return 0 on success.
+ */
+int nbxml_saveFile( const char *path, xmlDocPtr doc )
+{
+   char *buf;
+   size_t len;
+   int ret;
+
+   buf = nbxml_encode( doc, &len );
+   if (buf == NULL)
+      return -1;
+   ret = nfile_writeFile( buf, len, "%s", path );
+   free( buf );
+   return ret;
+}
@@ -0,0 +1,35 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef NBXML_H
+#  define NBXML_H
+
+
+#include <stddef.h>
+
+#include "libxml/tree.h"
+
+
+#define NBXML_MAGIC        "NBXML\x1a\r\n" /**< Magic at the start of binary files. */
+#define NBXML_MAGIC_LEN    8 /**< Length of the magic. */
+#define NBXML_VERSION      1 /**< Version of the binary format. */
+
+
+/*
+ * Memory.
+ */
+char* nbxml_encode( xmlDocPtr doc, size_t *len );
+xmlDocPtr nbxml_decode( const char *buf, size_t len );
+
+
+/*
+ * Files.
+ */
+int nbxml_isBinary( const char *path );
+xmlDocPtr nbxml_readFile( const char *path );
+int nbxml_saveFile( const char *path, xmlDocPtr doc );
+
+
+#endif /* NBXML_H */
@@ -599,6 +599,65 @@ int ndata_exists( const char* filename )
 }
 
 
+/**
+ * @brief Gets the modification time and size of a file in the ndata.
+ *
+ * Meant to cheaply tell whether a file changed. Files in a packfile report
+ *  those of the packfile itself since they can only change along with it.
+ *
+ *    @param filename Name of the file to check.
+ *    @param[out] mtime Modification time of the file.
+ *    @param[out] size Size of the file in bytes.
+ *    @return 0 on success, -1 if the file is not found.
+ */
+int ndata_fileInfo( const char* filename, time_t *mtime, size_t *size )
+{
+   char *buf, path[PATH_MAX];
+
+   /* See if needs to load packfile. */
+   if (ndata_cache == NULL) {
+
+      /* Try to read the file as locally. */
+      if ((ndata_source <= NDATA_SRC_LAIDOUT) &&
+            (nfile_fileInfo( mtime, size, "%s", filename ) == 0))
+         return 0;
+
+      /* We can try to use the dirname path. */
+      if ((ndata_filename == NULL) && (ndata_dirname != NULL) &&
+            (ndata_source <= NDATA_SRC_DIRNAME) &&
+            (nfile_fileInfo( mtime, size, "%s/%s", ndata_dirname, filename ) == 0))
+         return 0;
+
+      /* We can also try default location. */
+      if (ndata_source <= NDATA_SRC_NDATADEF) {
+         buf = strdup( NDATA_DEF );
+         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
+         free(buf);
+         if (nfile_fileInfo( mtime, size, "%s", path ) == 0)
+            return 0;
+      }
+
+      /* Try binary location. */
+      if (ndata_source <= NDATA_SRC_BINARY) {
+         buf = strdup( naev_binary() );
+         nsnprintf( path, sizeof(path), "%s/%s", nfile_dirname(buf), filename );
+         free(buf);
+         if (nfile_fileInfo( mtime, size, "%s", path ) == 0)
+            return 0;
+      }
+
+      /* Load the packfile. */
+      ndata_openPackfile();
+   }
+
+   /* Wasn't able to open the file. */
+   if ((ndata_cache == NULL) || !pack_checkCache( ndata_cache, filename ))
+      return -1;
+
+   return nfile_fileInfo( mtime, size, "%s", ndata_filename );
+}
+
+
 /**
  * @brief Reads a file from the ndata.
  *
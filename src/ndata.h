@@ -8,6 +8,7 @@
 
 
 #include <stdint.h>
+#include <time.h>
 
 #include "SDL.h"
 
@@ -43,6 +44,7 @@
 #define PLANET_DATA_PATH         "dat/assets/" /**< Path to planets. */
 #define SYSTEM_DATA_PATH         "dat/ssys/" /**< Path to systems. */
 #define SHIP_DATA_PATH           "dat/ships/" /**< Path to ships. */
+#define SCENARIO_DATA_PATH       "dat/scenarios/" /**< Path to stress test scenarios. */
 
 #define LANDING_DATA_PATH        "dat/landing.lua" /**< Lua script containing landing data. */
 
@@ -78,6 +80,7 @@ const char* ndata_name (void);
  * Individual file functions.
  */
 int ndata_exists( const char* filename );
+int ndata_fileInfo( const char* filename, time_t *mtime, size_t *size );
 void* ndata_read( const char* filename, uint32_t *filesize );
 char** ndata_list( const char *path, uint32_t* nfiles );
 char** ndata_listRecursive( const char *path, uint32_t* nfiles );
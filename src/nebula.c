@@ -6,6 +6,11 @@
  * @file nebula.c
  *
  * @brief Handles rendering and generating the nebula.
+ *
+ * The background nebula is a fixed size volume of layers that tile seamlessly,
+ *  so it gets repeated over the screen at any resolution and only ever needs
+ *  to be generated once. It's cached as a raw file that gets mapped and
+ *  uploaded directly.
  */
 
 #include "nebula.h"
@@ -25,7 +30,6 @@
 #include "gui.h"
 #include "conf.h"
 #include "spfx.h"
-#include "npng.h"
 #include "camera.h"
 #include "nstring.h"
 #include "ndata.h"
@@ -33,7 +37,11 @@
 
 #define NEBULA_Z             16 /**< Z plane */
 #define NEBULA_PUFFS         32 /**< Amount of puffs to generate */
-#define NEBULA_PATH_BG       "nebu_bg_%dx%d_%02d.png" /**< Nebula path format. */
+#define NEBULA_SIZE          512 /**< Width and height of the tileable layers. */
+#define NEBULA_PERIOD        3 /**< Noise lattice cells spanned by a layer. */
+#define NEBULA_PATH_BG       "nebu_bg_%d.raw" /**< Nebula path format. */
+#define NEBULA_MAGIC         "NNEB" /**< Nebula cache magic. */
+#define NEBULA_VERSION       1 /**< Nebula cache version. */
 
 #define NEBULA_PUFF_BUFFER   300 /**< Nebula buffer */
 
@@ -42,12 +50,19 @@
 extern void loadscreen_render( double done, const char *msg ); /**< from naev.c */
 
 
+/**
+ * @brief Header of the nebula cache, followed by the layers as 8 bit alpha.
+ */
+typedef struct NebulaHeader_ {
+   char magic[4]; /**< NEBULA_MAGIC. */
+   uint32_t version; /**< NEBULA_VERSION. */
+   uint32_t size; /**< Width and height of the layers. */
+   uint32_t layers; /**< Number of layers. */
+} NebulaHeader;
+
 /* The nebula textures */
 static GLuint nebu_textures[NEBULA_Z]; /**< BG Nebula textures. */
-static int nebu_w    = 0; /**< BG Nebula width. */
-static int nebu_h    = 0; /**< BG Nebula height. */
-static int nebu_pw   = 0; /**< BG Padded Nebula width. */
-static int nebu_ph   = 0; /**< BG Padded Nebula height. */
+static int nebu_regen = 0; /**< Whether to regenerate the cache on init. */
 
 /* Information on rendering */
 static int cur_nebu[2]           = { 0, 1 }; /**< Nebulae currently rendering. */
@@ -85,11 +100,8 @@ static double puff_y          = 0.;
  * prototypes
  */
 static int nebu_init_recursive( int iter );
-static int nebu_checkCompat( const char* file );
-static int nebu_loadTexture( SDL_Surface *sur, int w, int h, GLuint tex );
+static void nebu_loadTexture( const uint8_t *data, GLuint tex );
 static int nebu_generate (void);
-static int saveNebula( float *map, const uint32_t w, const uint32_t h, const char* file );
-static SDL_Surface* loadNebula( const char* file );
 static SDL_Surface* nebu_surfaceFromNebulaMap( float* map, const int w, const int h );
 /* Puffs. */
 static void nebu_generatePuffs (void);
@@ -105,6 +117,10 @@ static void nebu_renderMultitexture( const double dt );
  */
 int nebu_init (void)
 {
+   /* Nothing gets rendered when headless. */
+   if (gl_has(OPENGL_HEADLESS))
+      return 0;
+
    return nebu_init_recursive( 0 );
 }
 
@@ -118,8 +134,9 @@ int nebu_init (void)
 static int nebu_init_recursive( int iter )
 {
    int i;
-   char nebu_file[PATH_MAX];
-   SDL_Surface* nebu_sur;
+   size_t len;
+   char *data;
+   NebulaHeader *hdr;
    int ret;
    GLfloat vertex[4*3*2];
    GLfloat tw, th;
@@ -131,43 +148,37 @@ static int nebu_init_recursive( int iter )
    }
 
    /* Special code to regenerate the nebula */
-   if ((nebu_w == -9) && (nebu_h == -9))
+   if (nebu_regen) {
+      nebu_regen = 0;
       nebu_generate();
-
-   /* Set expected sizes */
-   nebu_w  = SCREEN_W;
-   nebu_h  = SCREEN_H;
-   if (gl_needPOT()) {
-      nebu_pw = gl_pot(nebu_w);
-      nebu_ph = gl_pot(nebu_h);
    }
-   else {
-      nebu_pw = nebu_w;
-      nebu_ph = nebu_h;
+
+   /* Map the cache. */
+   if (!nfile_fileExists( "%s"NEBULA_PATH NEBULA_PATH_BG, nfile_cachePath(), NEBULA_SIZE ))
+      goto no_nebula;
+   data = nfile_mapFile( &len, "%s"NEBULA_PATH NEBULA_PATH_BG, nfile_cachePath(), NEBULA_SIZE );
+   if (data == NULL)
+      goto no_nebula;
+
+   /* Check compatibility. */
+   hdr = (NebulaHeader*) data;
+   if ((len < sizeof(NebulaHeader)) ||
+         (strncmp( hdr->magic, NEBULA_MAGIC, 4 ) != 0) ||
+         (hdr->version != NEBULA_VERSION) ||
+         (hdr->size != NEBULA_SIZE) ||
+         (hdr->layers != NEBULA_Z) ||
+         (len < sizeof(NebulaHeader) + NEBULA_SIZE*NEBULA_SIZE*NEBULA_Z)) {
+      WARN("Nebula cache is invalid, regenerating.");
+      nfile_unmapFile( data, len );
+      goto no_nebula;
    }
 
-   /* Load each, checking for compatibility and padding */
+   /* Load each layer straight from the mapping. */
    glGenTextures( NEBULA_Z, nebu_textures );
-   for (i=0; i<NEBULA_Z; i++) {
-      nsnprintf( nebu_file, PATH_MAX, NEBULA_PATH_BG, nebu_w, nebu_h, i );
-
-      /* Check compatibility. */
-      if (nebu_checkCompat( nebu_file ))
-         goto no_nebula;
-
-      /* Try to load. */
-      nebu_sur = loadNebula( nebu_file );
-      if (nebu_sur == NULL)
-         goto no_nebula;
-      if ((nebu_sur->w != nebu_w) || (nebu_sur->h != nebu_h))
-         WARN("Nebula raw size doesn't match expected! (%dx%d instead of %dx%d)",
-               nebu_sur->w, nebu_sur->h, nebu_w, nebu_h );
-
-      /* Load the texture */
-      ret = nebu_loadTexture( nebu_sur, nebu_pw, nebu_ph, nebu_textures[i] );
-      if (ret)
-         goto no_nebula;
-   }
+   for (i=0; i<NEBULA_Z; i++)
+      nebu_loadTexture( (uint8_t*)&data[ sizeof(NebulaHeader) + i*NEBULA_SIZE*NEBULA_SIZE ],
+            nebu_textures[i] );
+   nfile_unmapFile( data, len );
 
    /* Generate puffs after the recursivity stuff. */
    nebu_generatePuffs();
@@ -185,9 +196,9 @@ static int nebu_init_recursive( int iter )
    vertex[5] = 0;
    vertex[6] = SCREEN_W;
    vertex[7] = SCREEN_H;
-   /* Texture 0. */
-   tw = (double)nebu_w / (double)nebu_pw;
-   th = (double)nebu_h / (double)nebu_ph;
+   /* Texture 0, layers repeat over the screen at one texel per pixel. */
+   tw = (double)SCREEN_W / (double)NEBULA_SIZE;
+   th = (double)SCREEN_H / (double)NEBULA_SIZE;
    vertex[8]  = 0.;
    vertex[9]  = 0.;
    vertex[10] = tw;
@@ -232,40 +243,27 @@ double nebu_getSightRadius (void)
 
 
 /**
- * @brief Loads sur into tex, checks for expected size of w and h.
+ * @brief Loads a layer into a texture.
  *
- *    @param sur Surface to load into texture.
- *    @param w Expected width of surface.
- *    @param h Expected height of surface.
+ *    @param data Alpha of the layer, NEBULA_SIZE by NEBULA_SIZE.
  *    @param tex Already generated texture to load into.
- *    @return 0 on success;
  */
-static int nebu_loadTexture( SDL_Surface *sur, int w, int h, GLuint tex )
+static void nebu_loadTexture( const uint8_t *data, GLuint tex )
 {
-   SDL_Surface *nebu_sur;
-
-   nebu_sur = gl_prepareSurface( sur );
-   if ((w!=0) && (h!=0) &&
-         ((nebu_sur->w != w) || (nebu_sur->h != h))) {
-      WARN("Nebula size doesn't match expected! (%dx%d instead of %dx%d)",
-            nebu_sur->w, nebu_sur->h, nebu_pw, nebu_ph );
-      return -1;
-   }
-
-   /* Load the texture */
+   /* Load the texture, it tiles so it can be repeated at any resolution. */
    glBindTexture( GL_TEXTURE_2D, tex );
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-   /* Store into opengl saving only alpha channel in video memory */
-   SDL_LockSurface( nebu_sur );
-   glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA, nebu_sur->w, nebu_sur->h,
-         0, GL_RGBA, GL_UNSIGNED_BYTE, nebu_sur->pixels );
-   SDL_UnlockSurface( nebu_sur );
+   /* Only the alpha channel is needed in video memory. */
+   glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+   glTexImage2D( GL_TEXTURE_2D, 0, GL_ALPHA, NEBULA_SIZE, NEBULA_SIZE,
+         0, GL_ALPHA, GL_UNSIGNED_BYTE, data );
+   glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
 
-   SDL_FreeSurface(nebu_sur);
    gl_checkErr();
-   return 0;
 }
 
 
@@ -277,11 +275,13 @@ void nebu_exit (void)
    int i;
 
    /* Free the Nebula BG. */
-   glDeleteTextures( NEBULA_Z, nebu_textures );
+   if (!gl_has(OPENGL_HEADLESS)) {
+      glDeleteTextures( NEBULA_Z, nebu_textures );
 
-   /* Free the puffs. */
-   for (i=0; i<NEBULA_PUFFS; i++)
-      gl_freeTexture( nebu_pufftexs[i] );
+      /* Free the puffs. */
+      for (i=0; i<NEBULA_PUFFS; i++)
+         gl_freeTexture( nebu_pufftexs[i] );
+   }
 
    /* Free the VBO. */
    if (nebu_vboBG != NULL) {
@@ -714,7 +714,7 @@ void nebu_prep( double density, double volatility )
  */
 void nebu_forceGenerate (void)
 {
-   nebu_w = nebu_h = -9; /* \o/ magic numbers */
+   nebu_regen = 1;
 }
 
 
@@ -727,39 +727,51 @@ static int nebu_generate (void)
 {
    int i;
    float *nebu;
+   char *buf;
+   uint8_t *layers;
+   size_t len;
+   NebulaHeader *hdr;
    const char *cache;
-   char nebu_file[PATH_MAX];
-   int w,h;
+   char path[PATH_MAX], tmp[PATH_MAX];
    int ret;
 
    /* Warn user of what is happening. */
    loadscreen_render( 0.05, "Generating Nebula (slow, run once)..." );
 
-   /* Get resolution to create at. */
-   w = SCREEN_W;
-   h = SCREEN_H;
-
    /* Try to make the dir first if it fails. */
    cache = nfile_cachePath();
    nfile_dirMakeExist( "%s", cache );
    nfile_dirMakeExist( "%s"NEBULA_PATH, cache );
 
-   /* Generate all the nebula backgrounds */
-   nebu = noise_genNebulaMap( w, h, NEBULA_Z, 5. );
+   /* Generate all the nebula backgrounds, independent of the resolution. */
+   nebu = noise_genNebulaMapTileable( NEBULA_SIZE, NEBULA_SIZE, NEBULA_Z, NEBULA_PERIOD );
+   if (nebu == NULL)
+      return -1;
 
-   /* Start saving - compression can take a bit. */
-   loadscreen_render( 0.05, "Compressing Nebula layers..." );
+   /* Convert to alpha. */
+   len = sizeof(NebulaHeader) + NEBULA_SIZE*NEBULA_SIZE*NEBULA_Z;
+   buf = calloc( 1, len );
+   hdr = (NebulaHeader*) buf;
+   memcpy( hdr->magic, NEBULA_MAGIC, 4 );
+   hdr->version = NEBULA_VERSION;
+   hdr->size    = NEBULA_SIZE;
+   hdr->layers  = NEBULA_Z;
+   layers = (uint8_t*) &buf[ sizeof(NebulaHeader) ];
+   for (i=0; i<NEBULA_SIZE*NEBULA_SIZE*NEBULA_Z; i++)
+      layers[i] = (uint8_t)(255. * CLAMP( 0., 1., nebu[i] ));
+   free(nebu);
 
-   /* Save each nebula as an image */
-   for (i=0; i<NEBULA_Z; i++) {
-      nsnprintf( nebu_file, PATH_MAX, NEBULA_PATH_BG, w, h, i );
-      ret = saveNebula( &nebu[ i*w*h ], w, h, nebu_file );
-      if (ret != 0)
-         break; /* An error has happened */
-   }
+   /* Write to a temporary file first so a crash never leaves a bad cache. */
+   nsnprintf( path, sizeof(path), "%s"NEBULA_PATH NEBULA_PATH_BG, cache, NEBULA_SIZE );
+   nsnprintf( tmp, sizeof(tmp), "%s.tmp", path );
+   ret = nfile_writeFile( buf, len, "%s", tmp );
+   if (ret == 0)
+      ret = nfile_replace( tmp, path );
+   if (ret != 0)
+      WARN("Unable to write nebula cache '%s'.", path);
 
    /* Cleanup */
-   free(nebu);
+   free(buf);
    return ret;
 }
 
@@ -792,89 +804,6 @@ static void nebu_generatePuffs (void)
 }
 
 
-/**
- * @brief Checks the validity of a nebula.
- *
- *    @param file Path of the nebula to check (relative to base directory).
- *    @return 0 on success.
- */
-static int nebu_checkCompat( const char* file )
-{
-   /* first check to see if file exists */
-   if (nfile_fileExists("%s"NEBULA_PATH"%s", nfile_cachePath(), file) == 0)
-      return -1;
-   return 0;
-}
-
-
-/**
- * @brief Saves a nebula.
- *
- *    @param map Nebula map to save.
- *    @param w Width of nebula map.
- *    @param h Height of nebula map.
- *    @param file Path to save into.
- *    @return 0 on success.
- */
-static int saveNebula( float *map, const uint32_t w, const uint32_t h, const char* file )
-{
-   char file_path[PATH_MAX];
-   SDL_Surface* sur;
-   int ret;
-
-   /* fix surface */
-   sur = nebu_surfaceFromNebulaMap( map, w, h );
-
-   /* save */
-   nsnprintf(file_path, PATH_MAX, "%s"NEBULA_PATH"%s", nfile_cachePath(), file );
-   ret = SDL_SavePNG( sur, file_path );
-
-   /* cleanup */
-   SDL_FreeSurface( sur );
-
-   return ret;
-}
-
-
-/**
- * @brief Loads the nebulae from file.
- *
- *    @param file Path of the nebula to load.  Relative to base directory.
- *    @return A SDL surface with the nebula.
- */
-static SDL_Surface* loadNebula( const char* file )
-{
-   char file_path[PATH_MAX];
-   SDL_Surface* sur;
-   SDL_RWops *rw;
-   npng_t *npng;
-
-   /* loads the file */
-   nsnprintf(file_path, PATH_MAX, "%s"NEBULA_PATH"%s", nfile_cachePath(), file );
-   rw    = SDL_RWFromFile( file_path, "rb" );;
-   if (rw == NULL) {
-      WARN("Unable to create rwops from Nebula image: %s", file);
-      return NULL;
-   }
-   npng  = npng_open( rw );
-   if (npng == NULL) {
-      WARN("Unable to open Nebula image: %s", file);
-      SDL_RWclose( rw );
-      return NULL;
-   }
-   sur   = npng_readSurface( npng, 0, 1 );
-   npng_close( npng );
-   SDL_RWclose( rw );
-   if (sur == NULL) {
-      WARN("Unable to load Nebula image: %s", file);
-      return NULL;
-   }
-
-   return sur;
-}
-
-
-
 /**
  * @brief Generates a SDL_Surface from a 2d nebula map
  *
@@ -25,8 +25,10 @@
 #if HAS_POSIX
 #include <sys/types.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <libgen.h>
+#include <sys/mman.h>
 #endif /* HAS_POSIX */
 #if HAS_WIN32
 #include <windows.h>
@@ -408,6 +410,37 @@ int nfile_fileExists( const char* path, ... )
 }
 
 
+/**
+ * @brief Gets the modification time and size of a file.
+ *
+ *    @param[out] mtime Modification time of the file.
+ *    @param[out] size Size of the file in bytes.
+ *    @param path printf formatted string pointing to the file.
+ *    @return 0 on success, -1 if the file can't be stat'd.
+ */
+int nfile_fileInfo( time_t *mtime, size_t *size, const char* path, ... )
+{
+   char file[PATH_MAX];
+   va_list ap;
+   struct stat buf;
+
+   if (path == NULL)
+      return -1;
+   va_start(ap, path);
+   vsnprintf(file, PATH_MAX, path, ap);
+   va_end(ap);
+
+   if (stat(file,&buf) != 0)
+      return -1;
+
+   if (mtime != NULL)
+      *mtime = buf.st_mtime;
+   if (size != NULL)
+      *size = buf.st_size;
+   return 0;
+}
+
+
 /**
  * @brief Backup a file, if it exists.
  *
@@ -728,6 +761,84 @@ char* nfile_readFile( int* filesize, const char* path, ... )
 }
 
 
+/**
+ * @brief Maps a file into memory read-only.
+ *
+ * Where memory mapping isn't available the file just gets read in.
+ *
+ *    @param[out] filesize Stores the size of the file.
+ *    @param path Path of the file.
+ *    @return The file data, must be released with nfile_unmapFile().
+ */
+void* nfile_mapFile( size_t* filesize, const char* path, ... )
+{
+   char base[PATH_MAX];
+   va_list ap;
+#if HAS_POSIX
+   int fd;
+   struct stat st;
+   void *data;
+#else /* HAS_POSIX */
+   int len;
+   char *buf;
+#endif /* HAS_POSIX */
+
+   *filesize = 0;
+   if (path == NULL)
+      return NULL;
+   else { /* get the message */
+      va_start(ap, path);
+      vsnprintf(base, PATH_MAX, path, ap);
+      va_end(ap);
+   }
+
+#if HAS_POSIX
+   fd = open( base, O_RDONLY );
+   if (fd < 0) {
+      WARN("Error occurred while opening '%s': %s", base, strerror(errno));
+      return NULL;
+   }
+   if (fstat( fd, &st ) || (st.st_size <= 0)) {
+      WARN("Unable to map empty or invalid file '%s'.", base);
+      close( fd );
+      return NULL;
+   }
+   data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd ); /* Mapping stays valid. */
+   if (data == MAP_FAILED) {
+      WARN("Error occurred while mapping '%s': %s", base, strerror(errno));
+      return NULL;
+   }
+   *filesize = st.st_size;
+   return data;
+#else /* HAS_POSIX */
+   buf = nfile_readFile( &len, "%s", base );
+   if (buf != NULL)
+      *filesize = len;
+   return buf;
+#endif /* HAS_POSIX */
+}
+
+
+/**
+ * @brief Releases a file mapped with nfile_mapFile().
+ *
+ *    @param data Data of the mapped file.
+ *    @param filesize Size of the mapped file.
+ */
+void nfile_unmapFile( void* data, size_t filesize )
+{
+   if (data == NULL)
+      return;
+#if HAS_POSIX
+   munmap( data, filesize );
+#else /* HAS_POSIX */
+   (void) filesize;
+   free( data );
+#endif /* HAS_POSIX */
+}
+
+
 /**
  * @brief Tries to create the file if it doesn't exist.
  *
@@ -852,3 +963,76 @@ int nfile_rename( const char* oldname, const char* newname )
       WARN("Error renaming %s to %s",oldname,newname);
    return 0;
 }
+
+
+/**
+ * @brief Flushes the contents of a file to disk.
+ *
+ *    @param path File to flush.
+ *    @return 0 on success.
+ */
+int nfile_sync( const char* path )
+{
+#if HAS_POSIX
+   int fd, ret;
+
+   fd = open( path, O_RDWR );
+   if (fd < 0) {
+      WARN("Unable to open '%s' for syncing: %s", path, strerror(errno));
+      return -1;
+   }
+   ret = fsync( fd );
+   if (ret)
+      WARN("Unable to sync '%s': %s", path, strerror(errno));
+   close( fd );
+   return ret;
+#elif HAS_WIN32
+   HANDLE h;
+   BOOL ret;
+
+   h = CreateFile( path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+         NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+   if (h == INVALID_HANDLE_VALUE) {
+      WARN("Unable to open '%s' for syncing.", path);
+      return -1;
+   }
+   ret = FlushFileBuffers( h );
+   CloseHandle( h );
+   if (!ret) {
+      WARN("Unable to sync '%s'.", path);
+      return -1;
+   }
+   return 0;
+#else /* HAS_POSIX */
+   (void) path;
+   return 0;
+#endif /* HAS_POSIX */
+}
+
+
+/**
+ * @brief Replaces a file with another one atomically.
+ *
+ * Unlike nfile_rename() the target may exist, and it will never be left
+ *  missing nor half written.
+ *
+ *    @param oldname File to move.
+ *    @param newname File to replace.
+ *    @return 0 on success.
+ */
+int nfile_replace( const char* oldname, const char* newname )
+{
+#if HAS_WIN32
+   if (!MoveFileEx( oldname, newname,
+            MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH )) {
+      WARN("Error replacing %s with %s", newname, oldname);
+      return -1;
+   }
+#else /* HAS_WIN32 */
+   if (rename( oldname, newname )) {
+      WARN("Error replacing %s with %s: %s", newname, oldname, strerror(errno));
+      return -1;
+   }
+#endif /* HAS_WIN32 */
+   return 0;
+}
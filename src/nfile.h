@@ -7,6 +7,10 @@
 #  define NFILE_H
 
 
+#include <stddef.h>
+#include <time.h>
+
+
 const char* nfile_dataPath (void);
 const char* nfile_configPath (void);
 const char* nfile_cachePath (void);
@@ -14,14 +18,19 @@ char* nfile_dirname( char *path );
 int nfile_dirMakeExist( const char* path, ... ); /* Creates if doesn't exist, 0 success */
 int nfile_dirExists( const char* path, ... ); /* Returns 1 on exists. */
 int nfile_fileExists( const char* path, ... ); /* Returns 1 on exists */
+int nfile_fileInfo( time_t *mtime, size_t *size, const char* path, ... ); /* Returns 0 on success */
 int nfile_backupIfExists( const char* path, ... );
 char** nfile_readDir( int* nfiles, const char* path, ... );
 char** nfile_readDirRecursive( int* nfiles, const char* path, ... );
 char* nfile_readFile( int* filesize, const char* path, ... );
+void* nfile_mapFile( size_t* filesize, const char* path, ... );
+void nfile_unmapFile( void* data, size_t filesize );
 int nfile_touch( const char* path, ... );
 int nfile_writeFile( const char* data, int len, const char* path, ... );
 int nfile_delete( const char* file );
 int nfile_rename( const char* oldname, const char* newname );
+int nfile_replace( const char* oldname, const char* newname );
+int nfile_sync( const char* path );
 
 
 #endif /* NFILE_H */
@@ -18,10 +18,32 @@
 #include "nluadef.h"
 #include "log.h"
 #include "mission.h"
+#include "nfile.h"
+#include "nstring.h"
+#include "nlua_prof.h"
+#include "perf.h"
+#include "conf.h"
+
+
+#define CLI_PROF_REPORT    "lua_profile.txt" /**< Default profiler report file. */
+#define CLI_PROF_FOLDED    "lua_profile.folded" /**< Default profiler folded stacks file. */
+#define CLI_PERF_TRACE     "frame_trace.json" /**< Default frame trace file. */
 
 
 /* CLI */
+static int cli_profStart( lua_State *L );
+static int cli_profStop( lua_State *L );
+static int cli_profReset( lua_State *L );
+static int cli_profDump( lua_State *L );
+static int cli_perfShow( lua_State *L );
+static int cli_perfTrace( lua_State *L );
 static const luaL_reg cli_methods[] = {
+   { "profStart", cli_profStart },
+   { "profStop", cli_profStop },
+   { "profReset", cli_profReset },
+   { "profDump", cli_profDump },
+   { "perfShow", cli_perfShow },
+   { "perfTrace", cli_perfTrace },
    {0,0}
 }; /**< CLI Lua methods. */
 
@@ -38,3 +60,131 @@ int nlua_loadCLI( lua_State *L )
    return 0;
 }
 
+
+
+/**
+ * @brief Starts the Lua profiler.
+ *
+ * Only AI, mission, event, hook, equip and spawn scripts are profiled.
+ *
+ * @usage cli.profStart()
+ *
+ * @luafunc profStart()
+ */
+static int cli_profStart( lua_State *L )
+{
+   (void) L;
+   nlua_profStart();
+   return 0;
+}
+
+
+/**
+ * @brief Stops the Lua profiler, results are kept until reset.
+ *
+ * @usage cli.profStop()
+ *
+ * @luafunc profStop()
+ */
+static int cli_profStop( lua_State *L )
+{
+   (void) L;
+   nlua_profStop();
+   return 0;
+}
+
+
+/**
+ * @brief Clears the Lua profiler results.
+ *
+ * @usage cli.profReset()
+ *
+ * @luafunc profReset()
+ */
+static int cli_profReset( lua_State *L )
+{
+   (void) L;
+   nlua_profReset();
+   return 0;
+}
+
+
+/**
+ * @brief Dumps the Lua profiler results.
+ *
+ * The report lists the time spent per context (AI profile, mission, event,
+ *  ...) and per function sorted by self time. Folded stacks can be turned
+ *  into a flame graph with flamegraph.pl.
+ *
+ * @usage cli.profDump() -- Writes a report to the config directory.
+ * @usage cli.profDump( nil, true ) -- Writes folded stacks instead.
+ *
+ *    @luaparam file Optional file to write to, relative to the config directory.
+ *    @luaparam folded Optional parameter to write folded stacks instead of a report.
+ *    @luareturn The path written to or nil on error.
+ * @luafunc profDump( file, folded )
+ */
+static int cli_profDump( lua_State *L )
+{
+   const char *file;
+   char path[PATH_MAX];
+   int folded;
+
+   folded = lua_toboolean(L,2);
+   file   = luaL_optstring(L, 1, folded ? CLI_PROF_FOLDED : CLI_PROF_REPORT);
+   nsnprintf( path, sizeof(path), "%s%s", nfile_configPath(), file );
+
+   if (nlua_profDump( path, folded ))
+      return 0;
+   lua_pushstring( L, path );
+   return 1;
+}
+
+
+/**
+ * @brief Shows or hides the frame timing overlay.
+ *
+ * @usage cli.perfShow() -- Toggles the overlay.
+ * @usage cli.perfShow( false ) -- Hides the overlay.
+ *
+ *    @luaparam show Optional parameter to set whether or not to show it.
+ * @luafunc perfShow( show )
+ */
+static int cli_perfShow( lua_State *L )
+{
+   if (lua_isnoneornil(L,1))
+      conf.perf_show = !conf.perf_show;
+   else
+      conf.perf_show = lua_toboolean(L,1);
+   return 0;
+}
+
+
+/**
+ * @brief Records the next frames as a Chrome trace.
+ *
+ * The trace gets saved once done and can be opened with chrome://tracing or
+ *  ui.perfetto.dev.
+ *
+ * @usage cli.perfTrace( 300 ) -- Traces the next 300 frames.
+ *
+ *    @luaparam frames Number of frames to trace.
+ *    @luaparam file Optional file to write to, relative to the config directory.
+ *    @luareturn The path that will be written or nil on error.
+ * @luafunc perfTrace( frames, file )
+ */
+static int cli_perfTrace( lua_State *L )
+{
+   const char *file;
+   char path[PATH_MAX];
+   int frames;
+
+   frames = luaL_checkinteger(L,1);
+   file   = luaL_optstring(L, 2, CLI_PERF_TRACE);
+   nsnprintf( path, sizeof(path), "%s%s", nfile_configPath(), file );
+
+   if (perf_traceStart( frames, path ))
+      return 0;
+   lua_pushstring( L, path );
+   return 1;
+}
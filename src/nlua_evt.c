@@ -25,6 +25,7 @@
 #include "nluadef.h"
 #include "nlua_system.h"
 #include "nlua_hook.h"
+#include "nlua_prof.h"
 #include "log.h"
 #include "event.h"
 #include "mission.h"
@@ -135,7 +136,7 @@ Event_t *event_getFromLua( lua_State *L )
  */
 int event_runLuaFunc( Event_t *ev, const char *func, int nargs )
 {
-   int ret, errf;
+   int ret, errf, mark;
    const char* err;
    lua_State *L;
    int evt_delete;
@@ -149,7 +150,9 @@ int event_runLuaFunc( Event_t *ev, const char *func, int nargs )
    errf = 0;
 #endif /* DEBUGGING */
 
+   mark = nlua_profEnter( L, "event", event_getData(ev->id) );
    ret = lua_pcall(L, nargs, 0, errf);
+   nlua_profLeave( L, mark );
    if (ret != 0) { /* error has occurred */
       err = (lua_isstring(L,-1)) ? lua_tostring(L,-1) : NULL;
       if ((err==NULL) || (strcmp(err,NLUA_DONE)!=0)) {
@@ -42,6 +42,8 @@ static int factionL_logoTiny( lua_State *L );
 static int factionL_colour( lua_State *L );
 static int factionL_isknown( lua_State *L );
 static int factionL_setknown( lua_State *L );
+static int factionL_setenemy( lua_State *L );
+static int factionL_setally( lua_State *L );
 static const luaL_reg faction_methods[] = {
    { "get", factionL_get },
    { "__eq", factionL_eq },
@@ -61,6 +63,8 @@ static const luaL_reg faction_methods[] = {
    { "colour", factionL_colour },
    { "known", factionL_isknown },
    { "setKnown", factionL_setknown },
+   { "setEnemy", factionL_setenemy },
+   { "setAlly", factionL_setally },
    {0,0}
 }; /**< Faction metatable methods. */
 static const luaL_reg faction_methods_cond[] = {
@@ -576,3 +580,55 @@ static int factionL_setknown( lua_State *L )
    return 0;
 }
 
+
+/**
+ * @brief Sets whether two factions are enemies.
+ *
+ * @usage f:setEnemy( faction.get("Pirate") ) -- Makes them enemies.
+ * @usage f:setEnemy( faction.get("Pirate"), false ) -- Makes them stop being enemies.
+ *    @luaparam f Faction to set enemy of.
+ *    @luaparam o Other faction.
+ *    @luaparam b Whether or not they should be enemies (defaults to true).
+ * @luafunc setEnemy( f, o, b )
+ */
+static int factionL_setenemy( lua_State *L )
+{
+   int f, o;
+
+   f = luaL_validfaction(L, 1);
+   o = luaL_validfaction(L, 2);
+
+   if (lua_isnoneornil(L, 3) || lua_toboolean(L, 3))
+      faction_addEnemy( f, o );
+   else
+      faction_rmEnemy( f, o );
+
+   return 0;
+}
+
+
+/**
+ * @brief Sets whether two factions are allies.
+ *
+ * @usage f:setAlly( faction.get("Empire") ) -- Makes them allies.
+ * @usage f:setAlly( faction.get("Empire"), false ) -- Makes them stop being allies.
+ *    @luaparam f Faction to set ally of.
+ *    @luaparam o Other faction.
+ *    @luaparam b Whether or not they should be allies (defaults to true).
+ * @luafunc setAlly( f, o, b )
+ */
+static int factionL_setally( lua_State *L )
+{
+   int f, o;
+
+   f = luaL_validfaction(L, 1);
+   o = luaL_validfaction(L, 2);
+
+   if (lua_isnoneornil(L, 3) || lua_toboolean(L, 3))
+      faction_addAlly( f, o );
+   else
+      faction_rmAlly( f, o );
+
+   return 0;
+}
+
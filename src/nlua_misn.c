@@ -32,6 +32,7 @@
 #include "nlua_music.h"
 #include "nlua_bkg.h"
 #include "nlua_tut.h"
+#include "nlua_prof.h"
 #include "player.h"
 #include "mission.h"
 #include "log.h"
@@ -242,7 +243,7 @@ lua_State *misn_runStart( Mission *misn, const char *func )
  */
 int misn_runFunc( Mission *misn, const char *func, int nargs )
 {
-   int i, ret, errf;
+   int i, ret, errf, mark;
    const char* err;
    lua_State *L;
    int misn_delete;
@@ -257,7 +258,9 @@ int misn_runFunc( Mission *misn, const char *func, int nargs )
    errf = 0;
 #endif /* DEBUGGING */
 
+   mark = nlua_profEnter( L, "misn", misn->data->name );
    ret = lua_pcall(L, nargs, 0, errf);
+   nlua_profLeave( L, mark );
    cur_mission = misn_getFromLua(L); /* The mission can change if accepted. */
    if (ret != 0) { /* error has occurred */
       err = (lua_isstring(L,-1)) ? lua_tostring(L,-1) : NULL;
@@ -338,7 +338,7 @@ static int outfitL_icon( lua_State *L )
 {
    LuaTex lt;
    Outfit *o = luaL_validoutfit(L,1);
-   lt.tex = gl_dupTexture( o->gfx_store );
+   lt.tex = gl_dupTexture( outfit_gfxStore( o ) );
    lua_pushtex( L, lt );
    return 1;
 }
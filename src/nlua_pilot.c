@@ -753,6 +753,7 @@ static int pilotL_clear( lua_State *L )
    (void) L;
    pilots_clear();
    weapon_clear();
+   space_populateCancel();
    return 0;
 }
 /**
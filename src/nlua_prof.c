@@ -0,0 +1,609 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file nlua_prof.c
+ *
+ * @brief Instrumenting profiler for the Lua scripts.
+ *
+ * The places that run scripts (AI, missions, events, spawn scripts, ...)
+ *  mark what they are running with nlua_profEnter() and nlua_profLeave().
+ *  While the profiler is active those states get a call/return hook which
+ *  keeps a shadow call stack, so wall time and call counts end up attributed
+ *  to every function and context in a call tree.
+ *
+ * The tree can be dumped either as a sorted report or as folded stacks that
+ *  can be fed directly to flamegraph.pl. When the profiler is not active the
+ *  instrumentation only costs a flag check.
+ */
+
+
+#include "nlua_prof.h"
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "nstring.h"
+
+#include "log.h"
+#include "array.h"
+#include "perf.h"
+
+
+#define PROF_HASH_MIN   256 /**< Minimum size of the frame hash table. */
+#define PROF_LABEL_MAX  256 /**< Maximum length of a frame label. */
+#define PROF_ROOT       0 /**< Root node of the call tree. */
+
+
+/**
+ * @brief A function or context that got called.
+ */
+typedef struct ProfFrame_ {
+   char *label; /**< Label used in the output. */
+   int ctx; /**< Is a context and not a Lua function. */
+   int onstack; /**< Times currently on the stack, used to not count recursion twice. */
+   unsigned int calls; /**< Number of calls. */
+   uint64_t self; /**< Ticks spent in the frame itself. */
+   uint64_t total; /**< Ticks spent in the frame including children. */
+} ProfFrame;
+
+
+/**
+ * @brief Node of the call tree.
+ */
+typedef struct ProfNode_ {
+   int frame; /**< Frame of the node, -1 for the root. */
+   int parent; /**< Parent node. */
+   int child; /**< First child node, -1 if none. */
+   int next; /**< Next sibling node, -1 if none. */
+   unsigned int calls; /**< Number of calls. */
+   uint64_t self; /**< Ticks spent in the node itself. */
+   uint64_t total; /**< Ticks spent in the node including children. */
+} ProfNode;
+
+
+/**
+ * @brief Entry of the shadow call stack.
+ */
+typedef struct ProfCall_ {
+   lua_State *L; /**< State the call belongs to. */
+   int node; /**< Call tree node. */
+   int ctx; /**< Is a context, these only get left explicitly. */
+   const void *fn; /**< Function called, used to match returns. */
+   uint64_t start; /**< Ticks when entered. */
+   uint64_t child; /**< Ticks spent in children. */
+} ProfCall;
+
+
+static int prof_active        = 0; /**< Whether or not the profiler is running. */
+static uint64_t prof_started  = 0; /**< Ticks when last started. */
+static uint64_t prof_elapsed  = 0; /**< Ticks profiled in previous runs. */
+static ProfFrame *prof_frames = NULL; /**< Known frames. */
+static ProfNode *prof_nodes   = NULL; /**< Call tree. */
+static ProfCall *prof_stack   = NULL; /**< Shadow call stack. */
+static int *prof_hash         = NULL; /**< Frame hash table, stores index+1. */
+static int prof_hashsize      = 0; /**< Size of the frame hash table. */
+
+
+/*
+ * Prototypes.
+ */
+static unsigned int prof_hashStr( const char *str );
+static int prof_frameGet( const char *label, int ctx );
+static int prof_nodeGet( int parent, int frame );
+static void prof_push( lua_State *L, int frame, int ctx, const void *fn, uint64_t now );
+static void prof_pop( uint64_t now );
+static void prof_hook( lua_State *L, lua_Debug *ar );
+static int prof_cmpSelf( const void *p1, const void *p2 );
+static int prof_cmpTotal( const void *p1, const void *p2 );
+static int prof_dumpReport( FILE *f );
+static int prof_dumpFolded( FILE *f );
+
+
+/**
+ * @brief Hashes a string (djb2).
+ */
+static unsigned int prof_hashStr( const char *str )
+{
+   unsigned int h;
+   h = 5381;
+   while (*str != '\0')
+      h = (h << 5) + h + (unsigned char)*str++;
+   return h;
+}
+
+
+/**
+ * @brief Gets a frame by label, creating it if needed.
+ *
+ *    @param label Label of the frame.
+ *    @param ctx Whether or not it's a context.
+ *    @return Index of the frame.
+ */
+static int prof_frameGet( const char *label, int ctx )
+{
+   int i, j, n, size;
+   int *hash;
+   ProfFrame *fr;
+
+   /* Look it up. */
+   if (prof_hashsize > 0) {
+      i = prof_hashStr( label ) & (prof_hashsize-1);
+      while (prof_hash[i] != 0) {
+         fr = &prof_frames[ prof_hash[i]-1 ];
+         if ((fr->ctx == ctx) && (strcmp( fr->label, label ) == 0))
+            return prof_hash[i]-1;
+         i = (i+1) & (prof_hashsize-1);
+      }
+   }
+
+   /* Create it. */
+   if (prof_frames == NULL)
+      prof_frames = array_create( ProfFrame );
+   fr = &array_grow( &prof_frames );
+   memset( fr, 0, sizeof(ProfFrame) );
+   fr->label = strdup( label );
+   fr->ctx   = ctx;
+   n = array_size( prof_frames );
+
+   /* Keep the table at most half full. */
+   if (2*n > prof_hashsize) {
+      size = MAX( PROF_HASH_MIN, 2*prof_hashsize );
+      hash = calloc( size, sizeof(int) );
+      for (j=0; j<n; j++) {
+         i = prof_hashStr( prof_frames[j].label ) & (size-1);
+         while (hash[i] != 0)
+            i = (i+1) & (size-1);
+         hash[i] = j+1;
+      }
+      free( prof_hash );
+      prof_hash     = hash;
+      prof_hashsize = size;
+   }
+   else {
+      i = prof_hashStr( label ) & (prof_hashsize-1);
+      while (prof_hash[i] != 0)
+         i = (i+1) & (prof_hashsize-1);
+      prof_hash[i] = n;
+   }
+
+   return n-1;
+}
+
+
+/**
+ * @brief Gets the child node of a node for a frame, creating it if needed.
+ *
+ *    @param parent Parent node.
+ *    @param frame Frame of the child.
+ *    @return Index of the child node.
+ */
+static int prof_nodeGet( int parent, int frame )
+{
+   int i;
+   ProfNode *node;
+
+   for (i=prof_nodes[parent].child; i>=0; i=prof_nodes[i].next)
+      if (prof_nodes[i].frame == frame)
+         return i;
+
+   node = &array_grow( &prof_nodes );
+   memset( node, 0, sizeof(ProfNode) );
+   node->frame  = frame;
+   node->parent = parent;
+   node->child  = -1;
+   i = array_size( prof_nodes ) - 1;
+   node->next   = prof_nodes[parent].child;
+   prof_nodes[parent].child = i;
+   return i;
+}
+
+
+/**
+ * @brief Pushes a call onto the shadow stack.
+ */
+static void prof_push( lua_State *L, int frame, int ctx, const void *fn, uint64_t now )
+{
+   int parent, node;
+   ProfCall *call;
+
+   parent = (array_size(prof_stack) > 0) ? array_back(prof_stack).node : PROF_ROOT;
+   node   = prof_nodeGet( parent, frame );
+   prof_nodes[node].calls++;
+   prof_frames[frame].calls++;
+   prof_frames[frame].onstack++;
+
+   call = &array_grow( &prof_stack );
+   call->L     = L;
+   call->node  = node;
+   call->ctx   = ctx;
+   call->fn    = fn;
+   call->start = now;
+   call->child = 0;
+}
+
+
+/**
+ * @brief Pops a call from the shadow stack and accounts its time.
+ */
+static void prof_pop( uint64_t now )
+{
+   ProfCall *call;
+   ProfNode *node;
+   ProfFrame *fr;
+   uint64_t elapsed, self;
+
+   call    = &array_back( prof_stack );
+   elapsed = now - call->start;
+   self    = (elapsed > call->child) ? elapsed - call->child : 0;
+
+   node = &prof_nodes[ call->node ];
+   node->self  += self;
+   node->total += elapsed;
+
+   fr = &prof_frames[ node->frame ];
+   fr->self += self;
+   if (--fr->onstack == 0)
+      fr->total += elapsed;
+
+   array_resize( &prof_stack, array_size(prof_stack)-1 );
+   if (array_size(prof_stack) > 0)
+      array_back(prof_stack).child += elapsed;
+}
+
+
+/**
+ * @brief Lua call/return hook.
+ */
+static void prof_hook( lua_State *L, lua_Debug *ar )
+{
+   char label[PROF_LABEL_MAX];
+   const char *name;
+   const void *fn;
+   uint64_t now;
+   int i;
+
+   now = perf_ticks();
+
+   /* Profiler was stopped, get out of the way. */
+   if (!prof_active) {
+      lua_sethook( L, NULL, 0, 0 );
+      return;
+   }
+
+   /* Only calls made from an instrumented context are of interest. */
+   if (array_size(prof_stack) == 0)
+      return;
+
+   if (ar->event == LUA_HOOKCALL) {
+      lua_getinfo( L, "Snf", ar );
+      fn = lua_topointer( L, -1 );
+      lua_pop( L, 1 );
+      name = ar->name;
+      if (name == NULL)
+         name = (strcmp(ar->what,"main")==0) ? "(main)" : "?";
+      if (strcmp(ar->what,"C")==0)
+         nsnprintf( label, sizeof(label), "%s [C]", name );
+      else
+         nsnprintf( label, sizeof(label), "%s (%s:%d)", name, ar->short_src, ar->linedefined );
+      /* Semicolons separate frames in the folded output. */
+      for (i=0; label[i]!='\0'; i++)
+         if (label[i] == ';')
+            label[i] = ':';
+      /* Don't bill the lookup to the function. */
+      prof_push( L, prof_frameGet( label, 0 ), 0, fn, perf_ticks() );
+   }
+   else if (ar->event == LUA_HOOKRET) {
+      /* Errors unwind frames without return events, so pop until the
+       * returning function is found. Frames of other states or contexts are
+       * never touched, whatever is left gets cleaned up leaving the context. */
+      lua_getinfo( L, "f", ar );
+      fn = lua_topointer( L, -1 );
+      lua_pop( L, 1 );
+      for (i=array_size(prof_stack)-1; i>=0; i--) {
+         if ((prof_stack[i].L != L) || prof_stack[i].ctx)
+            return;
+         if (prof_stack[i].fn == fn)
+            break;
+      }
+      if (i < 0)
+         return;
+      while (array_size(prof_stack) > i)
+         prof_pop( now );
+   }
+   else {
+      /* Tail returns have no function information, they always match the top. */
+      if ((array_back(prof_stack).L == L) && !array_back(prof_stack).ctx)
+         prof_pop( now );
+   }
+}
+
+
+/**
+ * @brief Starts profiling.
+ */
+void nlua_profStart (void)
+{
+   ProfNode *root;
+
+   if (prof_active)
+      return;
+   if (prof_nodes == NULL) {
+      prof_nodes = array_create( ProfNode );
+      prof_stack = array_create( ProfCall );
+      root = &array_grow( &prof_nodes );
+      memset( root, 0, sizeof(ProfNode) );
+      root->frame  = -1;
+      root->parent = -1;
+      root->child  = -1;
+      root->next   = -1;
+   }
+   prof_started = perf_ticks();
+   prof_active  = 1;
+}
+
+
+/**
+ * @brief Stops profiling, keeping the results.
+ */
+void nlua_profStop (void)
+{
+   uint64_t now;
+
+   if (!prof_active)
+      return;
+
+   now = perf_ticks();
+   while (array_size(prof_stack) > 0)
+      prof_pop( now );
+   prof_elapsed += now - prof_started;
+   prof_active   = 0;
+}
+
+
+/**
+ * @brief Clears all the results.
+ */
+void nlua_profReset (void)
+{
+   int active;
+
+   active = prof_active;
+   nlua_profStop();
+   nlua_profFree();
+   if (active)
+      nlua_profStart();
+}
+
+
+/**
+ * @brief Frees the profiler.
+ */
+void nlua_profFree (void)
+{
+   int i;
+
+   prof_active = 0;
+   if (prof_frames != NULL) {
+      for (i=0; i<array_size(prof_frames); i++)
+         free( prof_frames[i].label );
+      array_free( prof_frames );
+      prof_frames = NULL;
+   }
+   if (prof_nodes != NULL) {
+      array_free( prof_nodes );
+      prof_nodes = NULL;
+   }
+   if (prof_stack != NULL) {
+      array_free( prof_stack );
+      prof_stack = NULL;
+   }
+   free( prof_hash );
+   prof_hash     = NULL;
+   prof_hashsize = 0;
+   prof_elapsed  = 0;
+}
+
+
+/**
+ * @brief Checks to see if the profiler is running.
+ */
+int nlua_profActive (void)
+{
+   return prof_active;
+}
+
+
+/**
+ * @brief Marks the start of running Lua code in a context.
+ *
+ * @code
+ * mark = nlua_profEnter( L, "ai", profile->name );
+ * lua_pcall( L, 0, 0, errf );
+ * nlua_profLeave( L, mark );
+ * @endcode
+ *
+ *    @param L State that will run, NULL for contexts that only group others.
+ *    @param ctx Type of the context, like "ai" or "misn".
+ *    @param name Name of the context, like the AI profile.
+ *    @return Mark to pass to nlua_profLeave().
+ */
+int nlua_profEnter( lua_State *L, const char *ctx, const char *name )
+{
+   char label[PROF_LABEL_MAX];
+   int mark;
+
+   if (!prof_active) {
+      if ((L != NULL) && (lua_gethook(L) == prof_hook))
+         lua_sethook( L, NULL, 0, 0 );
+      return -1;
+   }
+
+   if ((L != NULL) && (lua_gethook(L) != prof_hook))
+      lua_sethook( L, prof_hook, LUA_MASKCALL | LUA_MASKRET, 0 );
+
+   nsnprintf( label, sizeof(label), "%s:%s", ctx, (name!=NULL) ? name : "?" );
+   mark = array_size( prof_stack );
+   prof_push( L, prof_frameGet( label, 1 ), 1, NULL, perf_ticks() );
+   return mark;
+}
+
+
+/**
+ * @brief Marks the end of running Lua code in a context.
+ *
+ *    @param L State that ran.
+ *    @param mark Mark returned by nlua_profEnter().
+ */
+void nlua_profLeave( lua_State *L, int mark )
+{
+   uint64_t now;
+   (void) L;
+
+   if ((mark < 0) || !prof_active)
+      return;
+
+   now = perf_ticks();
+   while (array_size(prof_stack) > mark)
+      prof_pop( now );
+}
+
+
+/**
+ * @brief Sorts frame indices by self time, descending.
+ */
+static int prof_cmpSelf( const void *p1, const void *p2 )
+{
+   const ProfFrame *f1, *f2;
+   f1 = &prof_frames[ *(const int*)p1 ];
+   f2 = &prof_frames[ *(const int*)p2 ];
+   if (f1->self != f2->self)
+      return (f1->self < f2->self) ? 1 : -1;
+   return strcmp( f1->label, f2->label );
+}
+
+
+/**
+ * @brief Sorts frame indices by total time, descending.
+ */
+static int prof_cmpTotal( const void *p1, const void *p2 )
+{
+   const ProfFrame *f1, *f2;
+   f1 = &prof_frames[ *(const int*)p1 ];
+   f2 = &prof_frames[ *(const int*)p2 ];
+   if (f1->total != f2->total)
+      return (f1->total < f2->total) ? 1 : -1;
+   return strcmp( f1->label, f2->label );
+}
+
+
+/**
+ * @brief Writes the sorted report.
+ */
+static int prof_dumpReport( FILE *f )
+{
+   int i, n, *idx;
+   double wall, lua, ms;
+   ProfFrame *fr;
+
+   n   = array_size( prof_frames );
+   idx = malloc( n * sizeof(int) );
+   for (i=0; i<n; i++)
+      idx[i] = i;
+
+   wall = perf_ms( prof_elapsed + (prof_active ? perf_ticks() - prof_started : 0) );
+   lua  = 0.;
+   for (i=prof_nodes[PROF_ROOT].child; i>=0; i=prof_nodes[i].next)
+      lua += perf_ms( prof_nodes[i].total );
+   fprintf( f, "Lua profile: %.1f ms in Lua over %.1f ms profiled (%.1f%%)\n\n",
+         lua, wall, (wall > 0.) ? 100. * lua / wall : 0. );
+
+   /* Contexts, that's AI profiles, missions, events and the like. */
+   qsort( idx, n, sizeof(int), prof_cmpTotal );
+   fprintf( f, "%12s %8s %10s %10s  %s\n", "total (ms)", "%", "calls", "avg (us)", "context" );
+   for (i=0; i<n; i++) {
+      fr = &prof_frames[ idx[i] ];
+      if (!fr->ctx)
+         continue;
+      ms = perf_ms( fr->total );
+      fprintf( f, "%12.3f %7.2f%% %10u %10.2f  %s\n", ms,
+            (lua > 0.) ? 100. * ms / lua : 0., fr->calls,
+            (fr->calls > 0) ? 1000. * ms / fr->calls : 0., fr->label );
+   }
+
+   /* Functions. */
+   qsort( idx, n, sizeof(int), prof_cmpSelf );
+   fprintf( f, "\n%12s %8s %12s %10s %10s  %s\n", "self (ms)", "%", "total (ms)", "calls", "avg (us)", "function" );
+   for (i=0; i<n; i++) {
+      fr = &prof_frames[ idx[i] ];
+      if (fr->ctx)
+         continue;
+      ms = perf_ms( fr->self );
+      fprintf( f, "%12.3f %7.2f%% %12.3f %10u %10.2f  %s\n", ms,
+            (lua > 0.) ? 100. * ms / lua : 0., perf_ms( fr->total ), fr->calls,
+            (fr->calls > 0) ? 1000. * perf_ms( fr->total ) / fr->calls : 0., fr->label );
+   }
+
+   free( idx );
+   return 0;
+}
+
+
+/**
+ * @brief Writes the call tree as folded stacks with microsecond counts.
+ */
+static int prof_dumpFolded( FILE *f )
+{
+   int i, j, n, depth, *path;
+   long us;
+
+   n    = array_size( prof_nodes );
+   path = malloc( n * sizeof(int) );
+   for (i=0; i<n; i++) {
+      us = (long)(1000. * perf_ms( prof_nodes[i].self ) + 0.5);
+      if ((prof_nodes[i].frame < 0) || (us <= 0))
+         continue;
+
+      /* Walk up to the root. */
+      depth = 0;
+      for (j=i; prof_nodes[j].frame >= 0; j=prof_nodes[j].parent)
+         path[ depth++ ] = prof_nodes[j].frame;
+      for (j=depth-1; j>=0; j--)
+         fprintf( f, "%s%c", prof_frames[ path[j] ].label, (j>0) ? ';' : ' ' );
+      fprintf( f, "%ld\n", us );
+   }
+   free( path );
+   return 0;
+}
+
+
+/**
+ * @brief Dumps the profiling results.
+ *
+ *    @param path File to write to.
+ *    @param folded Write folded stacks for flamegraph.pl instead of a report.
+ *    @return 0 on success.
+ */
+int nlua_profDump( const char *path, int folded )
+{
+   FILE *f;
+   int ret;
+
+   if (prof_nodes == NULL) {
+      WARN("No Lua profiling data to dump.");
+      return -1;
+   }
+
+   f = fopen( path, "w" );
+   if (f == NULL) {
+      WARN("Unable to open '%s' for writing.", path);
+      return -1;
+   }
+   ret = folded ? prof_dumpFolded( f ) : prof_dumpReport( f );
+   if (fclose( f ) != 0)
+      ret = -1;
+   return ret;
+}
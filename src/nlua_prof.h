@@ -0,0 +1,36 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef NLUA_PROF_H
+#  define NLUA_PROF_H
+
+
+#include <lua.h>
+
+
+/*
+ * Control.
+ */
+void nlua_profStart (void);
+void nlua_profStop (void);
+void nlua_profReset (void);
+void nlua_profFree (void);
+int nlua_profActive (void);
+
+
+/*
+ * Instrumentation.
+ */
+int nlua_profEnter( lua_State *L, const char *ctx, const char *name );
+void nlua_profLeave( lua_State *L, int mark );
+
+
+/*
+ * Output.
+ */
+int nlua_profDump( const char *path, int folded );
+
+
+#endif /* NLUA_PROF_H */
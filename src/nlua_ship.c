@@ -457,6 +457,7 @@ static int shipL_gfxTarget( lua_State *L )
    s  = luaL_validship(L,1);
 
    /* Push graphic. */
+   ship_gfxLoad( s );
    lt.tex = gl_dupTexture( s->gfx_target );
    if (lt.tex == NULL) {
       WARN("Unable to get ship target graphic for '%s'.", s->name);
@@ -487,6 +488,7 @@ static int shipL_gfx( lua_State *L )
    s  = luaL_validship(L,1);
 
    /* Push graphic. */
+   ship_gfxLoad( s );
    lt.tex = gl_dupTexture( s->gfx_space );
    if (lt.tex == NULL) {
       WARN("Unable to get ship graphic for '%s'.", s->name);
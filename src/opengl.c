@@ -238,6 +238,10 @@ GLboolean gl_hasVersion( int major, int minor )
    const char *p;
    double f;
 
+   /* No context to query. */
+   if (gl_has(OPENGL_HEADLESS))
+      return GL_FALSE;
+
    if (gl_contextVersion < 0.) {
       p = (const char*) glGetString(GL_VERSION);
 
@@ -262,6 +266,10 @@ GLboolean gl_hasVersion( int major, int minor )
  */
 GLboolean gl_hasExt( char *name )
 {
+   /* No context to query. */
+   if (gl_has(OPENGL_HEADLESS))
+      return GL_FALSE;
+
 #if SDL_VERSION_ATLEAST(2,0,0)
    return SDL_GL_ExtensionSupported( name );
 #else /* SDL_VERSION_ATLEAST(2,0,0) */
@@ -299,6 +307,9 @@ void gl_checkHandleError( const char *func, int line )
    GLenum err;
    const char* errstr;
 
+   if (gl_has(OPENGL_HEADLESS))
+      return;
+
    err = glGetError();
 
    /* No error. */
@@ -573,9 +584,10 @@ static int gl_getGLInfo (void)
          gl_screen.r, gl_screen.g, gl_screen.b, gl_screen.a,
          gl_has(OPENGL_DOUBLEBUF) ? "yes" : "no",
          gl_screen.fsaa, gl_screen.tex_max);
-   DEBUG("vsync: %s, vbo: %s, mm: %s, compress: %s, npot: %s",
+   DEBUG("vsync: %s, vbo: %s, glsl: %s, mm: %s, compress: %s, npot: %s",
          gl_has(OPENGL_VSYNC) ? "yes" : "no",
          gl_vboIsHW() ? "yes" : "no",
+         gl_shaderIsHW() ? "yes" : "no",
          gl_texHasMipmaps() ? "yes" : "no",
          gl_texHasCompress() ? "yes" : "no",
          gl_needPOT() ? "no" : "yes" );
@@ -758,6 +770,7 @@ int gl_init (void)
    gl_initMatrix();
    gl_initTextures();
    gl_initVBO();
+   gl_initShaders();
    gl_initRender();
 
    /* Get info about the OpenGL window */
@@ -770,6 +783,42 @@ int gl_init (void)
 }
 
 
+/**
+ * @brief Initializes the OpenGL subsystems without opening a window.
+ *
+ * Used by the headless simulation mode. The screen dimensions come from the
+ *  configuration so that everything that depends on them still behaves, but
+ *  there is no context so nothing ever gets uploaded or rendered.
+ *
+ *    @return 0 on success.
+ */
+int gl_initHeadless (void)
+{
+   memset( &gl_screen, 0, sizeof(gl_screen) );
+   gl_screen.flags = OPENGL_HEADLESS;
+   gl_screen.rw    = conf.width;
+   gl_screen.rh    = conf.height;
+   gl_setScale( 1. );
+
+   /* Set up the virtual screen. */
+   gl_setupScaling();
+   gl_setDefViewport( 0, 0, gl_screen.rw, gl_screen.rh );
+
+   /* Initialize subsystems, extensions are never loaded so they all fall back
+    * to their CPU side paths. */
+   gl_initMatrix();
+   gl_initTextures();
+   gl_initVBO();
+   gl_initShaders();
+   gl_initRender();
+
+   DEBUG("OpenGL Headless: %dx%d", SCREEN_W, SCREEN_H);
+   DEBUG("");
+
+   return 0;
+}
+
+
 /**
  * @brief Sets the scale factor.
  *
@@ -851,6 +900,7 @@ void gl_exit (void)
 {
    /* Exit the OpenGL subsystems. */
    gl_exitRender();
+   gl_exitShaders();
    gl_exitVBO();
    gl_exitTextures();
    gl_exitMatrix();
@@ -23,6 +23,7 @@
 #include "opengl_tex.h"
 #include "opengl_matrix.h"
 #include "opengl_vbo.h"
+#include "opengl_shader.h"
 #include "opengl_render.h"
 
 
@@ -47,6 +48,7 @@
 #define OPENGL_FULLSCREEN  (1<<0) /**< Fullscreen. */
 #define OPENGL_DOUBLEBUF   (1<<1) /**< Doublebuffer. */
 #define OPENGL_VSYNC       (1<<2) /**< Sync to monitor vertical refresh rate. */
+#define OPENGL_HEADLESS    (1<<3) /**< No window nor context, nothing gets rendered. */
 #define gl_has(f)    (gl_screen.flags & (f)) /**< Check for the flag */
 /**
  * @brief Stores data about the current opengl environment.
@@ -100,6 +102,7 @@ extern glInfo gl_screen; /* local structure set with gl_init and co */
  * initialization / cleanup
  */
 int gl_init (void);
+int gl_initHeadless (void);
 void gl_exit (void);
 
 
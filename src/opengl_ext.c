@@ -28,7 +28,10 @@ static void* gl_extGetProc( const char *proc );
 static int gl_extVBO (void);
 static int gl_extMultitexture (void);
 static int gl_extMipmaps (void);
+static int gl_extFramebuffers (void);
+static int gl_extBlendFuncSeparate (void);
 static int gl_extCompression (void);
+static int gl_extShaders (void);
 
 
 /**
@@ -157,6 +160,56 @@ static int gl_extMipmaps (void)
 }
 
 
+/**
+ * @brief Tries to load the framebuffer object extension.
+ */
+static int gl_extFramebuffers (void)
+{
+   if (gl_hasVersion( 3, 0 )) {
+      nglGenFramebuffers         = gl_extGetProc("glGenFramebuffers");
+      nglBindFramebuffer         = gl_extGetProc("glBindFramebuffer");
+      nglFramebufferTexture2D    = gl_extGetProc("glFramebufferTexture2D");
+      nglCheckFramebufferStatus  = gl_extGetProc("glCheckFramebufferStatus");
+      nglDeleteFramebuffers      = gl_extGetProc("glDeleteFramebuffers");
+   }
+   else if (gl_hasExt("GL_EXT_framebuffer_object")) {
+      nglGenFramebuffers         = gl_extGetProc("glGenFramebuffersEXT");
+      nglBindFramebuffer         = gl_extGetProc("glBindFramebufferEXT");
+      nglFramebufferTexture2D    = gl_extGetProc("glFramebufferTexture2DEXT");
+      nglCheckFramebufferStatus  = gl_extGetProc("glCheckFramebufferStatusEXT");
+      nglDeleteFramebuffers      = gl_extGetProc("glDeleteFramebuffersEXT");
+   }
+   else {
+      nglGenFramebuffers         = NULL;
+      nglBindFramebuffer         = NULL;
+      nglFramebufferTexture2D    = NULL;
+      nglCheckFramebufferStatus  = NULL;
+      nglDeleteFramebuffers      = NULL;
+      return -1;
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Tries to load separate blending of the alpha channel.
+ */
+static int gl_extBlendFuncSeparate (void)
+{
+   if (gl_hasVersion( 1, 4 ))
+      nglBlendFuncSeparate = gl_extGetProc("glBlendFuncSeparate");
+   else if (gl_hasExt("GL_EXT_blend_func_separate"))
+      nglBlendFuncSeparate = gl_extGetProc("glBlendFuncSeparateEXT");
+   else {
+      nglBlendFuncSeparate = NULL;
+      return -1;
+   }
+
+   return 0;
+}
+
+
 /**
  * @brief Tries to initialize the texture compression.
  */
@@ -206,6 +259,54 @@ static int gl_extCompression (void)
 }
 
 
+/**
+ * @brief Tries to load the OpenGL 2.0 shading language functions.
+ */
+static int gl_extShaders (void)
+{
+   if (conf.shaders && gl_hasVersion( 2, 0 )) {
+      nglCreateShader         = gl_extGetProc("glCreateShader");
+      nglShaderSource         = gl_extGetProc("glShaderSource");
+      nglCompileShader        = gl_extGetProc("glCompileShader");
+      nglGetShaderiv          = gl_extGetProc("glGetShaderiv");
+      nglGetShaderInfoLog     = gl_extGetProc("glGetShaderInfoLog");
+      nglDeleteShader         = gl_extGetProc("glDeleteShader");
+      nglCreateProgram        = gl_extGetProc("glCreateProgram");
+      nglAttachShader         = gl_extGetProc("glAttachShader");
+      nglLinkProgram          = gl_extGetProc("glLinkProgram");
+      nglGetProgramiv         = gl_extGetProc("glGetProgramiv");
+      nglGetProgramInfoLog    = gl_extGetProc("glGetProgramInfoLog");
+      nglUseProgram           = gl_extGetProc("glUseProgram");
+      nglDeleteProgram        = gl_extGetProc("glDeleteProgram");
+      nglGetUniformLocation   = gl_extGetProc("glGetUniformLocation");
+      nglUniform2f            = gl_extGetProc("glUniform2f");
+   }
+   else {
+      nglCreateShader         = NULL;
+      nglShaderSource         = NULL;
+      nglCompileShader        = NULL;
+      nglGetShaderiv          = NULL;
+      nglGetShaderInfoLog     = NULL;
+      nglDeleteShader         = NULL;
+      nglCreateProgram        = NULL;
+      nglAttachShader         = NULL;
+      nglLinkProgram          = NULL;
+      nglGetProgramiv         = NULL;
+      nglGetProgramInfoLog    = NULL;
+      nglUseProgram           = NULL;
+      nglDeleteProgram        = NULL;
+      nglGetUniformLocation   = NULL;
+      nglUniform2f            = NULL;
+      if (conf.shaders) {
+         WARN("OpenGL 2.0 shading language not found!");
+         return -1;
+      }
+   }
+
+   return 0;
+}
+
+
 /**
  * @brief Initializes opengl extensions.
  *
@@ -216,7 +317,10 @@ int gl_initExtensions (void)
    gl_extMultitexture();
    gl_extVBO();
    gl_extMipmaps();
+   gl_extFramebuffers();
+   gl_extBlendFuncSeparate();
    gl_extCompression();
+   gl_extShaders();
 
    return 0;
 }
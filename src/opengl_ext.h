@@ -26,9 +26,36 @@ void* (APIENTRY *nglMapBuffer)(GLenum target, GLenum access);
 void (APIENTRY *nglUnmapBuffer)(GLenum target);
 void (APIENTRY *nglDeleteBuffers)(GLsizei n, const GLuint* ids);
 
+/* GL_EXT_framebuffer_object */
+void (APIENTRY *nglGenFramebuffers)(GLsizei n, GLuint* ids);
+void (APIENTRY *nglBindFramebuffer)(GLenum target, GLuint id);
+void (APIENTRY *nglFramebufferTexture2D)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+GLenum (APIENTRY *nglCheckFramebufferStatus)(GLenum target);
+void (APIENTRY *nglDeleteFramebuffers)(GLsizei n, const GLuint* ids);
+
+/* GL_EXT_blend_func_separate */
+void (APIENTRY *nglBlendFuncSeparate)(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+
 /* GL_ARB_texture_compression */
 void (APIENTRY *nglCompressedTexImage2D)(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei, const GLvoid *);
 
+/* OpenGL 2.0 shading language */
+GLuint (APIENTRY *nglCreateShader)(GLenum type);
+void (APIENTRY *nglShaderSource)(GLuint shader, GLsizei count, const GLchar **string, const GLint *length);
+void (APIENTRY *nglCompileShader)(GLuint shader);
+void (APIENTRY *nglGetShaderiv)(GLuint shader, GLenum pname, GLint *params);
+void (APIENTRY *nglGetShaderInfoLog)(GLuint shader, GLsizei maxLength, GLsizei *length, GLchar *infoLog);
+void (APIENTRY *nglDeleteShader)(GLuint shader);
+GLuint (APIENTRY *nglCreateProgram)(void);
+void (APIENTRY *nglAttachShader)(GLuint program, GLuint shader);
+void (APIENTRY *nglLinkProgram)(GLuint program);
+void (APIENTRY *nglGetProgramiv)(GLuint program, GLenum pname, GLint *params);
+void (APIENTRY *nglGetProgramInfoLog)(GLuint program, GLsizei maxLength, GLsizei *length, GLchar *infoLog);
+void (APIENTRY *nglUseProgram)(GLuint program);
+void (APIENTRY *nglDeleteProgram)(GLuint program);
+GLint (APIENTRY *nglGetUniformLocation)(GLuint program, const GLchar *name);
+void (APIENTRY *nglUniform2f)(GLint location, GLfloat v0, GLfloat v1);
+
 
 /*
  * Initializes the extensions.
@@ -0,0 +1,206 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file opengl_shader.c
+ *
+ * @brief Handles OpenGL GLSL shader programs.
+ *
+ * Shaders are optional, everything using them must have a fixed function
+ *  fallback for when gl_shaderIsHW() is false or compilation fails.
+ */
+
+
+#include "opengl.h"
+
+#include "naev.h"
+
+#include "log.h"
+
+
+static int has_glsl = 0; /**< Whether or not GLSL is available. */
+
+
+/*
+ * Prototypes.
+ */
+static GLuint gl_shaderCompile( const char *name, GLenum type, const char *src );
+
+
+/**
+ * @brief Initializes the OpenGL shader subsystem.
+ *
+ *    @return 0 on success.
+ */
+int gl_initShaders (void)
+{
+   if (nglCreateProgram != NULL)
+      has_glsl = 1;
+
+   return 0;
+}
+
+
+/**
+ * @brief Exits the OpenGL shader subsystem.
+ */
+void gl_exitShaders (void)
+{
+   has_glsl = 0;
+}
+
+
+/**
+ * @brief Compiles a single shader stage.
+ *
+ *    @param name Name of the program (for error messages).
+ *    @param type Either GL_VERTEX_SHADER or GL_FRAGMENT_SHADER.
+ *    @param src Source of the shader.
+ *    @return The shader or 0 on error.
+ */
+static GLuint gl_shaderCompile( const char *name, GLenum type, const char *src )
+{
+   GLuint shader;
+   GLint status, len;
+   GLchar *log;
+
+   shader = nglCreateShader( type );
+   nglShaderSource( shader, 1, &src, NULL );
+   nglCompileShader( shader );
+
+   nglGetShaderiv( shader, GL_COMPILE_STATUS, &status );
+   if (status != GL_TRUE) {
+      nglGetShaderiv( shader, GL_INFO_LOG_LENGTH, &len );
+      log = malloc( len+1 );
+      nglGetShaderInfoLog( shader, len, NULL, log );
+      log[len] = '\0';
+      WARN("Shader '%s' failed to compile:\n%s", name, log);
+      free(log);
+      nglDeleteShader( shader );
+      return 0;
+   }
+
+   return shader;
+}
+
+
+/**
+ * @brief Creates a shader program.
+ *
+ *    @param name Name of the program (for error messages).
+ *    @param vert Vertex shader source or NULL to use the fixed function one.
+ *    @param frag Fragment shader source or NULL to use the fixed function one.
+ *    @return The program or 0 if shaders are unavailable or on error.
+ */
+GLuint gl_shaderCreate( const char *name, const char *vert, const char *frag )
+{
+   GLuint program, vs, fs;
+   GLint status, len;
+   GLchar *log;
+
+   if (!has_glsl)
+      return 0;
+
+   /* Compile the stages. */
+   vs = 0;
+   fs = 0;
+   if (vert != NULL) {
+      vs = gl_shaderCompile( name, GL_VERTEX_SHADER, vert );
+      if (vs == 0)
+         return 0;
+   }
+   if (frag != NULL) {
+      fs = gl_shaderCompile( name, GL_FRAGMENT_SHADER, frag );
+      if (fs == 0) {
+         if (vs != 0)
+            nglDeleteShader( vs );
+         return 0;
+      }
+   }
+
+   /* Link. */
+   program = nglCreateProgram();
+   if (vs != 0)
+      nglAttachShader( program, vs );
+   if (fs != 0)
+      nglAttachShader( program, fs );
+   nglLinkProgram( program );
+
+   /* Shaders are reference counted by the program now. */
+   if (vs != 0)
+      nglDeleteShader( vs );
+   if (fs != 0)
+      nglDeleteShader( fs );
+
+   nglGetProgramiv( program, GL_LINK_STATUS, &status );
+   if (status != GL_TRUE) {
+      nglGetProgramiv( program, GL_INFO_LOG_LENGTH, &len );
+      log = malloc( len+1 );
+      nglGetProgramInfoLog( program, len, NULL, log );
+      log[len] = '\0';
+      WARN("Shader '%s' failed to link:\n%s", name, log);
+      free(log);
+      nglDeleteProgram( program );
+      return 0;
+   }
+
+   /* Check for errors. */
+   gl_checkErr();
+
+   return program;
+}
+
+
+/**
+ * @brief Destroys a shader program.
+ *
+ *    @param program Program to destroy.
+ */
+void gl_shaderDestroy( GLuint program )
+{
+   if (has_glsl && (program != 0))
+      nglDeleteProgram( program );
+}
+
+
+/**
+ * @brief Activates a shader program.
+ *
+ *    @param program Program to use or 0 to go back to fixed function.
+ */
+void gl_shaderUse( GLuint program )
+{
+   if (has_glsl)
+      nglUseProgram( program );
+}
+
+
+/**
+ * @brief Gets the location of a uniform.
+ *
+ *    @param program Program to get uniform of.
+ *    @param name Name of the uniform.
+ *    @return Location of the uniform or -1 if not found.
+ */
+GLint gl_shaderUniform( GLuint program, const char *name )
+{
+   GLint loc;
+
+   loc = nglGetUniformLocation( program, name );
+   if (loc < 0)
+      WARN("Shader uniform '%s' not found.", name);
+
+   return loc;
+}
+
+
+/**
+ * @brief Checks to see if shaders are available.
+ *
+ *    @return 1 if GLSL shaders can be used.
+ */
+int gl_shaderIsHW (void)
+{
+   return has_glsl;
+}
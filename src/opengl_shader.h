@@ -0,0 +1,40 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef OPENGL_SHADER_H
+#  define OPENGL_SHADER_H
+
+
+#include "opengl.h"
+
+
+/*
+ * Init/cleanup.
+ */
+int gl_initShaders (void);
+void gl_exitShaders (void);
+
+
+/*
+ * Create/destroy.
+ */
+GLuint gl_shaderCreate( const char *name, const char *vert, const char *frag );
+void gl_shaderDestroy( GLuint program );
+
+
+/*
+ * Usage.
+ */
+void gl_shaderUse( GLuint program );
+GLint gl_shaderUniform( GLuint program, const char *name );
+
+
+/*
+ * Info.
+ */
+int gl_shaderIsHW (void);
+
+
+#endif /* OPENGL_SHADER_H */
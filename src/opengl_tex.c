@@ -23,6 +23,7 @@
 #include "gui.h"
 #include "conf.h"
 #include "npng.h"
+#include "texcache.h"
 
 
 /*
@@ -55,6 +56,8 @@ static uint8_t* SDL_MapTrans( SDL_Surface* s, int w, int h );
 /* glTexture */
 static GLuint gl_loadSurface( SDL_Surface* surface, int *rw, int *rh, unsigned int flags, int freesur );
 static glTexture* gl_loadNewImage( const char* path, unsigned int flags );
+static glTexture* gl_texCreate( const char *name, SDL_Surface* surface, uint8_t *trans,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur );
 /* List. */
 static glTexture* gl_texExists( const char* path );
 static int gl_texAdd( glTexture *tex );
@@ -307,6 +310,13 @@ static GLuint gl_loadSurface( SDL_Surface* surface, int *rw, int *rh, unsigned i
    if (rh != NULL)
       (*rh) = surface->h;
 
+   /* Nowhere to upload to. */
+   if (gl_has(OPENGL_HEADLESS)) {
+      if (freesur)
+         SDL_FreeSurface( surface );
+      return 0;
+   }
+
    /* opengl texture binding */
    glGenTextures( 1, &texture ); /* Creates the texture */
    glBindTexture( GL_TEXTURE_2D, texture ); /* Loads the texture */
@@ -379,7 +389,6 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
       unsigned int flags, int w, int h, int sx, int sy, int freesur )
 {
    glTexture *texture;
-   int rw, rh;
    uint8_t *trans;
 
    /* Make sure doesn't already exist. */
@@ -389,9 +398,6 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
          return texture;
    }
 
-   /* set up the texture defaults */
-   texture = calloc( 1, sizeof(glTexture) );
-
    /* Map transparency if needed .*/
    if (flags & OPENGL_TEX_MAPTRANS) {
       SDL_LockSurface(surface);
@@ -401,6 +407,57 @@ glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
    else
       trans = NULL;
 
+   return gl_texCreate( name, surface, trans, flags, w, h, sx, sy, freesur );
+}
+
+
+/**
+ * @brief Loads the already padded SDL_Surface to a glTexture with an already
+ *        mapped transparency.
+ *
+ *    @param name Name to load with.
+ *    @param surface Surface to load.
+ *    @param trans Transparency map, texture takes ownership of it.
+ *    @param flags Flags to use.
+ *    @param w Non-padded width.
+ *    @param h Non-padded height.
+ *    @param sx X sprites.
+ *    @param sy Y sprites.
+ *    @param freesur Whether or not to free the surface.
+ *    @return The glTexture for surface.
+ */
+glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, uint8_t *trans,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur )
+{
+   glTexture *texture;
+
+   /* Make sure doesn't already exist. */
+   if (name != NULL) {
+      texture = gl_texExists( name );
+      if (texture != NULL) {
+         free(trans);
+         if (freesur)
+            SDL_FreeSurface( surface );
+         return texture;
+      }
+   }
+
+   return gl_texCreate( name, surface, trans, flags, w, h, sx, sy, freesur );
+}
+
+
+/**
+ * @brief Creates a texture from a padded surface and adds it to the list.
+ */
+static glTexture* gl_texCreate( const char *name, SDL_Surface* surface, uint8_t *trans,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur )
+{
+   glTexture *texture;
+   int rw, rh;
+
+   /* set up the texture defaults */
+   texture = calloc( 1, sizeof(glTexture) );
+
    texture->w     = (double) w;
    texture->h     = (double) h;
    texture->sx    = (double) sx;
@@ -525,17 +582,34 @@ static glTexture* gl_loadNewImage( const char* path, const unsigned int flags )
    png_uint_32 w, h;
    int sx, sy;
    char *str;
-   int len;
+   int len, cache;
+   void *data;
+   uint32_t size;
+   TexCacheKey key;
+   TexCacheImg img;
+   glTexture *texture;
+
+   /* Only worth caching when there's more to do than decoding, only the
+    * transparency map depends on the flags. */
+   cache = (flags & (OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS)) &&
+         (texcache_key( &key, path, "image", flags & OPENGL_TEX_MAPTRANS ) == 0);
+   if (cache && (texcache_load( &key, &img, 1 ) == 0))
+      return gl_loadImagePadTrans( path, img.surface, img.trans, flags,
+            img.w, img.h, img.sx, img.sy, 1 );
 
    /* load from packfile */
-   rw = ndata_rwops( path );
-   if (rw == NULL) {
+   data = ndata_read( path, &size );
+   if (data == NULL) {
       WARN("Failed to load surface '%s' from ndata.", path);
       return NULL;
    }
+
+   rw = SDL_RWFromConstMem( data, size );
    npng     = npng_open( rw );
    if (npng == NULL) {
       WARN("File '%s' is not a png.", path );
+      SDL_RWclose( rw );
+      free( data );
       return NULL;
    }
    npng_dim( npng, &w, &h );
@@ -550,13 +624,33 @@ static glTexture* gl_loadNewImage( const char* path, const unsigned int flags )
    surface  = npng_readSurface( npng, gl_needPOT(), 1 );
    npng_close( npng );
    SDL_RWclose( rw );
+   free( data );
    if (surface == NULL) {
       WARN("'%s' could not be opened", path );
       return NULL;
    }
 
-   /* set the texture */
-   return gl_loadImagePad( path, surface, flags, w, h, sx, sy, 1 );
+   /* set the texture, surface is already padded so it's kept as is. */
+   texture = gl_loadImagePad( path, surface, flags, w, h, sx, sy, 0 );
+   if (texture == NULL) {
+      SDL_FreeSurface( surface );
+      return NULL;
+   }
+
+   /* Store for next time. */
+   if (cache) {
+      img.w       = w;
+      img.h       = h;
+      img.sx      = sx;
+      img.sy      = sy;
+      img.surface = surface;
+      img.trans   = texture->trans;
+      img.ntrans  = (texture->trans != NULL) ? (w*h+7)/8 : 0;
+      texcache_save( &key, &img, 1 );
+   }
+
+   SDL_FreeSurface( surface );
+   return texture;
 }
 
 
@@ -611,7 +705,8 @@ void gl_freeTexture( glTexture* texture )
          cur->used--;
          if (cur->used <= 0) { /* not used anymore */
             /* free the texture */
-            glDeleteTextures( 1, &texture->texture );
+            if (texture->texture != 0)
+               glDeleteTextures( 1, &texture->texture );
             if (texture->trans != NULL)
                free(texture->trans);
             if (texture->name != NULL)
@@ -639,7 +734,8 @@ void gl_freeTexture( glTexture* texture )
       WARN("Attempting to free texture '%s' not found in stack!", texture->name);
 
    /* Free anyways */
-   glDeleteTextures( 1, &texture->texture );
+   if (texture->texture != 0)
+      glDeleteTextures( 1, &texture->texture );
    if (texture->trans != NULL)
       free(texture->trans);
    if (texture->name != NULL)
@@ -88,6 +88,8 @@ SDL_Surface* gl_prepareSurface( SDL_Surface* surface ); /* Only preps it */
  */
 glTexture* gl_loadImagePad( const char *name, SDL_Surface* surface,
       unsigned int flags, int w, int h, int sx, int sy, int freesur );
+glTexture* gl_loadImagePadTrans( const char *name, SDL_Surface* surface, uint8_t *trans,
+      unsigned int flags, int w, int h, int sx, int sy, int freesur );
 glTexture* gl_loadImage( SDL_Surface* surface, const unsigned int flags ); /* Frees the surface. */
 glTexture* gl_newImage( const char* path, const unsigned int flags );
 glTexture* gl_newSprite( const char* path, const int sx, const int sy,
@@ -542,6 +542,56 @@ glTexture* outfit_gfx( const Outfit* o )
    else if (outfit_isAmmo(o)) return o->u.amm.gfx_space;
    return NULL;
 }
+
+
+/**
+ * @brief Gets the outfit's store graphic, loading it if needed.
+ *
+ * Store graphics are only needed in a few windows, so they get decoded the
+ *  first time they are shown instead of at startup.
+ *
+ *    @param o Outfit to get information from.
+ *    @return The store graphic or NULL if it can't be loaded.
+ */
+glTexture* outfit_gfxStore( const Outfit* o )
+{
+   Outfit *lo;
+
+   if ((o->gfx_store != NULL) || (o->gfx_store_path == NULL))
+      return o->gfx_store;
+
+   /* Loading is just caching, the outfit doesn't really change. */
+   lo = (Outfit*) o;
+   lo->gfx_store = gl_newImage( lo->gfx_store_path, OPENGL_TEX_MIPMAPS );
+   if (lo->gfx_store == NULL) {
+      WARN("Outfit '%s' unable to load store graphic '%s'.", lo->name, lo->gfx_store_path);
+      free( lo->gfx_store_path );
+      lo->gfx_store_path = NULL;
+   }
+   return lo->gfx_store;
+}
+
+
+/**
+ * @brief Gets a new reference to the outfit's store graphic.
+ *
+ * Unlike outfit_gfxStore() the outfit doesn't keep the graphic loaded, so it
+ *  gets freed as soon as the returned reference is freed unless something
+ *  else is using it.
+ *
+ *    @param o Outfit to get information from.
+ *    @return New reference to the store graphic, free with gl_freeTexture().
+ */
+glTexture* outfit_gfxStoreRef( const Outfit* o )
+{
+   if (o->gfx_store != NULL)
+      return gl_dupTexture( o->gfx_store );
+   if (o->gfx_store_path == NULL)
+      return NULL;
+   return gl_newImage( o->gfx_store_path, OPENGL_TEX_MIPMAPS );
+}
+
+
 /**
  * @brief Gets the outfit's sound effect.
  *    @param o Outfit to get information from.
@@ -2004,6 +2054,7 @@ static int outfit_parse( Outfit* temp, const char* file )
    char *prop;
    const char *cprop;
    uint32_t bufsize;
+   char str[PATH_MAX];
    char *buf = ndata_read( file, &bufsize );
 
    xmlDocPtr doc = xmlParseMemory( buf, bufsize );
@@ -2040,8 +2091,11 @@ static int outfit_parse( Outfit* temp, const char* file )
             xmlr_strd(cur,"description",temp->description);
             xmlr_strd(cur,"typename",temp->typename);
             if (xml_isNode(cur,"gfx_store")) {
-               temp->gfx_store = xml_parseTexture( cur,
-                     OUTFIT_GFX_PATH"store/%s.png", 1, 1, OPENGL_TEX_MIPMAPS );
+               /* Only remember the path, it gets loaded on demand. */
+               if (xml_get(cur) != NULL) {
+                  nsnprintf( str, sizeof(str), OUTFIT_GFX_PATH"store/%s.png", xml_get(cur) );
+                  temp->gfx_store_path = strdup( str );
+               }
                continue;
             }
             else if (xml_isNode(cur,"slot")) {
@@ -2132,7 +2186,7 @@ if (o) WARN("Outfit '%s' missing/invalid '"s"' element", temp->name) /**< Define
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->slot.type==OUTFIT_SLOT_NULL,"slot");
    MELEMENT((temp->slot.type!=OUTFIT_SLOT_NA) && (temp->slot.size==OUTFIT_SLOT_SIZE_NA),"size");
-   MELEMENT(temp->gfx_store==NULL,"gfx_store");
+   MELEMENT(temp->gfx_store_path==NULL,"gfx_store");
    /*MELEMENT(temp->mass==0,"mass"); Not really needed */
    MELEMENT(temp->type==0,"type");
    /*MELEMENT(temp->price==0,"price");*/
@@ -2324,6 +2378,7 @@ void outfit_free (void)
       free(o->name);
       if (o->gfx_store)
          gl_freeTexture(o->gfx_store);
+      free(o->gfx_store_path);
    }
 
    array_free(outfit_stack);
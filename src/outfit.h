@@ -328,7 +328,8 @@ typedef struct Outfit_ {
    char *description; /**< Store description. */
    char *desc_short; /**< Short outfit description. */
 
-   glTexture* gfx_store; /**< Store graphic. */
+   char *gfx_store_path; /**< Path of the store graphic, NULL if it failed to load. */
+   glTexture* gfx_store; /**< Store graphic, use outfit_gfxStore() as it's loaded on demand. */
 
    unsigned int properties; /**< Properties stored bitwise. */
 
@@ -395,6 +396,8 @@ const char *slotSize( const OutfitSlotSize o );
 const glColour *outfit_slotSizeColour( const OutfitSlot* os );
 OutfitSlotSize outfit_toSlotSize( const char *s );
 glTexture* outfit_gfx( const Outfit* o );
+glTexture* outfit_gfxStore( const Outfit* o );
+glTexture* outfit_gfxStoreRef( const Outfit* o );
 int outfit_spfxArmour( const Outfit* o );
 int outfit_spfxShield( const Outfit* o );
 const Damage *outfit_damage( const Outfit* o );
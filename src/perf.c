@@ -0,0 +1,420 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file perf.c
+ *
+ * @brief Times the stages of every frame.
+ *
+ * The main loop brackets each stage with perf_begin() and perf_end(), time
+ *  adds up per frame and the last PERF_HISTORY frames are kept to give the
+ *  min/avg/p99 shown in the overlay. Frames can also be recorded as a Chrome
+ *  trace (chrome://tracing or ui.perfetto.dev) to find out what is behind
+ *  spikes. Nothing gets timed unless the overlay is shown or a trace is being
+ *  recorded.
+ */
+
+
+#include "perf.h"
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "nstring.h"
+
+#include "SDL.h"
+
+#include "log.h"
+#include "conf.h"
+#include "font.h"
+#include "array.h"
+
+
+#define PERF_HISTORY       300 /**< Frames the stats are taken over. */
+#define PERF_STATS_EVERY   30 /**< Frames between stat updates. */
+#define PERF_TRACE_FRAMES  3600 /**< Maximum frames to trace at once. */
+
+
+/**
+ * @brief Stats of a zone over the last frames.
+ */
+typedef struct PerfStat_ {
+   double min; /**< Minimum ms. */
+   double avg; /**< Average ms. */
+   double p99; /**< 99th percentile ms. */
+} PerfStat;
+
+
+/**
+ * @brief A zone run stored for the trace.
+ */
+typedef struct PerfEvent_ {
+   PerfZone zone; /**< Zone that ran. */
+   uint64_t start; /**< Ticks when it started. */
+   uint64_t end; /**< Ticks when it ended. */
+} PerfEvent;
+
+
+/**
+ * @brief Names of the zones, indented by nesting for the overlay.
+ */
+static const char *perf_names[PERF_ZONES] = {
+   "frame",
+   " update",
+   "  space",
+   "  weapons",
+   "  spfx",
+   "  pilots",
+   "  camera",
+   "  hooks",
+   " render",
+   "  space",
+   "  weapons",
+   "  pilots",
+   "  spfx",
+   "  overlay",
+   "  gui",
+   " toolkit",
+   " swap"
+};
+
+
+static int perf_active              = 0; /**< Timing this frame. */
+static int perf_enabled             = 0; /**< Timing even with no overlay nor trace. */
+static uint64_t perf_start[PERF_ZONES]; /**< When the zones were last entered. */
+static uint64_t perf_acc[PERF_ZONES]; /**< Ticks spent in the zones this frame. */
+static float perf_hist[PERF_ZONES][PERF_HISTORY]; /**< Past frames in ms. */
+static int perf_hpos                = 0; /**< Next history position. */
+static int perf_hn                  = 0; /**< Frames in the history. */
+static int perf_age                 = 0; /**< Frames since the stats were updated. */
+static PerfStat perf_stats[PERF_ZONES]; /**< Current stats. */
+static PerfEvent *perf_events       = NULL; /**< Trace being recorded. */
+static int perf_traceNext           = 0; /**< Frames to trace starting next frame. */
+static int perf_traceLeft           = 0; /**< Frames left to trace. */
+static uint64_t perf_traceBase      = 0; /**< Ticks the trace started at. */
+static char *perf_tracePath         = NULL; /**< Where to save the trace. */
+
+
+/*
+ * Prototypes.
+ */
+static int perf_cmpFloat( const void *p1, const void *p2 );
+static void perf_updateStats (void);
+static int perf_traceSave (void);
+
+
+/**
+ * @brief Gets the current timer ticks.
+ *
+ * Uses the high resolution counter if available, only differences between
+ *  ticks are meaningful.
+ *
+ *    @return Current ticks, convert differences with perf_ms().
+ */
+uint64_t perf_ticks (void)
+{
+#if SDL_VERSION_ATLEAST(2,0,0)
+   return SDL_GetPerformanceCounter();
+#else /* SDL_VERSION_ATLEAST(2,0,0) */
+   return SDL_GetTicks();
+#endif /* SDL_VERSION_ATLEAST(2,0,0) */
+}
+
+
+/**
+ * @brief Converts timer ticks to milliseconds.
+ *
+ *    @param ticks Ticks from perf_ticks() to convert.
+ *    @return Milliseconds the ticks correspond to.
+ */
+double perf_ms( uint64_t ticks )
+{
+#if SDL_VERSION_ATLEAST(2,0,0)
+   return 1000. * (double)ticks / (double)SDL_GetPerformanceFrequency();
+#else /* SDL_VERSION_ATLEAST(2,0,0) */
+   return (double)ticks;
+#endif /* SDL_VERSION_ATLEAST(2,0,0) */
+}
+
+
+/**
+ * @brief Cleans up the frame timing.
+ */
+void perf_exit (void)
+{
+   if (perf_events != NULL) {
+      array_free( perf_events );
+      perf_events = NULL;
+   }
+   free( perf_tracePath );
+   perf_tracePath = NULL;
+   perf_traceNext = 0;
+   perf_traceLeft = 0;
+}
+
+
+/**
+ * @brief Keeps timing frames when nothing is shown nor traced.
+ *
+ *    @param enable Whether to always time frames.
+ */
+void perf_enable( int enable )
+{
+   perf_enabled = enable;
+}
+
+
+/**
+ * @brief Starts timing a frame.
+ */
+void perf_frameBegin (void)
+{
+   /* Traces always start with a full frame. */
+   if (perf_traceNext > 0) {
+      perf_traceLeft = perf_traceNext;
+      perf_traceNext = 0;
+      perf_traceBase = perf_ticks();
+   }
+
+   perf_active = conf.perf_show || perf_enabled || (perf_traceLeft > 0);
+   if (!perf_active)
+      return;
+
+   memset( perf_acc, 0, sizeof(perf_acc) );
+   perf_begin( PERF_FRAME );
+}
+
+
+/**
+ * @brief Finishes timing a frame.
+ */
+void perf_frameEnd (void)
+{
+   int i;
+
+   if (!perf_active)
+      return;
+   perf_end( PERF_FRAME );
+
+   /* Store in the history. */
+   for (i=0; i<PERF_ZONES; i++)
+      perf_hist[i][ perf_hpos ] = perf_ms( perf_acc[i] );
+   perf_hpos = (perf_hpos+1) % PERF_HISTORY;
+   perf_hn   = MIN( perf_hn+1, PERF_HISTORY );
+
+   /* Sorting every frame would be a waste. */
+   if ((++perf_age >= PERF_STATS_EVERY) || (perf_hn < PERF_STATS_EVERY)) {
+      perf_updateStats();
+      perf_age = 0;
+   }
+
+   /* Finish trace. */
+   if ((perf_traceLeft > 0) && (--perf_traceLeft == 0))
+      perf_traceSave();
+}
+
+
+/**
+ * @brief Enters a zone.
+ *
+ * Zones can be entered more than once a frame, the time adds up.
+ *
+ *    @param zone Zone being entered.
+ */
+void perf_begin( PerfZone zone )
+{
+   if (!perf_active)
+      return;
+   perf_start[zone] = perf_ticks();
+}
+
+
+/**
+ * @brief Leaves a zone.
+ *
+ *    @param zone Zone being left.
+ */
+void perf_end( PerfZone zone )
+{
+   uint64_t now;
+   PerfEvent *ev;
+
+   if (!perf_active)
+      return;
+
+   now = perf_ticks();
+   perf_acc[zone] += now - perf_start[zone];
+
+   if (perf_traceLeft > 0) {
+      ev = &array_grow( &perf_events );
+      ev->zone  = zone;
+      ev->start = perf_start[zone];
+      ev->end   = now;
+   }
+}
+
+
+/**
+ * @brief Gets the time spent in a zone during the last timed frame.
+ *
+ *    @param zone Zone to get.
+ *    @return Milliseconds spent in the zone.
+ */
+double perf_last( PerfZone zone )
+{
+   if (perf_hn == 0)
+      return 0.;
+   return perf_hist[zone][ (perf_hpos+PERF_HISTORY-1) % PERF_HISTORY ];
+}
+
+
+/**
+ * @brief Compares floats for qsort.
+ */
+static int perf_cmpFloat( const void *p1, const void *p2 )
+{
+   float f1, f2;
+   f1 = *(const float*)p1;
+   f2 = *(const float*)p2;
+   if (f1 < f2)
+      return -1;
+   else if (f1 > f2)
+      return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Updates the stats from the history.
+ */
+static void perf_updateStats (void)
+{
+   float buf[PERF_HISTORY];
+   double sum;
+   int i, j;
+
+   for (i=0; i<PERF_ZONES; i++) {
+      memcpy( buf, perf_hist[i], perf_hn * sizeof(float) );
+      qsort( buf, perf_hn, sizeof(float), perf_cmpFloat );
+      sum = 0.;
+      for (j=0; j<perf_hn; j++)
+         sum += buf[j];
+      perf_stats[i].min = buf[0];
+      perf_stats[i].avg = sum / (double)perf_hn;
+      perf_stats[i].p99 = buf[ (int)ceil( 0.99 * perf_hn ) - 1 ];
+   }
+}
+
+
+/**
+ * @brief Renders the frame timing overlay.
+ *
+ *    @param x X position to render at.
+ *    @param y Y position of the first line.
+ *    @return Y position below the overlay.
+ */
+double perf_render( double x, double y )
+{
+   int i;
+   double w;
+
+   if (perf_hn == 0)
+      return y;
+
+   w = gl_printWidthRaw( &gl_smallFont, "0000.00" ) + 5.;
+   gl_print( &gl_smallFont, x+80., y, NULL, "min" );
+   gl_print( &gl_smallFont, x+80.+w, y, NULL, "avg" );
+   gl_print( &gl_smallFont, x+80.+2.*w, y, NULL, "p99 ms" );
+   y -= gl_smallFont.h + 3.;
+   for (i=0; i<PERF_ZONES; i++) {
+      gl_print( &gl_smallFont, x, y, NULL, "%s", perf_names[i] );
+      gl_print( &gl_smallFont, x+80., y, NULL, "%.2f", perf_stats[i].min );
+      gl_print( &gl_smallFont, x+80.+w, y, NULL, "%.2f", perf_stats[i].avg );
+      gl_print( &gl_smallFont, x+80.+2.*w, y, NULL, "%.2f", perf_stats[i].p99 );
+      y -= gl_smallFont.h + 3.;
+   }
+   return y - 2.;
+}
+
+
+/**
+ * @brief Starts recording a Chrome trace from the next frame on.
+ *
+ *    @param frames Number of frames to record.
+ *    @param path Where to save the trace once done.
+ *    @return 0 on success.
+ */
+int perf_traceStart( int frames, const char *path )
+{
+   if (perf_tracing()) {
+      WARN("Already recording a frame trace.");
+      return -1;
+   }
+   if ((frames <= 0) || (frames > PERF_TRACE_FRAMES)) {
+      WARN("Frame traces must be between 1 and %d frames long.", PERF_TRACE_FRAMES);
+      return -1;
+   }
+
+   if (perf_events == NULL)
+      perf_events = array_create( PerfEvent );
+   array_resize( &perf_events, 0 );
+   free( perf_tracePath );
+   perf_tracePath = strdup( path );
+   perf_traceNext = frames;
+   return 0;
+}
+
+
+/**
+ * @brief Checks to see if a trace is being recorded.
+ */
+int perf_tracing (void)
+{
+   return (perf_traceNext > 0) || (perf_traceLeft > 0);
+}
+
+
+/**
+ * @brief Saves the recorded trace in the Chrome trace event format.
+ */
+static int perf_traceSave (void)
+{
+   FILE *f;
+   int i, n;
+   PerfEvent *ev;
+
+   f = fopen( perf_tracePath, "w" );
+   if (f == NULL) {
+      WARN("Unable to open '%s' for writing.", perf_tracePath);
+      return -1;
+   }
+
+   /* All times in microseconds. */
+   n = array_size( perf_events );
+   fprintf( f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+   fprintf( f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}" );
+   for (i=0; i<n; i++) {
+      ev = &perf_events[i];
+      fprintf( f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+            &perf_names[ ev->zone ][ strspn( perf_names[ ev->zone ], " " ) ],
+            ((ev->zone > PERF_UPDATE) && (ev->zone < PERF_RENDER)) ? "update" :
+               ((ev->zone > PERF_RENDER) && (ev->zone < PERF_TOOLKIT)) ? "render" : "frame",
+            1000. * perf_ms( ev->start - perf_traceBase ),
+            1000. * perf_ms( ev->end - ev->start ) );
+   }
+   fprintf( f, "\n]}\n" );
+
+   if (fclose( f ) != 0) {
+      WARN("Unable to write frame trace '%s'.", perf_tracePath);
+      return -1;
+   }
+   LOG("Saved %d frame trace events to '%s'.", n, perf_tracePath);
+
+   array_resize( &perf_events, 0 );
+   array_shrink( &perf_events );
+   return 0;
+}
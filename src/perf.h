@@ -0,0 +1,65 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef PERF_H
+#  define PERF_H
+
+
+#include <stdint.h>
+
+
+/**
+ * @brief Timed stages of a frame.
+ */
+typedef enum PerfZone_ {
+   PERF_FRAME, /**< Whole frame, not counting the frame limiter. */
+   PERF_UPDATE, /**< All the updates. */
+   PERF_SPACE_UPDATE, /**< space_update() */
+   PERF_WEAPONS_UPDATE, /**< weapons_update() */
+   PERF_SPFX_UPDATE, /**< spfx_update() */
+   PERF_PILOTS_UPDATE, /**< pilots_update() */
+   PERF_CAM_UPDATE, /**< cam_update() */
+   PERF_HOOKS, /**< Hooks run at the end of the update. */
+   PERF_RENDER, /**< All the rendering. */
+   PERF_SPACE_RENDER, /**< Stars, nebula and planets. */
+   PERF_WEAPONS_RENDER, /**< Both weapon layers. */
+   PERF_PILOTS_RENDER, /**< Pilots including the player. */
+   PERF_SPFX_RENDER, /**< All spfx layers. */
+   PERF_OVERLAY_RENDER, /**< Space and pilot overlays. */
+   PERF_GUI_RENDER, /**< GUI and overlay map. */
+   PERF_TOOLKIT, /**< Toolkit windows. */
+   PERF_SWAP, /**< Buffer swap, generally waiting for the GPU or vsync. */
+   PERF_ZONES /**< Number of zones, not a zone. */
+} PerfZone;
+
+
+/*
+ * Init/exit.
+ */
+void perf_exit (void);
+void perf_enable( int enable );
+
+
+/*
+ * Timing.
+ */
+uint64_t perf_ticks (void);
+double perf_ms( uint64_t ticks );
+void perf_frameBegin (void);
+void perf_frameEnd (void);
+void perf_begin( PerfZone zone );
+void perf_end( PerfZone zone );
+double perf_last( PerfZone zone );
+
+
+/*
+ * Output.
+ */
+double perf_render( double x, double y );
+int perf_traceStart( int frames, const char *path );
+int perf_tracing (void);
+
+
+#endif /* PERF_H */
@@ -38,6 +38,10 @@
  * @note Tried to optimize a while back with SSE and the works, but because
  *       of the nature of how it's implemented in non-linear fashion it just
  *       wound up complicating the code without actually making it faster.
+ *       The nebula generation gets around that by evaluating runs of pixels
+ *       of the same row at once: they share the y and z lattice coordinates
+ *       so only the table lookups are per pixel and all the arithmetic can
+ *       be done on vectors (SSE or AVX depending on how it's compiled).
  */
 
 
@@ -60,6 +64,19 @@
 
 #define SIMPLEX_SCALE 0.5f
 
+#define NOISE_TILE_ROWS    32 /**< Rows of a layer each nebula job handles. */
+
+/*
+ * Vector width of the row kernel, the compiler lowers the vector extensions
+ *  to whatever the target supports, down to plain scalar code.
+ */
+#if defined(__AVX__)
+#define NOISE_LANES        8 /**< Pixels evaluated at once. */
+#else /* defined(__AVX__) */
+#define NOISE_LANES        4 /**< Pixels evaluated at once. */
+#endif /* defined(__AVX__) */
+typedef float noise_vec __attribute__ ((vector_size (NOISE_LANES*sizeof(float)))); /**< Vector of pixels. */
+
 
 /**
  * @brief Linearly Interpolates x between a and b.
@@ -86,12 +103,15 @@ struct perlin_data_s {
  */
 typedef struct thread_args_ {
    int z; /**< Z level working on. */
+   int y0; /**< First row to generate. */
+   int y1; /**< Row after the last to generate. */
    float zoom; /**< Zoom level of detail. */
    int n; /**< Number of layers to generate. */
    int h; /**< Height. */
    int w; /**< Width. */
    perlin_data_t *noise; /**< Parent noise. */
    int octaves; /**< Octave parameters. */
+   int period; /**< Lattice cells after which the layer repeats, 0 if it doesn't. */
    float *max; /**< Maximum value. */
    float *nebula; /**< Nebula loading into. */
 } thread_args;
@@ -108,8 +128,16 @@ static float lattice3( perlin_data_t *pdata, int ix, float fx,
       int iy, float fy, int iz, float fz );
 static float lattice2( perlin_data_t *pdata, int ix, float fx, int iy, float fy );
 static float lattice1( perlin_data_t *pdata, int ix, float fx );
+/* Vectorized rows. */
+static noise_vec noise_get3v( perlin_data_t* pdata, noise_vec fx, float fy, float fz,
+      int px, int py );
+static noise_vec noise_turbulence3v( perlin_data_t* pdata, noise_vec fx,
+      float fy, float fz, int octaves, int period );
 /*Threading */
 static int noise_genNebulaMap_thread( void *data );
+static int noise_genNebulaMap_tile( void *data );
+static float* noise_genNebula( const int w, const int h, const int n, float zoom,
+      int tiled, int period );
 
 
 /**
@@ -426,6 +454,138 @@ float noise_turbulence3( perlin_data_t* pdata, float f[3], int octaves )
 }
 
 
+/**
+ * @brief Gets 3D Perlin noise for a run of pixels of the same row.
+ *
+ * Same as noise_get3() done on every lane, but can also wrap the lattice around
+ *  so the noise repeats.
+ *
+ *    @param pdata Perlin data to use.
+ *    @param fx X position of each pixel.
+ *    @param fy Y position shared by all the pixels.
+ *    @param fz Z position shared by all the pixels.
+ *    @param px Lattice cells after which to wrap on the X axis, 0 to not wrap.
+ *    @param py Lattice cells after which to wrap on the Y axis, 0 to not wrap.
+ *    @return The noise of each pixel.
+ */
+static noise_vec noise_get3v( perlin_data_t* pdata, noise_vec fx, float fy, float fz,
+      int px, int py )
+{
+   int i, c, ix[NOISE_LANES], iy, iz, h, x0, x1, y0, y1;
+   float ry, rz, wy, wz;
+   const float *grad[8];
+   noise_vec rx, wx, value, v[8];
+   noise_vec g[8][3] __attribute__ ((aligned (32)));
+
+   /* Y and Z are the same for all lanes. */
+   iy = (int)fy;
+   iz = (int)fz;
+   ry = fy - iy;
+   rz = fz - iz;
+   wy = CUBIC(ry);
+   wz = CUBIC(rz);
+   y0 = (py > 0) ? iy % py : iy;
+   y1 = (py > 0) ? (iy+1) % py : iy+1;
+   for (i=0; i<NOISE_LANES; i++) {
+      ix[i] = (int)fx[i];
+      rx[i] = fx[i] - ix[i];
+   }
+   wx = rx * rx * (3.f - 2.f*rx);
+
+#define LATTICE(x,c) \
+   x0 = (px > 0) ? (x) % px : (x); \
+   x1 = (px > 0) ? ((x)+1) % px : (x)+1; \
+   h = pdata->map[(((c)&1) ? x1 : x0) & 0xFF]; \
+   h = pdata->map[(h + (((c)&2) ? y1 : y0)) & 0xFF]; \
+   h = pdata->map[(h + iz + (((c)>>2)&1)) & 0xFF]; \
+   grad[c] = pdata->buffer[h]
+#define CORNER(g0,g1,g2,c) \
+   ((g0) * (((c)&1) ? rx-1.f : rx) + \
+    (g1) * (((c)&2) ? ry-1.f : ry) + \
+    (g2) * (((c)&4) ? rz-1.f : rz))
+
+   /* Pixels only go right so if the ends share a lattice cell all of them do,
+    * which is nearly always the case. */
+   if (ix[0] == ix[NOISE_LANES-1]) {
+      for (c=0; c<8; c++) {
+         LATTICE( ix[0], c );
+         v[c] = CORNER( grad[c][0], grad[c][1], grad[c][2], c );
+      }
+   }
+   /* Table lookups can't be vectorized, gather the gradients of the corners. */
+   else {
+      for (i=0; i<NOISE_LANES; i++) {
+         if ((i == 0) || (ix[i] != ix[i-1]))
+            for (c=0; c<8; c++) {
+               LATTICE( ix[i], c );
+            }
+         for (c=0; c<8; c++) {
+            g[c][0][i] = grad[c][0];
+            g[c][1][i] = grad[c][1];
+            g[c][2][i] = grad[c][2];
+         }
+      }
+      for (c=0; c<8; c++)
+         v[c] = CORNER( g[c][0], g[c][1], g[c][2], c );
+   }
+#undef CORNER
+#undef LATTICE
+
+   /* Interpolate. */
+   value = LERP(
+         LERP(
+            LERP(v[0], v[1], wx),
+            LERP(v[2], v[3], wx),
+            wy
+            ),
+         LERP(
+            LERP(v[4], v[5], wx),
+            LERP(v[6], v[7], wx),
+            wy
+            ),
+         wz
+         );
+
+   for (i=0; i<NOISE_LANES; i++)
+      value[i] = CLAMP(-0.99999f, 0.99999f, value[i]);
+   return value;
+}
+
+
+/**
+ * @brief Gets 3D turbulence noise for a run of pixels of the same row.
+ *
+ *    @param pdata Perlin data to generate noise from.
+ *    @param fx X position of each pixel.
+ *    @param fy Y position shared by all the pixels.
+ *    @param fz Z position shared by all the pixels.
+ *    @param octaves Octaves to use.
+ *    @param period Lattice cells after which the first octave repeats on the
+ *           X and Y axes, 0 to not repeat.
+ *    @return The noise level of each pixel.
+ */
+static noise_vec noise_turbulence3v( perlin_data_t* pdata, noise_vec fx,
+      float fy, float fz, int octaves, int period )
+{
+   noise_vec n, value = { 0. };
+   int i, j;
+
+   for (i=0; i<octaves; i++) {
+      n = noise_get3v( pdata, fx, fy, fz, period, period );
+      for (j=0; j<NOISE_LANES; j++)
+         value[j] += ABS(n[j]) * pdata->exponent[i];
+      fx *= pdata->lacunarity;
+      fy *= pdata->lacunarity;
+      fz *= pdata->lacunarity;
+      period = (int)((float)period * pdata->lacunarity);
+   }
+
+   for (j=0; j<NOISE_LANES; j++)
+      value[j] = CLAMP(-0.99999f, 0.99999f, value[j]);
+   return value;
+}
+
+
 /**
  * @brief Gets 2d Turbulence noise for a position.
  *
@@ -624,25 +784,70 @@ static int noise_genNebulaMap_thread( void *data )
 }
 
 
+/**
+ * @brief Thread worker for generating a tile of a nebula layer.
+ *
+ *    @param data Data to pass.
+ */
+static int noise_genNebulaMap_tile( void *data )
+{
+   thread_args *args = (thread_args*) data;
+   noise_vec fx, value;
+   float fy, fz, max, *row;
+   int x, y, i;
+
+   max = 0;
+   fz  = args->zoom * (float)args->z / (float)args->n;
+
+   for (y=args->y0; y<args->y1; y++) {
+      fy  = args->zoom * (float)y / (float)args->h;
+      row = &args->nebula[ args->z * args->w * args->h + y * args->w ];
+
+      for (x=0; x<args->w; x+=NOISE_LANES) {
+         for (i=0; i<NOISE_LANES; i++)
+            fx[i] = args->zoom * (float)(x+i) / (float)args->w;
+
+         value = noise_turbulence3v( args->noise, fx, fy, fz, args->octaves, args->period );
+
+         for (i=0; (i<NOISE_LANES) && (x+i<args->w); i++) {
+            if (max < value[i])
+               max = value[i];
+            row[x+i] = value[i];
+         }
+      }
+   }
+
+   /* Set up output. */
+   *args->max = max;
+
+   /* Clean up. */
+   free( args );
+   return 0;
+}
+
+
 /**
  * @brief Generates a 3d nebula map.
  *
  *    @param w Width of the map.
  *    @param h Height of the map.
  *    @param n Number of slices of the map (2d planes).
- *    @param rug Rugosity of the map.
+ *    @param zoom Lattice cells spanned by the map.
+ *    @param tiled Whether to use the vectorized tiles or a scalar job per layer.
+ *    @param period Lattice cells after which the map repeats, 0 to not repeat.
+ *           Only supported by the vectorized tiles.
  *    @return The map generated.
  */
-float* noise_genNebulaMap( const int w, const int h, const int n, float rug )
+static float* noise_genNebula( const int w, const int h, const int n, float zoom,
+      int tiled, int period )
 {
-   int x, y, z, i;
+   int x, y, z, i, ntiles, njobs;
    int octaves;
    float hurst;
    float lacunarity;
    perlin_data_t* noise;
    float *nebula;
    float value;
-   float zoom;
    float *_max;
    float max;
    unsigned int s;
@@ -653,7 +858,6 @@ float* noise_genNebulaMap( const int w, const int h, const int n, float rug )
    octaves     = 3;
    hurst       = NOISE_DEFAULT_HURST;
    lacunarity  = NOISE_DEFAULT_LACUNARITY;
-   zoom        = rug * ((float)h/768.)*((float)w/1024.);
 
    /* create noise and data */
    noise      = noise_new( 3, hurst, lacunarity );
@@ -668,34 +872,42 @@ float* noise_genNebulaMap( const int w, const int h, const int n, float rug )
    s = SDL_GetTicks();
    DEBUG("Generating Nebula of size %dx%dx%d", w, h, n);
 
+   /* Layers get split into tiles of rows so all the cores get work. */
+   ntiles      = tiled ? (h + NOISE_TILE_ROWS-1) / NOISE_TILE_ROWS : 1;
+   njobs       = n * ntiles;
+
    /* Prepare for generation. */
-   _max        = malloc( sizeof(float) * n );
+   _max        = malloc( sizeof(float) * njobs );
 
    /* Initialize vpool */
    vpool = vpool_create();
 
    /* Start to create the nebula */
-   for (z=0; z<n; z++) {
+   for (i=0; i<njobs; i++) {
       /* Make ze arguments! */
       args     = malloc( sizeof(thread_args) );
-      args->z  = z;
+      args->z  = i / ntiles;
+      args->y0 = tiled ? (i % ntiles) * NOISE_TILE_ROWS : 0;
+      args->y1 = tiled ? MIN( args->y0 + NOISE_TILE_ROWS, h ) : h;
       args->zoom = zoom;
       args->n  = n;
       args->h  = h;
       args->w  = w;
       args->noise = noise;
       args->octaves = octaves;
-      args->max = &_max[z];
+      args->period = period;
+      args->max = &_max[i];
       args->nebula = nebula;
 
       /* Launch ze thread. */
-      vpool_enqueue( vpool, noise_genNebulaMap_thread, args );
+      vpool_enqueue( vpool, tiled ? noise_genNebulaMap_tile :
+            noise_genNebulaMap_thread, args );
    }
 
    /* Wait for threads to signal completion. */
    vpool_wait( vpool );
    max = 0.;
-   for (i=0; i<n; i++) {
+   for (i=0; i<njobs; i++) {
       if (_max[i]>max)
          max = _max[i];
    }
@@ -717,6 +929,55 @@ float* noise_genNebulaMap( const int w, const int h, const int n, float rug )
 }
 
 
+/**
+ * @brief Generates a 3d nebula map.
+ *
+ *    @param w Width of the map.
+ *    @param h Height of the map.
+ *    @param n Number of slices of the map (2d planes).
+ *    @param rug Rugosity of the map.
+ *    @return The map generated.
+ */
+float* noise_genNebulaMap( const int w, const int h, const int n, float rug )
+{
+   return noise_genNebula( w, h, n, rug * ((float)h/768.)*((float)w/1024.), 1, 0 );
+}
+
+
+/**
+ * @brief Generates a 3d nebula map where each layer tiles seamlessly.
+ *
+ *    @param w Width of the map.
+ *    @param h Height of the map.
+ *    @param n Number of slices of the map (2d planes).
+ *    @param period Lattice cells spanned by each layer, the bigger the more
+ *           detailed it is.
+ *    @return The map generated.
+ */
+float* noise_genNebulaMapTileable( const int w, const int h, const int n, int period )
+{
+   return noise_genNebula( w, h, n, (float)period, 1, period );
+}
+
+
+/**
+ * @brief Generates a 3d nebula map pixel by pixel with a job per layer.
+ *
+ * Gives the same results as noise_genNebulaMap() but much slower, only kept
+ *  as a reference to compare and benchmark against.
+ *
+ *    @param w Width of the map.
+ *    @param h Height of the map.
+ *    @param n Number of slices of the map (2d planes).
+ *    @param rug Rugosity of the map.
+ *    @return The map generated.
+ */
+float* noise_genNebulaMapScalar( const int w, const int h, const int n, float rug )
+{
+   return noise_genNebula( w, h, n, rug * ((float)h/768.)*((float)w/1024.), 0, 0 );
+}
+
+
 /**
  * @brief Generates tiny nebula puffs
  *
@@ -30,6 +30,8 @@ float noise_simplex1( perlin_data_t* noise, float f[1] );
 /* High level. */
 float* noise_genRadarInt( const int w, const int h, float rug );
 float* noise_genNebulaMap( const int w, const int h, const int n, float rug );
+float* noise_genNebulaMapScalar( const int w, const int h, const int n, float rug );
+float* noise_genNebulaMapTileable( const int w, const int h, const int n, int period );
 float* noise_genNebulaPuffMap( const int w, const int h, float rug );
 
 
@@ -51,8 +51,30 @@
 #define PILOT_CHUNK_MAX 2048 /**< Maximum chunks to increment pilot_stack by */
 #define CHUNK_SIZE      32 /**< Size to allocate memory by. */
 
-/* ID Generators. */
-static unsigned int pilot_id = PLAYER_ID; /**< Stack of pilot ids to assure uniqueness */
+#define PILOT_HANDLE_BITS  16 /**< Bits of the pilot ID used for the handle slot. */
+#define PILOT_HANDLE_MAX   (1<<PILOT_HANDLE_BITS) /**< Maximum simultaneous pilots on the stack. */
+#define PILOT_HANDLE_SLOT(id) ((id) & (PILOT_HANDLE_MAX-1)) /**< Gets the slot of a pilot ID. */
+#define PILOT_HANDLE_GEN(id) ((id) >> PILOT_HANDLE_BITS) /**< Gets the generation of a pilot ID. */
+#define PILOT_POOL_MAX     256 /**< Maximum amount of freed pilots kept around for reuse. */
+
+
+/**
+ * @brief Handle slot of a pilot.
+ *
+ * Pilot IDs are a slot in the handle table combined with the generation of
+ *  the slot, so they can be looked up directly. Freeing a slot bumps the
+ *  generation so IDs of dead pilots never resolve to the pilot reusing it.
+ */
+typedef struct PilotHandle_ {
+   Pilot *p; /**< Pilot using the slot, NULL if free. */
+   int pos; /**< Position of the pilot in the pilot stack. */
+   unsigned int gen; /**< Current generation of the slot, never 0. */
+   int next; /**< Next free slot or -1. */
+} PilotHandle;
+
+static PilotHandle *pilot_handles = NULL; /**< Handle table (array.h). */
+static int pilot_handleFree = -1; /**< First free slot in the handle table. */
+static Pilot **pilot_pool = NULL; /**< Freed pilots kept around for reuse (array.h). */
 
 
 /* stack of pilot_nstack */
@@ -81,6 +103,15 @@ static int pilot_validEnemy( const Pilot* p, const Pilot* target );
 /* Misc. */
 static void pilot_setCommMsg( Pilot *p, const char *s );
 static int pilot_getStackPos( const unsigned int id );
+/* Memory. */
+static Pilot* pilot_alloc (void);
+static void pilot_dealloc( Pilot *p );
+static void pilot_poolFree (void);
+static unsigned int pilot_handleNew( Pilot *p );
+static PilotHandle* pilot_handleGet( const unsigned int id );
+static void pilot_handleRelease( const unsigned int id );
+static void pilot_handleReindex( int start );
+static void pilot_allocOutfits( Pilot *pilot );
 
 
 /**
@@ -93,6 +124,167 @@ Pilot** pilot_getAll( int *n )
 }
 
 
+/**
+ * @brief Gets memory for a pilot, reusing freed pilots when possible.
+ *
+ *    @return Uninitialized pilot memory or NULL on failure.
+ */
+static Pilot* pilot_alloc (void)
+{
+   Pilot *p;
+   int n;
+
+   if (pilot_pool != NULL) {
+      n = array_size(pilot_pool);
+      if (n > 0) {
+         p = pilot_pool[n-1];
+         array_resize( &pilot_pool, n-1 );
+         return p;
+      }
+   }
+
+   return malloc( sizeof(Pilot) );
+}
+
+
+/**
+ * @brief Gives pilot memory back to the pool.
+ *
+ *    @param p Pilot memory to give back.
+ */
+static void pilot_dealloc( Pilot *p )
+{
+   if (pilot_pool == NULL)
+      pilot_pool = array_create( Pilot* );
+
+   if (array_size(pilot_pool) >= PILOT_POOL_MAX) {
+      free(p);
+      return;
+   }
+   array_push_back( &pilot_pool, p );
+}
+
+
+/**
+ * @brief Frees the pilots kept for reuse.
+ */
+static void pilot_poolFree (void)
+{
+   int i;
+
+   if (pilot_pool == NULL)
+      return;
+
+   for (i=0; i<array_size(pilot_pool); i++)
+      free( pilot_pool[i] );
+   array_free( pilot_pool );
+   pilot_pool = NULL;
+}
+
+
+/**
+ * @brief Gets a new handle for a pilot.
+ *
+ *    @param p Pilot to get handle for.
+ *    @return ID of the pilot or 0 if there are too many pilots.
+ */
+static unsigned int pilot_handleNew( Pilot *p )
+{
+   PilotHandle *h;
+   int slot;
+
+   if (pilot_handles == NULL)
+      pilot_handles = array_create( PilotHandle );
+
+   /* Reuse a free slot if possible. */
+   if (pilot_handleFree >= 0) {
+      slot  = pilot_handleFree;
+      h     = &pilot_handles[slot];
+      pilot_handleFree = h->next;
+   }
+   else {
+      slot = array_size(pilot_handles);
+      if (slot >= PILOT_HANDLE_MAX) {
+         WARN("Too many pilots, unable to create more!");
+         return 0;
+      }
+      h        = &array_grow( &pilot_handles );
+      h->gen   = 1;
+   }
+
+   h->p     = p;
+   h->pos   = -1;
+   h->next  = -1;
+   return (h->gen << PILOT_HANDLE_BITS) | slot;
+}
+
+
+/**
+ * @brief Gets the handle of a pilot ID.
+ *
+ *    @param id ID to get handle of.
+ *    @return The handle or NULL if the ID is not in use.
+ */
+static PilotHandle* pilot_handleGet( const unsigned int id )
+{
+   PilotHandle *h;
+   int slot;
+
+   if (pilot_handles == NULL)
+      return NULL;
+
+   slot = PILOT_HANDLE_SLOT(id);
+   if (slot >= array_size(pilot_handles))
+      return NULL;
+
+   h = &pilot_handles[slot];
+   if ((h->p == NULL) || (h->gen != PILOT_HANDLE_GEN(id)))
+      return NULL;
+   return h;
+}
+
+
+/**
+ * @brief Frees the handle of a pilot ID.
+ *
+ *    @param id ID to free handle of.
+ */
+static void pilot_handleRelease( const unsigned int id )
+{
+   PilotHandle *h;
+
+   h = pilot_handleGet( id );
+   if (h == NULL)
+      return;
+
+   h->p     = NULL;
+   h->pos   = -1;
+   h->gen   = (h->gen + 1) & (UINT_MAX >> PILOT_HANDLE_BITS);
+   if (h->gen == 0)
+      h->gen = 1;
+   h->next  = pilot_handleFree;
+   pilot_handleFree = h - pilot_handles;
+}
+
+
+/**
+ * @brief Updates the stack positions stored in the handles.
+ *
+ *    @param start Stack position to start updating at.
+ */
+static void pilot_handleReindex( int start )
+{
+   PilotHandle *h;
+   int i;
+
+   for (i=start; i<pilot_nstack; i++) {
+      h = pilot_handleGet( pilot_stack[i]->id );
+      if (h != NULL)
+         h->pos = i;
+   }
+}
+
+
 /**
  * @brief Gets the pilot's position in the stack.
  *
@@ -101,19 +293,21 @@ Pilot** pilot_getAll( int *n )
  */
 static int pilot_getStackPos( const unsigned int id )
 {
-   /* binary search */
-   int l,m,h;
-   l = 0;
-   h = pilot_nstack-1;
-   while (l <= h) {
-      m = (l+h) >> 1; /* for impossible overflow returning neg value */
-      if (pilot_stack[m]->id > id) h = m-1;
-      else if (pilot_stack[m]->id < id) l = m+1;
-      else return m;
+   PilotHandle *h;
+   int i;
+
+   /* Player doesn't have a handle and is generally at the start. */
+   if (id == PLAYER_ID) {
+      for (i=0; i<pilot_nstack; i++)
+         if (pilot_stack[i]->id == PLAYER_ID)
+            return i;
+      return -1;
    }
 
-   /* Not found. */
-   return -1;
+   h = pilot_handleGet( id );
+   if ((h == NULL) || (h->pos < 0))
+      return -1;
+   return h->pos;
 }
 
 
@@ -509,26 +703,25 @@ double pilot_getNearestAng( const Pilot *p, unsigned int *tp, double ang, int di
 /**
  * @brief Pulls a pilot out of the pilot_stack based on ID.
  *
- * It's a binary search ( O(logn) ) therefore it's pretty fast and can be
- *  abused all the time.  Maximum iterations is 32 on a platform with 32 bit
- *  unsigned ints.
+ * It's a direct lookup in the handle table ( O(1) ) so it can be abused all
+ *  the time.
  *
  *    @param id ID of the pilot to get.
  *    @return The actual pilot who has matching ID or NULL if not found.
  */
 Pilot* pilot_get( const unsigned int id )
 {
-   int m;
+   PilotHandle *h;
 
    if (id==PLAYER_ID)
       return player.p; /* special case player.p */
 
-   m = pilot_getStackPos(id);
+   h = pilot_handleGet(id);
 
-   if ((m==-1) || (pilot_isFlag(pilot_stack[m], PILOT_DELETE)))
+   if ((h==NULL) || (pilot_isFlag(h->p, PILOT_DELETE)))
       return NULL;
    else
-      return pilot_stack[m];
+      return h->p;
 }
 
 
@@ -2096,6 +2289,36 @@ credits_t pilot_modCredits( Pilot *p, credits_t amount )
 }
 
 
+/**
+ * @brief Allocates the outfit slots of a pilot.
+ *
+ * All the slot arrays and the global slot list come from a single block owned
+ *  by outfit_structure, which keeps allocator traffic down when many pilots
+ *  are created and destroyed.
+ *
+ *    @param pilot Pilot to allocate slots of, slot counts must be set.
+ */
+static void pilot_allocOutfits( Pilot *pilot )
+{
+   PilotOutfitSlot *slots;
+   int nslots;
+
+   /* Slots go first since they have the strictest alignment. */
+   nslots = pilot->outfit_nstructure + pilot->outfit_nutility + pilot->outfit_nweapon;
+   slots  = calloc( 1, nslots * sizeof(PilotOutfitSlot) +
+         pilot->noutfits * sizeof(PilotOutfitSlot*) + 1 );
+   if (slots == NULL)
+      ERR("Out of memory!");
+
+   /* Slot types. */
+   pilot->outfit_structure = slots;
+   pilot->outfit_utility   = &slots[ pilot->outfit_nstructure ];
+   pilot->outfit_weapon    = &slots[ pilot->outfit_nstructure + pilot->outfit_nutility ];
+   /* Global. */
+   pilot->outfits          = (PilotOutfitSlot**) &slots[ nslots ];
+}
+
+
 /**
  * @brief Initialize pilot.
  *
@@ -2120,14 +2343,15 @@ void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction, const
 
    if (pilot_isFlagRaw(flags, PILOT_PLAYER)) /* Set player ID, should probably be fixed to something sane someday. */
       pilot->id = PLAYER_ID;
-   else
-      pilot->id = ++pilot_id; /* new unique pilot id based on pilot_id, can't be 0 */
+   else if (!pilot_isFlagRaw(flags, PILOT_EMPTY))
+      pilot->id = pilot_handleNew( pilot ); /* new unique handle, can't be 0 */
 
    /* Defaults. */
    pilot->autoweap = 1;
 
    /* Basic information. */
    pilot->ship = ship;
+   ship_gfxUse( ship ); /* Graphics are loaded on demand. */
    pilot->name = strdup( (name==NULL) ? ship->name : name );
 
    /* faction */
@@ -2149,16 +2373,11 @@ void pilot_init( Pilot* pilot, Ship* ship, const char* name, int faction, const
    pilot->nebu_absorb_shield = 0.;
 
    /* Allocate outfit memory. */
-   /* Slot types. */
    pilot->outfit_nstructure = ship->outfit_nstructure;
-   pilot->outfit_structure = calloc( ship->outfit_nstructure, sizeof(PilotOutfitSlot) );
    pilot->outfit_nutility  = ship->outfit_nutility;
-   pilot->outfit_utility   = calloc( ship->outfit_nutility, sizeof(PilotOutfitSlot) );
    pilot->outfit_nweapon   = ship->outfit_nweapon;
-   pilot->outfit_weapon    = calloc( ship->outfit_nweapon, sizeof(PilotOutfitSlot) );
-   /* Global. */
    pilot->noutfits = pilot->outfit_nstructure + pilot->outfit_nutility + pilot->outfit_nweapon;
-   pilot->outfits  = calloc( pilot->noutfits, sizeof(PilotOutfitSlot*) );
+   pilot_allocOutfits( pilot );
    /* First pass copy data. */
    p = 0;
    for (i=0; i<pilot->outfit_nstructure; i++) {
@@ -2273,9 +2492,10 @@ unsigned int pilot_create( Ship* ship, const char* name, int faction, const char
       const PilotFlags flags, const int systemFleet )
 {
    Pilot *dyn;
+   PilotHandle *h;
 
    /* Allocate pilot memory. */
-   dyn = malloc(sizeof(Pilot));
+   dyn = pilot_alloc();
    if (dyn == NULL) {
       WARN("Unable to allocate memory");
       return 0;
@@ -2293,10 +2513,23 @@ unsigned int pilot_create( Ship* ship, const char* name, int faction, const char
    /* Set the pilot in the stack -- must be there before initializing */
    pilot_stack[pilot_nstack] = dyn;
    pilot_nstack++; /* there's a new pilot */
+   pilot_ewInvalidateCache();
 
    /* Initialize the pilot. */
    pilot_init( dyn, ship, name, faction, ai, dir, pos, vel, flags, systemFleet );
 
+   /* Remember where it is for stack lookups. */
+   if (dyn->id != PLAYER_ID) {
+      h = pilot_handleGet( dyn->id );
+      if (h == NULL) {
+         pilot_free( dyn );
+         pilot_nstack--;
+         pilot_ewInvalidateCache();
+         return 0;
+      }
+      h->pos = pilot_nstack-1;
+   }
+
    return dyn->id;
 }
 
@@ -2315,7 +2548,7 @@ Pilot* pilot_createEmpty( Ship* ship, const char* name,
       int faction, const char *ai, PilotFlags flags )
 {
    Pilot* dyn;
-   dyn = malloc(sizeof(Pilot));
+   dyn = pilot_alloc();
    if (dyn == NULL) {
       WARN("Unable to allocate memory");
       return 0;
@@ -2335,10 +2568,11 @@ Pilot* pilot_createEmpty( Ship* ship, const char* name,
 Pilot* pilot_copy( Pilot* src )
 {
    int i, p;
-   Pilot *dest = malloc(sizeof(Pilot));
+   Pilot *dest = pilot_alloc();
 
    /* Copy data over, we'll have to reset all the pointers though. */
    memcpy( dest, src, sizeof(Pilot) );
+   ship_gfxUse( dest->ship );
 
    /* Copy names. */
    if (src->name)
@@ -2351,18 +2585,11 @@ Pilot* pilot_copy( Pilot* src )
    memcpy( dest->solid, src->solid, sizeof(Solid) );
 
    /* Copy outfits. */
-   dest->noutfits = src->noutfits;
-   dest->outfits  = malloc( sizeof(PilotOutfitSlot*) * dest->noutfits );
-   dest->outfit_nstructure = src->outfit_nstructure;
-   dest->outfit_structure  = malloc( sizeof(PilotOutfitSlot) * dest->outfit_nstructure );
+   pilot_allocOutfits( dest );
    memcpy( dest->outfit_structure, src->outfit_structure,
          sizeof(PilotOutfitSlot) * dest->outfit_nstructure );
-   dest->outfit_nutility = src->outfit_nutility;
-   dest->outfit_utility  = malloc( sizeof(PilotOutfitSlot) * dest->outfit_nutility );
    memcpy( dest->outfit_utility, src->outfit_utility,
          sizeof(PilotOutfitSlot) * dest->outfit_nutility );
-   dest->outfit_nweapon = src->outfit_nweapon;
-   dest->outfit_weapon  = malloc( sizeof(PilotOutfitSlot) * dest->outfit_nweapon );
    memcpy( dest->outfit_weapon, src->outfit_weapon,
          sizeof(PilotOutfitSlot) * dest->outfit_nweapon );
    p = 0;
@@ -2419,15 +2646,12 @@ void pilot_free( Pilot* p )
    /* Free weapon sets. */
    pilot_weapSetFree(p);
 
-   /* Free outfits. */
-   if (p->outfits != NULL)
-      free(p->outfits);
+   /* Ship graphics may be unloaded now. */
+   ship_gfxRelease(p->ship);
+
+   /* Free outfits, all the slots share the same block. */
    if (p->outfit_structure != NULL)
       free(p->outfit_structure);
-   if (p->outfit_utility != NULL)
-      free(p->outfit_utility);
-   if (p->outfit_weapon != NULL)
-      free(p->outfit_weapon);
 
    /* Remove commodities. */
    while (p->commodities != NULL)
@@ -2464,7 +2688,7 @@ void pilot_free( Pilot* p )
    memset( p, 0, sizeof(Pilot) );
 #endif /* DEBUGGING */
 
-   free(p);
+   pilot_dealloc(p);
 }
 
 
@@ -2478,9 +2702,12 @@ void pilot_destroy(Pilot* p)
    int i;
 
    /* find the pilot */
-   for (i=0; i < pilot_nstack; i++)
-      if (pilot_stack[i]==p)
-         break;
+   i = pilot_getStackPos( p->id );
+   if ((i < 0) || (pilot_stack[i] != p))
+      for (i=0; i < pilot_nstack; i++)
+         if (pilot_stack[i]==p)
+            break;
+   pilot_handleRelease( p->id );
 
    /* Remove faction if necessary. */
    if (p->presence > 0) {
@@ -2494,6 +2721,8 @@ void pilot_destroy(Pilot* p)
 
    /* copy other pilots down */
    memmove(&pilot_stack[i], &pilot_stack[i+1], (pilot_nstack-i)*sizeof(Pilot*));
+   pilot_handleReindex( i );
+   pilot_ewInvalidateCache();
 }
 
 
@@ -2507,12 +2736,22 @@ void pilots_free (void)
    pilot_freeGlobalHooks();
 
    /* Free pilots. */
-   for (i=0; i < pilot_nstack; i++)
+   for (i=0; i < pilot_nstack; i++) {
+      pilot_handleRelease(pilot_stack[i]->id);
       pilot_free(pilot_stack[i]);
+   }
    free(pilot_stack);
    pilot_stack = NULL;
    player.p = NULL;
    pilot_nstack = 0;
+   pilot_ewFreeCache();
+
+   /* Free memory. */
+   pilot_poolFree();
+   if (pilot_handles != NULL)
+      array_free(pilot_handles);
+   pilot_handles     = NULL;
+   pilot_handleFree  = -1;
 }
 
 
@@ -2528,8 +2767,10 @@ void pilots_clean (void)
          pilot_stack[0] = player.p;
          pilot_stack[0]->lockons = 0; /* Clear lockons. */
       }
-      else /* rest get killed */
+      else { /* rest get killed */
+         pilot_handleRelease(pilot_stack[i]->id);
          pilot_free(pilot_stack[i]);
+      }
    }
 
    if (player.p != NULL) { /* set stack to 1 if pilot exists */
@@ -2538,6 +2779,7 @@ void pilots_clean (void)
    }
    else
       pilot_nstack = 0;
+   pilot_ewInvalidateCache();
 
    /* Clear global hooks. */
    pilots_clearGlobalHooks();
@@ -2567,6 +2809,7 @@ void pilots_cleanAll (void)
       player.p = NULL;
    }
    pilot_nstack = 0;
+   pilot_ewInvalidateCache();
 }
 
 
@@ -2636,6 +2879,9 @@ void pilots_update( double dt )
       if (p->update) /* update */
          p->update( p, dt );
    }
+
+   /* Pilots moved, so detection must be recalculated. */
+   pilot_ewResetCache();
 }
 
 
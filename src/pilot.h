@@ -320,6 +320,7 @@ typedef struct Pilot_ {
    double ew_evasion; /**< Dynamic evasion factor. */
    double ew_detect; /**< Static detection factor. */
    double ew_jump_detect; /** Static jump detection factor */
+   int ew_cachepos;  /**< Position in the detection cache, only valid while the cache is. */
 
    /* Heat. */
    double heat_T;    /**< Ship temperature. [K] */
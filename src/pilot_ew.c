@@ -26,6 +26,39 @@ static double sensor_curRange    = 0.; /**< Current base sensor range, used to c
 #define  EVASION_SCALE              1.25           /**< Scales the evasion factor to the hide factor. Ensures that ships always have an evasion factor higher than their hide factor. */
 #define  SENSOR_DEFAULT_RANGE       7500           /**< The default sensor range for all ships. */
 
+
+/*
+ * Detection cache.
+ *
+ * Detection results only change when pilots move, which happens in the update
+ *  pass of pilots_update(). The cache is reset right after that pass so the
+ *  AI of the next frame and the rendering (radar) of this one look up each
+ *  observer/target pair only once. Each row belongs to an observer and has a
+ *  column per pilot, then planet, then jump point. Rows are cleared lazily the
+ *  first time they are used after a reset.
+ */
+#define  EW_UNKNOWN                 2              /**< Cache entry has not been calculated yet. */
+static int ew_cacheValid         = 0; /**< Whether the cache matches the pilot stack. */
+static Pilot **ew_cacheStack     = NULL; /**< Pilot stack the cache was built for. */
+static int ew_cacheNpilots       = 0; /**< Number of pilots (rows) in the cache. */
+static int ew_cacheNplanets      = 0; /**< Number of planet columns in the cache. */
+static int ew_cacheNjumps        = 0; /**< Number of jump point columns in the cache. */
+static int ew_cacheW             = 0; /**< Width of a row in the cache. */
+static int ew_cacheMem           = 0; /**< Allocated cache entries. */
+static int ew_cacheMemRows       = 0; /**< Allocated cache row flags. */
+static signed char *ew_cache     = NULL; /**< Cached detection results. */
+static char *ew_cacheRow         = NULL; /**< Whether a row has been cleared since the last reset. */
+
+
+/*
+ * Prototypes.
+ */
+static signed char* pilot_ewCacheGet( const Pilot *p, int col );
+static int pilot_ewCachePos( const Pilot *p );
+static int pilot_ewInRangePilot( const Pilot *p, const Pilot *target );
+static int pilot_ewInRangePlanet( const Pilot *p, int target );
+static int pilot_ewInRangeJump( const Pilot *p, int i );
+
 /**
  * @brief Updates the pilot's static electronic warfare properties.
  *
@@ -104,6 +137,112 @@ void pilot_updateSensorRange (void)
    /* Speeds up calculations as we compare it against vectors later on
     * and we want to avoid actually calculating the sqrt(). */
    sensor_curRange = pow2(sensor_curRange);
+
+   /* Results depend on the range. */
+   pilot_ewInvalidateCache();
+}
+
+
+/**
+ * @brief Resets the detection cache, should be called once pilots have moved.
+ */
+void pilot_ewResetCache (void)
+{
+   int i, n;
+
+   ew_cacheStack     = pilot_getAll( &n );
+   ew_cacheNpilots   = n;
+   ew_cacheNplanets  = (cur_system != NULL) ? cur_system->nplanets : 0;
+   ew_cacheNjumps    = (cur_system != NULL) ? cur_system->njumps : 0;
+   ew_cacheW         = ew_cacheNpilots + ew_cacheNplanets + ew_cacheNjumps;
+
+   /* Grow memory as needed. */
+   if (ew_cacheW * ew_cacheNpilots > ew_cacheMem) {
+      ew_cacheMem = ew_cacheW * ew_cacheNpilots;
+      ew_cache    = realloc( ew_cache, ew_cacheMem );
+   }
+   if (ew_cacheNpilots > ew_cacheMemRows) {
+      ew_cacheMemRows = ew_cacheNpilots;
+      ew_cacheRow     = realloc( ew_cacheRow, ew_cacheMemRows );
+   }
+
+   /* Set positions and mark all rows as dirty. */
+   for (i=0; i<n; i++)
+      ew_cacheStack[i]->ew_cachepos = i;
+   memset( ew_cacheRow, 0, ew_cacheNpilots );
+
+   ew_cacheValid = 1;
+}
+
+
+/**
+ * @brief Invalidates the detection cache, should be called when the pilot stack changes.
+ */
+void pilot_ewInvalidateCache (void)
+{
+   ew_cacheValid = 0;
+}
+
+
+/**
+ * @brief Frees the detection cache.
+ */
+void pilot_ewFreeCache (void)
+{
+   free( ew_cache );
+   free( ew_cacheRow );
+   ew_cache          = NULL;
+   ew_cacheRow       = NULL;
+   ew_cacheMem       = 0;
+   ew_cacheMemRows   = 0;
+   ew_cacheValid     = 0;
+}
+
+
+/**
+ * @brief Gets the position of a pilot in the detection cache.
+ *
+ *    @param p Pilot to get position of.
+ *    @return Position of the pilot or -1 if not in the cache.
+ */
+static int pilot_ewCachePos( const Pilot *p )
+{
+   int pos;
+
+   pos = p->ew_cachepos;
+   if ((pos < 0) || (pos >= ew_cacheNpilots) || (ew_cacheStack[pos] != p))
+      return -1;
+   return pos;
+}
+
+
+/**
+ * @brief Gets a detection cache entry.
+ *
+ *    @param p Observer.
+ *    @param col Column of the target.
+ *    @return The cache entry or NULL if it can't be cached.
+ */
+static signed char* pilot_ewCacheGet( const Pilot *p, int col )
+{
+   int row;
+   signed char *r;
+
+   if (!ew_cacheValid)
+      return NULL;
+
+   row = pilot_ewCachePos( p );
+   if (row < 0)
+      return NULL;
+
+   /* First use of the row since the reset. */
+   r = &ew_cache[ row*ew_cacheW ];
+   if (!ew_cacheRow[row]) {
+      memset( r, EW_UNKNOWN, ew_cacheW );
+      ew_cacheRow[row] = 1;
+   }
+
+   return &r[col];
 }
 
 
@@ -150,13 +289,40 @@ int pilot_inRange( const Pilot *p, double x, double y )
  */
 int pilot_inRangePilot( const Pilot *p, const Pilot *target )
 {
-   double d, sense;
+   int col;
+   signed char *c;
 
    /* Special case player or omni-visible. */
    if ((pilot_isPlayer(p) && pilot_isFlag(target, PILOT_VISPLAYER)) ||
          pilot_isFlag(target, PILOT_VISIBLE))
       return 1;
 
+   /* Try the cache. */
+   c = NULL;
+   if (ew_cacheValid) {
+      col = pilot_ewCachePos( target );
+      if (col >= 0)
+         c = pilot_ewCacheGet( p, col );
+   }
+   if (c == NULL)
+      return pilot_ewInRangePilot( p, target );
+   if (*c == EW_UNKNOWN)
+      *c = pilot_ewInRangePilot( p, target );
+   return *c;
+}
+
+
+/**
+ * @brief Actually calculates whether a pilot is in sensor range of another.
+ *
+ *    @param p Pilot who is trying to check to see if other is in sensor range.
+ *    @param target Target of p to check to see if is in sensor range.
+ *    @return 1 if they are in range, 0 if they aren't and -1 if they are detected fuzzily.
+ */
+static int pilot_ewInRangePilot( const Pilot *p, const Pilot *target )
+{
+   double d, sense;
+
    /* Get distance. */
    d = vect_dist2( &p->solid->pos, &target->solid->pos );
 
@@ -179,14 +345,37 @@ int pilot_inRangePilot( const Pilot *p, const Pilot *target )
  */
 int pilot_inRangePlanet( const Pilot *p, int target )
 {
-   double d;
-   Planet *pnt;
-   double sense;
+   signed char *c;
 
    /* pilot must exist */
    if ( p == NULL )
       return 0;
 
+   /* Try the cache. */
+   c = NULL;
+   if (ew_cacheValid && (target < ew_cacheNplanets))
+      c = pilot_ewCacheGet( p, ew_cacheNpilots + target );
+   if (c == NULL)
+      return pilot_ewInRangePlanet( p, target );
+   if (*c == EW_UNKNOWN)
+      *c = pilot_ewInRangePlanet( p, target );
+   return *c;
+}
+
+
+/**
+ * @brief Actually calculates whether a planet is in sensor range of the pilot.
+ *
+ *    @param p Pilot who is trying to check to see if the planet is in sensor range.
+ *    @param target Planet to see if is in sensor range.
+ *    @return 1 if they are in range, 0 if they aren't.
+ */
+static int pilot_ewInRangePlanet( const Pilot *p, int target )
+{
+   double d;
+   Planet *pnt;
+   double sense;
+
    /* Get the planet. */
    pnt = cur_system->planets[target];
 
@@ -215,15 +404,38 @@ int pilot_inRangePlanet( const Pilot *p, int target )
  */
 int pilot_inRangeJump( const Pilot *p, int i )
 {
-   double d;
-   JumpPoint *jp;
-   double sense;
-   double hide;
+   signed char *c;
 
    /* pilot must exist */
    if ( p == NULL )
       return 0;
 
+   /* Try the cache. */
+   c = NULL;
+   if (ew_cacheValid && (i < ew_cacheNjumps))
+      c = pilot_ewCacheGet( p, ew_cacheNpilots + ew_cacheNplanets + i );
+   if (c == NULL)
+      return pilot_ewInRangeJump( p, i );
+   if (*c == EW_UNKNOWN)
+      *c = pilot_ewInRangeJump( p, i );
+   return *c;
+}
+
+
+/**
+ * @brief Actually calculates whether a jump point is in sensor range of the pilot.
+ *
+ *    @param p Pilot who is trying to check to see if the jump point is in sensor range.
+ *    @param i Jump point to see if is in sensor range.
+ *    @return 1 if they are in range, 0 if they aren't.
+ */
+static int pilot_ewInRangeJump( const Pilot *p, int i )
+{
+   double d;
+   JumpPoint *jp;
+   double sense;
+   double hide;
+
    /* Get the jump point. */
    jp = &cur_system->jumps[i];
 
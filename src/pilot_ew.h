@@ -21,6 +21,13 @@ int pilot_inRangePilot( const Pilot *p, const Pilot *target );
 int pilot_inRangePlanet( const Pilot *p, int target );
 int pilot_inRangeJump( const Pilot *p, int target );
 
+/*
+ * Detection cache.
+ */
+void pilot_ewResetCache (void);
+void pilot_ewInvalidateCache (void);
+void pilot_ewFreeCache (void);
+
 /*
  * Weapon tracking.
  */
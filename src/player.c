@@ -2381,7 +2381,8 @@ static int player_outfitCompare( const void *arg1, const void *arg2 )
  * @brief Prepares two arrays for displaying in an image array.
  *
  *    @param[out] soutfits Names of outfits the player owns.
- *    @param[out] toutfits Textures of outfits for image array.
+ *    @param[out] toutfits Textures of outfits for image array, all NULL as
+ *                the image array should load them with outfits_loadImage().
  */
 int player_getOutfits( char** soutfits, glTexture** toutfits )
 {
@@ -2393,7 +2394,8 @@ int player_getOutfits( char** soutfits, glTexture** toutfits )
  * @brief Prepares two arrays for displaying in an image array.
  *
  *    @param[out] soutfits Names of outfits to .
- *    @param[out] toutfits Textures of outfits for image array.
+ *    @param[out] toutfits Textures of outfits for image array, all NULL as
+ *                the image array should load them with outfits_loadImage().
  *    @param[in] filter Function to filter which outfits to get.
  */
 int player_getOutfitsFiltered( char** soutfits, glTexture** toutfits,
@@ -2418,7 +2420,7 @@ int player_getOutfitsFiltered( char** soutfits, glTexture** toutfits,
       if ((filter == NULL) || filter(player_outfits[i].o)) {
          soutfits[j] = strdup( player_outfits[i].o->name );
          if (toutfits != NULL)
-            toutfits[j] = player_outfits[i].o->gfx_store;
+            toutfits[j] = NULL; /* Image array loads them when visible. */
          j++;
       }
    }
@@ -87,6 +87,23 @@ void rng_init (void)
 }
 
 
+/**
+ * @brief Seeds the random subsystem with a fixed value.
+ *
+ * Useful to get reproducible sequences, for example when benchmarking.
+ *
+ *    @param seed Seed to use.
+ */
+void rng_seed( uint32_t seed )
+{
+   int i;
+
+   mt_initArray( seed );
+   for (i=0; i<10; i++) /* generate numbers to get away from poor initial values */
+      mt_genArray();
+}
+
+
 /**
  * @fn static uint32_t rng_timeEntropy (void)
  *
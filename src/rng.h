@@ -8,6 +8,9 @@
 #  define RNG_H
 
 
+#include <stdint.h>
+
+
 /**
  * @brief Gets a random number between L and H (L <= RNG <= H).
  *
@@ -46,6 +49,7 @@
 
 /* Init */
 void rng_init (void);
+void rng_seed( uint32_t seed );
 
 /* Random functions */
 unsigned int randint (void);
@@ -13,6 +13,7 @@
 #include "naev.h"
 
 #include <errno.h> /* errno */
+#include "SDL_thread.h"
 
 #include "log.h"
 #include "nxml.h"
@@ -31,10 +32,36 @@
 #include "land.h"
 #include "gui.h"
 #include "load.h"
+#include "ntime.h"
+#include "threadpool.h"
+#include "nbxml.h"
+
+
+/**
+ * @brief A savegame waiting to be written to disk.
+ */
+typedef struct SaveJob_ {
+   xmlDocPtr doc; /**< Document to write, freed once written. */
+   char path[PATH_MAX]; /**< Path to write to. */
+   int backup; /**< Whether or not to back up the previous savegame. */
+   int binary; /**< Whether or not to use the binary format. */
+   unsigned int id; /**< Increasing job number, newer savegames win. */
+   int ret; /**< Result of the write, 0 on success. */
+   void (*done)( int ret, const char *path ); /**< Run on the main thread when done. */
+   struct SaveJob_ *next; /**< Next finished job. */
+} SaveJob;
 
 
 int save_loaded   = 0; /**< Just loaded the savegame. */
 
+static SDL_mutex *save_lock      = NULL; /**< Protects the job state. */
+static SDL_mutex *save_writeLock = NULL; /**< Only one savegame gets written at a time. */
+static SDL_cond *save_cond       = NULL; /**< Signaled when a job finishes. */
+static unsigned int save_nextId  = 0; /**< Number of the next job. */
+static unsigned int save_lastId  = 0; /**< Number of the newest job written. */
+static int save_pending          = 0; /**< Jobs not finished yet. */
+static SaveJob *save_finished    = NULL; /**< Finished jobs waiting for save_update(). */
+
 
 /*
  * prototypes
@@ -59,7 +86,35 @@ extern int space_sysSave( xmlTextWriterPtr writer ); /**< Saves the space stuff.
 /* unidiff.c */
 extern int diff_save( xmlTextWriterPtr writer ); /**< Saves the universe diffs. */
 /* static */
+static int save_header( xmlTextWriterPtr writer );
 static int save_data( xmlTextWriterPtr writer );
+static int save_write( void *data );
+static void save_complete( int ret, const char *path );
+
+
+/**
+ * @brief Saves the summary shown by the load menu.
+ *
+ * Duplicates some of the player data so the load menu can stop reading
+ *  right after it instead of parsing the whole savegame.
+ *
+ *    @param writer XML writer to use.
+ *    @return 0 on success.
+ */
+static int save_header( xmlTextWriterPtr writer )
+{
+   xmlw_startElem(writer,"header");
+   xmlw_elem(writer,"name","%s",player.name);
+   if (land_planet != NULL)
+      xmlw_elem(writer,"location","%s",land_planet->name);
+   xmlw_elem(writer,"credits","%"CREDITS_PRI,player.p->credits);
+   xmlw_elem(writer,"date","%"PRIi64,ntime_get());
+   xmlw_elem(writer,"shipname","%s",player.p->name);
+   xmlw_elem(writer,"shipmodel","%s",player.p->ship->name);
+   xmlw_endElem(writer); /* "header" */
+
+   return 0;
+}
 
 
 /**
@@ -88,11 +143,14 @@ static int save_data( xmlTextWriterPtr writer )
 /**
  * @brief Saves the current game.
  *
+ * The savegame is only built here, writing it to disk happens in the
+ *  background and errors are reported once done.
+ *
  *    @return 0 on success.
  */
 int save_all (void)
 {
-   char file[PATH_MAX];
+   SaveJob *job;
    xmlDocPtr doc;
    xmlTextWriterPtr writer;
 
@@ -120,6 +178,12 @@ int save_all (void)
    xmlw_elem( writer, "data", "%s", ndata_name() );
    xmlw_endElem(writer); /* "version" */
 
+   /* Save the header. */
+   if (save_header(writer) < 0) {
+      ERR("Trying to save game header");
+      goto err_writer;
+   }
+
    /* Save the data. */
    if (save_data(writer) < 0) {
       ERR("Trying to save game data");
@@ -130,31 +194,37 @@ int save_all (void)
    xmlw_endElem(writer); /* "naev_save" */
    xmlw_done(writer);
 
+   xmlFreeTextWriter(writer);
+
    /* Write to file. */
    if ((nfile_dirMakeExist("%s", nfile_dataPath()) < 0) ||
          (nfile_dirMakeExist("%ssaves", nfile_dataPath()) < 0)) {
       WARN("Failed to create save directory '%ssaves'.", nfile_dataPath());
-      goto err_writer;
+      goto err;
    }
-   nsnprintf(file, PATH_MAX, "%ssaves/%s.ns", nfile_dataPath(), player.name);
 
-   /* Back up old savegame. */
-   if (!save_loaded) {
-      if (nfile_backupIfExists(file) < 0) {
-         WARN("Aborting save...");
-         goto err_writer;
-      }
+   /* Hand it over to be written in the background. */
+   if (save_lock == NULL) {
+      save_lock      = SDL_CreateMutex();
+      save_writeLock = SDL_CreateMutex();
+      save_cond      = SDL_CreateCond();
    }
+   job         = calloc( 1, sizeof(SaveJob) );
+   job->doc    = doc;
+   job->backup = !save_loaded;
+   job->binary = conf.save_binary;
+   job->done   = save_complete;
+   nsnprintf(job->path, PATH_MAX, "%ssaves/%s.ns", nfile_dataPath(), player.name);
    save_loaded = 0;
 
-   /* Critical section, if crashes here player's game gets corrupted.
-    * Luckily we have a copy just in case... */
-   xmlFreeTextWriter(writer);
-   if (xmlSaveFileEnc(file, doc, "UTF-8") < 0) {
-      WARN("Failed to write savegame!  You'll most likely have to restore it by copying your backup savegame over your current savegame.");
-      goto err;
+   SDL_mutexP( save_lock );
+   job->id = ++save_nextId;
+   save_pending++;
+   SDL_mutexV( save_lock );
+   if (threadpool_newJob( save_write, job ) < 0) {
+      save_write( job );
+      save_update();
    }
-   xmlFreeDoc(doc);
 
    return 0;
 
@@ -165,6 +235,142 @@ err:
    return -1;
 }
 
+
+/**
+ * @brief Writes a savegame, run from the threadpool.
+ *
+ * Writes to a temporary file that only replaces the savegame once it's fully
+ *  on disk, so a crash at any point leaves either the old or the new one.
+ *
+ *    @param data SaveJob to write.
+ *    @return 0 on success.
+ */
+static int save_write( void *data )
+{
+   SaveJob *job;
+   char tmp[PATH_MAX];
+   int ret;
+#ifdef DEBUGGING
+   unsigned int time = SDL_GetTicks();
+#endif /* DEBUGGING */
+
+   job = (SaveJob*) data;
+
+   SDL_mutexP( save_writeLock );
+   /* A newer savegame was already written. */
+   if (job->id < save_lastId)
+      job->ret = 0;
+   else {
+      nsnprintf( tmp, sizeof(tmp), "%s.tmp", job->path );
+      job->ret = -1;
+      if (job->binary)
+         ret = nbxml_saveFile( tmp, job->doc );
+      else
+         ret = (xmlSaveFileEnc( tmp, job->doc, "UTF-8" ) < 0) ? -1 : 0;
+      if (ret)
+         WARN("Failed to write savegame '%s'!", tmp);
+      else if ((nfile_sync( tmp ) == 0) &&
+            (!job->backup || (nfile_backupIfExists( job->path ) == 0)) &&
+            (nfile_replace( tmp, job->path ) == 0))
+         job->ret = 0;
+      save_lastId = job->id;
+#ifdef DEBUGGING
+      DEBUG("Wrote %s savegame in %u ms", job->binary ? "binary" : "XML",
+            SDL_GetTicks() - time );
+#endif /* DEBUGGING */
+   }
+   SDL_mutexV( save_writeLock );
+   xmlFreeDoc( job->doc );
+   job->doc = NULL;
+
+   /* Report back to the main thread. */
+   SDL_mutexP( save_lock );
+   job->next     = save_finished;
+   save_finished = job;
+   save_pending--;
+   SDL_CondBroadcast( save_cond );
+   SDL_mutexV( save_lock );
+
+   return job->ret;
+}
+
+
+/**
+ * @brief Reports the result of writing a savegame.
+ *
+ *    @param ret Result of the write.
+ *    @param path Path of the savegame.
+ */
+static void save_complete( int ret, const char *path )
+{
+   if (ret == 0)
+      return;
+   dialogue_alert( "Failed to save game to '%s'! You should exit and check the log to see what happened and then file a bug report!", path );
+}
+
+
+/**
+ * @brief Runs the callbacks of finished savegame writes.
+ *
+ * Should be called from the main thread every frame.
+ */
+void save_update (void)
+{
+   SaveJob *job, *next;
+
+   if (save_lock == NULL)
+      return;
+
+   SDL_mutexP( save_lock );
+   job           = save_finished;
+   save_finished = NULL;
+   SDL_mutexV( save_lock );
+
+   for ( ; job != NULL; job = next) {
+      next = job->next;
+      if (job->done != NULL)
+         job->done( job->ret, job->path );
+      free( job );
+   }
+}
+
+
+/**
+ * @brief Waits for all pending savegames to be written.
+ *
+ * Must be called before reading savegames or exiting.
+ */
+void save_flush (void)
+{
+   if (save_lock == NULL)
+      return;
+
+   SDL_mutexP( save_lock );
+   while (save_pending > 0)
+      SDL_CondWait( save_cond, save_lock );
+   SDL_mutexV( save_lock );
+
+   save_update();
+}
+
+
+/**
+ * @brief Writes pending savegames and cleans up.
+ */
+void save_exit (void)
+{
+   save_flush();
+   if (save_lock == NULL)
+      return;
+
+   SDL_DestroyMutex( save_lock );
+   SDL_DestroyMutex( save_writeLock );
+   SDL_DestroyCond( save_cond );
+   save_lock      = NULL;
+   save_writeLock = NULL;
+   save_cond      = NULL;
+}
+
 /**
  * @brief Reload the current savegame.
  */
@@ -188,6 +394,7 @@ int save_hasSave (void)
    int has_save;
 
    /* Look for saved games. */
+   save_flush();
    files = nfile_readDir( &nfiles, "%ssaves", nfile_dataPath() );
    has_save = 0;
    for (i=0; i<nfiles; i++) {
@@ -208,3 +415,76 @@ int save_hasSave (void)
    return has_save;
 }
 
+
+/**
+ * @brief Converts a savegame between the XML and binary formats.
+ *
+ * The converted savegame replaces the original, which gets backed up first.
+ *  Both versions are read back and timed to compare the formats.
+ *
+ *    @param path Savegame to convert.
+ *    @return 0 on success.
+ */
+int save_convert( const char *path )
+{
+   xmlDocPtr doc;
+   char tmp[PATH_MAX];
+   int binary, ret;
+   unsigned int t, tread, twrite, tcheck;
+   size_t size_old, size_new;
+
+   /* Read the original. */
+   binary = nbxml_isBinary( path );
+   t      = SDL_GetTicks();
+   doc    = nbxml_readFile( path );
+   tread  = SDL_GetTicks() - t;
+   if (doc == NULL) {
+      WARN("Unable to read savegame '%s'.", path);
+      return -1;
+   }
+
+   /* Write the other format. */
+   nsnprintf( tmp, sizeof(tmp), "%s.tmp", path );
+   t = SDL_GetTicks();
+   if (binary) {
+      xmlSetDocCompressMode( doc, conf.save_compress );
+      ret = (xmlSaveFileEnc( tmp, doc, "UTF-8" ) < 0) ? -1 : 0;
+   }
+   else
+      ret = nbxml_saveFile( tmp, doc );
+   twrite = SDL_GetTicks() - t;
+   xmlFreeDoc( doc );
+   if (ret) {
+      WARN("Unable to write converted savegame '%s'.", tmp);
+      return -1;
+   }
+
+   /* Make sure it reads back. */
+   t      = SDL_GetTicks();
+   doc    = nbxml_readFile( tmp );
+   tcheck = SDL_GetTicks() - t;
+   if (doc == NULL) {
+      WARN("Converted savegame '%s' is unreadable.", tmp);
+      nfile_delete( tmp );
+      return -1;
+   }
+   xmlFreeDoc( doc );
+
+   /* Replace the original. */
+   size_old = size_new = 0;
+   nfile_fileInfo( NULL, &size_old, "%s", path );
+   nfile_fileInfo( NULL, &size_new, "%s", tmp );
+   if (nfile_backupIfExists( path ) || nfile_sync( tmp ) || nfile_replace( tmp, path )) {
+      WARN("Unable to replace savegame '%s'.", path);
+      return -1;
+   }
+
+   LOG("Converted '%s' from %s to %s:", path,
+         binary ? "binary" : "XML", binary ? "XML" : "binary" );
+   LOG("   %-6s %8lu bytes, read in %u ms", binary ? "binary" : "XML",
+         (unsigned long) size_old, tread );
+   LOG("   %-6s %8lu bytes, read in %u ms, written in %u ms", binary ? "XML" : "binary",
+         (unsigned long) size_new, tcheck, twrite );
+
+   return 0;
+}
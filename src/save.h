@@ -10,6 +10,10 @@
 int save_all (void);
 void save_reload (void);
 int save_hasSave (void);
+void save_update (void);
+void save_flush (void);
+void save_exit (void);
+int save_convert( const char *path );
 
 
 #endif /* SAVE_H */
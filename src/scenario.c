@@ -0,0 +1,499 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file scenario.c
+ *
+ * @brief Runs scripted battles to load test the simulation.
+ *
+ * A scenario sets up a system with the given fleets and ships from a fixed
+ *  RNG seed and lets them fight for a while, recording what every frame cost
+ *  along with how many pilots and weapons were around. It can be run headless
+ *  for repeatable numbers or windowed to watch it.
+ *
+ * Scenarios look like:
+ * @code
+ * <scenario>
+ *  <system>Gamma Polaris</system>
+ *  <seed>42</seed>
+ *  <time>60</time>
+ *  <nospawn />
+ *  <fleet count="4" x="-3000" y="0">Empire Lge Attack</fleet>
+ *  <pilot faction="Pirate" ai="pirate" count="20" x="3000" y="0">Pirate Kestrel</pilot>
+ *  <output>battle.csv</output>
+ * </scenario>
+ * @endcode
+ */
+
+
+#include "scenario.h"
+
+#include "naev.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "nstring.h"
+
+#if HAS_POSIX
+#include <sys/resource.h>
+#endif /* HAS_POSIX */
+
+#include "log.h"
+#include "conf.h"
+#include "nxml.h"
+#include "ndata.h"
+#include "nfile.h"
+#include "rng.h"
+#include "array.h"
+#include "perf.h"
+#include "pilot.h"
+#include "fleet.h"
+#include "faction.h"
+#include "weapon.h"
+#include "space.h"
+#include "camera.h"
+#include "pause.h"
+
+
+#define XML_SCENARIO_ID    "scenario" /**< Scenario XML document tag. */
+
+#define SCENARIO_SPREAD    500. /**< Radius pilots of a group are spread over. */
+
+
+/**
+ * @brief A frame of the scenario.
+ */
+typedef struct ScenarioFrame_ {
+   float t; /**< Simulated time at the end of the frame. */
+   float ms; /**< Milliseconds spent updating. */
+   int pilots; /**< Pilots in the system. */
+   int weapons; /**< Weapons in flight. */
+} ScenarioFrame;
+
+
+static int scenario_running         = 0; /**< A scenario is running. */
+static char *scenario_name          = NULL; /**< Name of the scenario. */
+static char *scenario_output        = NULL; /**< Where to save the frames. */
+static double scenario_time         = 0.; /**< Simulated seconds to run for. */
+static double scenario_t            = 0.; /**< Simulated seconds run so far. */
+static ScenarioFrame *scenario_frames = NULL; /**< Recorded frames. */
+
+
+/*
+ * Prototypes.
+ */
+static int scenario_load( xmlNodePtr parent );
+static int scenario_addGroup( xmlNodePtr node );
+static void scenario_groupPos( xmlNodePtr node, Vector2d *pos );
+static int scenario_cmpFloat( const void *p1, const void *p2 );
+static long scenario_peakMem (void);
+static int scenario_save (void);
+static void scenario_free (void);
+
+
+/**
+ * @brief Loads and sets up a scenario.
+ *
+ * The name can either be a path or the name of a scenario in the data.
+ *
+ *    @param name Scenario to start.
+ *    @return 0 on success.
+ */
+int scenario_start( const char *name )
+{
+   char path[PATH_MAX];
+   char *buf;
+   uint32_t bufsize;
+   int size, ret, n;
+   xmlDocPtr doc;
+   xmlNodePtr node;
+
+   if (scenario_running) {
+      WARN("A scenario is already running!");
+      return -1;
+   }
+
+   /* Files on disk take priority over the data. */
+   if (nfile_fileExists( name )) {
+      buf     = nfile_readFile( &size, name );
+      bufsize = (buf == NULL) ? 0 : size;
+   }
+   else {
+      nsnprintf( path, sizeof(path), SCENARIO_DATA_PATH"%s.xml", name );
+      buf = ndata_read( path, &bufsize );
+   }
+   if (buf == NULL) {
+      WARN("Scenario '%s' not found!", name);
+      return -1;
+   }
+
+   doc = xmlParseMemory( buf, bufsize );
+   free( buf );
+   if (doc == NULL) {
+      WARN("Unable to parse scenario '%s'!", name);
+      return -1;
+   }
+   node = doc->xmlChildrenNode;
+   if (!xml_isNode(node,XML_SCENARIO_ID)) {
+      WARN("Malformed scenario '%s': missing root element '"XML_SCENARIO_ID"'", name);
+      xmlFreeDoc( doc );
+      return -1;
+   }
+
+   scenario_name   = strdup( name );
+   scenario_time   = SCENARIO_TIME_DEFAULT;
+   scenario_t      = 0.;
+   scenario_frames = array_create( ScenarioFrame );
+   ret = scenario_load( node );
+   xmlFreeDoc( doc );
+   if (ret) {
+      scenario_free();
+      return -1;
+   }
+
+   /* Watch the battle from the middle when windowed. */
+   cam_setTargetPos( 0., 0., 0 );
+   cam_setZoom( conf.zoom_far );
+   pause_setSpeed( 1. );
+
+   /* Update cost is taken from the frame timing. */
+   perf_enable( 1 );
+   scenario_running = 1;
+
+   pilot_getAll( &n );
+   LOG("Scenario '%s': running %.1f seconds in %s with %d pilots",
+         scenario_name, scenario_time, cur_system->name, n );
+   return 0;
+}
+
+
+/**
+ * @brief Sets up the scenario from its XML.
+ *
+ *    @param parent Root node of the scenario.
+ *    @return 0 on success.
+ */
+static int scenario_load( xmlNodePtr parent )
+{
+   xmlNodePtr node;
+   char *sys;
+   uint32_t seed;
+   int nospawn;
+
+   /* Settings come first, groups need the system. */
+   sys     = NULL;
+   seed    = 0;
+   nospawn = 0;
+   node    = parent->xmlChildrenNode;
+   do {
+      xml_onlyNodes(node);
+      xmlr_str( node, "system", sys );
+      xmlr_uint( node, "seed", seed );
+      xmlr_float( node, "time", scenario_time );
+      xmlr_strd( node, "output", scenario_output );
+      if (xml_isNode(node,"nospawn")) {
+         nospawn = 1;
+         continue;
+      }
+      if (xml_isNode(node,"fleet") || xml_isNode(node,"pilot"))
+         continue;
+      WARN("Scenario '%s' has unknown node '%s'.", scenario_name, node->name);
+   } while (xml_nextNode(node));
+
+   if ((sys == NULL) || !system_exists( sys )) {
+      WARN("Scenario '%s' needs a valid system!", scenario_name);
+      return -1;
+   }
+
+   /* Everything random from here on is reproducible. */
+   rng_seed( seed );
+   space_init( sys );
+   if (nospawn) {
+      space_spawn = 0;
+      pilots_clean();
+   }
+
+   node = parent->xmlChildrenNode;
+   do {
+      xml_onlyNodes(node);
+      if (xml_isNode(node,"fleet") || xml_isNode(node,"pilot"))
+         if (scenario_addGroup( node ))
+            return -1;
+   } while (xml_nextNode(node));
+
+   return 0;
+}
+
+
+/**
+ * @brief Gets where a group is centred, random if not set.
+ *
+ *    @param node Group node.
+ *    @param[out] pos Centre of the group.
+ */
+static void scenario_groupPos( xmlNodePtr node, Vector2d *pos )
+{
+   char *x, *y;
+
+   xmlr_attr( node, "x", x );
+   xmlr_attr( node, "y", y );
+   if ((x != NULL) && (y != NULL))
+      vect_cset( pos, atof(x), atof(y) );
+   else
+      vect_pset( pos, RNGF() * cur_system->radius / 2., RNGF() * 2. * M_PI );
+   free( x );
+   free( y );
+}
+
+
+/**
+ * @brief Adds a group of fleets or pilots to the scenario.
+ *
+ *    @param node Group node.
+ *    @return 0 on success.
+ */
+static int scenario_addGroup( xmlNodePtr node )
+{
+   Fleet *flt;
+   Ship *ship;
+   Vector2d centre, vp, vv;
+   PilotFlags flags;
+   char *buf, *ai;
+   int i, j, count, faction;
+
+   ship    = NULL;
+   flt     = NULL;
+   ai      = NULL;
+   faction = -1;
+   if (xml_get(node) == NULL) {
+      WARN("Scenario '%s' has a %s without a name!", scenario_name, node->name);
+      return -1;
+   }
+   if (xml_isNode(node,"fleet")) {
+      flt = fleet_get( xml_get(node) );
+      if (flt == NULL) {
+         WARN("Fleet '%s' not found!", xml_get(node));
+         return -1;
+      }
+   }
+   else {
+      ship = ship_get( xml_get(node) );
+      xmlr_attr( node, "faction", buf );
+      if (buf != NULL) {
+         faction = faction_get( buf );
+         free( buf );
+      }
+      xmlr_attr( node, "ai", ai );
+      if ((ship == NULL) || (faction < 0) || (ai == NULL)) {
+         WARN("Scenario '%s' pilot needs a valid ship, faction and ai!", scenario_name);
+         free( ai );
+         return -1;
+      }
+   }
+
+   xmlr_attr( node, "count", buf );
+   count = (buf != NULL) ? atoi( buf ) : 1;
+   free( buf );
+
+   scenario_groupPos( node, &centre );
+   pilot_clearFlagsRaw( flags );
+   vectnull( &vv );
+   for (i=0; i<count; i++) {
+      if (flt != NULL) {
+         /* Fleet members stay together. */
+         vect_pset( &vp, RNGF() * SCENARIO_SPREAD, RNGF() * 2. * M_PI );
+         vect_cadd( &vp, centre.x, centre.y );
+         for (j=0; j<flt->npilots; j++)
+            fleet_createPilot( flt, &flt->pilots[j], RNGF() * 2. * M_PI,
+                  &vp, &vv, NULL, flags, -1 );
+      }
+      else {
+         vect_pset( &vp, RNGF() * SCENARIO_SPREAD, RNGF() * 2. * M_PI );
+         vect_cadd( &vp, centre.x, centre.y );
+         pilot_create( ship, ship->name, faction, ai, RNGF() * 2. * M_PI,
+               &vp, &vv, flags, -1 );
+      }
+   }
+
+   free( ai );
+   return 0;
+}
+
+
+/**
+ * @brief Records a frame of the scenario.
+ *
+ * Must be called after every timed frame that was simulated.
+ *
+ *    @param dt Simulated seconds the frame advanced.
+ *    @return 1 once the scenario is over.
+ */
+int scenario_frame( double dt )
+{
+   ScenarioFrame *f;
+
+   if (!scenario_running)
+      return 0;
+
+   scenario_t += dt;
+   f = &array_grow( &scenario_frames );
+   f->t       = scenario_t;
+   f->ms      = perf_last( PERF_UPDATE );
+   pilot_getAll( &f->pilots );
+   f->weapons = weapon_count();
+
+   return (scenario_t >= scenario_time);
+}
+
+
+/**
+ * @brief Checks to see if a scenario is running.
+ */
+int scenario_active (void)
+{
+   return scenario_running;
+}
+
+
+/**
+ * @brief Compares floats for qsort.
+ */
+static int scenario_cmpFloat( const void *p1, const void *p2 )
+{
+   float f1, f2;
+   f1 = *(const float*)p1;
+   f2 = *(const float*)p2;
+   if (f1 < f2)
+      return -1;
+   else if (f1 > f2)
+      return 1;
+   return 0;
+}
+
+
+/**
+ * @brief Gets the peak resident memory of the process.
+ *
+ *    @return Peak memory in kilobytes or -1 if unknown.
+ */
+static long scenario_peakMem (void)
+{
+#if HAS_POSIX
+   struct rusage ru;
+   if (getrusage( RUSAGE_SELF, &ru ) != 0)
+      return -1;
+#if HAS_MACOSX
+   return ru.ru_maxrss / 1024; /* Bytes on Mac OS X. */
+#else /* HAS_MACOSX */
+   return ru.ru_maxrss;
+#endif /* HAS_MACOSX */
+#else /* HAS_POSIX */
+   return -1;
+#endif /* HAS_POSIX */
+}
+
+
+/**
+ * @brief Saves the recorded frames as CSV.
+ *
+ *    @return 0 on success.
+ */
+static int scenario_save (void)
+{
+   FILE *f;
+   int i, n;
+   ScenarioFrame *fr;
+
+   f = fopen( scenario_output, "w" );
+   if (f == NULL) {
+      WARN("Unable to open '%s' for writing.", scenario_output);
+      return -1;
+   }
+
+   n = array_size( scenario_frames );
+   fprintf( f, "time,update_ms,pilots,weapons\n" );
+   for (i=0; i<n; i++) {
+      fr = &scenario_frames[i];
+      fprintf( f, "%.4f,%.4f,%d,%d\n", fr->t, fr->ms, fr->pilots, fr->weapons );
+   }
+
+   if (fclose( f ) != 0) {
+      WARN("Unable to write scenario frames '%s'.", scenario_output);
+      return -1;
+   }
+   LOG("Scenario '%s': saved %d frames to '%s'.", scenario_name, n, scenario_output);
+   return 0;
+}
+
+
+/**
+ * @brief Finishes the scenario and reports the results.
+ *
+ *    @return 0 on success.
+ */
+int scenario_end (void)
+{
+   float *ms;
+   double sum;
+   int i, n, ret, pmax, wmax;
+   long mem;
+
+   if (!scenario_running)
+      return 0;
+   perf_enable( 0 );
+
+   n = array_size( scenario_frames );
+   if (n == 0) {
+      WARN("Scenario '%s' ended without running a frame.", scenario_name);
+      scenario_free();
+      return -1;
+   }
+
+   /* Update cost percentiles and peak load. */
+   ms   = malloc( n * sizeof(float) );
+   sum  = 0.;
+   pmax = 0;
+   wmax = 0;
+   for (i=0; i<n; i++) {
+      ms[i] = scenario_frames[i].ms;
+      sum  += ms[i];
+      pmax  = MAX( pmax, scenario_frames[i].pilots );
+      wmax  = MAX( wmax, scenario_frames[i].weapons );
+   }
+   qsort( ms, n, sizeof(float), scenario_cmpFloat );
+   mem = scenario_peakMem();
+
+   LOG("Scenario '%s': %.1f simulated seconds in %d frames",
+         scenario_name, scenario_t, n );
+   LOG("Scenario '%s': update ms min %.3f, avg %.3f, p50 %.3f, p99 %.3f, max %.3f",
+         scenario_name, ms[0], sum / (double)n, ms[ n/2 ],
+         ms[ (int)ceil( 0.99 * n ) - 1 ], ms[n-1] );
+   LOG("Scenario '%s': peak %d pilots, %d weapons, %ld KiB resident",
+         scenario_name, pmax, wmax, mem );
+   free( ms );
+
+   ret = 0;
+   if (scenario_output != NULL)
+      ret = scenario_save();
+
+   scenario_free();
+   return ret;
+}
+
+
+/**
+ * @brief Frees the scenario.
+ */
+static void scenario_free (void)
+{
+   free( scenario_name );
+   scenario_name = NULL;
+   free( scenario_output );
+   scenario_output = NULL;
+   if (scenario_frames != NULL) {
+      array_free( scenario_frames );
+      scenario_frames = NULL;
+   }
+   scenario_running = 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef SCENARIO_H
+#  define SCENARIO_H
+
+
+#define SCENARIO_TIME_DEFAULT    60. /**< Default simulated seconds to run for. */
+
+
+/*
+ * Running.
+ */
+int scenario_start( const char *name );
+int scenario_frame( double dt );
+int scenario_end (void);
+int scenario_active (void);
+
+
+#endif /* SCENARIO_H */
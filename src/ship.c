@@ -28,6 +28,7 @@
 #include "shipstats.h"
 #include "slots.h"
 #include "nfile.h"
+#include "texcache.h"
 
 
 #define XML_SHIP  "ship" /**< XML individual ship identifier. */
@@ -45,14 +46,20 @@
 
 #define STATS_DESC_MAX 256 /**< Maximum length for statistics description. */
 
+#define SHIP_GFX_UNLOAD_AGE   3 /**< Graphics generations a ship can go unwanted before being unloaded. */
+#define SHIP_PLACEHOLDER_SIZE 32 /**< Size of a sprite of the placeholder graphics. */
+
 
 static Ship* ship_stack = NULL; /**< Stack of ships available in the game. */
+static unsigned int ship_gfxGen = 0; /**< Current graphics generation, bumped on every collection. */
+static glTexture **ship_placeholders = NULL; /**< Placeholder sprites for ships whose graphics failed to load. */
 
 
 /*
  * Prototypes
  */
-static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine );
+static int ship_setGFX( Ship *temp, char *buf, int sx, int sy, int engine );
+static glTexture* ship_gfxPlaceholder( int sx, int sy );
 static int ship_parse( Ship *temp, xmlNodePtr parent );
 
 
@@ -330,9 +337,18 @@ glTexture* ship_loadCommGFX( Ship* s )
 
 
 /**
- * @brief Generates a target graphic for a ship.
+ * @brief Generates the target and store graphics surfaces for a ship.
+ *
+ *    @param temp Ship to generate graphics for, space graphic must be loaded.
+ *    @param surface Surface of the space graphic.
+ *    @param sx Number of sprites on the X axis.
+ *    @param sy Number of sprites on the Y axis.
+ *    @param[out] target Padded target surface.
+ *    @param[out] store Padded store surface.
+ *    @return 0 on success.
  */
-static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
+static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy,
+      SDL_Surface **target, SDL_Surface **store )
 {
    SDL_Surface *gfx, *gfx_store;
    int potw, poth, potw_store, poth_store;
@@ -344,7 +360,6 @@ static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
    double r, g, b, a;
    double h, s, v;
 #endif
-   char buf[PATH_MAX];
 #if ! SDL_VERSION_ATLEAST(1,3,0)
    Uint32 saved_flags;
 #endif /* ! SDL_VERSION_ATLEAST(1,3,0) */
@@ -390,8 +405,12 @@ static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
          potw_store, poth_store, surface->format->BytesPerPixel*8, RGBAMASK );
 #endif /* SDL_VERSION_ATLEAST(1,3,0) */
 
-   if (gfx == NULL) {
+   if ((gfx == NULL) || (gfx_store == NULL)) {
       WARN( "Unable to create ship '%s' targeting surface.", temp->name );
+      if (gfx != NULL)
+         SDL_FreeSurface( gfx );
+      if (gfx_store != NULL)
+         SDL_FreeSurface( gfx_store );
       return -1;
    }
 
@@ -420,10 +439,6 @@ static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
       SDL_SetAlpha( surface, 0, 0 );
 #endif /* ! SDL_VERSION_ATLEAST(1,3,0) */
 
-   /* Load the store surface. */
-   nsnprintf( buf, sizeof(buf), "%s_gfx_store.png", temp->name );
-   temp->gfx_store = gl_loadImagePad( buf, gfx_store, 0, SHIP_TARGET_W, SHIP_TARGET_H, 1, 1, 1 );
-
 #if 0 /* Disabled for now due to issues with larger sprites. */
    /* Some filtering. */
    for (j=0; j<sh; j++) {
@@ -455,28 +470,28 @@ static int ship_genTargetGFX( Ship *temp, SDL_Surface *surface, int sx, int sy )
    }
 #endif
 
-   /* Load the surface. */
-   nsnprintf( buf, sizeof(buf), "%s_gfx_target.png", temp->name );
-   temp->gfx_target = gl_loadImagePad( buf, gfx, 0, sw, sh, 1, 1, 1 );
-
+   *target = gfx;
+   *store  = gfx_store;
    return 0;
 }
 
 
 /**
- * @brief Loads the graphics for a ship.
+ * @brief Sets up the paths of the graphics of a ship.
+ *
+ * The graphics themselves are only loaded when first needed with
+ *  ship_gfxLoad().
  *
- *    @param temp Ship to load into.
+ *    @param temp Ship to set up.
  *    @param buf Name of the texture to work with.
+ *    @param sx Number of sprites on the X axis.
+ *    @param sy Number of sprites on the Y axis.
+ *    @param engine Whether or not the ship has an engine glow sprite.
  */
-static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine )
+static int ship_setGFX( Ship *temp, char *buf, int sx, int sy, int engine )
 {
    char base[PATH_MAX], str[PATH_MAX];
    int i;
-   png_uint_32 w, h;
-   SDL_RWops *rw;
-   npng_t *npng;
-   SDL_Surface *surface;
 
    /* Get base path. */
    for (i=0; i<PATH_MAX; i++) {
@@ -491,37 +506,21 @@ static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine )
       return -1;
    }
 
-   /* Load the space sprite. */
+   /* Space sprite. */
    nsnprintf( str, PATH_MAX, SHIP_GFX_PATH"%s/%s"SHIP_EXT, base, buf );
-   rw    = ndata_rwops( str );
-   npng  = npng_open( rw );
-   npng_dim( npng, &w, &h );
-   surface = npng_readSurface( npng, gl_needPOT(), 1 );
-
-   /* Load the texture. */
-   temp->gfx_space = gl_loadImagePad( str, surface,
-         OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS,
-         w, h, sx, sy, 0 );
-
-   /* Create the target graphic. */
-   ship_genTargetGFX( temp, surface, sx, sy );
+   temp->gfx_path = strdup(str);
+   temp->gfx_sx   = sx;
+   temp->gfx_sy   = sy;
 
-   /* Free stuff. */
-   npng_close( npng );
-   SDL_RWclose( rw );
-   SDL_FreeSurface( surface );
-
-   /* Load the engine sprite .*/
-   if (engine && conf.engineglow && conf.interpolate) {
+   /* Engine sprite .*/
+   if (engine) {
       nsnprintf( str, PATH_MAX, SHIP_GFX_PATH"%s/%s"SHIP_ENGINE SHIP_EXT, base, buf );
-      temp->gfx_engine = gl_newSprite( str, sx, sy, OPENGL_TEX_MIPMAPS );
-      if (temp->gfx_engine == NULL)
-         WARN("Ship '%s' does not have an engine sprite (%s).", temp->name, str );
+      temp->gfx_enginePath = strdup(str);
    }
 
    /* Calculate mount angle. */
    temp->mangle  = 2.*M_PI;
-   temp->mangle /= temp->gfx_space->sx * temp->gfx_space->sy;
+   temp->mangle /= sx * sy;
 
    /* Get the comm graphic for future loading. */
    nsnprintf( str, PATH_MAX, SHIP_GFX_PATH"%s/%s"SHIP_COMM SHIP_EXT, base, buf );
@@ -531,6 +530,261 @@ static int ship_loadGFX( Ship *temp, char *buf, int sx, int sy, int engine )
 }
 
 
+/**
+ * @brief Gets a placeholder sprite sheet for ships whose graphics can't be loaded.
+ *
+ * Sprites are solid squares so the pilot can still be seen and hit.
+ *
+ *    @param sx Number of sprites on the X axis.
+ *    @param sy Number of sprites on the Y axis.
+ *    @return The placeholder, must be freed with gl_freeTexture().
+ */
+static glTexture* ship_gfxPlaceholder( int sx, int sy )
+{
+   char buf[PATH_MAX];
+   SDL_Surface *surface;
+   SDL_Rect rect;
+   glTexture *tex;
+   int i, w, h;
+
+   /* Share the placeholders with the same layout. */
+   if (ship_placeholders == NULL)
+      ship_placeholders = array_create( glTexture* );
+   for (i=0; i<array_size(ship_placeholders); i++)
+      if (((int)ship_placeholders[i]->sx == sx) && ((int)ship_placeholders[i]->sy == sy))
+         return gl_dupTexture( ship_placeholders[i] );
+
+   /* Create a padded surface with the sprite area filled. */
+   w = SHIP_PLACEHOLDER_SIZE * sx;
+   h = SHIP_PLACEHOLDER_SIZE * sy;
+   surface = SDL_CreateRGBSurface( 0, gl_needPOT() ? gl_pot(w) : w,
+         gl_needPOT() ? gl_pot(h) : h, 32, RGBAMASK );
+   if (surface == NULL) {
+      WARN("Unable to create placeholder ship graphics: %s", SDL_GetError());
+      return NULL;
+   }
+   rect.x = 0;
+   rect.y = 0;
+   rect.w = w;
+   rect.h = h;
+   SDL_FillRect( surface, &rect, SDL_MapRGBA( surface->format, 0x80, 0x80, 0x80, 0xFF ) );
+
+   nsnprintf( buf, sizeof(buf), "ship_placeholder_%dx%d", sx, sy );
+   tex = gl_loadImagePad( buf, surface, OPENGL_TEX_MAPTRANS, w, h, sx, sy, 1 );
+   if (tex == NULL)
+      return NULL;
+   array_push_back( &ship_placeholders, tex );
+   return gl_dupTexture( tex );
+}
+
+
+/**
+ * @brief Loads the graphics of a ship if they aren't loaded yet.
+ *
+ * Also marks them as wanted so they don't get collected soon. If the graphics
+ *  can't be loaded placeholders are used so gfx_space, gfx_target and gfx_store
+ *  are never NULL afterwards.
+ *
+ *    @param s Ship to load graphics of.
+ *    @return 0 on success.
+ */
+int ship_gfxLoad( Ship *s )
+{
+   png_uint_32 w, h;
+   SDL_RWops *rw;
+   npng_t *npng;
+   SDL_Surface *surface;
+   void *data;
+   uint32_t size;
+   TexCacheKey key;
+   char buf[PATH_MAX];
+   TexCacheImg img[3];
+   int i, cache;
+
+   s->gfx_used = ship_gfxGen;
+
+   /* Already loaded. */
+   if (s->gfx_space != NULL)
+      return 0;
+
+   /* Space sprite, target and store graphics all come from the same file. */
+   cache = (texcache_key( &key, s->gfx_path, "ship", (s->gfx_sx << 16) | s->gfx_sy ) == 0);
+   if (cache && (texcache_load( &key, img, 3 ) == 0)) {
+      /* Cached, the surfaces and transparency map get handed over. */
+      s->gfx_space = gl_loadImagePadTrans( s->gfx_path, img[0].surface, img[0].trans,
+            OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS,
+            img[0].w, img[0].h, img[0].sx, img[0].sy, 1 );
+      if (s->gfx_space == NULL) {
+         texcache_free( &img[1], 2 );
+         goto err;
+      }
+   }
+   else {
+      data = ndata_read( s->gfx_path, &size );
+      if (data == NULL) {
+         WARN("Ship '%s': unable to open '%s'.", s->name, s->gfx_path );
+         goto err;
+      }
+      rw    = SDL_RWFromConstMem( data, size );
+      npng  = npng_open( rw );
+      if (npng == NULL) {
+         WARN("Ship '%s': '%s' is not a png.", s->name, s->gfx_path );
+         SDL_RWclose( rw );
+         free( data );
+         goto err;
+      }
+      npng_dim( npng, &w, &h );
+      surface = npng_readSurface( npng, gl_needPOT(), 1 );
+      npng_close( npng );
+      SDL_RWclose( rw );
+      free( data );
+      if (surface == NULL) {
+         WARN("Ship '%s': unable to read '%s'.", s->name, s->gfx_path );
+         goto err;
+      }
+
+      /* Load the texture. */
+      s->gfx_space = gl_loadImagePad( s->gfx_path, surface,
+            OPENGL_TEX_MAPTRANS | OPENGL_TEX_MIPMAPS,
+            w, h, s->gfx_sx, s->gfx_sy, 0 );
+      if (s->gfx_space == NULL) {
+         SDL_FreeSurface( surface );
+         goto err;
+      }
+
+      /* Create the target graphic and store it all for next time. */
+      memset( img, 0, sizeof(img) );
+      if (ship_genTargetGFX( s, surface, s->gfx_sx, s->gfx_sy,
+               &img[1].surface, &img[2].surface ) == 0) {
+         img[0].w       = w;
+         img[0].h       = h;
+         img[0].sx      = s->gfx_sx;
+         img[0].sy      = s->gfx_sy;
+         img[0].surface = surface;
+         img[0].trans   = s->gfx_space->trans;
+         img[0].ntrans  = (w*h+7)/8;
+         img[1].w       = s->gfx_space->sw;
+         img[1].h       = s->gfx_space->sh;
+         img[2].w       = SHIP_TARGET_W;
+         img[2].h       = SHIP_TARGET_H;
+         for (i=1; i<3; i++)
+            img[i].sx = img[i].sy = 1;
+         if (cache)
+            texcache_save( &key, img, 3 );
+      }
+      SDL_FreeSurface( surface );
+   }
+
+   /* Load the target and store graphics. */
+   if (img[1].surface != NULL) {
+      nsnprintf( buf, sizeof(buf), "%s_gfx_target.png", s->name );
+      s->gfx_target = gl_loadImagePadTrans( buf, img[1].surface, NULL, 0,
+            img[1].w, img[1].h, 1, 1, 1 );
+   }
+   if (img[2].surface != NULL) {
+      nsnprintf( buf, sizeof(buf), "%s_gfx_store.png", s->name );
+      s->gfx_store = gl_loadImagePadTrans( buf, img[2].surface, NULL, 0,
+            img[2].w, img[2].h, 1, 1, 1 );
+   }
+
+   /* Load the engine sprite .*/
+   if ((s->gfx_enginePath != NULL) && conf.engineglow && conf.interpolate) {
+      s->gfx_engine = gl_newSprite( s->gfx_enginePath, s->gfx_sx, s->gfx_sy, OPENGL_TEX_MIPMAPS );
+      if (s->gfx_engine == NULL)
+         WARN("Ship '%s' does not have an engine sprite (%s).", s->name, s->gfx_enginePath );
+   }
+
+   return 0;
+
+err:
+   /* A single sprite placeholder does for the target and store graphics. */
+   s->gfx_space  = ship_gfxPlaceholder( s->gfx_sx, s->gfx_sy );
+   s->gfx_target = ship_gfxPlaceholder( 1, 1 );
+   s->gfx_store  = ship_gfxPlaceholder( 1, 1 );
+   return -1;
+}
+
+
+/**
+ * @brief Unloads the graphics of a ship.
+ *
+ *    @param s Ship to unload graphics of.
+ */
+void ship_gfxUnload( Ship *s )
+{
+   if (s->gfx_space != NULL)
+      gl_freeTexture(s->gfx_space);
+   if (s->gfx_engine != NULL)
+      gl_freeTexture(s->gfx_engine);
+   if (s->gfx_target != NULL)
+      gl_freeTexture(s->gfx_target);
+   if (s->gfx_store != NULL)
+      gl_freeTexture(s->gfx_store);
+   s->gfx_space  = NULL;
+   s->gfx_engine = NULL;
+   s->gfx_target = NULL;
+   s->gfx_store  = NULL;
+}
+
+
+/**
+ * @brief Marks the graphics of a ship as in use by a pilot, loading them if needed.
+ *
+ * Graphics in use never get collected, must be paired with ship_gfxRelease().
+ *
+ *    @param s Ship to use graphics of.
+ */
+void ship_gfxUse( Ship *s )
+{
+   ship_gfxLoad( s );
+   s->gfx_refs++;
+}
+
+
+/**
+ * @brief Releases the graphics of a ship used with ship_gfxUse().
+ *
+ *    @param s Ship to release graphics of.
+ */
+void ship_gfxRelease( Ship *s )
+{
+   s->gfx_refs--;
+   if (s->gfx_refs < 0) {
+      WARN("Ship '%s' graphics released more times than used!", s->name);
+      s->gfx_refs = 0;
+   }
+}
+
+
+/**
+ * @brief Unloads ship graphics that have not been used nor wanted for a while.
+ *
+ * Should be called once before loading the graphics wanted for a new system.
+ */
+void ships_gfxCollect (void)
+{
+   int i, n;
+   Ship *s;
+
+   ship_gfxGen++;
+
+   n = 0;
+   for (i=0; i<array_size(ship_stack); i++) {
+      s = &ship_stack[i];
+      if ((s->gfx_space == NULL) || (s->gfx_refs > 0) ||
+            (ship_gfxGen - s->gfx_used <= SHIP_GFX_UNLOAD_AGE))
+         continue;
+      ship_gfxUnload( s );
+      n++;
+   }
+
+#ifdef DEBUGGING
+   if (n > 0)
+      DEBUG("Unloaded graphics of %d unused ship%s", n, (n==1) ? "" : "s" );
+#endif /* DEBUGGING */
+}
+
+
 /**
  * @brief Parses a slot for a ship.
  *
@@ -727,8 +981,8 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
          else
             engine = 1;
 
-         /* Load the graphics. */
-         ship_loadGFX( temp, buf, sx, sy, engine );
+         /* Set up the graphics, they get loaded when needed. */
+         ship_setGFX( temp, buf, sx, sy, engine );
 
          continue;
       }
@@ -875,7 +1129,7 @@ static int ship_parse( Ship *temp, xmlNodePtr parent )
 #define MELEMENT(o,s)      if (o) WARN("Ship '%s' missing '"s"' element", temp->name)
    MELEMENT(temp->name==NULL,"name");
    MELEMENT(temp->base_type==NULL,"base_type");
-   MELEMENT(temp->gfx_space==NULL,"GFX");
+   MELEMENT(temp->gfx_path==NULL,"GFX");
    MELEMENT(temp->gui==NULL,"GUI");
    MELEMENT(temp->class==SHIP_CLASS_NULL,"class");
    MELEMENT(temp->price==0,"price");
@@ -1009,16 +1263,21 @@ void ships_free (void)
          ss_free( s->stats );
 
       /* Free graphics. */
-      gl_freeTexture(s->gfx_space);
-      if (s->gfx_engine != NULL)
-         gl_freeTexture(s->gfx_engine);
-      if (s->gfx_target != NULL)
-         gl_freeTexture(s->gfx_target);
-      if (s->gfx_store != NULL)
-         gl_freeTexture(s->gfx_store);
+      ship_gfxUnload( s );
+      free(s->gfx_path);
+      if (s->gfx_enginePath != NULL)
+         free(s->gfx_enginePath);
       free(s->gfx_comm);
    }
 
    array_free(ship_stack);
    ship_stack = NULL;
+
+   /* Free placeholders. */
+   if (ship_placeholders != NULL) {
+      for (i=0; i<array_size(ship_placeholders); i++)
+         gl_freeTexture( ship_placeholders[i] );
+      array_free( ship_placeholders );
+      ship_placeholders = NULL;
+   }
 }
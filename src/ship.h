@@ -114,11 +114,17 @@ typedef struct Ship_ {
    double dmg_absorb; /**< Damage absorption in per one [0:1] with 1 being 100% absorption. */
 
    /* graphics */
-   glTexture *gfx_space; /**< Space sprite sheet. */
+   glTexture *gfx_space; /**< Space sprite sheet, NULL if not loaded. */
    glTexture *gfx_engine; /**< Space engine glow sprite sheet. */
    glTexture *gfx_target; /**< Targeting window graphic. */
    glTexture *gfx_store; /**< Store graphic. */
    char* gfx_comm;   /**< Name of graphic for communication. */
+   char* gfx_path;   /**< Path of the space sprite sheet. */
+   char* gfx_enginePath; /**< Path of the engine glow sprite sheet, NULL if none. */
+   int gfx_sx;       /**< Number of sprites on the X axis. */
+   int gfx_sy;       /**< Number of sprites on the Y axis. */
+   int gfx_refs;     /**< Pilots using the graphics, can't be unloaded while in use. */
+   unsigned int gfx_used; /**< Graphics generation they were last wanted in. */
 
    /* GUI interface */
    char* gui;        /**< Name of the GUI the ship uses by default. */
@@ -164,6 +170,16 @@ credits_t ship_buyPrice( const Ship* s );
 glTexture* ship_loadCommGFX( Ship* s );
 
 
+/*
+ * graphics
+ */
+int ship_gfxLoad( Ship *s );
+void ship_gfxUnload( Ship *s );
+void ship_gfxUse( Ship *s );
+void ship_gfxRelease( Ship *s );
+void ships_gfxCollect (void);
+
+
 /*
  * misc.
  */
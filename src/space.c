@@ -37,11 +37,12 @@
 #include "fleet.h"
 #include "mission.h"
 #include "conf.h"
-#include "queue.h"
+#include "threadpool.h"
 #include "nlua.h"
 #include "nluadef.h"
 #include "nlua_pilot.h"
 #include "nlua_planet.h"
+#include "nlua_prof.h"
 #include "npng.h"
 #include "background.h"
 #include "map_overlay.h"
@@ -52,6 +53,8 @@
 #include "damagetype.h"
 #include "hook.h"
 #include "dev_uniedit.h"
+#include "array.h"
+#include "pilot_ew.h"
 
 
 #define XML_PLANET_TAG        "asset" /**< Individual planet xml tag. */
@@ -63,6 +66,14 @@
 #define CHUNK_SIZE            32 /**< Size to allocate by. */
 #define CHUNK_SIZE_SMALL       8 /**< Smaller size to allocate chunks by. */
 
+#define PRESENCE_JOBS         8 /**< Chunks presence reconstruction is split into. */
+
+/* Global rebuilds that can be deferred. */
+#define SPACE_DIRTY_JUMPS     (1<<0) /**< Jumps must be reconstructed. */
+#define SPACE_DIRTY_PRESENCE  (1<<1) /**< Presences must be reconstructed. */
+#define SPACE_DIRTY_ECONOMY   (1<<2) /**< Economy must be refreshed. */
+#define SPACE_DIRTY_GFX       (1<<3) /**< Current system graphics must be reloaded. */
+
 /* used to overcome warnings due to 0 values */
 #define FLAG_XSET             (1<<0) /**< Set the X position value. */
 #define FLAG_YSET             (1<<1) /**< Set the Y position value. */
@@ -98,6 +109,8 @@ static int planet_mstack = 0; /**< Memory size of planet stack. */
  * Misc.
  */
 static int systems_loading = 1; /**< Systems are loading. */
+static int space_deferred  = 0; /**< Nesting of deferred global rebuilds. */
+static unsigned int space_dirty = 0; /**< Global rebuilds pending, see SPACE_DIRTY_*. */
 StarSystem *cur_system = NULL; /**< Current star system. */
 glTexture *jumppoint_gfx = NULL; /**< Jump point graphics. */
 static glTexture *jumpbuoy_gfx = NULL; /**< Jump buoy graphics. */
@@ -138,7 +151,15 @@ static void system_parseJumps( const xmlNodePtr parent );
 /* misc */
 static int getPresenceIndex( StarSystem *sys, int faction );
 static void presenceCleanup( StarSystem *sys );
+static void system_spillRings( StarSystem *sys, int range );
+static void system_spillFree( StarSystem *sys );
+static int presence_accumulate( void *data );
+static void space_rebuildPresences (void);
+static void space_refreshEconomy (void);
 static void system_scheduler( double dt, int init );
+static void system_schedulerRun( SystemPresence *p, double dt, int init, int hide );
+static void space_spawnOutOfSight( Pilot *pilot );
+static void space_gfxLoadShips( StarSystem *sys );
 /* Render. */
 static void space_renderJumpPoint( JumpPoint *jp, int i );
 static void space_renderPlanet( Planet *p );
@@ -1035,147 +1056,251 @@ JumpPoint* jump_getTarget( StarSystem* target, const StarSystem* sys )
 /**
  * @brief Controls fleet spawning.
  *
+ * Initial spawns still pending are run first, but only for as long as
+ *  SYSTEM_POPULATE_BUDGET allows so that entering busy systems doesn't stall.
+ *  The rest is spread over the next real frames, they are not run while the
+ *  system is being simulated on entry.
+ *
  *    @param dt Current delta tick.
  *    @param init Should be 1 to initialize the scheduler.
  */
 static void system_scheduler( double dt, int init )
 {
-   int i, n, errf;
-   lua_State *L;
+   int i, n;
+   unsigned int start;
    SystemPresence *p;
-   LuaPilot *lp;
-   Pilot *pilot;
 
-   /* Go through all the factions and reduce the timer. */
+   /* Initial spawns, always do at least one. Headless runs must not depend on
+    * how fast the machine is. */
+   start = SDL_GetTicks();
+   n     = 0;
+   for (i=0; (init || !space_simulating) && (i < cur_system->npresence); i++) {
+      p = &cur_system->presence[i];
+      if (!p->pending || p->disabled)
+         continue;
+      if ((n > 0) && !conf.headless &&
+            (SDL_GetTicks() - start > SYSTEM_POPULATE_BUDGET))
+         break;
+      p->pending = 0;
+      /* Late spawns shouldn't pop in where the player can see them. */
+      system_schedulerRun( p, 0., 1, !init );
+      n++;
+   }
+   if (init)
+      return;
+
+   /* Regular spawns. */
    for (i=0; i < cur_system->npresence; i++) {
       p = &cur_system->presence[i];
-      L = faction_getScheduler( p->faction );
+      if (!p->pending)
+         system_schedulerRun( p, dt, 0, 0 );
+   }
+}
 
-      /* Must have a valid scheduler. */
-      if (L==NULL)
-         continue;
 
-      /* Spawning is disabled for this faction. */
-      if (p->disabled)
-         continue;
+/**
+ * @brief Runs the spawn script of a faction.
+ *
+ *    @param p Presence of the faction to run.
+ *    @param dt Current delta tick.
+ *    @param init Whether to run the initial spawn instead of the regular one.
+ *    @param hide Whether to move pilots spawned at arbitrary positions out of
+ *           the player's sight.
+ */
+static void system_schedulerRun( SystemPresence *p, double dt, int init, int hide )
+{
+   int n, errf, ret, mark;
+   lua_State *L;
+   LuaPilot *lp;
+   Pilot *pilot;
 
-      /* Run the appropriate function. */
-      if (init) {
+   L = faction_getScheduler( p->faction );
+
+   /* Must have a valid scheduler. */
+   if (L==NULL)
+      return;
+
+   /* Spawning is disabled for this faction. */
+   if (p->disabled)
+      return;
+
+   /* Run the appropriate function. */
+   if (init) {
 #if DEBUGGING
-         lua_pushcfunction(L, nlua_errTrace);
+      lua_pushcfunction(L, nlua_errTrace);
 #endif /* DEBUGGING */
-         lua_getglobal( L, "create" ); /* f */
-         if (lua_isnil(L,-1)) {
-            WARN("Lua Spawn script for faction '%s' missing obligatory entry point 'create'.",
-                  faction_name( p->faction ) );
+      lua_getglobal( L, "create" ); /* f */
+      if (lua_isnil(L,-1)) {
+         WARN("Lua Spawn script for faction '%s' missing obligatory entry point 'create'.",
+               faction_name( p->faction ) );
 #if DEBUGGING
-            lua_pop(L,2);
+         lua_pop(L,2);
 #else /* DEBUGGING */
-            lua_pop(L,1);
+         lua_pop(L,1);
 #endif /* DEBUGGING */
-            continue;
-         }
-         n = 0;
+         return;
       }
-      else {
-         /* Decrement dt, only continue  */
-         p->timer -= dt;
-         if (p->timer >= 0.)
-            continue;
+      n = 0;
+   }
+   else {
+      /* Decrement dt, only continue  */
+      p->timer -= dt;
+      if (p->timer >= 0.)
+         return;
 
 #if DEBUGGING
-         lua_pushcfunction(L, nlua_errTrace);
+      lua_pushcfunction(L, nlua_errTrace);
 #endif /* DEBUGGING */
-         lua_getglobal( L, "spawn" ); /* f */
-         if (lua_isnil(L,-1)) {
-            WARN("Lua Spawn script for faction '%s' missing obligatory entry point 'spawn'.",
-                  faction_name( p->faction ) );
+      lua_getglobal( L, "spawn" ); /* f */
+      if (lua_isnil(L,-1)) {
+         WARN("Lua Spawn script for faction '%s' missing obligatory entry point 'spawn'.",
+               faction_name( p->faction ) );
 #if DEBUGGING
-            lua_pop(L,2);
+         lua_pop(L,2);
 #else /* DEBUGGING */
-            lua_pop(L,1);
+         lua_pop(L,1);
 #endif /* DEBUGGING */
-            continue;
-         }
-         lua_pushnumber( L, p->curUsed ); /* f, presence */
-         n = 1;
+         return;
       }
-      lua_pushnumber( L, p->value ); /* f, [arg,], max */
+      lua_pushnumber( L, p->curUsed ); /* f, presence */
+      n = 1;
+   }
+   lua_pushnumber( L, p->value ); /* f, [arg,], max */
 
 #if DEBUGGING
-      errf = -2-(n+1);
+   errf = -2-(n+1);
 #else /* DEBUGGING */
-      errf = 0;
+   errf = 0;
 #endif /* DEBUGGING */
 
-      /* Actually run the function. */
-      if (lua_pcall(L, n+1, 2, errf)) { /* error has occurred */
-         WARN("Lua Spawn script for faction '%s' : %s",
-               faction_name( p->faction ), lua_tostring(L,-1));
+   /* Actually run the function. */
+   mark = nlua_profEnter( L, "spawn", faction_name( p->faction ) );
+   ret  = lua_pcall(L, n+1, 2, errf);
+   nlua_profLeave( L, mark );
+   if (ret) { /* error has occurred */
+      WARN("Lua Spawn script for faction '%s' : %s",
+            faction_name( p->faction ), lua_tostring(L,-1));
 #if DEBUGGING
-         lua_pop(L,2);
+      lua_pop(L,2);
 #else /* DEBUGGING */
-         lua_pop(L,1);
+      lua_pop(L,1);
 #endif /* DEBUGGING */
-         continue;
-      }
+      return;
+   }
 
-      /* Output is handled the same way. */
-      if (!lua_isnumber(L,-2)) {
-         WARN("Lua spawn script for faction '%s' failed to return timer value.",
-               faction_name( p->faction ) );
+   /* Output is handled the same way. */
+   if (!lua_isnumber(L,-2)) {
+      WARN("Lua spawn script for faction '%s' failed to return timer value.",
+            faction_name( p->faction ) );
 #if DEBUGGING
-         lua_pop(L,3);
+      lua_pop(L,3);
 #else /* DEBUGGING */
-         lua_pop(L,2);
+      lua_pop(L,2);
 #endif /* DEBUGGING */
-         continue;
-      }
-      p->timer    += lua_tonumber(L,-2);
-      /* Handle table if it exists. */
-      if (lua_istable(L,-1)) {
-         lua_pushnil(L); /* tk, k */
-         while (lua_next(L,-2) != 0) { /* tk, k, v */
-            /* Must be table. */
-            if (!lua_istable(L,-1)) {
-               WARN("Lua spawn script for faction '%s' returns invalid data (not a table).",
-                     faction_name( p->faction ) );
-               lua_pop(L,2); /* tk, k */
-               continue;
-            }
+      return;
+   }
+   p->timer    += lua_tonumber(L,-2);
+   /* Handle table if it exists. */
+   if (lua_istable(L,-1)) {
+      lua_pushnil(L); /* tk, k */
+      while (lua_next(L,-2) != 0) { /* tk, k, v */
+         /* Must be table. */
+         if (!lua_istable(L,-1)) {
+            WARN("Lua spawn script for faction '%s' returns invalid data (not a table).",
+                  faction_name( p->faction ) );
+            lua_pop(L,2); /* tk, k */
+            continue;
+         }
 
-            lua_getfield( L, -1, "pilot" ); /* tk, k, v, p */
-            if (!lua_ispilot(L,-1)) {
-               WARN("Lua spawn script for faction '%s' returns invalid data (not a pilot).",
-                     faction_name( p->faction ) );
-               lua_pop(L,2); /* tk, k */
-               continue;
-            }
-            lp    = lua_topilot(L,-1);
-            pilot = pilot_get( lp->pilot );
-            if (pilot == NULL) {
-               lua_pop(L,2); /* tk, k */
-               continue;
-            }
-            lua_pop(L,1); /* tk, k, v */
-            lua_getfield( L, -1, "presence" ); /* tk, k, v, p */
-            if (!lua_isnumber(L,-1)) {
-               WARN("Lua spawn script for faction '%s' returns invalid data (not a number).",
-                     faction_name( p->faction ) );
-               lua_pop(L,2); /* tk, k */
-               continue;
-            }
-            pilot->presence = lua_tonumber(L,-1);
-            p->curUsed     += pilot->presence;
+         lua_getfield( L, -1, "pilot" ); /* tk, k, v, p */
+         if (!lua_ispilot(L,-1)) {
+            WARN("Lua spawn script for faction '%s' returns invalid data (not a pilot).",
+                  faction_name( p->faction ) );
+            lua_pop(L,2); /* tk, k */
+            continue;
+         }
+         lp    = lua_topilot(L,-1);
+         pilot = pilot_get( lp->pilot );
+         if (pilot == NULL) {
+            lua_pop(L,2); /* tk, k */
+            continue;
+         }
+         lua_pop(L,1); /* tk, k, v */
+         lua_getfield( L, -1, "presence" ); /* tk, k, v, p */
+         if (!lua_isnumber(L,-1)) {
+            WARN("Lua spawn script for faction '%s' returns invalid data (not a number).",
+                  faction_name( p->faction ) );
             lua_pop(L,2); /* tk, k */
+            continue;
          }
+         pilot->presence = lua_tonumber(L,-1);
+         p->curUsed     += pilot->presence;
+         lua_pop(L,2); /* tk, k */
+
+         /* Don't let the player see it pop in, taking off and jumping in
+          * are fine to watch. */
+         if (hide && !pilot_isFlag( pilot, PILOT_TAKEOFF ) &&
+               !pilot_isFlag( pilot, PILOT_HYP_END ))
+            space_spawnOutOfSight( pilot );
       }
+   }
 #if DEBUGGING
-      lua_pop(L,3);
+   lua_pop(L,3);
 #else /* DEBUGGING */
-      lua_pop(L,2);
+   lua_pop(L,2);
 #endif /* DEBUGGING */
+}
+
+
+/**
+ * @brief Moves a late spawned pilot out of the player's sensor range.
+ *
+ * The pilot is pushed straight away from the player, so it still comes
+ *  from the same direction and acts normally from the start.
+ *
+ *    @param pilot Pilot that was just spawned.
+ */
+static void space_spawnOutOfSight( Pilot *pilot )
+{
+   double dx, dy, d, r;
+
+   if ((player.p == NULL) ||
+         !pilot_inRange( player.p, pilot->solid->pos.x, pilot->solid->pos.y ))
+      return;
+
+   dx = pilot->solid->pos.x - player.p->solid->pos.x;
+   dy = pilot->solid->pos.y - player.p->solid->pos.y;
+   d  = MOD( dx, dy );
+   if (d < 1.) {
+      r  = RNGF() * 2. * M_PI;
+      dx = cos( r );
+      dy = sin( r );
+      d  = 1.;
    }
+
+   /* Grow until out of range, sensor range depends on the nebula. */
+   r = MAX( d, 100. );
+   do {
+      r *= 1.5;
+      vect_cset( &pilot->solid->pos, player.p->solid->pos.x + dx / d * r,
+            player.p->solid->pos.y + dy / d * r );
+   } while (pilot_inRange( player.p, pilot->solid->pos.x, pilot->solid->pos.y ));
+}
+
+
+/**
+ * @brief Cancels the initial spawns that have not been run yet.
+ *
+ * Used when the system gets cleared so they don't show up afterwards.
+ */
+void space_populateCancel (void)
+{
+   int i;
+
+   if (cur_system == NULL)
+      return;
+   for (i=0; i<cur_system->npresence; i++)
+      cur_system->presence[i].pending = 0;
 }
 
 
@@ -1397,12 +1522,14 @@ void space_init( const char* sysname )
       cur_system->presence[i].curUsed  = 0;
       cur_system->presence[i].timer    = 0.;
       cur_system->presence[i].disabled = 0;
+      cur_system->presence[i].pending  = 1;
    }
 
    /* Load graphics. */
    space_gfxLoad( cur_system );
+   space_gfxLoadShips( cur_system );
 
-   /* Call the scheduler. */
+   /* Call the scheduler, what doesn't fit in this frame is spawned later. */
    system_scheduler( 0., 1 );
 
    /* we now know this system */
@@ -1702,6 +1829,52 @@ void space_gfxLoad( StarSystem *sys )
 }
 
 
+/**
+ * @brief Loads the graphics of the ships likely to be seen in a star system.
+ *
+ * These are the ships of the fleets of factions present in the system and
+ *  the ships sold at its shipyards. Ship graphics that haven't been wanted
+ *  for a while get unloaded first.
+ *
+ *    @param sys System to load ship graphics for.
+ */
+static void space_gfxLoadShips( StarSystem *sys )
+{
+   int i, j, n;
+   Fleet *flts;
+   Ship **ships;
+   Planet *planet;
+
+   ships_gfxCollect();
+
+   /* Fleets that can spawn here. */
+   for (i=0; i<sys->nfleets; i++)
+      for (j=0; j<sys->fleets[i]->npilots; j++)
+         if (sys->fleets[i]->pilots[j].ship != NULL)
+            ship_gfxLoad( sys->fleets[i]->pilots[j].ship );
+   flts = fleet_getAll( &n );
+   for (i=0; i<n; i++) {
+      if (system_getPresence( sys, flts[i].faction ) <= 0.)
+         continue;
+      for (j=0; j<flts[i].npilots; j++)
+         if (flts[i].pilots[j].ship != NULL)
+            ship_gfxLoad( flts[i].pilots[j].ship );
+   }
+
+   /* Ships for sale. */
+   for (i=0; i<sys->nplanets; i++) {
+      planet = sys->planets[i];
+      if ((planet->real != ASSET_REAL) || (planet->tech == NULL) ||
+            !planet_hasService( planet, PLANET_SERVICE_SHIPYARD ))
+         continue;
+      ships = tech_getShip( planet->tech, &n );
+      for (j=0; j<n; j++)
+         ship_gfxLoad( ships[j] );
+      free( ships );
+   }
+}
+
+
 /**
  * @brief Unloads all the graphics for a star system.
  *
@@ -2015,17 +2188,21 @@ int system_addPlanet( StarSystem *sys, const char *planetname )
    planetname_stack[spacename_nstack-1] = planet->name;
    systemname_stack[spacename_nstack-1] = sys->name;
 
-   /* Regenerate the economy stuff. */
-   economy_refresh();
-
-   /* Add the presence. */
-   if (!systems_loading) {
+   /* Add the presence, all of it gets redone at the end when deferred. */
+   if (space_deferred)
+      space_dirty |= SPACE_DIRTY_PRESENCE;
+   else if (!systems_loading) {
       system_addPresence( sys, planet->faction, planet->presenceAmount, planet->presenceRange );
       system_setFaction(sys);
    }
 
+   /* Update the economy stuff if the faction changed. */
+   space_refreshEconomy();
+
    /* Reload graphics if necessary. */
-   if (cur_system != NULL)
+   if (space_deferred)
+      space_dirty |= SPACE_DIRTY_GFX;
+   else if (cur_system != NULL)
       space_gfxLoad( cur_system );
 
    return 0;
@@ -2067,7 +2244,10 @@ int system_rmPlanet( StarSystem *sys, const char *planetname )
    memmove( &sys->planetsid[i], &sys->planetsid[i+1], sizeof(int) * (sys->nplanets-i) );
 
    /* Remove the presence. */
-   system_addPresence( sys, planet->faction, -(planet->presenceAmount), planet->presenceRange );
+   if (space_deferred)
+      space_dirty |= SPACE_DIRTY_PRESENCE;
+   else
+      system_addPresence( sys, planet->faction, -(planet->presenceAmount), planet->presenceRange );
 
    /* Remove from the name stack thingy. */
    found = 0;
@@ -2085,10 +2265,11 @@ int system_rmPlanet( StarSystem *sys, const char *planetname )
       WARN("Unable to find planet '%s' and system '%s' in planet<->system stack.",
             planetname, sys->name );
 
-   system_setFaction(sys);
+   if (!space_deferred)
+      system_setFaction(sys);
 
-   /* Regenerate the economy stuff. */
-   economy_refresh();
+   /* Update the economy stuff if the faction changed. */
+   space_refreshEconomy();
 
    return 0;
 }
@@ -2105,7 +2286,8 @@ int system_addJumpDiff( StarSystem *sys, xmlNodePtr node )
    if (system_parseJumpPointDiff(node, sys) <= -1)
       return 0;
    systems_reconstructJumps();
-   economy_refresh();
+   economy_queueSystem( sys->id );
+   space_refreshEconomy();
 
    return 1;
 }
@@ -2123,7 +2305,8 @@ int system_addJump( StarSystem *sys, xmlNodePtr node )
    if (system_parseJumpPoint(node, sys) <= -1)
       return 0;
    systems_reconstructJumps();
-   economy_refresh();
+   economy_queueSystem( sys->id );
+   space_refreshEconomy();
 
    return 1;
 }
@@ -2160,12 +2343,18 @@ int system_rmJump( StarSystem *sys, const char *jumpname )
 
    /* Remove jump from system. */
    sys->njumps--;
+   for (i=0; i<systems_nstack; i++)
+      system_spillFree( &systems_stack[i] );
 
    /* Refresh presence */
-   system_setFaction(sys);
+   if (space_deferred)
+      space_dirty |= SPACE_DIRTY_PRESENCE;
+   else
+      system_setFaction(sys);
 
-   /* Regenerate the economy stuff. */
-   economy_refresh();
+   /* Update the economy stuff. */
+   economy_queueSystem( sys->id );
+   space_refreshEconomy();
 
    return 0;
 }
@@ -2320,11 +2509,20 @@ void systems_reconstructJumps (void)
    StarSystem *sys;
    int i;
 
+   if (space_deferred) {
+      space_dirty |= SPACE_DIRTY_JUMPS;
+      return;
+   }
+
    /* So we need to calculate the shortest jump. */
    for (i=0; i<systems_nstack; i++) {
       sys = &systems_stack[i];
       system_reconstructJumps(sys);
    }
+
+   /* Presence spills over the jumps. */
+   for (i=0; i<systems_nstack; i++)
+      system_spillFree( &systems_stack[i] );
 }
 
 
@@ -2471,9 +2669,11 @@ static int sys_cmpSysFaction( const void *a, const void *b )
  */
 void system_setFaction( StarSystem *sys )
 {
-   int i, j;
+   int i, j, oldfaction;
    Planet *pnt;
 
+   oldfaction = sys->faction;
+
    /* Sort. */
    qsort( sys->presence, sys->npresence, sizeof(SystemPresence), sys_cmpSysFaction );
 
@@ -2490,6 +2690,10 @@ void system_setFaction( StarSystem *sys )
          sys->faction = pnt->faction;
       }
    }
+
+   /* Jump resistances depend on the faction. */
+   if (sys->faction != oldfaction)
+      economy_queueSystem( sys->id );
 }
 
 
@@ -2765,8 +2969,7 @@ int space_load (void)
    systems_loading = 0;
 
    /* Apply all the presences. */
-   for (i=0; i<systems_nstack; i++)
-      system_addAllPlanetsPresence(&systems_stack[i]);
+   space_rebuildPresences();
 
    /* Determine dominant faction. */
    for (i=0; i<systems_nstack; i++)
@@ -3062,6 +3265,7 @@ void space_exit (void)
 
       if(systems_stack[i].presence)
          free(systems_stack[i].presence);
+      system_spillFree( &systems_stack[i] );
 
       if (systems_stack[i].planets != NULL)
          free(systems_stack[i].planets);
@@ -3385,10 +3589,6 @@ static void presenceCleanup( StarSystem *sys )
 {
    int i;
 
-   /* Reset the spilled variable for the entire universe. */
-   for (i=0; i < systems_nstack; i++)
-      systems_stack[i].spilled = 0;
-
    /* Check for NULL and display a warning. */
    if (sys == NULL) {
       WARN("sys == NULL");
@@ -3422,6 +3622,82 @@ void system_presenceCleanupAll( void )
 }
 
 
+/**
+ * @brief Makes sure the systems presence spills into are cached.
+ *
+ * Presence spills over jumps that are neither hidden nor exit-only, the
+ *  systems reached are stored by how many jumps away they are. Only jumps
+ *  changing invalidates them, so they are computed once and reused by every
+ *  planet in the system.
+ *
+ *    @param sys System to get the spill rings of.
+ *    @param range Jumps away the rings must reach.
+ */
+static void system_spillRings( StarSystem *sys, int range )
+{
+   int i, j, k, start, end;
+   StarSystem *cur;
+   char *visited;
+
+   /* Already far enough or nothing more to reach. */
+   if ((sys->spillhop != NULL) &&
+         (sys->spillfull || (array_size(sys->spillhop) >= range)))
+      return;
+   system_spillFree( sys );
+
+   sys->spillsys = array_create( int );
+   sys->spillhop = array_create( int );
+   visited       = calloc( systems_nstack, sizeof(char) );
+   visited[ sys->id ] = 1;
+
+   /* Breadth first, each ring holds the systems one more jump away. */
+   start = 0;
+   end   = 0;
+   for (k=0; k<range; k++) {
+      /* The first ring comes from the system itself. */
+      for (i=(k==0) ? -1 : start; i<end; i++) {
+         cur = (i < 0) ? sys : &systems_stack[ sys->spillsys[i] ];
+         for (j=0; j<cur->njumps; j++) {
+            if (visited[ cur->jumps[j].target->id ] ||
+                  jp_isFlag( &cur->jumps[j], JP_HIDDEN ) ||
+                  jp_isFlag( &cur->jumps[j], JP_EXITONLY ))
+               continue;
+            visited[ cur->jumps[j].target->id ] = 1;
+            array_push_back( &sys->spillsys, cur->jumps[j].target->id );
+         }
+      }
+      start = end;
+      end   = array_size( sys->spillsys );
+      array_push_back( &sys->spillhop, end );
+
+      /* Ran out of systems before running out of range. */
+      if (start == end) {
+         sys->spillfull = 1;
+         break;
+      }
+   }
+
+   free( visited );
+}
+
+
+/**
+ * @brief Drops the cached spill rings of a system.
+ *
+ *    @param sys System to drop the spill rings of.
+ */
+static void system_spillFree( StarSystem *sys )
+{
+   if (sys->spillsys != NULL)
+      array_free( sys->spillsys );
+   if (sys->spillhop != NULL)
+      array_free( sys->spillhop );
+   sys->spillsys  = NULL;
+   sys->spillhop  = NULL;
+   sys->spillfull = 0;
+}
+
+
 /**
  * @brief Adds (or removes) some presence to a system.
  *
@@ -3432,8 +3708,7 @@ void system_presenceCleanupAll( void )
  */
 void system_addPresence( StarSystem *sys, int faction, double amount, int range )
 {
-   int i, x, curSpill;
-   Queue q, qn;
+   int i, x, hop, nhop;
    StarSystem *cur;
 
    /* Check for NULL and display a warning. */
@@ -3458,67 +3733,19 @@ void system_addPresence( StarSystem *sys, int faction, double amount, int range
    if (range < 1)
       return;
 
-   /* Add the spill. */
-   sys->spilled   = 1;
-   curSpill       = 0;
-   q              = q_create();
-   qn             = q_create();
-
-   /* Create the initial queue consisting of sys adjacencies. */
-   for (i=0; i < sys->njumps; i++) {
-      if (sys->jumps[i].target->spilled == 0 && !jp_isFlag( &sys->jumps[i], JP_HIDDEN ) && !jp_isFlag( &sys->jumps[i], JP_EXITONLY )) {
-         q_enqueue( q, sys->jumps[i].target );
-         sys->jumps[i].target->spilled = 1;
+   /* Spill less and less the further away. */
+   system_spillRings( sys, range );
+   nhop = MIN( range, array_size(sys->spillhop) );
+   for (hop=0, i=0; hop<nhop; hop++) {
+      for (; i<sys->spillhop[hop]; i++) {
+         cur = &systems_stack[ sys->spillsys[i] ];
+         x   = getPresenceIndex(cur, faction);
+         cur->presence[x].value += amount / (2 + hop);
       }
    }
 
-   /* If it's empty, something's wrong. */
-   if (q_isEmpty(q)) {
-      /* Means system isn't connected. */
-      /*WARN("q is empty after getting adjacencies of %s.", sys->name);*/
-      q_destroy(q);
-      q_destroy(qn);
-      presenceCleanup(sys);
-      return;
-   }
-
-   while (curSpill < range) {
-      /* Pull one off the current range queue. */
-      cur = q_dequeue(q);
-
-      /* Ran out of candidates before running out of spill range! */
-      if (cur == NULL)
-         break;
-
-      /* Enqueue all its adjacencies to the next range queue. */
-      for (i=0; i<cur->njumps; i++) {
-         if (cur->jumps[i].target->spilled == 0 && !jp_isFlag( &cur->jumps[i], JP_HIDDEN ) && !jp_isFlag( &cur->jumps[i], JP_EXITONLY )) {
-            q_enqueue( qn, cur->jumps[i].target );
-            cur->jumps[i].target->spilled = 1;
-         }
-      }
-
-      /* Spill some presence. */
-      x = getPresenceIndex(cur, faction);
-      cur->presence[x].value += amount / (2 + curSpill);
-
-      /* Check to see if we've finished this range and grab the next queue. */
-      if (q_isEmpty(q)) {
-         curSpill++;
-         q_destroy(q);
-         q  = qn;
-         qn = q_create();
-      }
-   }
-
-   /* Destroy the queues. */
-   q_destroy(q);
-   q_destroy(qn);
-
    /* Clean up our mess. */
    presenceCleanup(sys);
-
-   return;
 }
 
 
@@ -3574,6 +3801,127 @@ void system_addAllPlanetsPresence( StarSystem *sys )
 }
 
 
+/**
+ * @brief Chunk of systems to accumulate the presence of.
+ */
+typedef struct PresenceJob_ {
+   int start; /**< First system of the chunk. */
+   int end; /**< System after the last one of the chunk. */
+   int nfactions; /**< Number of factions. */
+   double *buf; /**< Presence by system then faction. */
+} PresenceJob;
+
+
+/**
+ * @brief Accumulates the presence of the planets in a chunk of systems.
+ *
+ * Only reads the systems and writes to its own buffer, so chunks can run in
+ *  parallel. Spill rings must already be cached.
+ *
+ *    @param data PresenceJob to run.
+ *    @return 0 always.
+ */
+static int presence_accumulate( void *data )
+{
+   PresenceJob *job;
+   StarSystem *sys;
+   Planet *pnt;
+   double *buf;
+   int i, j, k, hop, nhop;
+
+   job = (PresenceJob*) data;
+   for (i=job->start; i<job->end; i++) {
+      sys = &systems_stack[i];
+      for (j=0; j<sys->nplanets; j++) {
+         pnt = sys->planets[j];
+         if (!faction_isFaction( pnt->faction ) || (pnt->presenceAmount == 0.))
+            continue;
+         buf = &job->buf[ pnt->faction ];
+         buf[ i * job->nfactions ] += pnt->presenceAmount;
+         if (pnt->presenceRange < 1)
+            continue;
+         nhop = MIN( pnt->presenceRange, array_size(sys->spillhop) );
+         for (hop=0, k=0; hop<nhop; hop++)
+            for (; k<sys->spillhop[hop]; k++)
+               buf[ sys->spillsys[k] * job->nfactions ] += pnt->presenceAmount / (2 + hop);
+      }
+   }
+   return 0;
+}
+
+
+/**
+ * @brief Recomputes the presence of all systems from their planets.
+ *
+ * The systems are split into chunks summed in parallel into their own
+ *  buffers, which then get added up in order so the result doesn't depend
+ *  on the threads.
+ */
+static void space_rebuildPresences (void)
+{
+   PresenceJob jobs[PRESENCE_JOBS];
+   ThreadQueue *vpool;
+   StarSystem *sys;
+   double *total;
+   int *factions;
+   int i, j, k, n, nf, range;
+
+   nf = faction_count();
+   n = systems_nstack;
+
+   /* Rings are cached up front, the jobs only read them. */
+   for (i=0; i<n; i++) {
+      sys   = &systems_stack[i];
+      range = 0;
+      for (j=0; j<sys->nplanets; j++)
+         range = MAX( range, sys->planets[j]->presenceRange );
+      if (range > 0)
+         system_spillRings( sys, range );
+   }
+
+   vpool = vpool_create();
+   for (i=0; i<PRESENCE_JOBS; i++) {
+      jobs[i].start     = n * i / PRESENCE_JOBS;
+      jobs[i].end       = n * (i+1) / PRESENCE_JOBS;
+      jobs[i].nfactions = nf;
+      jobs[i].buf       = calloc( n * nf, sizeof(double) );
+      vpool_enqueue( vpool, presence_accumulate, &jobs[i] );
+   }
+   vpool_wait( vpool );
+
+   /* Reduce. */
+   total = jobs[0].buf;
+   for (i=1; i<PRESENCE_JOBS; i++) {
+      for (j=0; j<n*nf; j++)
+         total[j] += jobs[i].buf[j];
+      free( jobs[i].buf );
+   }
+
+   /* Only positive presences are kept. */
+   factions = malloc( nf * sizeof(int) );
+   for (i=0; i<n; i++) {
+      sys = &systems_stack[i];
+      free( sys->presence );
+      sys->presence  = NULL;
+      sys->npresence = 0;
+      k = 0;
+      for (j=0; j<nf; j++)
+         if (total[ i*nf + j ] > 0.)
+            factions[k++] = j;
+      if (k == 0)
+         continue;
+      sys->presence  = calloc( k, sizeof(SystemPresence) );
+      sys->npresence = k;
+      for (j=0; j<k; j++) {
+         sys->presence[j].faction = factions[j];
+         sys->presence[j].value   = total[ i*nf + factions[j] ];
+      }
+   }
+   free( factions );
+   free( total );
+}
+
+
 /**
  * @brief Reset the presence of all systems.
  */
@@ -3581,24 +3929,76 @@ void space_reconstructPresences( void )
 {
    int i;
 
-   /* Reset the presence in each system. */
-   for (i=0; i<systems_nstack; i++) {
-      if (systems_stack[i].presence)
-         free(systems_stack[i].presence);
-      systems_stack[i].presence  = NULL;
-      systems_stack[i].npresence = 0;
-      systems_stack[i].ownerpresence = 0.;
+   if (space_deferred) {
+      space_dirty |= SPACE_DIRTY_PRESENCE;
+      return;
    }
 
-   /* Re-add presence to each system. */
-   for (i=0; i<systems_nstack; i++)
-      system_addAllPlanetsPresence(&systems_stack[i]);
+   /* Recompute the presence in each system. */
+   space_rebuildPresences();
 
    /* Determine dominant faction. */
    for (i=0; i<systems_nstack; i++) {
       system_setFaction( &systems_stack[i] );
       systems_stack[i].ownerpresence = system_getPresence( &systems_stack[i], systems_stack[i].faction );
    }
+
+   /* Systems that changed hands change the economy. */
+   economy_refreshQueued();
+}
+
+
+/**
+ * @brief Refreshes the economy, or marks it for later when deferred.
+ */
+static void space_refreshEconomy (void)
+{
+   if (space_deferred)
+      space_dirty |= SPACE_DIRTY_ECONOMY;
+   else
+      economy_refreshQueued();
+}
+
+
+/**
+ * @brief Defers the global rebuilds until space_deferEnd().
+ *
+ * Jump and presence reconstruction, the economy refresh and reloading the
+ *  current system graphics are then done once at the end no matter how many
+ *  planets and jumps changed. Calls can be nested.
+ */
+void space_deferStart (void)
+{
+   space_deferred++;
+}
+
+
+/**
+ * @brief Runs the global rebuilds deferred since space_deferStart().
+ */
+void space_deferEnd (void)
+{
+   unsigned int dirty;
+
+   if (space_deferred <= 0) {
+      WARN("Global rebuilds are not being deferred!");
+      return;
+   }
+   if (--space_deferred > 0)
+      return;
+
+   dirty       = space_dirty;
+   space_dirty = 0;
+
+   /* Presence spills over the jumps and the economy needs both. */
+   if (dirty & SPACE_DIRTY_JUMPS)
+      systems_reconstructJumps();
+   if (dirty & SPACE_DIRTY_PRESENCE)
+      space_reconstructPresences();
+   if (dirty & (SPACE_DIRTY_JUMPS | SPACE_DIRTY_ECONOMY))
+      economy_refreshQueued();
+   if ((dirty & SPACE_DIRTY_GFX) && (cur_system != NULL))
+      space_gfxLoad( cur_system );
 }
 
 
@@ -3632,7 +4032,7 @@ int system_hasPlanet( const StarSystem *sys )
  */
 void system_rmCurrentPresence( StarSystem *sys, int faction, double amount )
 {
-   int id, errf;
+   int id, errf, ret, mark;
    lua_State *L;
    SystemPresence *presence;
 
@@ -3669,7 +4069,10 @@ void system_rmCurrentPresence( StarSystem *sys, int faction, double amount )
    lua_pushnumber( L, presence->timer );   /* f, cur, max, timer */
 
    /* Actually run the function. */
-   if (lua_pcall(L, 3, 1, errf)) { /* error has occurred */
+   mark = nlua_profEnter( L, "spawn", faction_name( faction ) );
+   ret  = lua_pcall(L, 3, 1, errf);
+   nlua_profLeave( L, mark );
+   if (ret) { /* error has occurred */
       WARN("Lua decrease script for faction '%s' : %s",
             faction_name( faction ), lua_tostring(L,-1));
 #if DEBUGGING
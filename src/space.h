@@ -18,6 +18,7 @@
 
 
 #define SYSTEM_SIMULATE_TIME  15. /**< Time to simulate system before player is added. */
+#define SYSTEM_POPULATE_BUDGET 4 /**< Milliseconds per frame the initial spawn may take. */
 
 #define MAX_HYPERSPACE_VEL    25 /**< Speed to brake to before jumping. */
 
@@ -179,6 +180,7 @@ typedef struct SystemPresence_ {
    double curUsed; /**< Presence currently used. */
    double timer; /**< Current faction timer. */
    int disabled; /**< Whether or not spawning is disabled for this presence. */
+   int pending; /**< Initial spawn has not been run yet. */
 } SystemPresence;
 
 
@@ -254,7 +256,9 @@ struct StarSystem_ {
    /* Presence. */
    SystemPresence *presence; /**< Pointer to an array of presences in this system. */
    int npresence; /**< Number of elements in the presence array. */
-   int spilled; /**< If the system has been spilled to yet. */
+   int *spillsys; /**< Systems presence spills into by jumps away (array.h). */
+   int *spillhop; /**< End of each jump distance in spillsys (array.h). */
+   int spillfull; /**< spillsys reaches every system it can. */
    int nsystemFleets; /**< The number of fleets in the system. */
    SystemFleet *systemFleets; /**< Array of pointers to the fleets in the system. */
    double ownerpresence; /**< Amount of presence the owning faction has in a system. */
@@ -278,6 +282,7 @@ extern int space_spawn; /**< 1 if spawning is enabled. */
  * loading/exiting
  */
 void space_init( const char* sysname );
+void space_populateCancel (void);
 int space_load (void);
 void space_exit (void);
 
@@ -344,6 +349,8 @@ void system_addPresence( StarSystem *sys, int faction, double amount, int range
 double system_getPresence( StarSystem *sys, int faction );
 void system_addAllPlanetsPresence( StarSystem *sys );
 void space_reconstructPresences( void );
+void space_deferStart (void);
+void space_deferEnd (void);
 void system_rmCurrentPresence( StarSystem *sys, int faction, double amount );
 
 /*
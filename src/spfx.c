@@ -6,6 +6,11 @@
  * @file spfx.c
  *
  * @brief Handles the special effects.
+ *
+ * Active effects are stored per layer as parallel arrays and removed by
+ *  swapping in the last one, since big battles spawn hundreds of them per
+ *  second. Rendering groups them by effect so each effect texture gets drawn
+ *  as a single batch of quads.
  */
 
 
@@ -30,6 +35,9 @@
 #include "nxml.h"
 #include "debris.h"
 #include "perlin.h"
+#include "opengl_vbo.h"
+#include "camera.h"
+#include "perf.h"
 
 
 #define SPFX_XML_ID     "spfxs" /**< XML Document tag. */
@@ -40,6 +48,9 @@
 #define SPFX_CHUNK_MAX  16384 /**< Maximum chunk to alloc when needed */
 #define SPFX_CHUNK_MIN  256 /**< Minimum chunk to alloc when needed */
 
+#define SPFX_LAYERS     2 /**< Number of layers. */
+#define SPFX_QUAD_FLOATS (6*(2+2)) /**< Floats per rendered effect, two triangles of vertex and texture coords. */
+
 #define SHAKE_MASS      (1./400.) /** Shake mass. */
 #define SHAKE_K         (1./50.) /**< Constant for virtual spring. */
 #define SHAKE_B         (3.*sqrt(SHAKE_K*SHAKE_MASS)) /**< Constant for virtual dampener. */
@@ -89,28 +100,38 @@ static int spfx_neffects = 0; /**< Total number of special effects. */
 
 
 /**
- * @struct SPFX
+ * @struct SPFX_Layer
  *
- * @brief An actual in-game active special effect.
+ * @brief Active in-game special effects of a layer, stored as parallel arrays.
  */
-typedef struct SPFX_ {
-   Vector2d pos; /**< Current position. */
-   Vector2d vel; /**< Current velocity. */
-
-   int lastframe; /**< Needed when paused */
-   int effect; /**< The real effect */
-
-   double timer; /**< Time left */
-} SPFX;
-
-
-/* front stack is for effects on player, back is for the rest */
-static SPFX *spfx_stack_front = NULL; /**< Frontal special effect layer. */
-static int spfx_nstack_front = 0; /**< Number of special effects in front. */
-static int spfx_mstack_front = 0; /**< Memory allocated for frontal special effects. */
-static SPFX *spfx_stack_back = NULL; /**< Back special effect layer. */
-static int spfx_nstack_back = 0; /**< Number of special effects in back. */
-static int spfx_mstack_back = 0; /**< Memory allocated for special effects in back. */
+typedef struct SPFX_Layer_ {
+   int n; /**< Number of active effects. */
+   int m; /**< Number of effects allocated. */
+   double *px; /**< X positions. */
+   double *py; /**< Y positions. */
+   double *vx; /**< X velocities. */
+   double *vy; /**< Y velocities. */
+   double *timer; /**< Time left. */
+   int *effect; /**< The real effects. */
+   int *lastframe; /**< Needed when paused. */
+} SPFX_Layer;
+
+
+/* front layer is for effects on player, back is for the rest */
+static SPFX_Layer spfx_layers[SPFX_LAYERS]; /**< Special effect layers. */
+
+/* Rendering. */
+static gl_vbo *spfx_vbo    = NULL; /**< Stream VBO for the effect quads. */
+static GLfloat *spfx_vboData = NULL; /**< Vertex data being built. */
+static int spfx_vboSize    = 0; /**< Effects the VBO can hold. */
+static int *spfx_order     = NULL; /**< Effects of a layer sorted by base effect. */
+static int spfx_morder     = 0; /**< Memory allocated for the sorted effects. */
+static int *spfx_count     = NULL; /**< Start of each base effect in the sorted effects. */
+
+/* Statistics. */
+static int spfx_statRendered  = 0; /**< Effects rendered last frame. */
+static double spfx_statTime   = 0.; /**< Milliseconds spent rendering last frame. */
+static double spfx_statAccum  = 0.; /**< Milliseconds spent rendering so far this frame. */
 
 
 /*
@@ -119,8 +140,10 @@ static int spfx_mstack_back = 0; /**< Memory allocated for special effects in ba
 /* General. */
 static int spfx_base_parse( SPFX_Base *temp, const xmlNodePtr parent );
 static void spfx_base_free( SPFX_Base *effect );
-static void spfx_destroy( SPFX *layer, int *nlayer, int spfx );
-static void spfx_update_layer( SPFX *layer, int *nlayer, const double dt );
+static void spfx_layerGrow( SPFX_Layer *l );
+static void spfx_layerFree( SPFX_Layer *l );
+static void spfx_destroy( SPFX_Layer *l, int spfx );
+static void spfx_update_layer( SPFX_Layer *l, const double dt );
 /* Haptic. */
 static int spfx_hapticInit (void);
 static void spfx_hapticRumble( double mod );
@@ -290,12 +313,22 @@ void spfx_free (void)
 
    /* get rid of all the particles and free the stacks */
    spfx_clear();
-   if (spfx_stack_front) free(spfx_stack_front);
-   spfx_stack_front = NULL;
-   spfx_mstack_front = 0;
-   if (spfx_stack_back) free(spfx_stack_back);
-   spfx_stack_back = NULL;
-   spfx_mstack_back = 0;
+   for (i=0; i<SPFX_LAYERS; i++)
+      spfx_layerFree( &spfx_layers[i] );
+
+   /* Rendering stuff. */
+   if (spfx_vbo != NULL) {
+      gl_vboDestroy( spfx_vbo );
+      spfx_vbo = NULL;
+   }
+   free( spfx_vboData );
+   spfx_vboData = NULL;
+   spfx_vboSize = 0;
+   free( spfx_order );
+   spfx_order  = NULL;
+   spfx_morder = 0;
+   free( spfx_count );
+   spfx_count  = NULL;
 
    /* now clear the effects */
    for (i=0; i<spfx_neffects; i++)
@@ -309,6 +342,46 @@ void spfx_free (void)
 }
 
 
+/**
+ * @brief Grows a layer to fit at least one more effect.
+ *
+ *    @param l Layer to grow.
+ */
+static void spfx_layerGrow( SPFX_Layer *l )
+{
+   if (l->m == 0)
+      l->m = SPFX_CHUNK_MIN;
+   else
+      l->m += MIN( l->m, SPFX_CHUNK_MAX );
+
+   l->px       = realloc( l->px,        l->m*sizeof(double) );
+   l->py       = realloc( l->py,        l->m*sizeof(double) );
+   l->vx       = realloc( l->vx,        l->m*sizeof(double) );
+   l->vy       = realloc( l->vy,        l->m*sizeof(double) );
+   l->timer    = realloc( l->timer,     l->m*sizeof(double) );
+   l->effect   = realloc( l->effect,    l->m*sizeof(int) );
+   l->lastframe = realloc( l->lastframe, l->m*sizeof(int) );
+}
+
+
+/**
+ * @brief Frees the memory of a layer.
+ *
+ *    @param l Layer to free.
+ */
+static void spfx_layerFree( SPFX_Layer *l )
+{
+   free( l->px );
+   free( l->py );
+   free( l->vx );
+   free( l->vy );
+   free( l->timer );
+   free( l->effect );
+   free( l->lastframe );
+   memset( l, 0, sizeof(SPFX_Layer) );
+}
+
+
 /**
  * @brief Creates a new special effect.
  *
@@ -324,10 +397,11 @@ void spfx_add( int effect,
       const double vx, const double vy,
       const int layer )
 {
-   SPFX *cur_spfx;
+   SPFX_Layer *l;
    double ttl, anim;
+   int i;
 
-   if ((effect < 0) || (effect > spfx_neffects)) {
+   if ((effect < 0) || (effect >= spfx_neffects)) {
       WARN("Trying to add spfx with invalid effect!");
       return;
    }
@@ -335,44 +409,29 @@ void spfx_add( int effect,
    /*
     * Select the Layer
     */
-   if (layer == SPFX_LAYER_FRONT) { /* front layer */
-      if (spfx_mstack_front < spfx_nstack_front+1) { /* need more memory */
-         if (spfx_mstack_front == 0)
-            spfx_mstack_front = SPFX_CHUNK_MIN;
-         else
-            spfx_mstack_front += MIN( spfx_mstack_front, SPFX_CHUNK_MAX );
-         spfx_stack_front = realloc( spfx_stack_front, spfx_mstack_front*sizeof(SPFX) );
-      }
-      cur_spfx = &spfx_stack_front[spfx_nstack_front];
-      spfx_nstack_front++;
-   }
-   else if (layer == SPFX_LAYER_BACK) { /* back layer */
-      if (spfx_mstack_back < spfx_nstack_back+1) { /* need more memory */
-         if (spfx_mstack_back == 0)
-            spfx_mstack_back = SPFX_CHUNK_MIN;
-         else
-            spfx_mstack_back += MIN( spfx_mstack_back, SPFX_CHUNK_MAX );
-         spfx_stack_back = realloc( spfx_stack_back, spfx_mstack_back*sizeof(SPFX) );
-      }
-      cur_spfx = &spfx_stack_back[spfx_nstack_back];
-      spfx_nstack_back++;
-   }
-   else {
+   if ((layer != SPFX_LAYER_FRONT) && (layer != SPFX_LAYER_BACK)) {
       WARN("Invalid SPFX layer.");
       return;
    }
+   l = &spfx_layers[layer];
+   if (l->n >= l->m) /* need more memory */
+      spfx_layerGrow( l );
+   i = l->n++;
 
    /* The actual adding of the spfx */
-   cur_spfx->effect = effect;
-   vect_csetmin( &cur_spfx->pos, px, py );
-   vect_csetmin( &cur_spfx->vel, vx, vy );
+   l->effect[i]    = effect;
+   l->lastframe[i] = 0;
+   l->px[i]        = px;
+   l->py[i]        = py;
+   l->vx[i]        = vx;
+   l->vy[i]        = vy;
    /* Timer magic if ttl != anim */
    ttl = spfx_effects[effect].ttl;
    anim = spfx_effects[effect].anim;
    if (ttl != anim)
-      cur_spfx->timer = ttl + RNGF()*anim;
+      l->timer[i] = ttl + RNGF()*anim;
    else
-      cur_spfx->timer = ttl;
+      l->timer[i] = ttl;
 }
 
 
@@ -383,13 +442,9 @@ void spfx_clear (void)
 {
    int i;
 
-   /* Clear front layer */
-   for (i=spfx_nstack_front-1; i>=0; i--)
-      spfx_destroy( spfx_stack_front, &spfx_nstack_front, i );
-
-   /* Clear back layer */
-   for (i=spfx_nstack_back-1; i>=0; i--)
-      spfx_destroy( spfx_stack_back, &spfx_nstack_back, i );
+   /* Clear the layers, memory is kept for reuse. */
+   for (i=0; i<SPFX_LAYERS; i++)
+      spfx_layers[i].n = 0;
 
    /* Clear rumble */
    shake_set = 0;
@@ -402,14 +457,26 @@ void spfx_clear (void)
 /**
  * @brief Destroys an active spfx.
  *
- *    @param layer Layer the spfx is on.
- *    @param nlayer Pointer to the number of elements in the layer.
- *    @param spfx Position of the spfx in the stack.
+ * Order doesn't matter so the last effect takes its place.
+ *
+ *    @param l Layer the spfx is on.
+ *    @param spfx Position of the spfx in the layer.
  */
-static void spfx_destroy( SPFX *layer, int *nlayer, int spfx )
+static void spfx_destroy( SPFX_Layer *l, int spfx )
 {
-   (*nlayer)--;
-   memmove( &layer[spfx], &layer[spfx+1], (*nlayer-spfx)*sizeof(SPFX) );
+   int last;
+
+   last = --l->n;
+   if (spfx == last)
+      return;
+
+   l->px[spfx]        = l->px[last];
+   l->py[spfx]        = l->py[last];
+   l->vx[spfx]        = l->vx[last];
+   l->vy[spfx]        = l->vy[last];
+   l->timer[spfx]     = l->timer[last];
+   l->effect[spfx]    = l->effect[last];
+   l->lastframe[spfx] = l->lastframe[last];
 }
 
 
@@ -420,34 +487,35 @@ static void spfx_destroy( SPFX *layer, int *nlayer, int spfx )
  */
 void spfx_update( const double dt )
 {
-   spfx_update_layer( spfx_stack_front, &spfx_nstack_front, dt );
-   spfx_update_layer( spfx_stack_back, &spfx_nstack_back, dt );
+   int i;
+   for (i=0; i<SPFX_LAYERS; i++)
+      spfx_update_layer( &spfx_layers[i], dt );
 }
 
 
 /**
  * @brief Updates an individual spfx.
  *
- *    @param layer Layer the spfx is on.
- *    @param nlayer Pointer to the associated nlayer.
+ *    @param l Layer to update.
  *    @param dt Current delta tick.
  */
-static void spfx_update_layer( SPFX *layer, int *nlayer, const double dt )
+static void spfx_update_layer( SPFX_Layer *l, const double dt )
 {
    int i;
 
-   for (i=0; i<*nlayer; i++) {
-      layer[i].timer -= dt; /* less time to live */
+   /* Go backwards so the effects swapped in on removal are already updated. */
+   for (i=l->n-1; i>=0; i--) {
+      l->timer[i] -= dt; /* less time to live */
 
       /* time to die! */
-      if (layer[i].timer < 0.) {
-         spfx_destroy( layer, nlayer, i );
-         i--;
+      if (l->timer[i] < 0.) {
+         spfx_destroy( l, i );
          continue;
       }
 
       /* actually update it */
-      vect_cadd( &layer[i].pos, dt*VX(layer[i].vel), dt*VY(layer[i].vel) );
+      l->px[i] += dt*l->vx[i];
+      l->py[i] += dt*l->vy[i];
    }
 }
 
@@ -702,53 +770,159 @@ void spfx_cinematic (void)
 /**
  * @brief Renders the entire spfx layer.
  *
+ * Effects are sorted by base effect so every effect texture is drawn with
+ *  a single batch of quads.
+ *
  *    @param layer Layer to render.
  */
 void spfx_render( const int layer )
 {
-   SPFX *spfx_stack;
-   int i, spfx_nstack;
+   SPFX_Layer *l;
    SPFX_Base *effect;
-   int sx, sy;
-   double time;
-
+   glTexture *gfx;
+   GLfloat *v;
+   GLsizei size;
+   int i, j, e, k, n, end, sx, sy, frame;
+   double time, z, x, y, w, h, tx, ty, tw, th;
+   uint64_t t0;
 
    /* get the appropriate layer */
-   switch (layer) {
-      case SPFX_LAYER_FRONT:
-         spfx_stack = spfx_stack_front;
-         spfx_nstack = spfx_nstack_front;
-         break;
-
-      case SPFX_LAYER_BACK:
-         spfx_stack = spfx_stack_back;
-         spfx_nstack = spfx_nstack_back;
-         break;
-
-      default:
-         WARN("Rendering invalid SPFX layer.");
-         return;
+   if ((layer != SPFX_LAYER_FRONT) && (layer != SPFX_LAYER_BACK)) {
+      WARN("Rendering invalid SPFX layer.");
+      return;
    }
+   l = &spfx_layers[layer];
 
-   /* Now render the layer */
-   for (i=spfx_nstack-1; i>=0; i--) {
-      effect = &spfx_effects[ spfx_stack[i].effect ];
-
-      /* Simplifies */
-      sx = (int)effect->gfx->sx;
-      sy = (int)effect->gfx->sy;
+   /* Statistics get reset at the start of every frame with the back layer. */
+   if (layer == SPFX_LAYER_BACK) {
+      spfx_statRendered = 0;
+      spfx_statAccum    = 0.;
+   }
+   if (l->n == 0) {
+      if (layer == SPFX_LAYER_FRONT)
+         spfx_statTime = spfx_statAccum;
+      return;
+   }
+   t0 = perf_ticks();
+
+   /* Make sure there's enough room. */
+   if (spfx_count == NULL)
+      spfx_count = malloc( (spfx_neffects+1) * sizeof(int) );
+   if (spfx_morder < l->n) {
+      spfx_morder = l->m;
+      spfx_order  = realloc( spfx_order, spfx_morder * sizeof(int) );
+   }
+   if (spfx_vboSize < l->n) {
+      spfx_vboSize = l->m;
+      size = sizeof(GLfloat) * SPFX_QUAD_FLOATS * spfx_vboSize;
+      spfx_vboData = realloc( spfx_vboData, size );
+      if (spfx_vbo == NULL)
+         spfx_vbo = gl_vboCreateStream( size, NULL );
+      gl_vboData( spfx_vbo, size, NULL );
+   }
 
-      if (!paused) { /* don't calculate frame if paused */
-         time = 1. - fmod(spfx_stack[i].timer,effect->anim) / effect->anim;
-         spfx_stack[i].lastframe = sx * sy * MIN(time, 1.);
+   /* Sort by base effect, counting sort since there are few of them. */
+   memset( spfx_count, 0, (spfx_neffects+1) * sizeof(int) );
+   for (i=0; i<l->n; i++)
+      spfx_count[ l->effect[i]+1 ]++;
+   for (e=0; e<spfx_neffects; e++)
+      spfx_count[e+1] += spfx_count[e];
+   for (i=l->n-1; i>=0; i--)
+      spfx_order[ spfx_count[ l->effect[i] ]++ ] = i;
+   /* spfx_count[e] now points at the end of effect e. */
+
+   /* Build all the quads. */
+   z = cam_getZoom();
+   n = 0;
+   k = 0;
+   for (e=0; e<spfx_neffects; e++) {
+      end    = spfx_count[e];
+      effect = &spfx_effects[e];
+      gfx    = effect->gfx;
+      sx     = (int)gfx->sx;
+      sy     = (int)gfx->sy;
+      w      = gfx->sw*z;
+      h      = gfx->sh*z;
+      tw     = gfx->srw;
+      th     = gfx->srh;
+      for (j=k; j<end; j++) {
+         i = spfx_order[j];
+
+         if (!paused) { /* don't calculate frame if paused */
+            time = 1. - fmod(l->timer[i],effect->anim) / effect->anim;
+            l->lastframe[i] = sx * sy * MIN(time, 1.);
+         }
+         frame = l->lastframe[i];
+
+         /* Translate coords and check if inbounds. */
+         gl_gameToScreenCoords( &x, &y, l->px[i] - gfx->sw/2., l->py[i] - gfx->sh/2. );
+         if ((x < -w) || (x > SCREEN_W+w) ||
+               (y < -h) || (y > SCREEN_H+h))
+            continue;
+
+         /* texture coords */
+         tx = gfx->sw*(double)(frame % sx)/gfx->rw;
+         ty = gfx->sh*(gfx->sy-(double)(frame / sx)-1)/gfx->rh;
+
+         /* Two triangles. */
+         v = &spfx_vboData[ n*SPFX_QUAD_FLOATS ];
+         v[0]  = x;     v[1]  = y;     v[2]  = tx;    v[3]  = ty;
+         v[4]  = x+w;   v[5]  = y;     v[6]  = tx+tw; v[7]  = ty;
+         v[8]  = x;     v[9]  = y+h;   v[10] = tx;    v[11] = ty+th;
+         v[12] = x+w;   v[13] = y;     v[14] = tx+tw; v[15] = ty;
+         v[16] = x+w;   v[17] = y+h;   v[18] = tx+tw; v[19] = ty+th;
+         v[20] = x;     v[21] = y+h;   v[22] = tx;    v[23] = ty+th;
+         n++;
       }
+      /* Remember where the batch ends. */
+      k = end;
+      spfx_count[e] = n;
+   }
 
-      /* Renders */
-      gl_blitSprite( effect->gfx,
-            VX(spfx_stack[i].pos), VY(spfx_stack[i].pos),
-            spfx_stack[i].lastframe % sx,
-            spfx_stack[i].lastframe / sx,
-            NULL );
+   /* Render a batch per effect texture. */
+   if (n > 0) {
+      gl_vboSubData( spfx_vbo, 0, sizeof(GLfloat) * SPFX_QUAD_FLOATS * n, spfx_vboData );
+      gl_vboActivateOffset( spfx_vbo, GL_VERTEX_ARRAY, 0,
+            2, GL_FLOAT, 4*sizeof(GLfloat) );
+      gl_vboActivateOffset( spfx_vbo, GL_TEXTURE_COORD_ARRAY, 2*sizeof(GLfloat),
+            2, GL_FLOAT, 4*sizeof(GLfloat) );
+      glEnable( GL_TEXTURE_2D );
+      glColor4d( 1., 1., 1., 1. );
+      k = 0;
+      for (e=0; e<spfx_neffects; e++) {
+         if (spfx_count[e] == k)
+            continue;
+         glBindTexture( GL_TEXTURE_2D, spfx_effects[e].gfx->texture );
+         glDrawArrays( GL_TRIANGLES, 6*k, 6*(spfx_count[e]-k) );
+         k = spfx_count[e];
+      }
+      glDisable( GL_TEXTURE_2D );
+      gl_vboDeactivate();
+      gl_checkErr();
    }
+
+   /* Statistics. */
+   spfx_statRendered += n;
+   spfx_statAccum    += perf_ms( perf_ticks() - t0 );
+   if (layer == SPFX_LAYER_FRONT)
+      spfx_statTime = spfx_statAccum;
 }
 
+
+/**
+ * @brief Gets statistics on the special effects.
+ *
+ *    @param[out] active Number of active effects.
+ *    @param[out] rendered Number of effects rendered last frame.
+ *    @param[out] ms Milliseconds spent rendering them last frame.
+ */
+void spfx_getStats( int *active, int *rendered, double *ms )
+{
+   int i;
+
+   *active = 0;
+   for (i=0; i<SPFX_LAYERS; i++)
+      *active += spfx_layers[i].n;
+   *rendered = spfx_statRendered;
+   *ms       = spfx_statTime;
+}
@@ -7,6 +7,11 @@
  *
  * @brief Handles tech groups and metagroups for populating the planet outfitter,
  *        shipyard and commodity exchange.
+ *
+ * The contents of a group once all the groups it includes are flattened get
+ *  cached as bitsets over the outfit, ship and commodity stacks. Any change to
+ *  any group bumps a generation counter which invalidates all the caches, since
+ *  a group sees the changes of every group it includes.
  */
 
 
@@ -26,12 +31,15 @@
 #define XML_TECH_ID         "Techs"          /**< Tech xml document tag. */
 #define XML_TECH_TAG        "tech"           /**< Individual tech xml tag. */
 
+#define TECH_CACHE_TYPES    3                /**< Number of item types with a cache. */
+#define TECH_WORD_BITS      32               /**< Bits in a bitset word. */
+
 
 /**
  * @brief Different tech types.
  */
 typedef enum tech_item_type_e {
-   TECH_TYPE_OUTFIT,       /**< Tech contains an outfit. */
+   TECH_TYPE_OUTFIT=0,     /**< Tech contains an outfit. */
    TECH_TYPE_SHIP,         /**< Tech contains a ship. */
    TECH_TYPE_COMMODITY,    /**< Tech contains a commodity. */
    /*TECH_TYPE_CONTRABAND,*/   /**< Tech contains contraband. */
@@ -62,6 +70,9 @@ typedef struct tech_item_s {
 struct tech_group_s {
    char *name;          /**< Name of the tech group. */
    tech_item_t *items;  /**< Items in the tech group. */
+   unsigned int cache_gen; /**< Generation the cache was resolved at. */
+   int cache_busy;      /**< Group is being resolved, used to catch cycles. */
+   uint32_t *cache[TECH_CACHE_TYPES]; /**< Resolved items as bitsets over the stacks. */
 };
 
 
@@ -69,12 +80,12 @@ struct tech_group_s {
  * Group list.
  */
 static tech_group_t *tech_groups = NULL;
+static unsigned int tech_gen     = 1; /**< Current cache generation, 0 is never valid. */
 
 
 /*
  * Prototypes.
  */
-static void tech_createMetaGroup( tech_group_t *grp, tech_group_t **tech, int num );
 static void tech_freeGroup( tech_group_t *grp );
 static char* tech_getItemName( tech_item_t *item );
 /* Loading. */
@@ -88,7 +99,12 @@ static int tech_getID( const char *name );
 static int tech_addItemGroupPointer( tech_group_t *grp, tech_group_t *ptr );
 static int tech_addItemGroup( tech_group_t *grp, const char* name );
 /* Getting by tech. */
-static void** tech_addGroupItem( void **items, tech_item_type_t type, tech_group_t *tech, int *n, int *m );
+static void tech_invalidate (void);
+static int tech_stackSize( tech_item_type_t type );
+static int tech_stackIndex( const tech_item_t *item );
+static int tech_resolve( tech_group_t *tech );
+static void** tech_getItems( tech_group_t **tech, int num, tech_item_type_t type, int *n );
+static int tech_hasResolved( tech_group_t *tech, tech_item_type_t type, int id );
 
 
 /**
@@ -205,10 +221,15 @@ void tech_free (void)
  */
 static void tech_freeGroup( tech_group_t *grp )
 {
+   int i;
+
    if (grp->name != NULL)
       free(grp->name);
    if (grp->items != NULL)
       array_free( grp->items );
+   for (i=0; i<TECH_CACHE_TYPES; i++)
+      if (grp->cache[i] != NULL)
+         free( grp->cache[i] );
 }
 
 
@@ -399,6 +420,7 @@ static int tech_parseNodeData( tech_group_t *tech, xmlNodePtr parent )
  */
 static tech_item_t *tech_itemGrow( tech_group_t *grp )
 {
+   tech_invalidate();
    if (grp->items == NULL)
       grp->items = array_create( tech_item_t );
    return &array_grow( &grp->items );
@@ -542,6 +564,7 @@ int tech_rmItemTech( tech_group_t *tech, const char *value )
       buf = tech_getItemName( &tech->items[i] );
       if (strcmp(buf, value)==0) {
          array_erase( &tech->items, &tech->items[i], &tech->items[i+1] );
+         tech_invalidate();
          return 0;
       }
    }
@@ -576,6 +599,7 @@ int tech_rmItem( const char *name, const char *value )
       buf = tech_getItemName( &tech->items[i] );
       if (strcmp(buf, value)==0) {
          array_erase( &tech->items, &tech->items[i], &tech->items[i+1] );
+         tech_invalidate();
          return 0;
       }
    }
@@ -649,87 +673,206 @@ static int tech_addItemGroup( tech_group_t *grp, const char *name )
 
 
 /**
- * @brief Creates a meta-tech group pointing only to other groups.
- *
- *    @param grp Group to initialize.
- *    @param tech List of tech groups to attach.
- *    @param num Number of tech groups.
+ * @brief Invalidates the resolved contents of all the groups.
  */
-static void tech_createMetaGroup( tech_group_t *grp, tech_group_t **tech, int num )
+static void tech_invalidate (void)
 {
-   int i;
+   tech_gen++;
+   if (tech_gen == 0)
+      tech_gen = 1;
+}
 
-   /* Create meta group. */
-   memset( grp, 0, sizeof(tech_group_t) );
 
-   /* Create a meta-group. */
-   for (i=0; i<num; i++)
-      tech_addItemGroupPointer( grp, tech[i] );
+/**
+ * @brief Gets the size of the stack an item type indexes.
+ */
+static int tech_stackSize( tech_item_type_t type )
+{
+   int n;
+
+   switch (type) {
+      case TECH_TYPE_OUTFIT:
+         outfit_getAll( &n );
+         return n;
+      case TECH_TYPE_SHIP:
+         ship_getAll( &n );
+         return n;
+      case TECH_TYPE_COMMODITY:
+         commodity_getAll( &n );
+         return n;
+      default:
+         return 0;
+   }
 }
 
 
 /**
- * @brief Recursive function for creating an array of commodities from a tech group.
+ * @brief Gets the position of an item in its stack.
  */
-static void** tech_addGroupItem( void **items, tech_item_type_t type, tech_group_t *tech, int *n, int *m )
+static int tech_stackIndex( const tech_item_t *item )
 {
-   int i, j, size, f;
+   int n;
+
+   switch (item->type) {
+      case TECH_TYPE_OUTFIT:
+         return item->u.outfit - outfit_getAll( &n );
+      case TECH_TYPE_SHIP:
+         return item->u.ship - ship_getAll( &n );
+      case TECH_TYPE_COMMODITY:
+         return item->u.comm - commodity_getAll( &n );
+      default:
+         return -1;
+   }
+}
+
+
+/**
+ * @brief Resolves the contents of a group into its cache if needed.
+ *
+ *    @param tech Group to resolve.
+ *    @return 0 on success.
+ */
+static int tech_resolve( tech_group_t *tech )
+{
+   int i, j, t, s, id, nw;
    tech_item_t *item;
+   tech_group_t *grp;
 
-   /* Must have items. */
-   if (tech->items == NULL)
-      return items;
+   /* Still valid. */
+   if (tech->cache_gen == tech_gen)
+      return 0;
 
-   /* Comfort. */
-   size  = array_size( tech->items );
+   /* Groups including themselves would recurse forever. */
+   if (tech->cache_busy) {
+      WARN("Tech group '%s' includes itself.", (tech->name != NULL) ? tech->name : "(anonymous)" );
+      return -1;
+   }
+   tech->cache_busy = 1;
 
-   /* Load commodities first, then we handle groups. */
-   for (i=0; i<size; i++) {
-      item = &tech->items[i];
+   /* Clear the bitsets, the stacks don't change size once loaded. */
+   for (t=0; t<TECH_CACHE_TYPES; t++) {
+      nw = (tech_stackSize( t ) + TECH_WORD_BITS-1) / TECH_WORD_BITS;
+      free( tech->cache[t] );
+      tech->cache[t] = calloc( MAX(nw,1), sizeof(uint32_t) );
+   }
 
-      /* Only handle commodities for now. */
-      if (item->type != type)
-         continue;
+   /* Set own items and merge included groups. */
+   s = array_size( tech->items );
+   for (i=0; i<s; i++) {
+      item = &tech->items[i];
+      switch (item->type) {
+         case TECH_TYPE_OUTFIT:
+         case TECH_TYPE_SHIP:
+         case TECH_TYPE_COMMODITY:
+            id = tech_stackIndex( item );
+            tech->cache[ item->type ][ id / TECH_WORD_BITS ] |= 1U << (id % TECH_WORD_BITS);
+            break;
 
-      /* Skip if already in list. */
-      f = 0;
-      for (j=0; j<*n; j++) {
-         if (items[j] == item->u.ptr) {
-            f = 1;
+         case TECH_TYPE_GROUP:
+         case TECH_TYPE_GROUP_POINTER:
+            grp = (item->type == TECH_TYPE_GROUP) ?
+                  &tech_groups[ item->u.grp ] : item->u.grpptr;
+            if (tech_resolve( grp ))
+               break;
+            for (t=0; t<TECH_CACHE_TYPES; t++) {
+               nw = (tech_stackSize( t ) + TECH_WORD_BITS-1) / TECH_WORD_BITS;
+               for (j=0; j<nw; j++)
+                  tech->cache[t][j] |= grp->cache[t][j];
+            }
             break;
-         }
       }
-      if (f == 1)
-         continue;
+   }
 
-      /* Allocate memory if needed. */
-      (*n)++;
-      if ((*n) > (*m)) {
-         if ((*m) == 0)
-            (*m)  = 16;
-         (*m) *= 2;
-         items = realloc( items, sizeof(void*) * (*m) );
-      }
+   tech->cache_busy = 0;
+   tech->cache_gen  = tech_gen;
+   return 0;
+}
+
+
+/**
+ * @brief Gets the union of the items of a type in a set of groups.
+ *
+ * @note The returned list must be freed (but not the pointers).
+ *
+ *    @param tech Groups to get items from.
+ *    @param num Number of groups.
+ *    @param type Type of the items to get.
+ *    @param[out] n Number of items found.
+ *    @return The items found, NULL if none.
+ */
+static void** tech_getItems( tech_group_t **tech, int num, tech_item_type_t type, int *n )
+{
+   int i, j, b, ns, nw;
+   uint32_t *bits, w;
+   void **items;
+   char *base;
+   size_t stride;
+
+   *n = 0;
+   ns = tech_stackSize( type );
+   nw = (ns + TECH_WORD_BITS-1) / TECH_WORD_BITS;
+   if (nw == 0)
+      return NULL;
 
-      /* Add. */
-      items[ (*n)-1 ]  = item->u.ptr;
+   /* Union is just or-ing the bitsets. */
+   bits = calloc( nw, sizeof(uint32_t) );
+   for (i=0; i<num; i++) {
+      if ((tech[i] == NULL) || tech_resolve( tech[i] ))
+         continue;
+      for (j=0; j<nw; j++)
+         bits[j] |= tech[i]->cache[type][j];
    }
 
-   /* Now handle other groups. */
-   for (i=0; i<size; i++) {
-      item = &tech->items[i];
+   /* Get the stack to map the bits back to. */
+   switch (type) {
+      case TECH_TYPE_OUTFIT:
+         base     = (char*) outfit_getAll( &ns );
+         stride   = sizeof(Outfit);
+         break;
+      case TECH_TYPE_SHIP:
+         base     = (char*) ship_getAll( &ns );
+         stride   = sizeof(Ship);
+         break;
+      default:
+         base     = (char*) commodity_getAll( &ns );
+         stride   = sizeof(Commodity);
+         break;
+   }
 
-      /* Only handle commodities for now. */
-      if (item->type == TECH_TYPE_GROUP)
-         items  = tech_addGroupItem( items, type, &tech_groups[ item->u.grp ], n, m );
-      else if (item->type == TECH_TYPE_GROUP_POINTER)
-         items  = tech_addGroupItem( items, type, item->u.grpptr, n, m );
+   /* Count and expand. */
+   for (j=0; j<nw; j++)
+      for (w=bits[j]; w!=0; w&=w-1)
+         (*n)++;
+   if (*n == 0) {
+      free(bits);
+      return NULL;
+   }
+   items = malloc( sizeof(void*) * (*n) );
+   i = 0;
+   for (j=0; j<nw; j++) {
+      if (bits[j] == 0)
+         continue;
+      for (b=0; b<TECH_WORD_BITS; b++)
+         if (bits[j] & (1U << b))
+            items[i++] = base + stride * (j*TECH_WORD_BITS + b);
    }
 
+   free(bits);
    return items;
 }
 
 
+/**
+ * @brief Checks to see if an item is in a group once resolved.
+ */
+static int tech_hasResolved( tech_group_t *tech, tech_item_type_t type, int id )
+{
+   if ((tech == NULL) || (id < 0) || tech_resolve( tech ))
+      return 0;
+   return !!(tech->cache[type][ id / TECH_WORD_BITS ] & (1U << (id % TECH_WORD_BITS)));
+}
+
+
 /**
  * @brief Checks whether a given tech group has the specified item.
  *
@@ -807,7 +950,6 @@ char** tech_getAllItemNames( int *n )
  */
 Outfit** tech_getOutfit( tech_group_t *tech, int *n )
 {
-   int m;
    Outfit **o;
 
    if (tech==NULL) {
@@ -816,15 +958,9 @@ Outfit** tech_getOutfit( tech_group_t *tech, int *n )
    }
 
    /* Get the outfits. */
-   *n = 0;
-   m  = 0;
-   o  = (Outfit**)tech_addGroupItem( NULL, TECH_TYPE_OUTFIT, tech, n, &m );
-
-   /* None found case. */
-   if (o == NULL) {
-      *n = 0;
+   o = (Outfit**) tech_getItems( &tech, 1, TECH_TYPE_OUTFIT, n );
+   if (o == NULL)
       return NULL;
-   }
 
    /* Sort. */
    qsort( o, *n, sizeof(Outfit*), outfit_compareTech );
@@ -844,7 +980,6 @@ Outfit** tech_getOutfit( tech_group_t *tech, int *n )
  */
 Outfit** tech_getOutfitArray( tech_group_t **tech, int num, int *n )
 {
-   tech_group_t grp;
    Outfit **o;
 
    if (tech==NULL) {
@@ -852,10 +987,12 @@ Outfit** tech_getOutfitArray( tech_group_t **tech, int num, int *n )
       return NULL;
    }
 
-   tech_createMetaGroup( &grp, tech, num );
-   o = tech_getOutfit( &grp, n );
-   tech_freeGroup( &grp );
+   o = (Outfit**) tech_getItems( tech, num, TECH_TYPE_OUTFIT, n );
+   if (o == NULL)
+      return NULL;
 
+   /* Sort. */
+   qsort( o, *n, sizeof(Outfit*), outfit_compareTech );
    return o;
 }
 
@@ -871,7 +1008,6 @@ Outfit** tech_getOutfitArray( tech_group_t **tech, int num, int *n )
  */
 Ship** tech_getShip( tech_group_t *tech, int *n )
 {
-   int m;
    Ship **s;
 
    if (tech==NULL) {
@@ -879,16 +1015,10 @@ Ship** tech_getShip( tech_group_t *tech, int *n )
       return NULL;
    }
 
-   /* Get the outfits. */
-   *n = 0;
-   m  = 0;
-   s  = (Ship**) tech_addGroupItem( NULL, TECH_TYPE_SHIP, tech, n, &m );
-
-   /* None found case. */
-   if (s == NULL) {
-      *n = 0;
+   /* Get the ships. */
+   s = (Ship**) tech_getItems( &tech, 1, TECH_TYPE_SHIP, n );
+   if (s == NULL)
       return NULL;
-   }
 
    /* Sort. */
    qsort( s, *n, sizeof(Ship*), ship_compareTech );
@@ -908,7 +1038,6 @@ Ship** tech_getShip( tech_group_t *tech, int *n )
  */
 Ship** tech_getShipArray( tech_group_t **tech, int num, int *n )
 {
-   tech_group_t grp;
    Ship **s;
 
    if (tech==NULL) {
@@ -916,10 +1045,12 @@ Ship** tech_getShipArray( tech_group_t **tech, int num, int *n )
       return NULL;
    }
 
-   tech_createMetaGroup( &grp, tech, num );
-   s = tech_getShip( &grp, n );
-   tech_freeGroup( &grp );
+   s = (Ship**) tech_getItems( tech, num, TECH_TYPE_SHIP, n );
+   if (s == NULL)
+      return NULL;
 
+   /* Sort. */
+   qsort( s, *n, sizeof(Ship*), ship_compareTech );
    return s;
 }
 
@@ -936,7 +1067,6 @@ Ship** tech_getShipArray( tech_group_t **tech, int num, int *n )
  */
 Commodity** tech_getCommodityArray( tech_group_t **tech, int num, int *n )
 {
-   tech_group_t grp;
    Commodity **c;
 
    if (tech==NULL) {
@@ -944,10 +1074,12 @@ Commodity** tech_getCommodityArray( tech_group_t **tech, int num, int *n )
       return NULL;
    }
 
-   tech_createMetaGroup( &grp, tech, num );
-   c = tech_getCommodity( &grp, n );
-   tech_freeGroup( &grp );
+   c = (Commodity**) tech_getItems( tech, num, TECH_TYPE_COMMODITY, n );
+   if (c == NULL)
+      return NULL;
 
+   /* Sort. */
+   qsort( c, *n, sizeof(Commodity*), commodity_compareTech );
    return c;
 }
 
@@ -963,7 +1095,6 @@ Commodity** tech_getCommodityArray( tech_group_t **tech, int num, int *n )
  */
 Commodity** tech_getCommodity( tech_group_t *tech, int *n )
 {
-   int m;
    Commodity **c;
 
    if (tech==NULL) {
@@ -972,15 +1103,9 @@ Commodity** tech_getCommodity( tech_group_t *tech, int *n )
    }
 
    /* Get the commodities. */
-   *n = 0;
-   m  = 0;
-   c  = (Commodity**) tech_addGroupItem( NULL, TECH_TYPE_COMMODITY, tech, n, &m );
-
-   /* None found case. */
-   if (c == NULL) {
-      *n = 0;
+   c = (Commodity**) tech_getItems( &tech, 1, TECH_TYPE_COMMODITY, n );
+   if (c == NULL)
       return NULL;
-   }
 
    /* Sort. */
    qsort( c, *n, sizeof(Commodity*), commodity_compareTech );
@@ -988,3 +1113,31 @@ Commodity** tech_getCommodity( tech_group_t *tech, int *n )
 }
 
 
+/**
+ * @brief Checks to see if a tech group provides an outfit.
+ *
+ *    @param tech Tech group to check.
+ *    @param o Outfit to look for.
+ *    @return 1 if the outfit is available in the group.
+ */
+int tech_hasOutfit( tech_group_t *tech, const Outfit *o )
+{
+   int n;
+   return tech_hasResolved( tech, TECH_TYPE_OUTFIT, o - outfit_getAll( &n ) );
+}
+
+
+/**
+ * @brief Checks to see if a tech group provides a ship.
+ *
+ *    @param tech Tech group to check.
+ *    @param s Ship to look for.
+ *    @return 1 if the ship is available in the group.
+ */
+int tech_hasShip( tech_group_t *tech, const Ship *s )
+{
+   int n;
+   return tech_hasResolved( tech, TECH_TYPE_SHIP, s - ship_getAll( &n ) );
+}
+
+
@@ -0,0 +1,390 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file texcache.c
+ *
+ * @brief Caches derived image data on disk.
+ *
+ * Decoding PNGs, padding them to power of two, mapping their transparency and
+ *  generating derived graphics is deterministic, so the results get stored
+ *  under the cache path. Later runs can skip all of that and just copy the
+ *  data over from a mapping of the file.
+ *
+ * Every source gets a single file named after its path, tag and flags, which
+ *  stores the modification time and size of the source. When the source
+ *  changes they no longer match and the file gets overwritten, and
+ *  texcache_prune() removes the files whose source no longer exists, so the
+ *  cache does not keep growing. Checking the source this way is cheap, so a
+ *  hit doesn't need to read the source at all.
+ *
+ * Files are laid out as a fixed header, the source path, a table of image
+ *  entries and then the image data with every block aligned. The data is
+ *  stored in native byte order and files from a different byte order or
+ *  version are ignored.
+ */
+
+
+#include "texcache.h"
+
+#include "naev.h"
+
+#include <stdlib.h>
+#include "nstring.h"
+
+#include "log.h"
+#include "nfile.h"
+#include "ndata.h"
+#include "md5.h"
+#include "opengl.h"
+
+
+#define TEXCACHE_PATH      "gfx/" /**< Cache subdirectory. */
+#define TEXCACHE_EXT       ".ntc" /**< Cache file extension. */
+#define TEXCACHE_MAGIC     "NTEX" /**< File magic. */
+#define TEXCACHE_VERSION   3 /**< Bump when the format or the derived data changes. */
+#define TEXCACHE_ENDIAN    0x01020304 /**< Used to detect byte order. */
+#define TEXCACHE_ALIGN     16 /**< Alignment of the data blocks. */
+
+#define TEXCACHE_ALIGNED(x) (((x) + TEXCACHE_ALIGN-1) & ~(TEXCACHE_ALIGN-1)) /**< Aligns an offset. */
+
+
+/**
+ * @brief Header of a cache file.
+ */
+typedef struct TexCacheHeader_ {
+   char magic[4]; /**< TEXCACHE_MAGIC. */
+   uint32_t version; /**< TEXCACHE_VERSION. */
+   uint32_t endian; /**< TEXCACHE_ENDIAN in the byte order of the writer. */
+   uint32_t nimg; /**< Number of images. */
+   int64_t mtime; /**< Modification time of the source. */
+   uint64_t size; /**< Size of the source. */
+   uint32_t pathlen; /**< Length of the source path, including terminator. */
+} TexCacheHeader;
+
+
+/**
+ * @brief Image entry of a cache file.
+ */
+typedef struct TexCacheEntry_ {
+   uint32_t w; /**< Real width. */
+   uint32_t h; /**< Real height. */
+   uint32_t sx; /**< X sprites. */
+   uint32_t sy; /**< Y sprites. */
+   uint32_t rw; /**< Padded width. */
+   uint32_t rh; /**< Padded height. */
+   uint32_t bpp; /**< Bits per pixel. */
+   uint32_t pitch; /**< Bytes per row. */
+   uint32_t mask[4]; /**< RGBA masks. */
+   uint32_t ntrans; /**< Transparency map size. */
+   uint32_t off_pixels; /**< Offset of the pixel data. */
+   uint32_t off_trans; /**< Offset of the transparency map. */
+   uint32_t pad; /**< Keeps the entry aligned. */
+} TexCacheEntry;
+
+
+/**
+ * @brief Gets the cache key for a source in ndata.
+ *
+ *    @param[out] key Key to write.
+ *    @param path Path of the source in ndata.
+ *    @param tag Tag identifying what gets derived from the source.
+ *    @param flags Flags that change the derived data.
+ *    @return 0 on success, nonzero if the source can't be found.
+ */
+int texcache_key( TexCacheKey *key, const char *path, const char *tag, unsigned int flags )
+{
+   md5_state_t md5;
+   md5_byte_t digest[16];
+   uint32_t params[3];
+   time_t mtime;
+   size_t size;
+   int i;
+
+   /* Stamp to tell if the source changed. */
+   if (ndata_fileInfo( path, &mtime, &size ))
+      return -1;
+   key->mtime = mtime;
+   key->size  = size;
+
+   /* Anything that changes the result goes into the hash. */
+   params[0] = TEXCACHE_VERSION;
+   params[1] = flags;
+   params[2] = gl_needPOT();
+
+   /* The name depends on what the source is and what gets derived. */
+   md5_init( &md5 );
+   md5_append( &md5, (const md5_byte_t*)params, sizeof(params) );
+   md5_append( &md5, (const md5_byte_t*)tag, strlen(tag)+1 );
+   md5_append( &md5, (const md5_byte_t*)path, strlen(path)+1 );
+   md5_finish( &md5, digest );
+   for (i=0; i<16; i++)
+      nsnprintf( &key->name[2*i], 3, "%02x", digest[i] );
+
+   key->path = path;
+   return 0;
+}
+
+
+/**
+ * @brief Checks the header of a mapped cache file.
+ *
+ *    @param data Mapped file.
+ *    @param size Size of the mapping.
+ *    @param n Number of images expected, negative to not check.
+ *    @return The header or NULL if invalid.
+ */
+static const TexCacheHeader* texcache_header( const char *data, size_t size, int n )
+{
+   const TexCacheHeader *hdr;
+   size_t start;
+
+   hdr = (const TexCacheHeader*) data;
+   if ((size < sizeof(TexCacheHeader)) ||
+         (strncmp( hdr->magic, TEXCACHE_MAGIC, 4 ) != 0) ||
+         (hdr->version != TEXCACHE_VERSION) ||
+         (hdr->endian != TEXCACHE_ENDIAN) ||
+         ((n >= 0) && (hdr->nimg != (uint32_t)n)) ||
+         (hdr->pathlen == 0) || (hdr->pathlen > PATH_MAX))
+      return NULL;
+
+   start = TEXCACHE_ALIGNED( sizeof(TexCacheHeader) + hdr->pathlen );
+   if ((size < start + hdr->nimg*sizeof(TexCacheEntry)) ||
+         (data[ sizeof(TexCacheHeader) + hdr->pathlen - 1 ] != '\0'))
+      return NULL;
+
+   return hdr;
+}
+
+
+/**
+ * @brief Loads images from the cache.
+ *
+ *    @param key Key to load.
+ *    @param[out] img Images to load into, must be freed with texcache_free().
+ *    @param n Number of images expected.
+ *    @return 0 on success, nonzero if not found, outdated or invalid.
+ */
+int texcache_load( const TexCacheKey *key, TexCacheImg *img, int n )
+{
+   char *buf;
+   size_t size;
+   int i, j;
+   uint32_t pitch;
+   const TexCacheHeader *hdr;
+   const TexCacheEntry *ent;
+   SDL_Surface *s;
+
+   if (!nfile_fileExists( "%s"TEXCACHE_PATH"%s"TEXCACHE_EXT, nfile_cachePath(), key->name ))
+      return -1;
+   buf = nfile_mapFile( &size, "%s"TEXCACHE_PATH"%s"TEXCACHE_EXT, nfile_cachePath(), key->name );
+   if (buf == NULL)
+      return -1;
+
+   /* Check header. */
+   hdr = texcache_header( buf, size, n );
+   if (hdr == NULL)
+      goto err;
+
+   /* Source changed, gets overwritten when saving again. */
+   if ((hdr->mtime != key->mtime) || (hdr->size != key->size)) {
+      nfile_unmapFile( buf, size );
+      return -1;
+   }
+
+   memset( img, 0, sizeof(TexCacheImg) * n );
+   ent = (const TexCacheEntry*) &buf[ TEXCACHE_ALIGNED( sizeof(TexCacheHeader) + hdr->pathlen ) ];
+   for (i=0; i<n; i++) {
+      /* Entry must be within bounds. */
+      if (((uint64_t)ent[i].off_pixels + (uint64_t)ent[i].pitch*ent[i].rh > (uint64_t)size) ||
+            ((uint64_t)ent[i].off_trans + ent[i].ntrans > (uint64_t)size))
+         goto err_img;
+
+      /* Surfaces get handed over to the caller so they can't use the mapping. */
+      s = SDL_CreateRGBSurface( 0, ent[i].rw, ent[i].rh, ent[i].bpp,
+            ent[i].mask[0], ent[i].mask[1], ent[i].mask[2], ent[i].mask[3] );
+      if (s == NULL)
+         goto err_img;
+      pitch = MIN( (uint32_t)s->pitch, ent[i].pitch );
+      for (j=0; j<(int)ent[i].rh; j++)
+         memcpy( (uint8_t*)s->pixels + j*s->pitch,
+               &buf[ ent[i].off_pixels + j*ent[i].pitch ], pitch );
+
+      img[i].w       = ent[i].w;
+      img[i].h       = ent[i].h;
+      img[i].sx      = ent[i].sx;
+      img[i].sy      = ent[i].sy;
+      img[i].surface = s;
+      img[i].ntrans  = ent[i].ntrans;
+      if (ent[i].ntrans > 0) {
+         img[i].trans = malloc( ent[i].ntrans );
+         memcpy( img[i].trans, &buf[ ent[i].off_trans ], ent[i].ntrans );
+      }
+   }
+
+   nfile_unmapFile( buf, size );
+   return 0;
+
+err_img:
+   texcache_free( img, n );
+err:
+   WARN("Texture cache '%s' is invalid, ignoring.", key->name);
+   nfile_unmapFile( buf, size );
+   return -1;
+}
+
+
+/**
+ * @brief Saves images to the cache.
+ *
+ *    @param key Key to save as.
+ *    @param img Images to save.
+ *    @param n Number of images.
+ *    @return 0 on success.
+ */
+int texcache_save( const TexCacheKey *key, const TexCacheImg *img, int n )
+{
+   char *buf, path[PATH_MAX], tmp[PATH_MAX];
+   size_t size, start, pathlen;
+   int i, j;
+   TexCacheHeader *hdr;
+   TexCacheEntry *ent;
+   SDL_Surface *s;
+
+   /* Lay out the file. */
+   pathlen = strlen( key->path ) + 1;
+   start   = TEXCACHE_ALIGNED( sizeof(TexCacheHeader) + pathlen );
+   size    = TEXCACHE_ALIGNED( start + n*sizeof(TexCacheEntry) );
+   for (i=0; i<n; i++) {
+      size += TEXCACHE_ALIGNED( img[i].surface->pitch * img[i].surface->h );
+      size += TEXCACHE_ALIGNED( img[i].ntrans );
+   }
+   buf = calloc( 1, size );
+   if (buf == NULL) {
+      WARN("Out of memory!");
+      return -1;
+   }
+
+   hdr = (TexCacheHeader*) buf;
+   memcpy( hdr->magic, TEXCACHE_MAGIC, 4 );
+   hdr->version = TEXCACHE_VERSION;
+   hdr->endian  = TEXCACHE_ENDIAN;
+   hdr->nimg    = n;
+   hdr->pathlen = pathlen;
+   hdr->mtime   = key->mtime;
+   hdr->size    = key->size;
+   memcpy( &buf[ sizeof(TexCacheHeader) ], key->path, pathlen );
+
+   ent  = (TexCacheEntry*) &buf[ start ];
+   size = TEXCACHE_ALIGNED( start + n*sizeof(TexCacheEntry) );
+   for (i=0; i<n; i++) {
+      s = img[i].surface;
+      ent[i].w       = img[i].w;
+      ent[i].h       = img[i].h;
+      ent[i].sx      = img[i].sx;
+      ent[i].sy      = img[i].sy;
+      ent[i].rw      = s->w;
+      ent[i].rh      = s->h;
+      ent[i].bpp     = s->format->BitsPerPixel;
+      ent[i].pitch   = s->pitch;
+      ent[i].mask[0] = s->format->Rmask;
+      ent[i].mask[1] = s->format->Gmask;
+      ent[i].mask[2] = s->format->Bmask;
+      ent[i].mask[3] = s->format->Amask;
+      ent[i].ntrans  = img[i].ntrans;
+
+      ent[i].off_pixels = size;
+      SDL_LockSurface( s );
+      for (j=0; j<s->h; j++)
+         memcpy( &buf[ size + j*s->pitch ], (uint8_t*)s->pixels + j*s->pitch, s->pitch );
+      SDL_UnlockSurface( s );
+      size += TEXCACHE_ALIGNED( s->pitch * s->h );
+
+      ent[i].off_trans = size;
+      if (img[i].ntrans > 0)
+         memcpy( &buf[ size ], img[i].trans, img[i].ntrans );
+      size += TEXCACHE_ALIGNED( img[i].ntrans );
+   }
+
+   /* Write to a temporary file first so a crash never leaves a bad entry. */
+   nfile_dirMakeExist( "%s"TEXCACHE_PATH, nfile_cachePath() );
+   nsnprintf( path, sizeof(path), "%s"TEXCACHE_PATH"%s"TEXCACHE_EXT, nfile_cachePath(), key->name );
+   nsnprintf( tmp, sizeof(tmp), "%s.tmp", path );
+   if (nfile_writeFile( buf, size, "%s", tmp ) || nfile_replace( tmp, path )) {
+      WARN("Unable to write texture cache '%s'.", path);
+      free(buf);
+      return -1;
+   }
+
+   free(buf);
+   return 0;
+}
+
+
+/**
+ * @brief Frees images loaded with texcache_load().
+ *
+ *    @param img Images to free.
+ *    @param n Number of images.
+ */
+void texcache_free( TexCacheImg *img, int n )
+{
+   int i;
+   for (i=0; i<n; i++) {
+      if (img[i].surface != NULL)
+         SDL_FreeSurface( img[i].surface );
+      if (img[i].trans != NULL)
+         free( img[i].trans );
+   }
+   memset( img, 0, sizeof(TexCacheImg) * n );
+}
+
+
+/**
+ * @brief Removes cache files that are no longer of any use.
+ *
+ * Gets rid of files from other versions, leftover temporary files and files
+ *  whose source is no longer in ndata. Must be run after ndata is opened.
+ *
+ *    @return Number of files removed.
+ */
+int texcache_prune (void)
+{
+   char **files, *data, path[PATH_MAX];
+   const TexCacheHeader *hdr;
+   size_t size, len;
+   int i, nfiles, keep, removed;
+
+   files = nfile_readDir( &nfiles, "%s"TEXCACHE_PATH, nfile_cachePath() );
+   if (files == NULL)
+      return 0;
+
+   removed = 0;
+   for (i=0; i<nfiles; i++) {
+      nsnprintf( path, sizeof(path), "%s"TEXCACHE_PATH"%s", nfile_cachePath(), files[i] );
+      keep = 0;
+
+      /* Only files with a valid header and an existing source are kept. */
+      len = strlen( files[i] );
+      if ((len > strlen(TEXCACHE_EXT)) &&
+            (strcmp( &files[i][ len-strlen(TEXCACHE_EXT) ], TEXCACHE_EXT ) == 0)) {
+         data = nfile_mapFile( &size, "%s", path );
+         if (data != NULL) {
+            hdr = texcache_header( data, size, -1 );
+            if (hdr != NULL)
+               keep = ndata_exists( &data[ sizeof(TexCacheHeader) ] );
+            nfile_unmapFile( data, size );
+         }
+      }
+
+      if (!keep && (nfile_delete( path ) == 0))
+         removed++;
+      free( files[i] );
+   }
+   free( files );
+
+   if (removed > 0)
+      DEBUG("Pruned %d texture cache files.", removed);
+   return removed;
+}
@@ -0,0 +1,58 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+
+#ifndef TEXCACHE_H
+#  define TEXCACHE_H
+
+
+#include <stdint.h>
+
+#include "SDL.h"
+
+
+#define TEXCACHE_KEY_LEN   33 /**< Length of a cache file name, hex MD5 plus terminator. */
+
+
+/**
+ * @brief Identifies an entry in the texture cache.
+ */
+typedef struct TexCacheKey_ {
+   char name[TEXCACHE_KEY_LEN]; /**< File name, depends only on the source. */
+   int64_t mtime; /**< Modification time of the source. */
+   uint64_t size; /**< Size of the source. */
+   const char *path; /**< Path of the source, not owned. */
+} TexCacheKey;
+
+
+/**
+ * @brief Derived image data stored in the texture cache.
+ */
+typedef struct TexCacheImg_ {
+   uint32_t w; /**< Real width of the image. */
+   uint32_t h; /**< Real height of the image. */
+   uint32_t sx; /**< Number of sprites on the X axis. */
+   uint32_t sy; /**< Number of sprites on the Y axis. */
+   SDL_Surface *surface; /**< Padded surface, ready to upload. */
+   uint8_t *trans; /**< Transparency map, NULL if none. */
+   uint32_t ntrans; /**< Size of the transparency map in bytes. */
+} TexCacheImg;
+
+
+/*
+ * Keys.
+ */
+int texcache_key( TexCacheKey *key, const char *path, const char *tag, unsigned int flags );
+
+
+/*
+ * Loading and saving.
+ */
+int texcache_load( const TexCacheKey *key, TexCacheImg *img, int n );
+int texcache_save( const TexCacheKey *key, const TexCacheImg *img, int n );
+void texcache_free( TexCacheImg *img, int n );
+int texcache_prune (void);
+
+
+#endif /* TEXCACHE_H */
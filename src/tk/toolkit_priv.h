@@ -62,6 +62,7 @@ typedef enum WidgetStatus_ {
 #define WGT_FLAG_RAWINPUT     (1<<1)   /**< Widget should always get raw input. */
 #define WGT_FLAG_ALWAYSMMOVE  (1<<2)   /**< Widget should always get mouse motion events. */
 #define WGT_FLAG_FOCUSED      (1<<3)   /**< Widget is focused. */
+#define WGT_FLAG_DYNAMIC      (1<<4)   /**< Widget changes on its own and must be rendered every frame. */
 #define WGT_FLAG_KILL         (1<<9)   /**< Widget should die. */
 #define wgt_setFlag(w,f)      ((w)->flags |= (f)) /**< Sets a widget flag. */
 #define wgt_rmFlag(w,f)       ((w)->flags &= ~(f)) /**< Removes a widget flag. */
@@ -166,6 +167,17 @@ typedef struct Window_ {
    int focus; /**< Current focused widget. */
    Widget *widgets; /**< Widget storage. */
    void *udata; /**< Custom data of the window. */
+
+   /* Render cache. */
+   int dirty; /**< Cached content must be rendered again. */
+   Widget *cache_stop; /**< First widget not in the cache. */
+   GLuint cache_tex; /**< Texture holding the cached content, 0 if none. */
+   int cache_tw; /**< Width of the cache texture. */
+   int cache_th; /**< Height of the cache texture. */
+   int cache_pw; /**< Width of the cached pixels. */
+   int cache_ph; /**< Height of the cached pixels. */
+   int cache_px; /**< Screen X position of the cached pixels. */
+   int cache_py; /**< Screen Y position of the cached pixels. */
 } Window;
 
 
@@ -175,6 +187,7 @@ Window* window_wget( const unsigned int wid );
 int toolkit_inputWindow( Window *wdw, SDL_Event *event, int purge );
 void window_render( Window* w );
 void window_renderOverlay( Window* w );
+void window_dirty( Window *w );
 
 
 /* Widget stuff. */
@@ -65,6 +65,7 @@ void window_addCust( const unsigned int wid,
    wgt->dat.cst.mouse   = mouse;
    wgt->dat.cst.clip    = 1;
    wgt->dat.cst.userdata = data;
+   wgt_setFlag( wgt, WGT_FLAG_DYNAMIC ); /* Custom rendering can change at any time. */
 
    /* position/size */
    wgt->w = (double) w;
@@ -17,6 +17,13 @@
 #include "opengl.h"
 
 
+#define IAR_PRELOAD_ROWS   2 /**< Rows kept loaded above and below the visible ones. */
+
+#define IAR_IMG_NONE       0 /**< Image not loaded. */
+#define IAR_IMG_LOADED     1 /**< Image loaded and owned by the widget. */
+#define IAR_IMG_FAILED     2 /**< Image could not be loaded. */
+
+
 /* Render. */
 static void iar_render( Widget* iar, double bx, double by );
 static void iar_renderOverlay( Widget* iar, double bx, double by );
@@ -30,6 +37,10 @@ static int iar_focusImage( Widget* iar, double bx, double by );
 static void iar_focus( Widget* iar, double bx, double by );
 static void iar_scroll( Widget* iar, int direction );
 static void iar_centerSelected( Widget *iar );
+static void iar_visibleRows( Widget *iar, int *first, int *last );
+/* Lazy loading. */
+static void iar_loadImages( Widget *iar, int first, int last );
+static void iar_unloadImage( Widget *iar, int pos );
 /* Misc. */
 static Widget *iar_getWidget( const unsigned int wid, const char *name );
 static char* toolkit_getNameById( Widget *wgt, int elem );
@@ -117,6 +128,94 @@ static void iar_getDim( Widget* iar, double *w, double *h )
 }
 
 
+/**
+ * @brief Gets the rows of an image array that are visible.
+ *
+ *    @param iar Image array to get visible rows of.
+ *    @param[out] first First visible row.
+ *    @param[out] last Row after the last visible one.
+ */
+static void iar_visibleRows( Widget *iar, int *first, int *last )
+{
+   double h;
+
+   iar_getDim( iar, NULL, &h );
+   *first = MAX( 0, (int)floor( iar->dat.iar.pos / h ) );
+   *last  = MIN( iar->dat.iar.yelem, (int)ceil( (iar->dat.iar.pos + iar->h) / h ) );
+}
+
+
+/**
+ * @brief Loads the images near the visible rows and frees the rest.
+ *
+ *    @param iar Image array to load images of.
+ *    @param first First visible row.
+ *    @param last Row after the last visible one.
+ */
+static void iar_loadImages( Widget *iar, int first, int last )
+{
+   int i, j, pos, xelem, n;
+
+   if (iar->dat.iar.imgload == NULL)
+      return;
+
+   xelem = iar->dat.iar.xelem;
+   n     = iar->dat.iar.nelements;
+   first = MAX( 0, first - IAR_PRELOAD_ROWS );
+   last  = MIN( iar->dat.iar.yelem, last + IAR_PRELOAD_ROWS );
+
+   /* Free rows that are no longer near. */
+   for (j=iar->dat.iar.loadfirst; j<iar->dat.iar.loadlast; j++) {
+      if ((j >= first) && (j < last))
+         continue;
+      for (i=0; i<xelem; i++) {
+         pos = j*xelem + i;
+         if (pos >= n)
+            break;
+         iar_unloadImage( iar, pos );
+      }
+   }
+
+   /* Load the new rows. */
+   for (j=first; j<last; j++) {
+      for (i=0; i<xelem; i++) {
+         pos = j*xelem + i;
+         if (pos >= n)
+            break;
+         if ((iar->dat.iar.imgstate[pos] != IAR_IMG_NONE) ||
+               (iar->dat.iar.images[pos] != NULL))
+            continue;
+         if (iar->dat.iar.captions[pos] != NULL)
+            iar->dat.iar.images[pos] = iar->dat.iar.imgload( iar->dat.iar.captions[pos] );
+         iar->dat.iar.imgstate[pos] = (iar->dat.iar.images[pos] != NULL) ?
+               IAR_IMG_LOADED : IAR_IMG_FAILED;
+      }
+   }
+
+   iar->dat.iar.loadfirst = first;
+   iar->dat.iar.loadlast  = last;
+}
+
+
+/**
+ * @brief Frees a lazily loaded image.
+ *
+ *    @param iar Image array to free image of.
+ *    @param pos Element to free image of.
+ */
+static void iar_unloadImage( Widget *iar, int pos )
+{
+   if (iar->dat.iar.imgstate[pos] == IAR_IMG_LOADED) {
+      if (iar->dat.iar.imgunload != NULL)
+         iar->dat.iar.imgunload( iar->dat.iar.captions[pos], iar->dat.iar.images[pos] );
+      else
+         gl_freeTexture( iar->dat.iar.images[pos] );
+      iar->dat.iar.images[pos] = NULL;
+   }
+   iar->dat.iar.imgstate[pos] = IAR_IMG_NONE;
+}
+
+
 /**
  * @brief Renders an image array.
  *
@@ -126,7 +225,7 @@ static void iar_getDim( Widget* iar, double *w, double *h )
  */
 static void iar_render( Widget* iar, double bx, double by )
 {
-   int i,j, pos;
+   int i,j, pos, jstart, jend;
    double x,y, w,h, xcurs,ycurs;
    double scroll_pos;
    int xelem, yelem;
@@ -166,11 +265,13 @@ static void iar_render( Widget* iar, double bx, double by )
    toolkit_drawScrollbar( x + iar->w - 10., y, 10., iar->h, scroll_pos );
 
    /*
-    * Main drawing loop.
+    * Main drawing loop, only the visible rows.
     */
+   iar_visibleRows( iar, &jstart, &jend );
+   iar_loadImages( iar, jstart, jend );
    gl_clipRect( x, y, iar->w, iar->h );
-   ycurs = y + iar->h - h + iar->dat.iar.pos;
-   for (j=0; j<yelem; j++) {
+   ycurs = y + iar->h - h + iar->dat.iar.pos - jstart*h;
+   for (j=jstart; j<jend; j++) {
       xcurs = x + xspace;
       for (i=0; i<xelem; i++) {
 
@@ -481,6 +582,13 @@ static void iar_cleanup( Widget* iar )
 {
    int i;
 
+   /* Free lazily loaded images. */
+   if (iar->dat.iar.imgstate != NULL) {
+      for (i=0; i<iar->dat.iar.nelements; i++)
+         iar_unloadImage( iar, i );
+      free( iar->dat.iar.imgstate );
+   }
+
    if (iar->dat.iar.nelements > 0) { /* Free each text individually */
       for (i=0; i<iar->dat.iar.nelements; i++) {
          if (iar->dat.iar.captions[i])
@@ -558,7 +666,7 @@ static void iar_scroll( Widget* iar, int direction )
  */
 static int iar_focusImage( Widget* iar, double bx, double by )
 {
-   int i,j;
+   int i,j, pos;
    double w,h, ycurs,xcurs;
    int xelem, yelem;
    double xspace;
@@ -570,27 +678,24 @@ static int iar_focusImage( Widget* iar, double bx, double by )
    xelem = iar->dat.iar.xelem;
    yelem = iar->dat.iar.yelem;
    xspace = (double)(((int)iar->w - 10) % (int)w) / (double)(xelem + 1);
-   if (bx < iar->w - 10.) {
-
-      /* Loop through elements until finding collision. */
-      ycurs = iar->h - h + iar->dat.iar.pos;
-      for (j=0; j<yelem; j++) {
-         xcurs = xspace;
-         for (i=0; i<xelem; i++) {
-            /* Out of elements. */
-            if ((j*xelem + i) >= iar->dat.iar.nelements)
-               break;
-
-            /* Check for collision. */
-            if ((bx > xcurs) && (bx < xcurs+w-4.) &&
-                  (by > ycurs) && (by < ycurs+h-4.))
-               return j*xelem + i;
-
-            xcurs += xspace + w;
-         }
-         ycurs -= h;
-      }
-   }
+   if (bx >= iar->w - 10.)
+      return -1;
+
+   /* Get the cell directly instead of going through all the elements. */
+   j = (int)floor( (iar->h + iar->dat.iar.pos - by) / h );
+   i = (int)floor( (bx - xspace) / (w + xspace) );
+   if ((i < 0) || (i >= xelem) || (j < 0) || (j >= yelem))
+      return -1;
+   pos = j*xelem + i;
+   if (pos >= iar->dat.iar.nelements)
+      return -1;
+
+   /* Check for collision, there are gaps between elements. */
+   xcurs = xspace + i*(w + xspace);
+   ycurs = iar->h - h + iar->dat.iar.pos - j*h;
+   if ((bx > xcurs) && (bx < xcurs+w-4.) &&
+         (by > ycurs) && (by < ycurs+h-4.))
+      return pos;
 
    return -1;
 }
@@ -937,3 +1042,33 @@ int toolkit_setImageArrayBackground( const unsigned int wid, const char* name,
 }
 
 
+/**
+ * @brief Makes the image array load its images lazily.
+ *
+ * Images of elements that are NULL get loaded by caption when their row comes
+ *  near the visible area and released again when it gets scrolled far enough
+ *  away, so only a few rows of images exist at a time.
+ *
+ *    @param wid Window where image array is.
+ *    @param name Name of the image array.
+ *    @param load Function returning a new texture reference for a caption.
+ *    @param unload Function releasing what load got for a caption, NULL to
+ *           just use gl_freeTexture().
+ *    @return 0 on success.
+ */
+int toolkit_setImageArrayLoader( const unsigned int wid, const char* name,
+      glTexture* (*load) (const char*),
+      void (*unload) (const char*, glTexture*) )
+{
+   Widget *wgt = iar_getWidget( wid, name );
+   if (wgt == NULL)
+      return -1;
+
+   if (wgt->dat.iar.imgstate == NULL)
+      wgt->dat.iar.imgstate = calloc( MAX(1, wgt->dat.iar.nelements), sizeof(uint8_t) );
+   wgt->dat.iar.imgload   = load;
+   wgt->dat.iar.imgunload = unload;
+   return 0;
+}
+
+
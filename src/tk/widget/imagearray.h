@@ -35,6 +35,11 @@ typedef struct WidgetImageArrayData_ {
    int ih; /**< Image height to use. */
    void (*fptr) (unsigned int,char*); /**< Modify callback - triggered on selection. */
    void (*rmptr) (unsigned int,char*); /**< Right click callback. */
+   glTexture* (*imgload) (const char*); /**< Loads the image of an element by caption, NULL if images are given. */
+   void (*imgunload) (const char*, glTexture*); /**< Releases a loaded image, NULL to just free it. */
+   uint8_t *imgstate; /**< Lazy loading state of each element. */
+   int loadfirst; /**< First row with lazily loaded images. */
+   int loadlast; /**< Row after the last with lazily loaded images. */
 } WidgetImageArrayData;
 
 
@@ -61,6 +66,9 @@ int toolkit_setImageArraySlotType( const unsigned int wid, const char* name,
       char **slottype );
 int toolkit_setImageArrayBackground( const unsigned int wid, const char* name,
       glColour *bg );
+int toolkit_setImageArrayLoader( const unsigned int wid, const char* name,
+      glTexture* (*load) (const char*),
+      void (*unload) (const char*, glTexture*) );
 
 
 #endif /* WGT_IMAGEARRAY_H */
@@ -14,12 +14,14 @@
 #include "naev.h"
 
 #include <stdarg.h>
+#include <math.h>
 
 #include "tk/toolkit_priv.h"
 
 #include "log.h"
 #include "pause.h"
 #include "opengl.h"
+#include "opengl_ext.h"
 #include "input.h"
 #include "nstd.h"
 #include "dialogue.h"
@@ -70,6 +72,17 @@ static gl_vbo *toolkit_vbo; /**< Toolkit VBO. */
 static GLsizei toolkit_vboColourOffset; /**< Colour offset. */
 
 
+/*
+ * Render cache.
+ */
+static GLuint toolkit_fbo     = 0; /**< Framebuffer windows get cached through. */
+static GLuint toolkit_fboTex  = 0; /**< Texture backing the framebuffer. */
+static int toolkit_fboW       = 0; /**< Width of the framebuffer. */
+static int toolkit_fboH       = 0; /**< Height of the framebuffer. */
+static int toolkit_fboFailed  = 0; /**< Framebuffer could not be created. */
+static int toolkit_rendering  = 0; /**< Windows are being rendered, lookups don't dirty them. */
+
+
 /*
  * static prototypes
  */
@@ -84,6 +97,16 @@ static int toolkit_isFocusable( Widget *wgt );
 static Widget* toolkit_getFocus( Window *wdw );
 /* render */
 static void window_renderBorder( Window* w );
+static void window_renderWidgets( Window *w, Widget *start, Widget *stop );
+static void window_renderFocus( Window *w );
+static void window_renderCached( Window *w );
+static int widget_isDynamic( Widget *wgt );
+static Widget* window_firstDynamic( Window *w );
+static void window_cacheRect( Window *w, int *px, int *py, int *pw, int *ph );
+static int window_cacheUpdate( Window *w, Widget *stop );
+static void window_cacheRender( Window *w );
+static int toolkit_cacheCheck (void);
+static void toolkit_cacheFree (void);
 /* Death. */
 static void widget_kill( Widget *wgt );
 static void window_kill( Window *wdw );
@@ -218,13 +241,37 @@ Window* window_wget( const unsigned int wid )
    Window *w;
    if (windows == NULL)
       return NULL;
-   for (w = windows; w != NULL; w = w->next)
-      if (w->id == wid)
+   for (w = windows; w != NULL; w = w->next) {
+      if (w->id == wid) {
+         /* Anything looked up from outside rendering may get modified. */
+         if (!toolkit_rendering)
+            window_dirty( w );
          return w;
+      }
+   }
    return NULL;
 }
 
 
+/**
+ * @brief Marks a window as needing to be rendered again.
+ *
+ *    @param w Window to mark.
+ */
+void window_dirty( Window *w )
+{
+   Window *wdw;
+
+   w->dirty = 1;
+
+   /* Windows that don't render on their own are drawn by another window's
+    * widgets, so we can't tell which cache holds them. */
+   if (window_isFlag( w, WINDOW_NORENDER ))
+      for (wdw = windows; wdw != NULL; wdw = wdw->next)
+         wdw->dirty = 1;
+}
+
+
 /**
  * @brief Gets a widget from window id and widgetname.
  *
@@ -770,6 +817,8 @@ static void window_kill( Window *wdw )
    /* Destroy the window. */
    if (wdw->name)
       free(wdw->name);
+   if (wdw->cache_tex != 0)
+      glDeleteTextures( 1, &wdw->cache_tex );
    wgt = wdw->widgets;
    while (wgt != NULL) {
       wgtkill = wgt;
@@ -1462,41 +1511,323 @@ static void window_renderBorder( Window* w )
  */
 void window_render( Window *w )
 {
-   double x, y, wid, hei;
-   Widget *wgt;
-
    /* Do not render dead windows. */
    if (window_isFlag( w, WINDOW_KILL ))
       return;
 
-   /* position */
-   x = w->x;
-   y = w->y;
-
    /* See if needs border. */
    if (!window_isFlag( w, WINDOW_NOBORDER ))
       window_renderBorder(w);
 
-   /*
-    * widgets
-    */
-   for (wgt=w->widgets; wgt!=NULL; wgt=wgt->next)
+   /* Widgets. */
+   window_renderWidgets( w, w->widgets, NULL );
+
+   /* Focused widget. */
+   window_renderFocus( w );
+}
+
+
+/**
+ * @brief Renders part of the widgets of a window.
+ *
+ *    @param w Window to render widgets of.
+ *    @param start First widget to render.
+ *    @param stop Widget to stop at or NULL to render until the end.
+ */
+static void window_renderWidgets( Window *w, Widget *start, Widget *stop )
+{
+   Widget *wgt;
+
+   for (wgt=start; (wgt!=NULL) && (wgt!=stop); wgt=wgt->next)
       if (wgt->render != NULL)
-         wgt->render( wgt, x, y );
+         wgt->render( wgt, w->x, w->y );
+}
 
-   /*
-    * focused widget
-    */
-   if (w->focus != -1) {
-      wgt = toolkit_getFocus( w );
-      if (wgt == NULL)
+
+/**
+ * @brief Renders the outline of the focused widget of a window.
+ *
+ *    @param w Window to render focus of.
+ */
+static void window_renderFocus( Window *w )
+{
+   Widget *wgt;
+
+   if (w->focus == -1)
+      return;
+
+   wgt = toolkit_getFocus( w );
+   if (wgt == NULL)
+      return;
+   toolkit_drawOutline( w->x + wgt->x, w->y + wgt->y, wgt->w, wgt->h,
+         3, &cBlack, NULL );
+}
+
+
+/**
+ * @brief Checks to see if a widget has to be rendered every frame.
+ *
+ *    @param wgt Widget to check.
+ *    @return 1 if the widget can't be cached.
+ */
+static int widget_isDynamic( Widget *wgt )
+{
+   Window *wdw;
+
+   if (wgt_isFlag( wgt, WGT_FLAG_DYNAMIC ))
+      return 1;
+
+   /* Tabbed windows render the active tab's window. */
+   if (wgt->type == WIDGET_TABBEDWINDOW) {
+      wdw = window_wget( wgt->dat.tab.windows[ wgt->dat.tab.active ] );
+      return (wdw != NULL) && (window_firstDynamic( wdw ) != NULL);
+   }
+
+   return 0;
+}
+
+
+/**
+ * @brief Gets the first widget of a window that can't be cached.
+ *
+ *    @param w Window to check.
+ *    @return First dynamic widget or NULL if the whole window can be cached.
+ */
+static Widget* window_firstDynamic( Window *w )
+{
+   Widget *wgt;
+
+   for (wgt=w->widgets; wgt!=NULL; wgt=wgt->next)
+      if (widget_isDynamic( wgt ))
+         return wgt;
+   return NULL;
+}
+
+
+/**
+ * @brief Renders a window, using the cache for the content that didn't change.
+ *
+ * The border and all the widgets before the first dynamic widget get rendered
+ *  to a texture, which is drawn instead until the window is marked dirty. The
+ *  rest of the widgets and the focus outline are rendered every frame on top,
+ *  so the drawing order stays the same.
+ *
+ *    @param w Window to render.
+ */
+static void window_renderCached( Window *w )
+{
+   Widget *stop;
+   int px, py, pw, ph;
+
+   /* Do not render dead windows. */
+   if (window_isFlag( w, WINDOW_KILL ))
+      return;
+
+   /* See if the cache is still good. */
+   stop = window_firstDynamic( w );
+   window_cacheRect( w, &px, &py, &pw, &ph );
+   if (w->dirty || (w->cache_tex == 0) || (stop != w->cache_stop) ||
+         (px != w->cache_px) || (py != w->cache_py) ||
+         (pw != w->cache_pw) || (ph != w->cache_ph)) {
+      if (window_cacheUpdate( w, stop )) {
+         window_render( w );
          return;
-      x  += wgt->x;
-      y  += wgt->y;
-      wid = wgt->w;
-      hei = wgt->h;
-      toolkit_drawOutline( x, y, wid, hei, 3, &cBlack, NULL );
+      }
    }
+
+   /* Cached content. */
+   window_cacheRender( w );
+
+   /* Dynamic content. */
+   window_renderWidgets( w, stop, NULL );
+   window_renderFocus( w );
+}
+
+
+/**
+ * @brief Gets the screen pixels covered by a window.
+ *
+ *    @param w Window to get pixels of.
+ *    @param[out] px X position of the pixels.
+ *    @param[out] py Y position of the pixels.
+ *    @param[out] pw Width in pixels.
+ *    @param[out] ph Height in pixels.
+ */
+static void window_cacheRect( Window *w, int *px, int *py, int *pw, int *ph )
+{
+   int x2, y2;
+
+   /* Same conversion as gl_clipRect, with a pixel of margin. */
+   *px = (int)floor( (w->x + gl_screen.x) / gl_screen.mxscale ) - 1;
+   *py = (int)floor( (w->y + gl_screen.y) / gl_screen.myscale ) - 1;
+   x2  = (int)ceil( (w->x + w->w + gl_screen.x) / gl_screen.mxscale ) + 1;
+   y2  = (int)ceil( (w->y + w->h + gl_screen.y) / gl_screen.myscale ) + 1;
+
+   /* Must be on the screen. */
+   *px = MAX( *px, 0 );
+   *py = MAX( *py, 0 );
+   *pw = MIN( x2, gl_screen.rw ) - *px;
+   *ph = MIN( y2, gl_screen.rh ) - *py;
+}
+
+
+/**
+ * @brief Renders the static content of a window to its cache.
+ *
+ *    @param w Window to update cache of.
+ *    @param stop First widget not to cache.
+ *    @return 0 on success.
+ */
+static int window_cacheUpdate( Window *w, Widget *stop )
+{
+   int px, py, pw, ph, tw, th;
+   GLfloat clear[4];
+
+   if (toolkit_cacheCheck())
+      return -1;
+
+   window_cacheRect( w, &px, &py, &pw, &ph );
+   if ((pw <= 0) || (ph <= 0))
+      return -1;
+
+   /* Render to the framebuffer, it has the same layout as the screen. */
+   nglBindFramebuffer( GL_FRAMEBUFFER_EXT, toolkit_fbo );
+   glGetFloatv( GL_COLOR_CLEAR_VALUE, clear );
+   glClearColor( 0., 0., 0., 0. );
+   glClear( GL_COLOR_BUFFER_BIT );
+   glClearColor( clear[0], clear[1], clear[2], clear[3] );
+   /* Colour gets premultiplied while alpha accumulates normally, which is what
+    *  window_cacheRender() expects. */
+   nglBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA,
+         GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   if (!window_isFlag( w, WINDOW_NOBORDER ))
+      window_renderBorder(w);
+   window_renderWidgets( w, w->widgets, stop );
+   glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+   /* Copy the pixels to the window's own texture. */
+   tw = gl_needPOT() ? gl_pot(pw) : pw;
+   th = gl_needPOT() ? gl_pot(ph) : ph;
+   if (w->cache_tex == 0)
+      glGenTextures( 1, &w->cache_tex );
+   glBindTexture( GL_TEXTURE_2D, w->cache_tex );
+   if ((tw != w->cache_tw) || (th != w->cache_th)) {
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP );
+      glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP );
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, tw, th, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+      w->cache_tw = tw;
+      w->cache_th = th;
+   }
+   glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, px, py, pw, ph );
+   nglBindFramebuffer( GL_FRAMEBUFFER_EXT, 0 );
+
+   /* Check for errors. */
+   gl_checkErr();
+
+   w->cache_px    = px;
+   w->cache_py    = py;
+   w->cache_pw    = pw;
+   w->cache_ph    = ph;
+   w->cache_stop  = stop;
+   w->dirty       = 0;
+   return 0;
+}
+
+
+/**
+ * @brief Draws the cached content of a window.
+ *
+ *    @param w Window to draw cache of.
+ */
+static void window_cacheRender( Window *w )
+{
+   glTexture tex;
+
+   memset( &tex, 0, sizeof(glTexture) );
+   tex.texture = w->cache_tex;
+
+   /* Content was blended onto a transparent buffer so it's premultiplied. */
+   glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+   gl_blitTexture( &tex,
+         w->cache_px * gl_screen.mxscale - gl_screen.x,
+         w->cache_py * gl_screen.myscale - gl_screen.y,
+         w->cache_pw * gl_screen.mxscale,
+         w->cache_ph * gl_screen.myscale,
+         0., 0.,
+         (double)w->cache_pw / (double)w->cache_tw,
+         (double)w->cache_ph / (double)w->cache_th, NULL );
+   glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+}
+
+
+/**
+ * @brief Makes sure the framebuffer used for caching windows is ready.
+ *
+ *    @return 0 if windows can be cached.
+ */
+static int toolkit_cacheCheck (void)
+{
+   Window *wdw;
+   GLenum status;
+   int w, h;
+
+   if ((nglGenFramebuffers == NULL) || (nglBlendFuncSeparate == NULL) ||
+         toolkit_fboFailed)
+      return -1;
+
+   /* Already good. */
+   w = gl_needPOT() ? gl_pot(gl_screen.rw) : gl_screen.rw;
+   h = gl_needPOT() ? gl_pot(gl_screen.rh) : gl_screen.rh;
+   if ((toolkit_fbo != 0) && (w == toolkit_fboW) && (h == toolkit_fboH))
+      return 0;
+
+   /* Create the framebuffer. */
+   toolkit_cacheFree();
+   glGenTextures( 1, &toolkit_fboTex );
+   glBindTexture( GL_TEXTURE_2D, toolkit_fboTex );
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+   glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+   glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0,
+         GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+   nglGenFramebuffers( 1, &toolkit_fbo );
+   nglBindFramebuffer( GL_FRAMEBUFFER_EXT, toolkit_fbo );
+   nglFramebufferTexture2D( GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT,
+         GL_TEXTURE_2D, toolkit_fboTex, 0 );
+   status = nglCheckFramebufferStatus( GL_FRAMEBUFFER_EXT );
+   nglBindFramebuffer( GL_FRAMEBUFFER_EXT, 0 );
+   if (status != GL_FRAMEBUFFER_COMPLETE_EXT) {
+      WARN("Unable to create toolkit framebuffer, windows will not be cached.");
+      toolkit_cacheFree();
+      toolkit_fboFailed = 1;
+      return -1;
+   }
+   toolkit_fboW = w;
+   toolkit_fboH = h;
+
+   /* Screen changed, everything has to be rendered again. */
+   for (wdw = windows; wdw != NULL; wdw = wdw->next)
+      wdw->dirty = 1;
+
+   return 0;
+}
+
+
+/**
+ * @brief Frees the framebuffer used for caching windows.
+ */
+static void toolkit_cacheFree (void)
+{
+   if (toolkit_fbo != 0)
+      nglDeleteFramebuffers( 1, &toolkit_fbo );
+   if (toolkit_fboTex != 0)
+      glDeleteTextures( 1, &toolkit_fboTex );
+   toolkit_fbo    = 0;
+   toolkit_fboTex = 0;
+   toolkit_fboW   = 0;
+   toolkit_fboH   = 0;
 }
 
 
@@ -1560,13 +1891,15 @@ void toolkit_render (void)
    Window *w;
 
    /* Render base. */
+   toolkit_rendering = 1;
    for (w = windows; w!=NULL; w = w->next) {
       if (!window_isFlag(w, WINDOW_NORENDER) &&
             !window_isFlag(w, WINDOW_KILL)) {
-         window_render(w);
+         window_renderCached(w);
          window_renderOverlay(w);
       }
    }
+   toolkit_rendering = 0;
 }
 
 
@@ -1599,6 +1932,9 @@ int toolkit_inputWindow( Window *wdw, SDL_Event *event, int purge )
    Widget *wgt;
    ret = 0;
 
+   /* Input can change anything in the window. */
+   window_dirty( wdw );
+
    /* See if widget needs event. */
    for (wgt=wdw->widgets; wgt!=NULL; wgt=wgt->next) {
       if (wgt_isFlag( wgt, WGT_FLAG_RAWINPUT )) {
@@ -2127,6 +2463,7 @@ void toolkit_update (void)
    wdw = toolkit_getActiveWindow();
    if (wdw == NULL)
       return;
+   window_dirty( wdw );
 
    /* See if widget needs event. */
    for (wgt=wdw->widgets; wgt!=NULL; wgt=wgt->next) {
@@ -2422,5 +2759,8 @@ void toolkit_exit (void)
    /* Free the VBO. */
    gl_vboDestroy( toolkit_vbo );
    toolkit_vbo = NULL;
+
+   /* Free the cache. */
+   toolkit_cacheFree();
 }
 
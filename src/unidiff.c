@@ -123,10 +123,20 @@ static int diff_nstack = 0; /**< Number of diffs in the stack. */
 static int diff_mstack = 0; /**< Currently allocated diffs. */
 
 
+/*
+ * Batching.
+ */
+static int diff_batch      = 0; /**< Nesting of diff_begin(). */
+static char *diff_buf      = NULL; /**< Unidiff file kept loaded while batching. */
+static xmlDocPtr diff_doc  = NULL; /**< Parsed unidiff file kept while batching. */
+
+
 /*
  * Prototypes.
  */
 static UniDiff_t* diff_get( const char *name );
+static xmlNodePtr diff_open (void);
+static void diff_close (void);
 static UniDiff_t *diff_newDiff (void);
 static int diff_removeDiff( UniDiff_t *diff );
 static int diff_patchSystem( UniDiff_t *diff, xmlNodePtr node );
@@ -173,63 +183,133 @@ static UniDiff_t* diff_get( const char *name )
 
 
 /**
- * @brief Applies a diff to the universe.
+ * @brief Starts applying and removing diffs as a batch.
  *
- *    @param name Diff to apply.
- *    @return 0 on success.
+ * The global rebuilds every diff needs (jumps, presence, economy, overlay)
+ *  are done once at diff_commit() instead of after each diff, and the
+ *  unidiff file is only parsed once. Calls can be nested.
  */
-int diff_apply( const char *name )
+void diff_begin (void)
 {
-   xmlNodePtr node;
-   xmlDocPtr doc;
-   uint32_t bufsize;
-   char *buf;
-   char *diffname;
+   if (diff_batch++ == 0)
+      space_deferStart();
+}
 
-   /* Check if already applied. */
-   if (diff_isApplied(name))
-      return 0;
 
-   buf = ndata_read( DIFF_DATA_PATH, &bufsize );
-   doc = xmlParseMemory( buf, bufsize );
+/**
+ * @brief Finishes a batch started with diff_begin().
+ */
+void diff_commit (void)
+{
+   if (diff_batch <= 0) {
+      WARN("Committing unidiffs without diff_begin()!");
+      return;
+   }
+   if (--diff_batch > 0)
+      return;
+
+   diff_close();
+   space_deferEnd();
+
+   /* Update overlay map just in case. */
+   ovr_refresh();
+}
 
-   node = doc->xmlChildrenNode;
+
+/**
+ * @brief Gets the first diff in the unidiff file, loading it if needed.
+ *
+ *    @return First node of the unidiff file or NULL on error.
+ */
+static xmlNodePtr diff_open (void)
+{
+   uint32_t bufsize;
+   xmlNodePtr node;
+
+   if (diff_doc == NULL) {
+      diff_buf = ndata_read( DIFF_DATA_PATH, &bufsize );
+      if (diff_buf == NULL) {
+         WARN("Unable to read '"DIFF_DATA_PATH"'.");
+         return NULL;
+      }
+      diff_doc = xmlParseMemory( diff_buf, bufsize );
+      if (diff_doc == NULL) {
+         diff_close();
+         return NULL;
+      }
+   }
+
+   node = diff_doc->xmlChildrenNode;
    if (strcmp((char*)node->name,"unidiffs")) {
       ERR("Malformed unidiff file: missing root element 'unidiffs'");
-      return 0;
+      return NULL;
    }
 
    node = node->xmlChildrenNode; /* first system node */
    if (node == NULL) {
       ERR("Malformed unidiff file: does not contain elements");
-      return 0;
+      return NULL;
    }
 
-   do {
-      if (xml_isNode(node,"unidiff")) {
-         /* Check to see if it's the diff we're looking for. */
-         xmlr_attr(node,"name",diffname);
-         if (strcmp(diffname,name)==0) {
-            /* Apply it. */
-            diff_patch( node );
-
-            /* Clean up. */
-            free(diffname);
-            xmlFreeDoc(doc);
-            free(buf);
+   return node;
+}
 
-            return 0;
-         }
-         free(diffname);
-      }
-   } while (xml_nextNode(node));
 
-   /* More clean up. */
-   xmlFreeDoc(doc);
-   free(buf);
+/**
+ * @brief Frees the loaded unidiff file.
+ */
+static void diff_close (void)
+{
+   if (diff_doc != NULL)
+      xmlFreeDoc( diff_doc );
+   free( diff_buf );
+   diff_doc = NULL;
+   diff_buf = NULL;
+}
 
-   WARN("UniDiff '%s' not found in "DIFF_DATA_PATH".", name);
-   return -1;
+
+/**
+ * @brief Applies a diff to the universe.
+ *
+ *    @param name Diff to apply.
+ *    @return 0 on success.
+ */
+int diff_apply( const char *name )
+{
+   xmlNodePtr node;
+   char *diffname;
+   int ret;
+
+   /* Check if already applied. */
+   if (diff_isApplied(name))
+      return 0;
+
+   diff_begin();
+   node = diff_open();
+   ret  = -1;
+   if (node == NULL)
+      ret = 0;
+   else {
+      do {
+         if (xml_isNode(node,"unidiff")) {
+            /* Check to see if it's the diff we're looking for. */
+            xmlr_attr(node,"name",diffname);
+            if (strcmp(diffname,name)==0) {
+               /* Apply it. */
+               diff_patch( node );
+               free(diffname);
+               ret = 0;
+               break;
+            }
+            free(diffname);
+         }
+      } while (xml_nextNode(node));
+   }
+   diff_commit();
+
+   if (ret)
+      WARN("UniDiff '%s' not found in "DIFF_DATA_PATH".", name);
+   return ret;
 }
 
 
@@ -527,12 +607,10 @@ static int diff_patch( xmlNodePtr parent )
       }
    }
 
-   /* Prune presences if necessary. */
+   /* Prune presences if necessary, deferred until the batch is committed. */
    if (univ_update)
       space_reconstructPresences();
 
-   /* Update overlay map just in case. */
-   ovr_refresh();
    return 0;
 }
 
@@ -645,7 +723,9 @@ void diff_remove( const char *name )
    if (diff == NULL)
       return;
 
+   diff_begin();
    diff_removeDiff(diff);
+   diff_commit();
 }
 
 
@@ -654,8 +734,10 @@ void diff_remove( const char *name )
  */
 void diff_clear (void)
 {
+   diff_begin();
    while (diff_nstack > 0)
       diff_removeDiff(&diff_stack[diff_nstack-1]);
+   diff_commit();
 }
 
 
@@ -829,6 +911,8 @@ int diff_load( xmlNodePtr parent )
 {
    xmlNodePtr node, cur;
 
+   /* Everything gets rebuilt once all the diffs are in. */
+   diff_begin();
    diff_clear();
 
    node = parent->xmlChildrenNode;
@@ -842,6 +926,7 @@ int diff_load( xmlNodePtr parent )
       }
    } while (xml_nextNode(node));
 
+   diff_commit();
    return 0;
 
 }
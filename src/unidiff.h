@@ -12,6 +12,8 @@ int diff_apply( const char *name );
 void diff_remove( const char *name );
 void diff_clear (void);
 int diff_isApplied( const char *name );
+void diff_begin (void);
+void diff_commit (void);
 
 
 #endif /* UNIDIFF_H */
@@ -634,6 +634,17 @@ static void weapons_updateLayer( const double dt, const WeaponLayer layer )
 }
 
 
+/**
+ * @brief Gets the number of weapons in flight.
+ *
+ *    @return Number of weapons in both layers.
+ */
+int weapon_count (void)
+{
+   return nwbackLayer + nwfrontLayer;
+}
+
+
 /**
  * @brief Renders all the weapons in a layer.
  *
@@ -52,6 +52,7 @@ void weapon_explode( double x, double y, double radius,
  */
 void weapons_update( const double dt );
 void weapons_render( const WeaponLayer layer, const double dt );
+int weapon_count (void);
 
 
 /*
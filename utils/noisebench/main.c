@@ -0,0 +1,163 @@
+/*
+ * See Licensing and Copyright notice in naev.h
+ */
+
+/**
+ * @file main.c
+ *
+ * @brief Benchmarks the nebula noise generation.
+ *
+ * Times the vectorized tiled generator against the reference scalar one that
+ *  uses a job per layer, at the resolutions the nebula usually gets generated
+ *  at. Both get the same seed so the results are also checked to match.
+ */
+
+
+#include <stdlib.h> /* exit() */
+#include <stdio.h> /* printf() */
+#include <stdint.h> /* uint32_t */
+#include <unistd.h> /* getopt */
+#include <getopt.h> /* getopt_long */
+
+#include "SDL.h"
+
+#include "perlin.h"
+#include "rng.h"
+#include "threadpool.h"
+
+
+#define BENCH_SEED      0x6e617665 /**< Seed used for all the runs. */
+#define BENCH_LAYERS    16 /**< Same as NEBULA_Z. */
+#define BENCH_RUG       5. /**< Same rugosity the nebula uses. */
+
+
+typedef float* (*bench_gen)( const int w, const int h, const int n, float rug );
+
+
+static void print_usage( char* appname )
+{
+   printf(
+         "Usage is: %s [options] [WIDTHxHEIGHT ...]\n"
+         "   Defaults to 1920x1080 and 3840x2160.\n"
+         "   Options:\n"
+         "     -n LAYERS   Number of layers to generate (default %d).\n"
+         "     -r RUNS     Number of runs to average (default 1).\n"
+         , appname, BENCH_LAYERS );
+}
+
+
+/**
+ * @brief Runs a generator and checksums the output.
+ *
+ *    @param gen Generator to run.
+ *    @param w Width.
+ *    @param h Height.
+ *    @param n Layers.
+ *    @param[out] sum Checksum of the output.
+ *    @return Milliseconds taken, negative on error.
+ */
+static int bench_run( bench_gen gen, int w, int h, int n, double *sum )
+{
+   unsigned int t;
+   float *map;
+   long i;
+
+   rng_seed( BENCH_SEED );
+   t   = SDL_GetTicks();
+   map = gen( w, h, n, BENCH_RUG );
+   t   = SDL_GetTicks() - t;
+   if (map == NULL)
+      return -1;
+
+   *sum = 0.;
+   for (i=0; i<(long)w*h*n; i++)
+      *sum += map[i];
+   free(map);
+
+   return t;
+}
+
+
+int main( int argc, char** argv )
+{
+   static struct option long_options[] = {
+      { "help", no_argument, 0, 'h' },
+      { "layers", required_argument, 0, 'n' },
+      { "runs", required_argument, 0, 'r' },
+      { NULL, 0, 0, 0 }
+   };
+   static const char *defaults[] = { "1920x1080", "3840x2160" };
+   const char **sizes;
+   int option_index;
+   int c, i, j, n, runs, nsizes;
+   int w, h, ts, tv, ret;
+   double sums, sumv;
+
+   /* Handle parameters. */
+   n     = BENCH_LAYERS;
+   runs  = 1;
+   while ((c = getopt_long( argc, argv,
+         "hn:r:",
+         long_options, &option_index)) != -1) {
+      switch (c) {
+         case 'n':
+            n = atoi( optarg );
+            break;
+         case 'r':
+            runs = atoi( optarg );
+            break;
+         default:
+            print_usage( argv[0] );
+            exit(EXIT_SUCCESS);
+      }
+   }
+   if ((n <= 0) || (runs <= 0)) {
+      print_usage( argv[0] );
+      exit(EXIT_FAILURE);
+   }
+   if (optind < argc) {
+      sizes  = (const char**) &argv[optind];
+      nsizes = argc - optind;
+   }
+   else {
+      sizes  = defaults;
+      nsizes = sizeof(defaults) / sizeof(defaults[0]);
+   }
+
+   if (SDL_Init( SDL_INIT_TIMER )) {
+      fprintf( stderr, "Unable to initialize SDL: %s\n", SDL_GetError() );
+      exit(EXIT_FAILURE);
+   }
+   threadpool_init();
+
+   ret = EXIT_SUCCESS;
+   printf( "%-12s %12s %12s %9s  %s\n", "size", "scalar (ms)", "tiled (ms)", "speedup", "match" );
+   for (i=0; i<nsizes; i++) {
+      if ((sscanf( sizes[i], "%dx%d", &w, &h ) != 2) || (w <= 0) || (h <= 0)) {
+         fprintf( stderr, "Invalid size '%s'\n", sizes[i] );
+         ret = EXIT_FAILURE;
+         continue;
+      }
+
+      ts = tv = 0;
+      for (j=0; j<runs; j++) {
+         ts += bench_run( noise_genNebulaMapScalar, w, h, n, &sums );
+         tv += bench_run( noise_genNebulaMap, w, h, n, &sumv );
+      }
+      if ((ts < 0) || (tv < 0)) {
+         fprintf( stderr, "Unable to generate '%s'\n", sizes[i] );
+         ret = EXIT_FAILURE;
+         continue;
+      }
+      ts /= runs;
+      tv /= runs;
+
+      printf( "%-12s %12d %12d %8.2fx  %s\n", sizes[i], ts, tv,
+            (double)ts / (double)((tv > 0) ? tv : 1), (sums == sumv) ? "yes" : "NO" );
+      if (sums != sumv)
+         ret = EXIT_FAILURE;
+   }
+
+   SDL_Quit();
+   exit(ret);
+}